@@ -0,0 +1,35 @@
+#include "ClockSync.h"
+
+ClockSync::ClockSync() : next(0), count(0), offset(0)
+{
+}
+
+void ClockSync::sample(uint32_t senderTime, uint32_t localTime)
+{
+  uint32_t sample = localTime - senderTime;
+
+  // A rebooted or different sender has an unrelated clock, forget the old one
+  int32_t error = (int32_t)(sample - offset);
+  if (count > 0 && (error > CLOCK_SYNC_RESET_US || error < -CLOCK_SYNC_RESET_US))
+  {
+    count = 0;
+    next = 0;
+  }
+
+  samples[next] = sample;
+  next = (next + 1) % CLOCK_SYNC_SAMPLES;
+  if (count < CLOCK_SYNC_SAMPLES)
+  {
+    count++;
+  }
+
+  // Offsets wrap with micros(), compare them by difference
+  offset = samples[0];
+  for (uint8_t i = 1; i < count; i++)
+  {
+    if ((int32_t)(samples[i] - offset) < 0)
+    {
+      offset = samples[i];
+    }
+  }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+#define CLOCK_SYNC_SAMPLES 16       // Commits the offset estimate looks back over
+#define CLOCK_SYNC_RESET_US 100000  // A sample this far off the estimate means a new clock, start over
+
+// Estimates the offset from a sender's micros() to ours from the timestamps
+// in its COMMIT packets.
+//
+// Every sample is local arrival time minus sender time: the real offset plus
+// that packet's transit and callback delay. The delay is never negative, so
+// the smallest recent sample is the best estimate, and a commit that was held
+// up does not move it. Receivers that heard the same broadcast then agree on
+// the sender's clock to within the spread of their fastest deliveries.
+class ClockSync
+{
+public:
+  ClockSync();
+
+  void sample(uint32_t senderTime, uint32_t localTime);
+
+  bool synced() const { return count > 0; }
+  uint32_t toLocal(uint32_t senderTime) const { return senderTime + offset; }
+
+private:
+  uint32_t samples[CLOCK_SYNC_SAMPLES];
+  uint8_t next;
+  uint8_t count;
+  uint32_t offset; // Smallest sample in the window
+};
@@ -0,0 +1,71 @@
+#include "ColorLut.h"
+#include <math.h>
+#include <string.h>
+
+// Ordered dither offsets in 1/256 steps. Every value is below 256, so 0 stays
+// 0 and 255 stays 255.
+static const uint8_t DITHER[8] = {0, 128, 64, 192, 32, 160, 96, 224};
+#define ROUND_OFFSET 128 // Plain rounding when dithering is off
+
+ColorLut::ColorLut(float gammaValue) : level(255), dither(true), frameCount(0)
+{
+  for (int i = 0; i < 256; i++)
+  {
+    gamma[i] = (uint16_t)(powf(i / 255.0f, gammaValue) * (255 << 8) + 0.5f);
+  }
+  build();
+}
+
+void ColorLut::setBrightness(uint8_t brightness)
+{
+  if (brightness == level)
+  {
+    return; // Table is already built for this level
+  }
+  level = brightness;
+  build();
+}
+
+void ColorLut::build()
+{
+  for (int i = 0; i < 256; i++)
+  {
+    table[i] = (uint32_t)gamma[i] * level / 255;
+  }
+}
+
+RGB ColorLut::apply(const RGB &color) const
+{
+  RGB out = {(uint8_t)((table[color.red] + ROUND_OFFSET) >> 8),
+             (uint8_t)((table[color.green] + ROUND_OFFSET) >> 8),
+             (uint8_t)((table[color.blue] + ROUND_OFFSET) >> 8)};
+  return out;
+}
+
+void ColorLut::render(const RGB *pixels, const LedSpan *spans, uint16_t spanCount, uint8_t *grb)
+{
+  frameCount++;
+  for (uint16_t s = 0; s < spanCount; s++)
+  {
+    const LedSpan &span = spans[s];
+    uint8_t *out = grb + span.firstLed * 3;
+    if (span.pixel == LED_UNMAPPED)
+    {
+      memset(out, 0, span.count * 3);
+      continue;
+    }
+
+    const RGB &color = pixels[span.pixel];
+    uint16_t green = table[color.green];
+    uint16_t red = table[color.red];
+    uint16_t blue = table[color.blue];
+    for (uint16_t i = span.firstLed; i < span.firstLed + span.count; i++)
+    {
+      uint16_t offset = dither ? DITHER[(i + frameCount) & 7] : ROUND_OFFSET;
+      out[0] = (green + offset) >> 8;
+      out[1] = (red + offset) >> 8;
+      out[2] = (blue + offset) >> 8;
+      out += 3;
+    }
+  }
+}
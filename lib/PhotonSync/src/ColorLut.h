@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include "FrameProtocol.h"
+#include "LedMap.h"
+
+// Gamma correction and brightness in one precomputed 256-entry table,
+// applied in a single pass while writing the strip's GRB buffer. Entries are
+// 8.8 fixed point, which leaves room for temporal dithering: the fraction
+// that a plain 8-bit table would drop is carried into the output by a small
+// offset that changes per LED and per frame, so dim fades stay smooth.
+class ColorLut
+{
+public:
+  explicit ColorLut(float gamma);
+
+  // Scale the table to brightness 0-255. Cheap, no pow() after construction.
+  void setBrightness(uint8_t brightness);
+  uint8_t brightness() const { return level; }
+
+  void setDithering(bool enabled) { dither = enabled; }
+
+  // Corrected colour of one pixel, without dithering
+  RGB apply(const RGB &color) const;
+
+  // Write the LEDs covered by spans into grb (3 bytes per LED, green first).
+  // Each span's colour is looked up once, LED_UNMAPPED spans are dark.
+  void render(const RGB *pixels, const LedSpan *spans, uint16_t spanCount, uint8_t *grb);
+
+private:
+  void build();
+
+  uint16_t gamma[256]; // Gamma curve at full brightness, 8.8 fixed point
+  uint16_t table[256]; // Gamma curve scaled by brightness, 8.8 fixed point
+  uint8_t level;
+  bool dither;
+  uint8_t frameCount; // Advances the dither pattern on every render
+};
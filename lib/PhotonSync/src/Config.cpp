@@ -0,0 +1,411 @@
+#include "Config.h"
+#include "Crc.h"
+#include <ArduinoJson.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CONFIG_IMAGE_MAGIC 0x46435350UL // "PSCF"
+#define CONFIG_IMAGE_VERSION 1          // Bump whenever PhotonConfig changes
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;     // Bytes of PhotonConfig that follow
+  uint32_t jsonSize; // config.json the image was built from
+  uint16_t jsonCrc;
+  uint16_t crc;      // Over everything before it and the config bytes
+} ImageHeader;
+
+#define IMAGE_CRC_OFFSET offsetof(ImageHeader, crc)
+#define CONFIG_FIXED_SIZE offsetof(PhotonConfig, segments)
+
+// Plain integer keys, stored into a uint8_t or uint16_t member
+typedef struct
+{
+  const char *key;
+  long min;
+  long max;
+  uint32_t bit;
+  size_t offset;
+  size_t size;
+} IntKey;
+
+#define INT_KEY(key, min, max, bit, member) \
+  {key, min, max, bit, offsetof(PhotonConfig, member), sizeof(((PhotonConfig *)0)->member)}
+
+static const IntKey INT_KEYS[] = {
+    INT_KEY("Channel", 0, 14, CONFIG_CHANNEL, channel),
+    INT_KEY("Num_Pixels", 0, FRAME_MAX_PIXELS, CONFIG_NUM_PIXELS, numPixels),
+    INT_KEY("Pixel_Index", 0, FRAME_MAX_PIXELS - 1, CONFIG_PIXEL_INDEX, pixelIndex),
+    INT_KEY("Latch_Delay_Ms", 0, 1000, CONFIG_LATCH_DELAY, latchDelayMs),
+    INT_KEY("Num_LED", 0, CONFIG_MAX_LEDS, CONFIG_NUM_LED, numLed),
+    INT_KEY("Serpentine", 0, CONFIG_MAX_LEDS, CONFIG_SERPENTINE, serpentine),
+    INT_KEY("Max_FPS", 0, 1000, CONFIG_MAX_FPS, maxFps),
+    INT_KEY("Render_Core", 0, 1, CONFIG_RENDER_CORE, renderCore),
+    INT_KEY("Render_Priority", 1, 24, CONFIG_RENDER_PRIORITY, renderPriority),
+};
+
+typedef struct
+{
+  const char *key;
+  uint32_t bit;
+  size_t offset;
+} BoolKey;
+
+static const BoolKey BOOL_KEYS[] = {
+    {"Broadcast", CONFIG_BROADCAST, offsetof(PhotonConfig, broadcast)},
+    {"Reverse", CONFIG_REVERSE, offsetof(PhotonConfig, reverse)},
+};
+
+static bool fail(ConfigError *error, const char *key, const char *message)
+{
+  error->key = key;
+  error->message = message;
+  return false;
+}
+
+static bool readInt(JsonVariantConst value, const char *key, long min, long max, long *out, ConfigError *error)
+{
+  if (!value.is<long>())
+  {
+    return fail(error, key, "must be a whole number");
+  }
+  long number = value.as<long>();
+  if (number < min || number > max)
+  {
+    return fail(error, key, "out of range");
+  }
+  *out = number;
+  return true;
+}
+
+bool parseMac(const char *text, uint8_t *mac)
+{
+  // Scan into unsigned ints, %x into the bytes themselves would write past them
+  unsigned int bytes[6];
+  char end;
+  if (text == NULL ||
+      sscanf(text, "%2x:%2x:%2x:%2x:%2x:%2x%c", &bytes[0], &bytes[1], &bytes[2],
+             &bytes[3], &bytes[4], &bytes[5], &end) != 6)
+  {
+    return false;
+  }
+  for (int i = 0; i < 6; i++)
+  {
+    mac[i] = bytes[i];
+  }
+  return true;
+}
+
+static bool parseOutputs(JsonVariantConst value, PhotonConfig *config, ConfigError *error)
+{
+  if (!value.is<JsonArrayConst>())
+  {
+    return fail(error, "Outputs", "must be a list of {\"Pin\", \"LEDs\"}");
+  }
+  JsonArrayConst outputs = value.as<JsonArrayConst>();
+  if (outputs.size() > CONFIG_MAX_OUTPUTS)
+  {
+    return fail(error, "Outputs", "too many outputs");
+  }
+  for (JsonVariantConst output : outputs)
+  {
+    long pin, leds;
+    if (!output.is<JsonObjectConst>())
+    {
+      return fail(error, "Outputs", "must be a list of {\"Pin\", \"LEDs\"}");
+    }
+    if (!readInt(output["Pin"], "Outputs.Pin", 0, 39, &pin, error) ||
+        !readInt(output["LEDs"], "Outputs.LEDs", 0, CONFIG_MAX_LEDS, &leds, error))
+    {
+      return false;
+    }
+    config->outputPins[config->numOutputs] = pin;
+    config->outputLeds[config->numOutputs] = leds;
+    config->numOutputs++;
+  }
+  return true;
+}
+
+bool parseConfig(const char *json, size_t len, PhotonConfig *config, ConfigError *error)
+{
+  memset(config, 0, sizeof(PhotonConfig));
+
+  JsonDocument doc;
+  DeserializationError result = deserializeJson(doc, json, len);
+  if (result)
+  {
+    return fail(error, NULL, result.c_str());
+  }
+  if (!doc.is<JsonObjectConst>())
+  {
+    return fail(error, NULL, "must be a JSON object");
+  }
+  JsonObjectConst root = doc.as<JsonObjectConst>();
+
+  for (size_t i = 0; i < sizeof(INT_KEYS) / sizeof(INT_KEYS[0]); i++)
+  {
+    const IntKey &key = INT_KEYS[i];
+    JsonVariantConst value = root[key.key];
+    long number;
+    if (value.isNull())
+    {
+      continue;
+    }
+    if (!readInt(value, key.key, key.min, key.max, &number, error))
+    {
+      return false;
+    }
+    uint8_t *member = (uint8_t *)config + key.offset;
+    if (key.size == 1)
+    {
+      *member = number;
+    }
+    else
+    {
+      *(uint16_t *)member = number;
+    }
+    config->present |= key.bit;
+  }
+
+  for (size_t i = 0; i < sizeof(BOOL_KEYS) / sizeof(BOOL_KEYS[0]); i++)
+  {
+    const BoolKey &key = BOOL_KEYS[i];
+    JsonVariantConst value = root[key.key];
+    if (value.isNull())
+    {
+      continue;
+    }
+    if (!value.is<bool>())
+    {
+      return fail(error, key.key, "must be true or false");
+    }
+    *(bool *)((uint8_t *)config + key.offset) = value.as<bool>();
+    config->present |= key.bit;
+  }
+
+  JsonVariantConst value = root["Receiver_Address"];
+  if (!value.isNull())
+  {
+    if (!parseMac(value.as<const char *>(), config->receiverAddress))
+    {
+      return fail(error, "Receiver_Address", "must look like \"AA:BB:CC:DD:EE:FF\"");
+    }
+    config->present |= CONFIG_RECEIVER_ADDRESS;
+  }
+
+  value = root["Start_Color"];
+  if (!value.isNull())
+  {
+    long channels[3];
+    if (!value.is<JsonArrayConst>() || value.size() != 3)
+    {
+      return fail(error, "Start_Color", "must be [red, green, blue]");
+    }
+    for (int i = 0; i < 3; i++)
+    {
+      if (!readInt(value[i], "Start_Color", 0, 255, &channels[i], error))
+      {
+        return false;
+      }
+    }
+    config->startColor.red = channels[0];
+    config->startColor.green = channels[1];
+    config->startColor.blue = channels[2];
+    config->present |= CONFIG_START_COLOR;
+  }
+
+  value = root["Segments"];
+  if (!value.isNull())
+  {
+    if (!value.is<JsonArrayConst>() || value.size() > CONFIG_MAX_SEGMENTS)
+    {
+      return fail(error, "Segments", "must be a list of at most 2048 LED counts");
+    }
+    for (JsonVariantConst segment : value.as<JsonArrayConst>())
+    {
+      long leds;
+      if (!readInt(segment, "Segments", 0, CONFIG_MAX_LEDS, &leds, error))
+      {
+        return false;
+      }
+      config->segments[config->numSegments++] = leds;
+    }
+    config->present |= CONFIG_SEGMENTS;
+  }
+
+  value = root["Outputs"];
+  if (!value.isNull())
+  {
+    if (!parseOutputs(value, config, error))
+    {
+      return false;
+    }
+    config->present |= CONFIG_OUTPUTS;
+  }
+  return true;
+}
+
+const char *configSourceName(ConfigSource source)
+{
+  switch (source)
+  {
+  case CONFIG_CACHED:
+    return "cache";
+  case CONFIG_PARSED:
+    return "config.json";
+  case CONFIG_STALE:
+    return "cache of an older config.json";
+  default:
+    return "defaults";
+  }
+}
+
+size_t configImageSize(const PhotonConfig &config)
+{
+  return sizeof(ImageHeader) + CONFIG_FIXED_SIZE + config.numSegments * sizeof(uint16_t);
+}
+
+size_t packConfig(const PhotonConfig &config, uint32_t jsonSize, uint16_t jsonCrc, uint8_t *out, size_t capacity)
+{
+  size_t size = configImageSize(config);
+  if (capacity < size)
+  {
+    return 0;
+  }
+
+  ImageHeader header;
+  header.magic = CONFIG_IMAGE_MAGIC;
+  header.version = CONFIG_IMAGE_VERSION;
+  header.size = size - sizeof(ImageHeader);
+  header.jsonSize = jsonSize;
+  header.jsonCrc = jsonCrc;
+  memcpy(&out[sizeof(ImageHeader)], &config, header.size);
+  header.crc = crc16(&out[sizeof(ImageHeader)], header.size, crc16((const uint8_t *)&header, IMAGE_CRC_OFFSET));
+  memcpy(out, &header, sizeof(ImageHeader));
+  return size;
+}
+
+bool unpackConfig(const uint8_t *image, size_t len, uint32_t jsonSize, uint16_t jsonCrc, PhotonConfig *config)
+{
+  ImageHeader header;
+  if (len < sizeof(ImageHeader) + CONFIG_FIXED_SIZE)
+  {
+    return false;
+  }
+  memcpy(&header, image, sizeof(ImageHeader));
+  if (header.magic != CONFIG_IMAGE_MAGIC || header.version != CONFIG_IMAGE_VERSION ||
+      header.size != len - sizeof(ImageHeader) || header.size > sizeof(PhotonConfig))
+  {
+    return false;
+  }
+  if (jsonSize != 0 && (header.jsonSize != jsonSize || header.jsonCrc != jsonCrc))
+  {
+    return false; // Built from a different config.json
+  }
+  const uint8_t *body = &image[sizeof(ImageHeader)];
+  if (crc16(body, header.size, crc16(image, IMAGE_CRC_OFFSET)) != header.crc)
+  {
+    return false;
+  }
+
+  PhotonConfig unpacked;
+  memset(&unpacked, 0, sizeof(PhotonConfig));
+  memcpy(&unpacked, body, header.size);
+  if (unpacked.numOutputs > CONFIG_MAX_OUTPUTS || unpacked.numSegments > CONFIG_MAX_SEGMENTS ||
+      configImageSize(unpacked) != len)
+  {
+    return false;
+  }
+  memcpy(config, &unpacked, sizeof(PhotonConfig));
+  return true;
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <memory>
+
+ConfigSource loadConfigFile(fs::FS &fs, PhotonConfig *config)
+{
+  // config.json, NUL-terminated for the parser
+  std::unique_ptr<char[]> json;
+  size_t jsonSize = 0;
+  uint16_t jsonCrc = 0;
+  if (!fs.exists(CONFIG_FILE))
+  {
+    Serial.println("Config file does not exist");
+  }
+  else
+  {
+    File jsonFile = fs.open(CONFIG_FILE, "r");
+    size_t size = jsonFile ? jsonFile.size() : 0;
+    if (size > CONFIG_MAX_JSON)
+    {
+      Serial.println("Config file size is too large");
+    }
+    else if (size > 0)
+    {
+      json.reset(new char[size + 1]);
+      jsonSize = jsonFile.readBytes(json.get(), size);
+      json[jsonSize] = '\0';
+      jsonCrc = crc16((const uint8_t *)json.get(), jsonSize);
+    }
+    jsonFile.close();
+  }
+
+  // The cache, from this or an earlier config.json
+  std::unique_ptr<uint8_t[]> image;
+  size_t imageSize = 0;
+  if (fs.exists(CONFIG_CACHE_FILE))
+  {
+    File imageFile = fs.open(CONFIG_CACHE_FILE, "r");
+    size_t size = imageFile ? imageFile.size() : 0;
+    if (size <= sizeof(ImageHeader) + sizeof(PhotonConfig))
+    {
+      image.reset(new uint8_t[size]);
+      imageSize = imageFile.read(image.get(), size);
+    }
+    imageFile.close();
+  }
+
+  if (jsonSize > 0 && imageSize > 0 && unpackConfig(image.get(), imageSize, jsonSize, jsonCrc, config))
+  {
+    return CONFIG_CACHED;
+  }
+
+  if (jsonSize > 0)
+  {
+    ConfigError error;
+    if (parseConfig(json.get(), jsonSize, config, &error))
+    {
+      size_t size = configImageSize(*config);
+      std::unique_ptr<uint8_t[]> packed(new uint8_t[size]);
+      packConfig(*config, jsonSize, jsonCrc, packed.get(), size);
+      File imageFile = fs.open(CONFIG_CACHE_FILE, "w");
+      if (!imageFile || imageFile.write(packed.get(), size) != size)
+      {
+        Serial.println("Failed to write the config cache");
+      }
+      imageFile.close();
+      return CONFIG_PARSED;
+    }
+
+    Serial.print("Invalid config file: ");
+    if (error.key != NULL)
+    {
+      Serial.print(error.key);
+      Serial.print(" ");
+    }
+    Serial.println(error.message);
+  }
+
+  if (imageSize > 0 && unpackConfig(image.get(), imageSize, 0, 0, config))
+  {
+    Serial.println("Using the last valid config instead");
+    return CONFIG_STALE;
+  }
+  memset(config, 0, sizeof(PhotonConfig));
+  return CONFIG_DEFAULTS;
+}
+#endif
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FrameProtocol.h"
+#include "RGB.h"
+
+// Settings shared by the senders and receivers, read from config.json.
+//
+// The JSON is validated once against the schema below, then cached in SPIFFS
+// as a compact binary image keyed by the JSON's size and CRC. Later boots
+// with the same config.json only checksum the file and copy the image.
+// Every key is optional. A key that is present but has the wrong type or
+// range rejects the whole file, and the error names the key.
+//
+//   Channel           0-14
+//   Receiver_Address  "AA:BB:CC:DD:EE:FF"
+//   Broadcast         true/false
+//   Num_Pixels        0-2048
+//   Pixel_Index       0-2047
+//   Start_Color       [R, G, B], 0-255 each
+//   Latch_Delay_Ms    0-1000                 sender-gh
+//   Num_LED           0-2048                 receiver
+//   Reverse           true/false             receiver
+//   Serpentine        0-2048                 receiver
+//   Segments          [LEDs, ...]            receiver, up to 2048 entries
+//   Max_FPS           0-1000                 receiver
+//   Render_Core       0-1                    receiver
+//   Render_Priority   1-24                   receiver
+//   Outputs           [{"Pin": 0-39, "LEDs": 0-2048}, ...]  receiver, up to 8
+
+#define CONFIG_FILE "/config.json"
+#define CONFIG_CACHE_FILE "/config.bin"
+#define CONFIG_MAX_JSON 16384  // Largest config.json accepted
+#define CONFIG_MAX_LEDS 2048
+#define CONFIG_MAX_OUTPUTS 8
+#define CONFIG_MAX_SEGMENTS FRAME_MAX_PIXELS
+
+// Bits of PhotonConfig::present, set for every key config.json had
+#define CONFIG_CHANNEL (1UL << 0)
+#define CONFIG_RECEIVER_ADDRESS (1UL << 1)
+#define CONFIG_BROADCAST (1UL << 2)
+#define CONFIG_NUM_PIXELS (1UL << 3)
+#define CONFIG_PIXEL_INDEX (1UL << 4)
+#define CONFIG_START_COLOR (1UL << 5)
+#define CONFIG_LATCH_DELAY (1UL << 6)
+#define CONFIG_NUM_LED (1UL << 7)
+#define CONFIG_REVERSE (1UL << 8)
+#define CONFIG_SERPENTINE (1UL << 9)
+#define CONFIG_SEGMENTS (1UL << 10)
+#define CONFIG_MAX_FPS (1UL << 11)
+#define CONFIG_RENDER_CORE (1UL << 12)
+#define CONFIG_RENDER_PRIORITY (1UL << 13)
+#define CONFIG_OUTPUTS (1UL << 14)
+
+// Keys missing from the file are left out of present, each target keeps its
+// own default for them. segments must stay the last member, the cache only
+// stores the entries in use.
+typedef struct
+{
+  uint32_t present;
+  uint8_t channel;
+  uint8_t receiverAddress[6];
+  bool broadcast;
+  uint16_t numPixels;
+  uint16_t pixelIndex;
+  RGB startColor;
+  uint16_t latchDelayMs;
+  uint16_t numLed;
+  bool reverse;
+  uint16_t serpentine;
+  uint16_t maxFps;
+  uint8_t renderCore;
+  uint8_t renderPriority;
+  uint8_t numOutputs;
+  uint8_t outputPins[CONFIG_MAX_OUTPUTS];
+  uint16_t outputLeds[CONFIG_MAX_OUTPUTS];
+  uint16_t numSegments;
+  uint16_t segments[CONFIG_MAX_SEGMENTS];
+} PhotonConfig;
+
+// Why a config.json was rejected
+typedef struct
+{
+  const char *key;     // Offending key, NULL if the file as a whole is bad
+  const char *message;
+} ConfigError;
+
+// Where loadConfigFile() got its settings from
+enum ConfigSource
+{
+  CONFIG_DEFAULTS = 0, // No usable config.json and no cache, nothing is present
+  CONFIG_CACHED,       // The binary cache matched config.json
+  CONFIG_PARSED,       // config.json was parsed and the cache rewritten
+  CONFIG_STALE,        // config.json is invalid, the cache of an older one was used
+};
+
+const char *configSourceName(ConfigSource source);
+
+// Parse and validate a config.json. json must be NUL-terminated at json[len].
+// Returns true and fills config, or false and fills error.
+bool parseConfig(const char *json, size_t len, PhotonConfig *config, ConfigError *error);
+
+// Parse "AA:BB:CC:DD:EE:FF" into 6 bytes
+bool parseMac(const char *text, uint8_t *mac);
+
+// The binary cache image. jsonSize and jsonCrc identify the config.json it
+// was built from.
+size_t configImageSize(const PhotonConfig &config);
+size_t packConfig(const PhotonConfig &config, uint32_t jsonSize, uint16_t jsonCrc, uint8_t *out, size_t capacity);
+
+// Returns true if image is intact, of this firmware's layout, and was built
+// from a config.json of jsonSize and jsonCrc. Pass jsonSize 0 to accept an
+// image of any config.json.
+bool unpackConfig(const uint8_t *image, size_t len, uint32_t jsonSize, uint16_t jsonCrc, PhotonConfig *config);
+
+#ifdef ARDUINO
+#include <FS.h>
+
+// Load the config the fastest valid way: the cache if it matches config.json,
+// otherwise parse config.json and rewrite the cache. Errors are printed.
+ConfigSource loadConfigFile(fs::FS &fs, PhotonConfig *config);
+#endif
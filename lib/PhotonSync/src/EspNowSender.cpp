@@ -0,0 +1,90 @@
+#include "EspNowSender.h"
+#include "Telemetry.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_now.h>
+#include <atomic>
+#include <string.h>
+
+static esp_now_peer_info_t peerInfo;
+static TxRing *txRing = NULL;
+static std::atomic<uint32_t> startedAt(0); // micros() the packet in the air was started
+
+static void onDataSent(const uint8_t *mac_addr, esp_now_send_status_t status)
+// Runs in the WiFi task: record the completion and start the next packet
+{
+  bool delivered = status == ESP_NOW_SEND_SUCCESS;
+  telemetry.count(delivered ? TELEMETRY_PACKETS_ACKED : TELEMETRY_PACKETS_FAILED);
+  telemetry.record(TELEMETRY_ACK_US, micros() - startedAt.load(std::memory_order_relaxed));
+  if (txRing != NULL)
+  {
+    txRing->onSent(delivered); // May start the next packet
+  }
+}
+
+bool beginEspNowSender(const uint8_t *peer, uint8_t channel, TxRing *ring, bool verbose)
+{
+  txRing = ring;
+
+  // Initialize Wi-Fi
+  WiFi.mode(WIFI_STA);
+  Serial.println("Connecting to WiFi...");
+
+  // Initialize ESP Now
+  if (esp_now_init() != ESP_OK)
+  {
+    Serial.println("Error initializing ESP-NOW");
+    return false;
+  }
+  else if (verbose)
+  {
+    Serial.println("She's giving ESP-Ussy");
+  }
+
+  // Register callback
+  esp_now_register_send_cb(onDataSent);
+
+  // Register peer
+  memcpy(peerInfo.peer_addr, peer, 6);
+  peerInfo.channel = channel;
+  peerInfo.encrypt = false;
+  if (verbose)
+  {
+    Serial.print("Broadcasting at the bus stop on ");
+    for (int i = 0; i < 6; i++)
+    {
+      // Print each byte with a colon separator
+      Serial.print(peerInfo.peer_addr[i], HEX);
+      Serial.print(":");
+    }
+    Serial.println();
+  }
+
+  // Add peer
+  if (esp_now_add_peer(&peerInfo) != ESP_OK)
+  {
+    Serial.println("Failed to add peer");
+    return false;
+  }
+  else if (verbose)
+  {
+    Serial.println("and you are on the list ;)");
+  }
+  return true;
+}
+
+bool espNowSend(const uint8_t *data, size_t len)
+// Called from loop() or from onDataSent
+{
+  startedAt.store(micros(), std::memory_order_relaxed); // Before sending, the callback can run first
+  if (esp_now_send(peerInfo.peer_addr, data, len) != ESP_OK)
+  {
+    telemetry.count(TELEMETRY_TX_REFUSED);
+    return false;
+  }
+  telemetry.count(TELEMETRY_PACKETS_SENT);
+  return true;
+}
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "TxRing.h"
+
+// ESP-NOW setup shared by the senders: WiFi station mode, one peer, and the
+// send callback wired to a TxRing so every completion starts the next packet.
+// Only built for the ESP32, the rest of the library also builds on a PC.
+
+#ifdef ARDUINO
+// Bring up WiFi and ESP-NOW and add peer on channel. Prints progress when
+// verbose. Returns false if ESP-NOW or the peer could not be set up.
+bool beginEspNowSender(const uint8_t *peer, uint8_t channel, TxRing *ring, bool verbose);
+
+// TxRing transport, sends to the peer given to beginEspNowSender()
+bool espNowSend(const uint8_t *data, size_t len);
+#endif
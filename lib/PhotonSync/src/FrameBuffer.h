@@ -0,0 +1,17 @@
+#pragma once
+
+#include "FrameProtocol.h"
+
+// Colour of every pixel index the receiver buffers. Preallocated and indexed
+// directly by pixel index, so the receive path never allocates and the render
+// loop reads each LED's colour with a single load.
+typedef struct
+{
+  RGB pixels[FRAME_MAX_PIXELS];
+  FadeCommand fades[FRAME_MAX_FADES]; // Fades that start with this frame, pixels already hold their targets
+  uint8_t fadeCount;
+  SceneTable scenes; // Loaded scenes and their triggers, kept from frame to frame like the pixels
+  bool latched;     // A staged frame, show it at latchAt rather than right away
+  uint32_t latchAt; // micros() to show the frame at
+  uint8_t frameId;  // Frame ID of the packets that built it, 0 for legacy and restored frames
+} FrameBuffer;
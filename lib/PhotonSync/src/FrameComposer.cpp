@@ -0,0 +1,21 @@
+#include "FrameComposer.h"
+#include <string.h>
+
+FrameComposer::FrameComposer()
+{
+  memset(pixels, 0, sizeof(pixels));
+}
+
+void FrameComposer::compose(const FrameBuffer &frame, bool newFrame, unsigned long now, unsigned long startAt)
+{
+  if (newFrame)
+  {
+    // Fades start from whatever the LEDs show now
+    for (uint8_t f = 0; f < frame.fadeCount; f++)
+    {
+      fader.start(frame.fades[f], pixels, startAt);
+    }
+  }
+  fader.compose(frame.pixels, pixels, now);
+  scenes.render(frame.scenes, pixels, FRAME_MAX_PIXELS, now, startAt);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include "FrameBuffer.h"
+#include "PixelFader.h"
+#include "Scene.h"
+
+// What the LEDs show for the frames the renderer takes: the frame's pixels
+// with its fades and scenes running over them. Shared by the receiver's
+// render task and the simulator.
+class FrameComposer
+{
+public:
+  FrameComposer();
+
+  // Compose frame as it looks at now (millis()) into shown(). A new frame's
+  // fades and triggered scenes start at startAt, its latch time if it has
+  // one.
+  void compose(const FrameBuffer &frame, bool newFrame, unsigned long now, unsigned long startAt);
+
+  // A fade or scene moves the LEDs without a new frame
+  bool animating() const { return fader.active() || scenes.active(); }
+
+  // Colour of every pixel index as of the last compose()
+  const RGB *shown() const { return pixels; }
+
+private:
+  PixelFader fader;
+  SceneEngine scenes;
+  RGB pixels[FRAME_MAX_PIXELS];
+};
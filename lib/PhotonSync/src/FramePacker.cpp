@@ -0,0 +1,239 @@
+#include "FramePacker.h"
+#include <string.h>
+
+FramePacker::FramePacker(const PacketSink &sink, unsigned long maxDelayMs)
+    : sink(sink), maxDelayMs(maxDelayMs), batchPixels(PACKER_MAX_PIXELS), quantizeBits(0), firstQueuedAt(0),
+      dirtyCount(0), dirtyFirst(FRAME_MAX_PIXELS), dirtyLast(0), seenFirst(FRAME_MAX_PIXELS), seenLast(0),
+      resumeFrom(FRAME_MAX_PIXELS), resumeLast(0), resumeKeyframe(false), keyframeDue(false),
+      sequence(0), frameId(0), latchDelayMs(0), clock(NULL), commitsPending(0)
+{
+  memset(exact, 0, sizeof(exact));
+  memset(frame, 0, sizeof(frame));
+  memset(sent, 0, sizeof(sent));
+  memset(dirty, 0, sizeof(dirty));
+}
+
+void FramePacker::add(const Pixel &pixel, unsigned long now)
+{
+  RGB color = {pixel.red, pixel.green, pixel.blue};
+  queue(pixel.index, color, now);
+
+  if (dirtyCount >= batchPixels)
+  {
+    flush(); // A refused flush keeps the pixels, poll() retries them
+  }
+}
+
+void FramePacker::set(uint16_t start, const RGB *colors, uint16_t count, unsigned long now)
+{
+  for (uint16_t i = 0; i < count && start + i < FRAME_MAX_PIXELS; i++)
+  {
+    queue(start + i, colors[i], now);
+  }
+}
+
+// Drop the low bits of each channel, filling them from the high ones so
+// full brightness stays 255
+static uint8_t quantize(uint8_t channel, uint8_t bits)
+{
+  uint8_t high = channel & (0xFF << bits);
+  return high | (high >> (8 - bits));
+}
+
+static RGB quantize(RGB color, uint8_t bits)
+{
+  if (bits == 0)
+  {
+    return color;
+  }
+  RGB out = {quantize(color.red, bits), quantize(color.green, bits), quantize(color.blue, bits)};
+  return out;
+}
+
+void FramePacker::queue(uint16_t index, RGB color, unsigned long now)
+{
+  exact[index] = color;
+  frame[index] = quantize(color, quantizeBits);
+
+  if (index < seenFirst)
+  {
+    seenFirst = index;
+  }
+  if (index > seenLast)
+  {
+    seenLast = index;
+  }
+
+  if (dirty[index / 32] & (1UL << (index % 32)))
+  {
+    return; // Already pending, the newest value is sent with it
+  }
+  dirty[index / 32] |= 1UL << (index % 32);
+  if (dirtyCount++ == 0)
+  {
+    firstQueuedAt = now;
+  }
+  if (index < dirtyFirst)
+  {
+    dirtyFirst = index;
+  }
+  if (index > dirtyLast)
+  {
+    dirtyLast = index;
+  }
+}
+
+void FramePacker::setLatch(uint16_t latchDelayMs, PacketClock clock)
+{
+  this->latchDelayMs = clock != NULL ? latchDelayMs : 0;
+  this->clock = clock;
+}
+
+void FramePacker::setPacing(size_t batchPixels, uint8_t quantizeBits, unsigned long now)
+{
+  this->batchPixels = batchPixels > 0 ? batchPixels : 1;
+  if (quantizeBits >= this->quantizeBits)
+  {
+    this->quantizeBits = quantizeBits; // Coarser from the next change on, what was sent is close enough
+    return;
+  }
+
+  this->quantizeBits = quantizeBits;
+  for (uint32_t i = seenFirst; i <= seenLast && i < FRAME_MAX_PIXELS; i++)
+  {
+    if (quantize(exact[i], quantizeBits) != frame[i])
+    {
+      queue(i, exact[i], now);
+    }
+  }
+}
+
+bool FramePacker::poll(unsigned long now)
+{
+  if (commitsPending > 0 && !sendCommits())
+  {
+    return false;
+  }
+  bool resuming = resumeFrom < FRAME_MAX_PIXELS;
+  if (!resuming && (dirtyCount == 0 || now - firstQueuedAt < maxDelayMs))
+  {
+    return true;
+  }
+  return flush();
+}
+
+bool FramePacker::flush()
+{
+  bool resuming = resumeFrom < FRAME_MAX_PIXELS;
+  if (dirtyCount == 0 && !resuming)
+  {
+    return true;
+  }
+  commitsPending = 0; // This frame replaces the staged one on the receivers
+
+  // Finish a frame that was cut short before starting the next one. Starting
+  // over instead would never get to the end of a frame while the radio is
+  // the bottleneck and new pixels keep arriving.
+  bool keyframe = resuming ? resumeKeyframe : keyframeDue || frameId % PACKER_KEYFRAME_INTERVAL == 0;
+  uint16_t first = resuming ? resumeFrom : keyframe ? seenFirst : dirtyFirst;
+  uint16_t last = resuming ? resumeLast : keyframe ? seenLast : dirtyLast;
+  if (!sendRange(first, last - first + 1, keyframe))
+  {
+    return false;
+  }
+
+  frameId++;
+  resumeFrom = FRAME_MAX_PIXELS;
+  keyframeDue = keyframeDue && !keyframe;
+  findDirtyRange(); // Pixels that changed behind the resume point go in the next frame
+
+  if (latchDelayMs > 0)
+  {
+    commitsPending = PACKER_COMMIT_REPEAT;
+    return sendCommits(); // A refused commit is retried by poll()
+  }
+  return true;
+}
+
+bool FramePacker::sendCommits()
+{
+  while (commitsPending > 0)
+  {
+    uint8_t *packet = sink.reserve();
+    if (packet == NULL)
+    {
+      return false;
+    }
+    FrameHeader header = {(uint8_t)(sequence == 0 ? FRAME_FLAG_SEQ_RESET : 0), (uint8_t)(frameId - 1), sequence};
+    FrameCommit commit = {clock(), latchDelayMs};
+    sink.send(writeCommit(packet, DATASIZE, header, commit));
+    sequence++;
+    commitsPending--;
+  }
+  return true;
+}
+
+bool FramePacker::sendRange(uint16_t first, uint16_t count, bool keyframe)
+{
+  FrameHeader header = {0, frameId, 0};
+
+  uint16_t done = 0;
+  while (done < count)
+  {
+    uint8_t *packet = sink.reserve();
+    if (packet == NULL)
+    {
+      // Resume from here next time, under the same frame ID. The packets
+      // already sent are kept in sent, so the retry only carries the rest.
+      resumeFrom = first + done;
+      resumeLast = first + count - 1;
+      resumeKeyframe = keyframe;
+      return false;
+    }
+
+    uint16_t consumed;
+    header.sequence = sequence;
+    header.flags = sequence == 0 ? FRAME_FLAG_SEQ_RESET : 0; // Receivers forget what they knew about us
+    if (latchDelayMs > 0)
+    {
+      header.flags |= FRAME_FLAG_STAGED;
+    }
+    sink.send(encodeFrame(packet, DATASIZE, header, frame, keyframe ? NULL : sent, first + done, count - done,
+                          &consumed));
+    memcpy(&sent[first + done], &frame[first + done], consumed * sizeof(RGB));
+    clearDirty(first + done, consumed);
+    sequence++;
+    done += consumed;
+  }
+  return true;
+}
+
+void FramePacker::clearDirty(uint16_t first, uint16_t count)
+{
+  for (uint16_t i = first; i < first + count; i++)
+  {
+    if (dirty[i / 32] & (1UL << (i % 32)))
+    {
+      dirty[i / 32] &= ~(1UL << (i % 32));
+      dirtyCount--;
+    }
+  }
+}
+
+void FramePacker::findDirtyRange()
+{
+  dirtyFirst = FRAME_MAX_PIXELS;
+  dirtyLast = 0;
+  for (uint16_t word = 0; word < FRAME_MAX_PIXELS / 32; word++)
+  {
+    if (dirty[word] == 0)
+    {
+      continue;
+    }
+    if (dirtyFirst == FRAME_MAX_PIXELS)
+    {
+      dirtyFirst = word * 32 + __builtin_ctz(dirty[word]);
+    }
+    dirtyLast = word * 32 + 31 - __builtin_clz(dirty[word]);
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FrameProtocol.h"
+#include "Pixel.h"
+
+#define DATASIZE FRAME_MAX_PACKET // Largest payload ESP-NOW will carry in one packet
+#define PACKER_MAX_PIXELS (DATASIZE / sizeof(Pixel))  // Flush after as many changes as one legacy Pixel packet held
+#define PACKER_KEYFRAME_INTERVAL 32 // Every Nth frame is sent in full so a receiver that missed a packet recovers
+#define PACKER_COMMIT_REPEAT 2      // COMMIT packets sent per staged frame, broadcasts are never retried
+
+// Where the packer builds its packets, on the senders a TxRing slot so a
+// packet is encoded in place instead of copied in. reserve() returns a
+// DATASIZE byte buffer for the next packet, or NULL if the radio cannot take
+// one now. send() queues the len bytes written to the buffer reserve() last
+// returned.
+typedef struct
+{
+  uint8_t *(*reserve)();
+  void (*send)(size_t len);
+} PacketSink;
+
+// Returns micros(), stamped into COMMIT packets
+typedef uint32_t (*PacketClock)();
+
+// Collects Pixels from Grasshopper into frames instead of sending them one by
+// one. A frame is encoded once PACKER_MAX_PIXELS pixels changed, or once the
+// oldest change has waited maxDelayMs. Only pixels that differ from what was
+// last sent go out, run-length and delta encoded (see FrameProtocol.h).
+//
+// setPacing() trades detail for air time when the link is congested (see
+// RateController.h).
+class FramePacker
+{
+public:
+  FramePacker(const PacketSink &sink, unsigned long maxDelayMs);
+
+  // Queue a pixel. A newer value for the same index replaces the older one.
+  void add(const Pixel &pixel, unsigned long now);
+
+  // Queue a run of count colours starting at pixel start, as one frame from
+  // the binary serial protocol. Does not flush on its own; the caller calls
+  // flush() once the frame is complete. Pixels past FRAME_MAX_PIXELS are
+  // dropped.
+  void set(uint16_t start, const RGB *colors, uint16_t count, unsigned long now);
+
+  // Flush if the oldest change is past its deadline. Call every loop.
+  bool poll(unsigned long now);
+
+  // Send every pending change. Whatever the sink has no room for stays
+  // pending and is sent with its newest value on the next flush.
+  bool flush();
+
+  // Stage every frame and follow it with a COMMIT, so all receivers show it
+  // latchDelayMs after it was sent. 0 shows frames as they arrive.
+  void setLatch(uint16_t latchDelayMs, PacketClock clock);
+
+  // Flush legacy pixels batchPixels at a time and drop the low quantizeBits
+  // bits of every channel. Pixels whose colour comes out different once fewer
+  // bits are dropped are queued again, so the detail comes back when the link
+  // recovers.
+  void setPacing(size_t batchPixels, uint8_t quantizeBits, unsigned long now);
+
+  // Send the next frame in full, for receivers that missed a packet
+  void requestKeyframe() { keyframeDue = true; }
+
+  size_t pending() const { return dirtyCount; }
+
+private:
+  bool sendCommits();
+  void queue(uint16_t index, RGB color, unsigned long now);
+  bool sendRange(uint16_t first, uint16_t count, bool keyframe);
+  void clearDirty(uint16_t first, uint16_t count);
+  void findDirtyRange();
+
+  PacketSink sink;
+  unsigned long maxDelayMs;
+  size_t batchPixels;
+  uint8_t quantizeBits;
+  unsigned long firstQueuedAt; // millis() when the oldest pending change was queued
+  RGB exact[FRAME_MAX_PIXELS]; // Newest colour of every pixel
+  RGB frame[FRAME_MAX_PIXELS]; // The same, quantized, what is sent
+  RGB sent[FRAME_MAX_PIXELS];  // Colour the receivers were last sent
+  uint32_t dirty[FRAME_MAX_PIXELS / 32];
+  size_t dirtyCount;
+  uint16_t dirtyFirst, dirtyLast; // Range of changed pixels
+  uint16_t seenFirst, seenLast;   // Range of every pixel ever queued, covered by keyframes
+  uint16_t resumeFrom, resumeLast; // Rest of a frame a refused packet cut short, resumeFrom is FRAME_MAX_PIXELS if none
+  bool resumeKeyframe;
+  bool keyframeDue;
+  uint16_t sequence;
+  uint8_t frameId;
+  uint16_t latchDelayMs;
+  PacketClock clock;
+  uint8_t commitsPending; // COMMIT packets still to send for frame frameId - 1
+};
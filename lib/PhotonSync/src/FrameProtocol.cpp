@@ -0,0 +1,578 @@
+#include "FrameProtocol.h"
+#include <string.h>
+
+#define RECORD_HEADER_SIZE 3      // opcode, start, count
+#define WIDE_RECORD_HEADER_SIZE 5 // opcode, start lo, hi, count lo, hi
+#define FADE_OPERAND_SIZE (sizeof(RGB) + 2)
+#define LOAD_HEADER_SIZE 4    // opcode, slot, flags, step count
+#define TRIGGER_SIZE 3        // opcode, slot, action
+
+FrameWriter::FrameWriter(uint8_t *buffer, size_t capacity)
+    : buffer(buffer), capacity(capacity), used(0), openSet(0), wide(false)
+{
+}
+
+void FrameWriter::begin(const FrameHeader &header)
+{
+  buffer[0] = FRAME_MAGIC;
+  buffer[1] = header.flags & FRAME_FLAGS_V2 ? FRAME_VERSION : FRAME_VERSION_BASIC;
+  buffer[2] = header.flags;
+  buffer[3] = header.frameId;
+  buffer[4] = header.sequence & 0xFF;
+  buffer[5] = header.sequence >> 8;
+  used = FRAME_HEADER_SIZE;
+  openSet = 0;
+  wide = header.flags & FRAME_FLAG_WIDE;
+}
+
+void FrameWriter::setFlags(uint8_t flags)
+{
+  // The record layout is fixed once records are written
+  buffer[2] = (flags & ~FRAME_FLAG_WIDE) | (wide ? FRAME_FLAG_WIDE : 0);
+  if (buffer[2] & FRAME_FLAGS_V2)
+  {
+    buffer[1] = FRAME_VERSION;
+  }
+}
+
+bool FrameWriter::fits(uint16_t start, uint32_t count, size_t operandSize) const
+{
+  size_t headerSize = wide ? WIDE_RECORD_HEADER_SIZE : RECORD_HEADER_SIZE;
+  return count > 0 && count <= maxRun() && start + count <= maxPixels() &&
+         remaining() >= headerSize + operandSize;
+}
+
+void FrameWriter::writeRecordHeader(uint8_t op, uint16_t start, uint16_t count)
+{
+  buffer[used++] = op;
+  if (wide)
+  {
+    buffer[used++] = start & 0xFF;
+    buffer[used++] = start >> 8;
+    buffer[used++] = count & 0xFF;
+    buffer[used++] = count >> 8;
+  }
+  else
+  {
+    buffer[used++] = start;
+    buffer[used++] = count;
+  }
+}
+
+bool FrameWriter::set(uint16_t start, const RGB *colors, uint16_t count)
+{
+  if (!fits(start, count, count * sizeof(RGB)))
+  {
+    return false;
+  }
+  openSet = used;
+  writeRecordHeader(FRAME_OP_SET, start, count);
+  memcpy(&buffer[used], colors, count * sizeof(RGB));
+  used += count * sizeof(RGB);
+  return true;
+}
+
+bool FrameWriter::fill(uint16_t start, uint16_t count, RGB color)
+{
+  if (!fits(start, count, sizeof(RGB)))
+  {
+    return false;
+  }
+  openSet = 0;
+  writeRecordHeader(FRAME_OP_FILL, start, count);
+  memcpy(&buffer[used], &color, sizeof(RGB));
+  used += sizeof(RGB);
+  return true;
+}
+
+bool FrameWriter::add(uint16_t start, uint16_t count, RGB delta)
+{
+  if (!fits(start, count, sizeof(RGB)))
+  {
+    return false;
+  }
+  openSet = 0;
+  writeRecordHeader(FRAME_OP_ADD, start, count);
+  memcpy(&buffer[used], &delta, sizeof(RGB));
+  used += sizeof(RGB);
+  return true;
+}
+
+bool FrameWriter::fade(uint16_t start, uint16_t count, RGB target, uint16_t durationMs)
+{
+  if (!fits(start, count, FADE_OPERAND_SIZE))
+  {
+    return false;
+  }
+  openSet = 0;
+  buffer[1] = FRAME_VERSION;
+  writeRecordHeader(FRAME_OP_FADE, start, count);
+  memcpy(&buffer[used], &target, sizeof(RGB));
+  used += sizeof(RGB);
+  buffer[used++] = durationMs & 0xFF;
+  buffer[used++] = durationMs >> 8;
+  return true;
+}
+
+bool FrameWriter::load(uint8_t slot, const Scene &scene)
+{
+  if (slot >= SCENE_SLOTS || scene.stepCount == 0 || scene.stepCount > SCENE_MAX_STEPS ||
+      remaining() < LOAD_HEADER_SIZE + (size_t)scene.stepCount * FRAME_SCENE_STEP_SIZE)
+  {
+    return false;
+  }
+  openSet = 0;
+  buffer[1] = FRAME_VERSION;
+  buffer[used++] = FRAME_OP_LOAD;
+  buffer[used++] = slot;
+  buffer[used++] = scene.flags;
+  buffer[used++] = scene.stepCount;
+  for (uint8_t s = 0; s < scene.stepCount; s++)
+  {
+    const SceneStep &step = scene.steps[s];
+    buffer[used++] = step.effect;
+    buffer[used++] = step.start & 0xFF;
+    buffer[used++] = step.start >> 8;
+    buffer[used++] = step.count & 0xFF;
+    buffer[used++] = step.count >> 8;
+    memcpy(&buffer[used], &step.a, sizeof(RGB));
+    used += sizeof(RGB);
+    memcpy(&buffer[used], &step.b, sizeof(RGB));
+    used += sizeof(RGB);
+    buffer[used++] = step.durationMs & 0xFF;
+    buffer[used++] = step.durationMs >> 8;
+    buffer[used++] = step.width;
+    buffer[used++] = step.repeat;
+  }
+  return true;
+}
+
+bool FrameWriter::trigger(uint8_t slot, SceneAction action)
+{
+  if (slot >= SCENE_SLOTS || remaining() < TRIGGER_SIZE)
+  {
+    return false;
+  }
+  openSet = 0;
+  buffer[1] = FRAME_VERSION;
+  buffer[used++] = FRAME_OP_TRIGGER;
+  buffer[used++] = slot;
+  buffer[used++] = action;
+  return true;
+}
+
+bool FrameWriter::extend(RGB color)
+{
+  if (openSet == 0 || remaining() < sizeof(RGB))
+  {
+    return false;
+  }
+
+  uint32_t start, count;
+  if (wide)
+  {
+    start = buffer[openSet + 1] | (buffer[openSet + 2] << 8);
+    count = buffer[openSet + 3] | (buffer[openSet + 4] << 8);
+  }
+  else
+  {
+    start = buffer[openSet + 1];
+    count = buffer[openSet + 2];
+  }
+  if (count + 1 > maxRun() || start + count + 1 > maxPixels())
+  {
+    return false;
+  }
+
+  count++;
+  if (wide)
+  {
+    buffer[openSet + 3] = count & 0xFF;
+    buffer[openSet + 4] = count >> 8;
+  }
+  else
+  {
+    buffer[openSet + 2] = count;
+  }
+  memcpy(&buffer[used], &color, sizeof(RGB));
+  used += sizeof(RGB);
+  return true;
+}
+
+static RGB difference(const RGB &to, const RGB &from)
+{
+  RGB delta = {(uint8_t)(to.red - from.red), (uint8_t)(to.green - from.green), (uint8_t)(to.blue - from.blue)};
+  return delta;
+}
+
+size_t encodeFrame(uint8_t *out, size_t capacity, const FrameHeader &header,
+                   const RGB *frame, const RGB *previous,
+                   uint16_t first, uint16_t count, uint16_t *consumed)
+{
+  FrameWriter writer(out, capacity);
+  FrameHeader packetHeader = header;
+  if (previous == NULL)
+  {
+    packetHeader.flags |= FRAME_FLAG_KEYFRAME;
+  }
+  if (first + count > FRAME_NARROW_PIXELS)
+  {
+    packetHeader.flags |= FRAME_FLAG_WIDE;
+  }
+  writer.begin(packetHeader);
+  const uint32_t maxRun = writer.maxRun();
+
+  const uint16_t end = first + count;
+  uint16_t i = first;
+  bool literalOpen = false; // The last record is a SET that the next literal pixel can join
+
+  while (i < end)
+  {
+    // Pixels the receiver already shows cost nothing in a delta frame
+    if (previous != NULL && frame[i] == previous[i])
+    {
+      literalOpen = false;
+      i++;
+      continue;
+    }
+
+    // Measure the runs starting here
+    uint16_t fillRun = 1;
+    while (i + fillRun < end && fillRun < maxRun && frame[i + fillRun] == frame[i])
+    {
+      fillRun++;
+    }
+    uint16_t addRun = 0;
+    RGB delta = {0, 0, 0};
+    if (previous != NULL)
+    {
+      delta = difference(frame[i], previous[i]);
+      addRun = 1;
+      while (i + addRun < end && addRun < maxRun &&
+             difference(frame[i + addRun], previous[i + addRun]) == delta)
+      {
+        addRun++;
+      }
+    }
+
+    // A run of two or more is cheaper as one FILL/ADD record than as literals
+    if (fillRun >= 2 || addRun >= 2)
+    {
+      bool written = fillRun >= addRun ? writer.fill(i, fillRun, frame[i]) : writer.add(i, addRun, delta);
+      if (!written)
+      {
+        break;
+      }
+      i += fillRun >= addRun ? fillRun : addRun;
+      literalOpen = false;
+      continue;
+    }
+
+    if (!(literalOpen && writer.extend(frame[i])))
+    {
+      if (!writer.set(i, &frame[i], 1))
+      {
+        break;
+      }
+    }
+    literalOpen = true;
+    i++;
+  }
+
+  *consumed = i - first;
+  if (i == end)
+  {
+    writer.setFlags(packetHeader.flags | FRAME_FLAG_LAST);
+  }
+  return writer.length();
+}
+
+bool isFramePacket(const uint8_t *data, size_t len)
+{
+  return len >= FRAME_HEADER_SIZE && data[0] == FRAME_MAGIC;
+}
+
+static FrameDecodeResult readSceneStep(const uint8_t *data, SceneStep *step)
+{
+  step->effect = data[0];
+  step->start = data[1] | (data[2] << 8);
+  step->count = data[3] | (data[4] << 8);
+  memcpy(&step->a, &data[5], sizeof(RGB));
+  memcpy(&step->b, &data[8], sizeof(RGB));
+  step->durationMs = data[11] | (data[12] << 8);
+  step->width = data[13];
+  step->repeat = data[14];
+
+  if (step->effect < SCENE_FADE || step->effect > SCENE_GRADIENT || step->count == 0 ||
+      (uint32_t)step->start + step->count > 0x10000 || step->durationMs == 0)
+  {
+    return FRAME_BAD_RECORD;
+  }
+  return FRAME_OK;
+}
+
+// Check one LOAD or TRIGGER record at *pos and move past it. With
+// target == NULL only validates.
+static FrameDecodeResult applySceneRecord(const uint8_t *data, size_t len, size_t *pos, FrameTarget *target)
+{
+  const uint8_t *record = &data[*pos];
+  size_t left = len - *pos;
+  SceneTable *scenes = target != NULL ? target->scenes : NULL;
+
+  if (record[0] == FRAME_OP_TRIGGER)
+  {
+    if (left < TRIGGER_SIZE)
+    {
+      return FRAME_TRUNCATED;
+    }
+    uint8_t slot = record[1];
+    uint8_t action = record[2];
+    if (slot >= SCENE_SLOTS || action > SCENE_PLAY)
+    {
+      return FRAME_BAD_RECORD;
+    }
+    if (scenes != NULL)
+    {
+      scenes->triggers[slot]++;
+      scenes->playing = action == SCENE_PLAY ? scenes->playing | (1 << slot) : scenes->playing & ~(1 << slot);
+    }
+    *pos += TRIGGER_SIZE;
+    return FRAME_OK;
+  }
+
+  if (left < LOAD_HEADER_SIZE)
+  {
+    return FRAME_TRUNCATED;
+  }
+  uint8_t slot = record[1];
+  uint8_t stepCount = record[3];
+  if (slot >= SCENE_SLOTS || stepCount == 0 || stepCount > SCENE_MAX_STEPS)
+  {
+    return FRAME_BAD_RECORD;
+  }
+  size_t size = LOAD_HEADER_SIZE + stepCount * FRAME_SCENE_STEP_SIZE;
+  if (left < size)
+  {
+    return FRAME_TRUNCATED;
+  }
+
+  Scene scene;
+  memset(&scene, 0, sizeof(scene));
+  scene.flags = record[2];
+  scene.stepCount = stepCount;
+  for (uint8_t s = 0; s < stepCount; s++)
+  {
+    if (readSceneStep(&record[LOAD_HEADER_SIZE + s * FRAME_SCENE_STEP_SIZE], &scene.steps[s]) != FRAME_OK)
+    {
+      return FRAME_BAD_RECORD;
+    }
+  }
+  if (scenes != NULL)
+  {
+    scenes->slots[slot] = scene; // A playing scene carries on with the new steps
+  }
+  *pos += size;
+  return FRAME_OK;
+}
+
+// Walk the records of a packet. With target == NULL only validates.
+static FrameDecodeResult applyRecords(const uint8_t *data, size_t len, FrameTarget *target)
+{
+  const bool wide = data[2] & FRAME_FLAG_WIDE;
+  const size_t headerSize = wide ? WIDE_RECORD_HEADER_SIZE : RECORD_HEADER_SIZE;
+  const uint32_t maxPixels = wide ? 0x10000 : FRAME_NARROW_PIXELS;
+
+  size_t pos = FRAME_HEADER_SIZE;
+  while (pos < len)
+  {
+    if (data[pos] == FRAME_OP_LOAD || data[pos] == FRAME_OP_TRIGGER)
+    {
+      FrameDecodeResult result = applySceneRecord(data, len, &pos, target);
+      if (result != FRAME_OK)
+      {
+        return result;
+      }
+      continue;
+    }
+
+    if (len - pos < headerSize)
+    {
+      return FRAME_TRUNCATED;
+    }
+    uint8_t op = data[pos];
+    uint32_t start, count;
+    if (wide)
+    {
+      start = data[pos + 1] | (data[pos + 2] << 8);
+      count = data[pos + 3] | (data[pos + 4] << 8);
+    }
+    else
+    {
+      start = data[pos + 1];
+      count = data[pos + 2];
+    }
+    pos += headerSize;
+
+    if (count == 0 || start + count > maxPixels)
+    {
+      return FRAME_BAD_RECORD;
+    }
+
+    size_t operandSize;
+    switch (op)
+    {
+    case FRAME_OP_SET:
+      operandSize = count * sizeof(RGB);
+      break;
+    case FRAME_OP_FILL:
+    case FRAME_OP_ADD:
+      operandSize = sizeof(RGB);
+      break;
+    case FRAME_OP_FADE:
+      operandSize = FADE_OPERAND_SIZE;
+      break;
+    default:
+      return FRAME_BAD_RECORD;
+    }
+    if (len - pos < operandSize)
+    {
+      return FRAME_TRUNCATED;
+    }
+
+    // Clip the record to the window
+    uint32_t first = start;
+    uint32_t end = start + count;
+    if (target != NULL)
+    {
+      uint32_t windowEnd = target->windowStart + target->windowCount;
+      if (windowEnd > target->size)
+      {
+        windowEnd = target->size;
+      }
+      first = start > target->windowStart ? start : target->windowStart;
+      end = end < windowEnd ? end : windowEnd;
+    }
+
+    if (target != NULL && first < end)
+    {
+      RGB *frame = target->pixels;
+      const RGB *operand = (const RGB *)&data[pos];
+      switch (op)
+      {
+      case FRAME_OP_SET:
+        memcpy(&frame[first], &operand[first - start], (end - first) * sizeof(RGB));
+        break;
+      case FRAME_OP_FILL:
+        for (uint32_t i = first; i < end; i++)
+        {
+          frame[i] = *operand;
+        }
+        break;
+      case FRAME_OP_ADD:
+        for (uint32_t i = first; i < end; i++)
+        {
+          frame[i].red += operand->red;
+          frame[i].green += operand->green;
+          frame[i].blue += operand->blue;
+        }
+        break;
+      case FRAME_OP_FADE:
+        for (uint32_t i = first; i < end; i++)
+        {
+          frame[i] = *operand;
+        }
+        if (target->fades != NULL && target->fadeCount < target->maxFades)
+        {
+          FadeCommand &fade = target->fades[target->fadeCount++];
+          fade.start = first;
+          fade.count = end - first;
+          fade.target = *operand;
+          fade.durationMs = data[pos + sizeof(RGB)] | (data[pos + sizeof(RGB) + 1] << 8);
+        }
+        break;
+      }
+    }
+    pos += operandSize;
+  }
+  return FRAME_OK;
+}
+
+FrameDecodeResult readFrameHeader(const uint8_t *data, size_t len, FrameHeader *header)
+{
+  if (!isFramePacket(data, len))
+  {
+    return FRAME_NOT_FRAME;
+  }
+  if (data[1] < FRAME_VERSION_BASIC || data[1] > FRAME_VERSION ||
+      (data[1] == FRAME_VERSION_BASIC && (data[2] & FRAME_FLAGS_V2)))
+  {
+    return FRAME_BAD_VERSION;
+  }
+
+  header->flags = data[2];
+  header->frameId = data[3];
+  header->sequence = data[4] | (data[5] << 8);
+  return FRAME_OK;
+}
+
+FrameDecodeResult decodeFrame(const uint8_t *data, size_t len, FrameHeader *header, FrameTarget *target)
+{
+  FrameHeader packetHeader;
+  FrameDecodeResult result = readFrameHeader(data, len, &packetHeader);
+  if (result != FRAME_OK)
+  {
+    return result;
+  }
+  if (packetHeader.flags & FRAME_FLAG_COMMIT)
+  {
+    return FRAME_IS_COMMIT;
+  }
+
+  result = applyRecords(data, len, NULL);
+  if (result != FRAME_OK)
+  {
+    return result;
+  }
+
+  *header = packetHeader;
+  return applyRecords(data, len, target);
+}
+
+size_t writeCommit(uint8_t *out, size_t capacity, const FrameHeader &header, const FrameCommit &commit)
+{
+  if (capacity < FRAME_COMMIT_SIZE)
+  {
+    return 0;
+  }
+  FrameHeader commitHeader = header;
+  commitHeader.flags = (header.flags & FRAME_FLAG_SEQ_RESET) | FRAME_FLAG_COMMIT;
+  FrameWriter writer(out, capacity);
+  writer.begin(commitHeader);
+
+  uint8_t *operands = &out[FRAME_HEADER_SIZE];
+  for (int i = 0; i < 4; i++)
+  {
+    operands[i] = commit.senderTime >> (8 * i);
+  }
+  operands[4] = commit.latchDelayMs & 0xFF;
+  operands[5] = commit.latchDelayMs >> 8;
+  return FRAME_COMMIT_SIZE;
+}
+
+FrameDecodeResult decodeCommit(const uint8_t *data, size_t len, FrameHeader *header, FrameCommit *commit)
+{
+  FrameDecodeResult result = readFrameHeader(data, len, header);
+  if (result != FRAME_OK)
+  {
+    return result;
+  }
+  if (!(header->flags & FRAME_FLAG_COMMIT) || len < FRAME_COMMIT_SIZE)
+  {
+    return FRAME_TRUNCATED;
+  }
+
+  const uint8_t *operands = &data[FRAME_HEADER_SIZE];
+  commit->senderTime = operands[0] | (operands[1] << 8) | (operands[2] << 16) | ((uint32_t)operands[3] << 24);
+  commit->latchDelayMs = operands[4] | (operands[5] << 8);
+  return FRAME_OK;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "RGB.h"
+#include "Scene.h"
+
+// PhotonSync frame packet, shared by the senders and the receiver.
+//
+//   byte 0     FRAME_MAGIC
+//   byte 1     version, see below
+//   byte 2     flags (FRAME_FLAG_*)
+//   byte 3     frame ID, the same for every packet of one frame
+//   byte 4-5   sequence number, little-endian, +1 for every packet sent
+//              by the same sender. Receivers drop repeats and late packets.
+//   byte 6..   records, each one opcode byte followed by its operands
+//
+// Records carry absolute pixel indices, so every packet of a frame can be
+// applied on its own. Pixels a delta frame does not mention keep the value
+// they had in the previous frame.
+//
+// A record's start and count are one byte each, which addresses pixels
+// 0-255. Packets with FRAME_FLAG_WIDE carry them as 16-bit little-endian
+// values instead. Encoders only set the flag when a frame reaches past
+// pixel 255, so small installations stay readable by older receivers.
+//
+// LOAD and TRIGGER records drive the receiver's scenes (Scene.h) and have no
+// start and count. Their fields are the same in narrow and wide packets:
+//
+//   LOAD       slot, flags, step count, then per step: effect, start lo, hi,
+//              count lo, hi, a RGB, b RGB, ms lo, hi, width, repeat
+//   TRIGGER    slot, SceneAction
+//
+// A frame carrying a TRIGGER starts the scene when the frame is shown, so a
+// staged frame starts it on every receiver at its latch time.
+//
+// Frames flagged FRAME_FLAG_STAGED are held by the receivers once complete.
+// A COMMIT packet (FRAME_FLAG_COMMIT) names the frame ID and carries no
+// records, only
+//
+//   byte 6-9   sender time in microseconds, little-endian
+//   byte 10-11 latch delay in milliseconds, little-endian
+//
+// Every receiver shows the frame latch delay after the sender time, converted
+// to its own clock, so fixtures driven by different receivers change on the
+// same tick.
+//
+// Every packet carries the lowest version that reads it correctly. Version 1
+// is the header with narrow SET, FILL and ADD records, the only thing the
+// first receivers understood, and those drop any other version whole. A
+// packet that is wide, staged or a COMMIT, or carries FADE, LOAD or TRIGGER
+// records, is version 2, so an old receiver never applies 16-bit fields as
+// 8-bit ones or shows a staged frame unlatched. SEQ_RESET needs no bump, an
+// old receiver has no sequence to reset.
+//
+// Packets that do not start with FRAME_MAGIC are the legacy format: a raw
+// array of 4-byte Pixel {index, red, green, blue} structs. The magic is a
+// pixel index no legacy packet of FRAME_HEADER_SIZE bytes or more starts
+// with: sender-gh's text path refuses index 0, and the button sender's
+// one-pixel packets are shorter than a header.
+
+#define FRAME_MAGIC 0x00
+#define FRAME_VERSION 2       // Newest version this code reads and writes
+#define FRAME_VERSION_BASIC 1 // Narrow SET, FILL and ADD records only
+#define FRAME_HEADER_SIZE 6
+#define FRAME_MAX_PACKET 250  // ESP-NOW payload limit
+#define FRAME_NARROW_PIXELS 256 // Pixels a packet without FRAME_FLAG_WIDE can address
+#define FRAME_MAX_PIXELS 2048   // Pixels the senders and receivers buffer
+
+// Header flags
+#define FRAME_FLAG_KEYFRAME 0x01 // Every pixel in the packet's range is sent as an absolute colour
+#define FRAME_FLAG_LAST 0x02     // Last packet of the frame
+#define FRAME_FLAG_WIDE 0x04     // Record start and count are 16-bit
+#define FRAME_FLAG_SEQ_RESET 0x08 // The sender's sequence numbers started over, it rebooted or the counter wrapped
+#define FRAME_FLAG_STAGED 0x10    // Hold the frame until its COMMIT packet arrives
+#define FRAME_FLAG_COMMIT 0x20    // COMMIT packet, see above
+#define FRAME_FLAGS_V2 (FRAME_FLAG_WIDE | FRAME_FLAG_STAGED | FRAME_FLAG_COMMIT) // Flags a version 1 packet may not carry
+
+// Record opcodes
+#define FRAME_OP_SET 0x01  // start, count, count x RGB     Literal colours
+#define FRAME_OP_FILL 0x02 // start, count, RGB             Run of one colour
+#define FRAME_OP_ADD 0x03  // start, count, dR, dG, dB      Run of pixels that all changed by the same amount since the previous frame (mod 256)
+#define FRAME_OP_FADE 0x04 // start, count, RGB, ms lo, hi  Fade a run from whatever the receiver shows to RGB over ms milliseconds
+#define FRAME_OP_LOAD 0x05    // see above                  Store a scene in a slot
+#define FRAME_OP_TRIGGER 0x06 // slot, action               Play or stop a stored scene
+
+#define FRAME_MAX_FADES 8 // Fade records one frame can carry to the renderer
+#define FRAME_COMMIT_SIZE (FRAME_HEADER_SIZE + 6)
+#define FRAME_SCENE_STEP_SIZE 15 // One step of a LOAD record
+
+typedef struct
+{
+  uint8_t flags;
+  uint8_t frameId;
+  uint16_t sequence;
+} FrameHeader;
+
+// A fade the receiver interpolates locally at its own render rate, so the
+// sender transmits one keyframe instead of every step
+typedef struct
+{
+  uint16_t start;
+  uint16_t count;
+  RGB target;
+  uint16_t durationMs;
+} FadeCommand;
+
+// Where decodeFrame writes. Records are clipped to the window, so a receiver
+// listening to a broadcast only touches the pixels it displays.
+typedef struct
+{
+  RGB *pixels;          // Indexed by pixel index, holds the previous frame
+  uint16_t size;        // Length of pixels
+  uint16_t windowStart; // First pixel index to write
+  uint16_t windowCount; // Number of pixels to write
+  FadeCommand *fades;   // Filled with the FADE records in the window, may be NULL
+  uint8_t maxFades;
+  uint8_t fadeCount;    // Entries of fades in use
+  SceneTable *scenes;   // Takes the LOAD and TRIGGER records whole, unclipped. May be NULL to ignore them.
+} FrameTarget;
+
+// Operands of a COMMIT packet
+typedef struct
+{
+  uint32_t senderTime;   // micros() on the sender when the packet was built
+  uint16_t latchDelayMs; // Show the frame this long after senderTime
+} FrameCommit;
+
+enum FrameDecodeResult
+{
+  FRAME_OK = 0,
+  FRAME_NOT_FRAME,   // No magic byte, treat as a legacy Pixel array
+  FRAME_BAD_VERSION, // Sent by a newer or older protocol version
+  FRAME_TRUNCATED,   // A record runs past the end of the packet
+  FRAME_BAD_RECORD,  // Unknown opcode, empty run, run past the addressable range or bad scene
+  FRAME_IS_COMMIT,   // A COMMIT packet, read it with decodeCommit()
+};
+
+// Builds one packet record by record. Every add method returns false and
+// leaves the packet untouched if the record does not fit.
+class FrameWriter
+{
+public:
+  FrameWriter(uint8_t *buffer, size_t capacity);
+
+  void begin(const FrameHeader &header);
+  void setFlags(uint8_t flags);
+
+  bool set(uint16_t start, const RGB *colors, uint16_t count);
+  bool fill(uint16_t start, uint16_t count, RGB color);
+  bool add(uint16_t start, uint16_t count, RGB delta);
+  bool fade(uint16_t start, uint16_t count, RGB target, uint16_t durationMs);
+  bool load(uint8_t slot, const Scene &scene);
+  bool trigger(uint8_t slot, SceneAction action);
+
+  // Append one more colour to the SET record written last. Used by the
+  // encoder to grow a literal run pixel by pixel.
+  bool extend(RGB color);
+
+  size_t length() const { return used; }
+  size_t remaining() const { return capacity - used; }
+
+  // Longest run and highest index + 1 a record can carry in this packet
+  uint32_t maxRun() const { return wide ? 0xFFFF : 0xFF; }
+  uint32_t maxPixels() const { return wide ? 0x10000 : FRAME_NARROW_PIXELS; }
+
+private:
+  bool fits(uint16_t start, uint32_t count, size_t operandSize) const;
+  void writeRecordHeader(uint8_t op, uint16_t start, uint16_t count);
+
+  uint8_t *buffer;
+  size_t capacity;
+  size_t used;
+  size_t openSet; // Offset of the last SET record, 0 if the last record was not a SET
+  bool wide;      // FRAME_FLAG_WIDE is set, record fields are 16-bit
+};
+
+// Encode pixels [first, first + count) of frame into one packet.
+// previous holds the frame the receiver already shows; pass NULL for a
+// keyframe. Returns the packet length and stores how many pixels the packet
+// covers in consumed. FRAME_FLAG_LAST is set once the whole range is covered,
+// so callers loop until consumed reaches count, bumping the sequence number.
+// FRAME_FLAG_WIDE is set if the range reaches past pixel 255.
+size_t encodeFrame(uint8_t *out, size_t capacity, const FrameHeader &header,
+                   const RGB *frame, const RGB *previous,
+                   uint16_t first, uint16_t count, uint16_t *consumed);
+
+// True if data carries a PhotonSync frame header rather than legacy Pixels
+bool isFramePacket(const uint8_t *data, size_t len);
+
+// Read just the header, to check the sequence number before decoding.
+// Returns FRAME_OK, FRAME_NOT_FRAME or FRAME_BAD_VERSION.
+FrameDecodeResult readFrameHeader(const uint8_t *data, size_t len, FrameHeader *header);
+
+// Build a COMMIT packet for frame header.frameId, returns its length or 0 if
+// it does not fit
+size_t writeCommit(uint8_t *out, size_t capacity, const FrameHeader &header, const FrameCommit &commit);
+
+// Read a COMMIT packet. Returns FRAME_TRUNCATED if it is not one.
+FrameDecodeResult decodeCommit(const uint8_t *data, size_t len, FrameHeader *header, FrameCommit *commit);
+
+// Validate a packet, then apply the part of its records inside the target's
+// window to the target. Nothing is written unless the whole packet is valid.
+// A FADE record sets its pixels to the fade target and is appended to the
+// target's fades. Without room the pixels simply jump to the target.
+// LOAD and TRIGGER records update the target's scenes.
+FrameDecodeResult decodeFrame(const uint8_t *data, size_t len, FrameHeader *header, FrameTarget *target);
@@ -0,0 +1,166 @@
+#include "FrameReceiver.h"
+#include "Pixel.h"
+#include "Telemetry.h"
+#include <string.h>
+
+#define LOG_MODULE "rx"
+#define LOG_LEVEL LOG_LEVEL_WARN // LOG_LEVEL_DEBUG prints every dropped packet
+#include "Log.h"
+
+FrameReceiver::FrameReceiver() : staged(false), stagedId(0)
+{
+  memset(&building, 0, sizeof(building));
+  decodeTarget.pixels = building.pixels;
+  decodeTarget.size = FRAME_MAX_PIXELS;
+  decodeTarget.windowStart = 0;
+  decodeTarget.windowCount = FRAME_MAX_PIXELS;
+  decodeTarget.fades = building.fades;
+  decodeTarget.maxFades = FRAME_MAX_FADES;
+  decodeTarget.fadeCount = 0;
+  decodeTarget.scenes = &building.scenes;
+}
+
+void FrameReceiver::setWindow(uint16_t first, uint16_t count)
+{
+  decodeTarget.windowStart = first;
+  decodeTarget.windowCount = count;
+}
+
+ReceiveResult FrameReceiver::receive(const uint8_t *mac, const uint8_t *data, size_t len, uint32_t receivedAt,
+                                     unsigned long now)
+{
+  telemetry.count(TELEMETRY_PACKETS_RECEIVED);
+  if (isFramePacket(data, len))
+  {
+    return receiveFrame(mac, data, len, receivedAt, now);
+  }
+
+  // Legacy packet: an array of Pixel structs, a complete frame on its own
+  if (len % sizeof(Pixel) != 0)
+  {
+    telemetry.count(TELEMETRY_DECODE_ERRORS);
+    return RECEIVE_NOTHING;
+  }
+  const Pixel *pixels = (const Pixel *)data;
+  for (size_t i = 0; i < len / sizeof(Pixel); i++)
+  {
+    RGB &target = building.pixels[pixels[i].index];
+    target.red = pixels[i].red;
+    target.green = pixels[i].green;
+    target.blue = pixels[i].blue;
+  }
+  return publish();
+}
+
+ReceiveResult FrameReceiver::receiveFrame(const uint8_t *mac, const uint8_t *data, size_t len, uint32_t receivedAt,
+                                          unsigned long now)
+{
+  // A late or repeated packet would overwrite newer colours, check before applying anything
+  FrameHeader header;
+  if (readFrameHeader(data, len, &header) != FRAME_OK)
+  {
+    telemetry.count(TELEMETRY_DECODE_ERRORS);
+    LOG_DEBUG("Bad frame header, %u bytes", len);
+    return RECEIVE_NOTHING;
+  }
+  SequenceVerdict order = sequences.check(mac, header, now);
+  if (order != SEQ_ACCEPT)
+  {
+    telemetry.count(TELEMETRY_PACKETS_DROPPED);
+    LOG_DEBUG("Dropped packet %u of frame %u, %s", header.sequence, header.frameId,
+              order == SEQ_LATE ? "late" : "duplicate");
+    return RECEIVE_NOTHING;
+  }
+
+  if (header.flags & FRAME_FLAG_COMMIT)
+  {
+    return commit(data, len, receivedAt);
+  }
+
+  FrameDecodeResult result = decodeFrame(data, len, &header, &decodeTarget);
+  if (result != FRAME_OK)
+  {
+    telemetry.count(TELEMETRY_DECODE_ERRORS);
+    LOG_DEBUG("Could not decode packet %u, error %d", header.sequence, (int)result);
+    return RECEIVE_NOTHING; // Drop packets we cannot decode rather than show garbage
+  }
+
+  // Only whole frames go to the renderer, never half of a multi-packet frame.
+  // A staged frame waits in the write buffer for its COMMIT.
+  if (!(header.flags & FRAME_FLAG_LAST))
+  {
+    return RECEIVE_NOTHING;
+  }
+  if (header.flags & FRAME_FLAG_STAGED)
+  {
+    copyFrame(header.frameId);
+    staged = true;
+    stagedId = header.frameId;
+    return RECEIVE_NOTHING;
+  }
+  FrameBuffer &next = copyFrame(header.frameId);
+  next.latched = false;
+  return handOver();
+}
+
+ReceiveResult FrameReceiver::commit(const uint8_t *data, size_t len, uint32_t receivedAt)
+// Latch the staged frame the COMMIT names. Repeats of a COMMIT find nothing staged.
+{
+  FrameHeader header;
+  FrameCommit commit;
+  if (decodeCommit(data, len, &header, &commit) != FRAME_OK)
+  {
+    telemetry.count(TELEMETRY_DECODE_ERRORS);
+    return RECEIVE_NOTHING;
+  }
+  senderClock.sample(commit.senderTime, receivedAt);
+
+  if (!staged || header.frameId != stagedId)
+  {
+    return RECEIVE_NOTHING;
+  }
+  FrameBuffer &next = frames.writeBuffer();
+  next.latched = true;
+  next.latchAt = senderClock.toLocal(commit.senderTime) + commit.latchDelayMs * 1000UL;
+  return handOver();
+}
+
+ReceiveResult FrameReceiver::publish()
+{
+  FrameBuffer &next = copyFrame(0);
+  next.latched = false;
+  return handOver();
+}
+
+FrameBuffer &FrameReceiver::copyFrame(uint8_t frameId)
+// The decode buffer keeps its contents for the next delta packet
+{
+  building.fadeCount = decodeTarget.fadeCount;
+  building.frameId = frameId;
+  FrameBuffer &next = frames.writeBuffer();
+  memcpy(&next, &building, sizeof(FrameBuffer));
+  decodeTarget.fadeCount = 0; // Fades start once, with the frame that carried them
+  return next;
+}
+
+ReceiveResult FrameReceiver::handOver()
+{
+  staged = false;
+  telemetry.count(TELEMETRY_FRAMES_PUBLISHED);
+  if (frames.publish())
+  {
+    telemetry.count(TELEMETRY_FRAMES_DROPPED);
+    return RECEIVE_REPLACED;
+  }
+  return RECEIVE_PUBLISHED;
+}
+
+uint32_t latchWait(const FrameBuffer &frame, uint32_t now)
+{
+  if (!frame.latched)
+  {
+    return 0;
+  }
+  int32_t wait = (int32_t)(frame.latchAt - now);
+  return wait > 0 && wait <= LATCH_MAX_WAIT_US ? wait : 0;
+}
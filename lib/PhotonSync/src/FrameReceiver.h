@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FrameProtocol.h"
+#include "FrameBuffer.h"
+#include "TripleBuffer.h"
+#include "SequenceTracker.h"
+#include "ClockSync.h"
+
+#define LATCH_MAX_WAIT_US 1000000 // A latch time further out than this is a bad clock estimate, show the frame now
+
+// What receive() did with a packet
+enum ReceiveResult
+{
+  RECEIVE_NOTHING = 0, // Applied to the frame being built, dropped, or staged
+  RECEIVE_PUBLISHED,   // A whole frame went to the renderer
+  RECEIVE_REPLACED,    // Published, and it replaced a frame the renderer never took
+};
+
+// The receiver's packet path: drops late and repeated packets, decodes the
+// rest into the frame being built, holds staged frames until their COMMIT and
+// hands whole frames to the renderer through a TripleBuffer. The receiver
+// sketch runs it on the WiFi task, the simulator on its simulated radio.
+//
+// receive() and publish() are the producer side, takeFrame() and frame() the
+// renderer's. Times are the receiver's micros() and millis().
+class FrameReceiver
+{
+public:
+  FrameReceiver();
+
+  // Decode only pixels [first, first + count), call before the first packet
+  void setWindow(uint16_t first, uint16_t count);
+
+  // One packet from mac, in the PhotonSync frame format or the legacy Pixel array
+  ReceiveResult receive(const uint8_t *mac, const uint8_t *data, size_t len, uint32_t receivedAt, unsigned long now);
+
+  // Hand the frame built so far to the renderer, for a frame restored into target()
+  ReceiveResult publish();
+
+  // Where packets are decoded to, for restoring a saved frame before the first packet
+  FrameTarget *target() { return &decodeTarget; }
+
+  // Renderer side: take the newest published frame, true if there was one
+  bool takeFrame() { return frames.update(); }
+  const FrameBuffer &frame() const { return frames.readBuffer(); }
+
+  const SequenceStats &sequenceStats() const { return sequences.stats(); }
+
+private:
+  ReceiveResult receiveFrame(const uint8_t *mac, const uint8_t *data, size_t len, uint32_t receivedAt,
+                             unsigned long now);
+  ReceiveResult commit(const uint8_t *data, size_t len, uint32_t receivedAt);
+  FrameBuffer &copyFrame(uint8_t frameId);
+  ReceiveResult handOver();
+
+  FrameBuffer building; // Every pixel received so far, the base delta packets apply to
+  FrameTarget decodeTarget;
+  TripleBuffer<FrameBuffer> frames;
+  SequenceTracker sequences;
+  ClockSync senderClock; // Maps sender timestamps in COMMIT packets to our micros()
+  bool staged;           // The write buffer holds a complete frame waiting for its COMMIT
+  uint8_t stagedId;
+};
+
+// Microseconds from now until frame should be shown, 0 for a frame that is
+// not latched, already late or latched implausibly far out
+uint32_t latchWait(const FrameBuffer &frame, uint32_t now);
@@ -0,0 +1,35 @@
+#include "IdleAnimation.h"
+
+IdleAnimation::IdleAnimation(unsigned long holdMs, unsigned long fadeMs, unsigned long offMs)
+    : holdMs(holdMs), fadeMs(fadeMs), offMs(offMs), startedAt(0), running(false)
+{
+}
+
+void IdleAnimation::start(unsigned long now)
+{
+  startedAt = now;
+  running = true;
+}
+
+uint8_t IdleAnimation::brightness(unsigned long now) const
+{
+  unsigned long period = holdMs + fadeMs + offMs + fadeMs;
+  unsigned long t = (now - startedAt) % period;
+
+  if (t < holdMs)
+  {
+    return 255;
+  }
+  t -= holdMs;
+  if (t < fadeMs)
+  {
+    return 255 - (t * 255) / fadeMs; // Fading out
+  }
+  t -= fadeMs;
+  if (t < offMs)
+  {
+    return 0;
+  }
+  t -= offMs;
+  return (t * 255) / fadeMs; // Fading in
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+// Brightness envelope of the "breathing" animation the receiver shows until
+// the first frame arrives: hold at full brightness, fade to black, stay off,
+// fade back in, repeat. It is a pure function of time, so loop() asks for the
+// brightness of the current tick and never blocks waiting for the next step.
+class IdleAnimation
+{
+public:
+  IdleAnimation(unsigned long holdMs, unsigned long fadeMs, unsigned long offMs);
+
+  void start(unsigned long now);
+  void stop() { running = false; }
+  bool active() const { return running; }
+
+  // Brightness 0-255 at time now (millis())
+  uint8_t brightness(unsigned long now) const;
+
+private:
+  unsigned long holdMs;
+  unsigned long fadeMs;
+  unsigned long offMs;
+  unsigned long startedAt;
+  bool running;
+};
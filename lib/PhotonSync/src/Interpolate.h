@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include "FrameProtocol.h"
+
+// Linear interpolation of one colour channel, elapsed ms into a fade of
+// duration ms. Returns exactly from at 0 and exactly to from duration on,
+// and never moves backwards in between.
+inline uint8_t lerpChannel(uint8_t from, uint8_t to, uint32_t elapsed, uint32_t duration)
+{
+  if (elapsed >= duration)
+  {
+    return to;
+  }
+  // |to - from| <= 255 and elapsed < duration <= 65535, so this fits in 32 bits
+  return from + ((int32_t)to - (int32_t)from) * (int32_t)elapsed / (int32_t)duration;
+}
+
+inline RGB lerpColor(const RGB &from, const RGB &to, uint32_t elapsed, uint32_t duration)
+{
+  RGB color = {lerpChannel(from.red, to.red, elapsed, duration),
+               lerpChannel(from.green, to.green, elapsed, duration),
+               lerpChannel(from.blue, to.blue, elapsed, duration)};
+  return color;
+}
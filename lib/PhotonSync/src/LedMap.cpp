@@ -0,0 +1,77 @@
+#include "LedMap.h"
+
+// Logical position along the layout -> pixel it shows
+static uint16_t pixelAt(const LedLayout &layout, uint16_t position)
+{
+  if (layout.numPixels == 0)
+  {
+    return LED_UNMAPPED;
+  }
+
+  if (layout.segments != NULL)
+  {
+    uint16_t end = 0;
+    for (uint16_t i = 0; i < layout.segmentCount && i < layout.numPixels; i++)
+    {
+      end += layout.segments[i];
+      if (position < end)
+      {
+        return layout.pixelIndex + i;
+      }
+    }
+    return LED_UNMAPPED; // Past the last segment
+  }
+
+  // Even split. The first (ledCount % numPixels) pixels take one extra LED,
+  // so uneven divisions still reach the end of the strip.
+  uint16_t groupSize = layout.ledCount / layout.numPixels;
+  uint16_t remainder = layout.ledCount % layout.numPixels;
+  uint32_t bigGroups = (uint32_t)remainder * (groupSize + 1);
+  if (position < bigGroups)
+  {
+    return layout.pixelIndex + position / (groupSize + 1);
+  }
+  return layout.pixelIndex + remainder + (position - bigGroups) / groupSize;
+}
+
+// Physical LED -> logical position. Reversal and serpentine rows are both
+// their own inverse, so undoing them is applying them again in reverse order.
+static uint16_t positionOf(const LedLayout &layout, uint16_t led)
+{
+  uint16_t position = layout.reverse ? layout.ledCount - 1 - led : led;
+
+  if (layout.serpentine > 0)
+  {
+    uint16_t row = position / layout.serpentine;
+    if (row % 2 == 1)
+    {
+      uint16_t rowStart = row * layout.serpentine;
+      uint16_t rowLength = layout.ledCount - rowStart < layout.serpentine ? layout.ledCount - rowStart : layout.serpentine;
+      position = rowStart + rowLength - 1 - (position - rowStart);
+    }
+  }
+  return position;
+}
+
+uint16_t buildLedMap(const LedLayout &layout, LedSpan *spans, uint16_t maxSpans)
+{
+  uint16_t spanCount = 0;
+  for (uint16_t led = 0; led < layout.ledCount; led++)
+  {
+    uint16_t pixel = pixelAt(layout, positionOf(layout, led));
+    if (spanCount > 0 && spans[spanCount - 1].pixel == pixel)
+    {
+      spans[spanCount - 1].count++;
+      continue;
+    }
+    if (spanCount == maxSpans)
+    {
+      return 0;
+    }
+    spans[spanCount].firstLed = led;
+    spans[spanCount].count = 1;
+    spans[spanCount].pixel = pixel;
+    spanCount++;
+  }
+  return spanCount;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_NUM_LED 2048      // Longest strip one receiver drives
+#define LED_UNMAPPED 0xFFFF   // Span pixel for LEDs no pixel is assigned to, they stay dark
+
+// A run of physically consecutive LEDs that all show the same pixel. The
+// renderer walks the span table in order and looks each colour up once per
+// span instead of once per LED.
+typedef struct
+{
+  uint16_t firstLed;
+  uint16_t count;
+  uint16_t pixel; // Frame buffer index, or LED_UNMAPPED
+} LedSpan;
+
+// How the pixels of a receiver's window are laid out over its LEDs
+typedef struct
+{
+  uint16_t ledCount;
+  uint16_t pixelIndex;       // First pixel this receiver displays
+  uint16_t numPixels;        // Number of pixels it displays
+  const uint16_t *segments;  // LEDs per pixel, in pixel order. NULL splits the LEDs evenly
+  uint16_t segmentCount;
+  bool reverse;              // The strip is fed from its far end
+  uint16_t serpentine;       // LEDs per row of a zig-zag layout where every other row runs backwards, 0 for a straight strip
+} LedLayout;
+
+// Build the span table for layout. Spans are in physical LED order and cover
+// every LED exactly once. Returns the number of spans, 0 if they do not fit
+// in maxSpans.
+uint16_t buildLedMap(const LedLayout &layout, LedSpan *spans, uint16_t maxSpans);
@@ -0,0 +1,58 @@
+#include "LedOutputs.h"
+
+uint8_t planOutputs(const uint8_t *pins, const uint16_t *counts, uint8_t requested, uint16_t maxLeds, LedOutput *outputs)
+{
+  uint8_t planned = 0;
+  uint16_t next = 0;
+  for (uint8_t i = 0; i < requested && planned < MAX_OUTPUTS && next < maxLeds; i++)
+  {
+    uint16_t count = counts[i];
+    if (count > maxLeds - next)
+    {
+      count = maxLeds - next;
+    }
+    if (count == 0)
+    {
+      continue;
+    }
+    outputs[planned].pin = pins[i];
+    outputs[planned].firstLed = next;
+    outputs[planned].count = count;
+    planned++;
+    next += count;
+  }
+  return planned;
+}
+
+uint16_t totalLeds(const LedOutput *outputs, uint8_t count)
+{
+  uint16_t total = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    total += outputs[i].count;
+  }
+  return total;
+}
+
+uint32_t stripTimeUs(uint16_t count)
+{
+  return (uint32_t)count * LED_BITS * LED_BIT_NS / 1000 + LED_RESET_US;
+}
+
+uint32_t frameTimeUs(const LedOutput *outputs, uint8_t count, bool parallel)
+{
+  uint32_t time = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    uint32_t strip = stripTimeUs(outputs[i].count);
+    if (parallel)
+    {
+      time = strip > time ? strip : time;
+    }
+    else
+    {
+      time += strip;
+    }
+  }
+  return time;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+#define MAX_OUTPUTS 8        // Strips one receiver drives, one RMT channel each
+#define LED_BITS 24          // GRB, 8 bits per channel
+#define LED_BIT_NS 1250      // WS2812 bit period at 800 kHz
+#define LED_RESET_US 50      // Line held low after the last bit to latch the strip
+
+// One strip on its own pin, showing LEDs [firstLed, firstLed + count) of the
+// receiver's LED buffer. The LED map treats all strips as one chain in
+// config order, so layouts, reversing and serpentine rows span strips.
+typedef struct
+{
+  uint8_t pin;
+  uint16_t firstLed;
+  uint16_t count;
+} LedOutput;
+
+// Lay the requested strips end to end in the LED buffer. Strips that do not
+// fit in maxLeds are shortened or dropped. Returns the number of outputs
+// filled in, at most MAX_OUTPUTS.
+uint8_t planOutputs(const uint8_t *pins, const uint16_t *counts, uint8_t requested, uint16_t maxLeds, LedOutput *outputs);
+
+// LEDs across all outputs
+uint16_t totalLeds(const LedOutput *outputs, uint8_t count);
+
+// Time to clock count LEDs out of one pin
+uint32_t stripTimeUs(uint16_t count);
+
+// Time to show a whole frame. Outputs sent in parallel take as long as the
+// longest strip, sent one after the other as long as all strips together.
+uint32_t frameTimeUs(const LedOutput *outputs, uint8_t count, bool parallel);
@@ -0,0 +1,197 @@
+#include "Log.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+LogRing logRing;
+
+static uint32_t logClock()
+{
+#ifdef ARDUINO
+  return micros();
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+LogRing::LogRing() : head(0), tail(0), droppedCount(0)
+{
+  for (uint32_t i = 0; i < LOG_RING_SLOTS; i++)
+  {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+void LogRing::push(uint8_t level, const char *module, const char *format, const LogArg *args, uint8_t argCount)
+{
+  uint32_t position = head.load(std::memory_order_relaxed);
+  Slot *slot;
+  for (;;)
+  {
+    slot = &slots[position % LOG_RING_SLOTS];
+    int32_t lag = (int32_t)(slot->sequence.load(std::memory_order_acquire) - position);
+    if (lag == 0)
+    {
+      // Free, claim it unless another producer got there first
+      if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (lag < 0)
+    {
+      droppedCount.fetch_add(1, std::memory_order_relaxed); // Still holds a record loop() has not taken
+      return;
+    }
+    else
+    {
+      position = head.load(std::memory_order_relaxed);
+    }
+  }
+
+  LogRecord &record = slot->record;
+  record.time = logClock();
+  record.level = level;
+  record.argCount = argCount;
+  record.module = module;
+  record.format = format;
+  memcpy(record.args, args, argCount * sizeof(LogArg));
+  slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+bool LogRing::take(LogRecord *record)
+{
+  Slot &slot = slots[tail % LOG_RING_SLOTS];
+  if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+  {
+    return false;
+  }
+  memcpy(record, &slot.record, sizeof(LogRecord));
+  slot.sequence.store(tail + LOG_RING_SLOTS, std::memory_order_release);
+  tail++;
+  return true;
+}
+
+static const char LEVEL_LETTERS[] = "-EWID";
+
+size_t logFormat(const LogRecord &record, char *out, size_t capacity)
+{
+  if (capacity < 2)
+  {
+    if (capacity == 1)
+    {
+      out[0] = '\0';
+    }
+    return 0;
+  }
+  int n = snprintf(out, capacity, "%10lu %c %s: ", (unsigned long)record.time,
+                   LEVEL_LETTERS[record.level <= LOG_LEVEL_DEBUG ? record.level : 0], record.module);
+  size_t used = n < 0 ? 0 : (size_t)n < capacity ? n : capacity - 1;
+
+  // Walk the format, printing each conversion with its own argument
+  const char *p = record.format;
+  uint8_t next = 0;
+  while (*p != '\0' && used + 1 < capacity)
+  {
+    if (*p != '%')
+    {
+      out[used++] = *p++;
+      continue;
+    }
+
+    // Copy one conversion, "%-08.3f" and the like, to print it on its own
+    char spec[16];
+    size_t length = 0;
+    spec[length++] = *p++;
+    while (*p != '\0' && strchr("-+ #0123456789.", *p) != NULL && length < sizeof(spec) - 3)
+    {
+      spec[length++] = *p++;
+    }
+    char conversion = *p;
+    if (conversion == '\0')
+    {
+      break;
+    }
+    p++;
+    if (conversion == '%')
+    {
+      out[used++] = '%';
+      continue;
+    }
+
+    const LogArg *arg = next < record.argCount ? &record.args[next++] : NULL;
+    int printed = 0;
+    char *at = &out[used];
+    size_t room = capacity - used;
+    spec[length++] = conversion;
+    spec[length] = '\0';
+    if (arg == NULL)
+    {
+      printed = snprintf(at, room, "?");
+    }
+    else if (conversion == 's')
+    {
+      printed = snprintf(at, room, spec, arg->type == LOG_ARG_STRING && arg->s != NULL ? arg->s : "?");
+    }
+    else if (conversion == 'f')
+    {
+      printed = snprintf(at, room, spec, arg->type == LOG_ARG_FLOAT ? (double)arg->f : (double)arg->i);
+    }
+    else if (conversion == 'd' || conversion == 'i' || conversion == 'c')
+    {
+      printed = snprintf(at, room, spec, arg->type == LOG_ARG_FLOAT ? (int)arg->f : (int)arg->i);
+    }
+    else if (conversion == 'u' || conversion == 'x' || conversion == 'X')
+    {
+      printed = snprintf(at, room, spec, arg->type == LOG_ARG_FLOAT ? (unsigned)arg->f : (unsigned)arg->u);
+    }
+    else
+    {
+      printed = snprintf(at, room, "?");
+    }
+    if (printed > 0)
+    {
+      used += (size_t)printed < room ? printed : room - 1;
+    }
+  }
+
+  // Always end on a newline, even when the line was cut
+  if (used + 1 >= capacity)
+  {
+    used = capacity - 2;
+  }
+  out[used++] = '\n';
+  out[used] = '\0';
+  return used;
+}
+
+#ifdef ARDUINO
+void logDrain(HardwareSerial &out)
+{
+  static uint32_t droppedReported = 0;
+  char line[LOG_LINE_MAX];
+
+  uint32_t dropped = logRing.dropped();
+  if (dropped != droppedReported && out.availableForWrite() >= LOG_LINE_MAX)
+  {
+    snprintf(line, sizeof(line), "%10lu W log: %lu records dropped, the ring was full\n",
+             (unsigned long)micros(), (unsigned long)(dropped - droppedReported));
+    out.print(line);
+    droppedReported = dropped;
+  }
+
+  LogRecord record;
+  while (out.availableForWrite() >= LOG_LINE_MAX && logRing.take(&record))
+  {
+    size_t length = logFormat(record, line, sizeof(line));
+    out.write((const uint8_t *)line, length);
+  }
+}
+#endif
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+// Logging that costs nothing when it is off and next to nothing when it is
+// on, so it can stay in the packet and render paths.
+//
+// Every file picks its own level and name before including this header:
+//
+//   #define LOG_MODULE "rx"
+//   #define LOG_LEVEL LOG_LEVEL_WARN
+//   #include <Log.h>
+//
+//   LOG_WARN("Dropped a frame, %u in a row", dropped);
+//
+// A call above the file's level, or above LOG_MAX_LEVEL (set it with a build
+// flag to silence a whole firmware), is a constant-false branch: it compiles
+// to nothing and its arguments are never evaluated.
+//
+// An enabled call does not format anything. It copies the format pointer
+// and up to LOG_MAX_ARGS arguments into a lock-free ring, which is safe from
+// any task. loop() formats and prints the records later with logDrain().
+// The format and any string argument must therefore outlive the call,
+// string literals do. Records that find the ring full are counted and
+// reported by the next drain.
+//
+// Formats support %d %i %u %x %X %c %s %f and %%, with flags, width and
+// precision.
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL LOG_LEVEL_DEBUG
+#endif
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_WARN
+#endif
+#ifndef LOG_MODULE
+#define LOG_MODULE "main"
+#endif
+
+#define LOG_MAX_ARGS 6
+#define LOG_RING_SLOTS 32 // A power of two
+#define LOG_LINE_MAX 128  // Longest formatted line, longer ones are cut
+
+#define LOG_AT(level, ...)                                 \
+  do                                                       \
+  {                                                        \
+    if (logEnabled(level, LOG_LEVEL))                      \
+    {                                                      \
+      logRing.write(level, LOG_MODULE, __VA_ARGS__);       \
+    }                                                      \
+  } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+constexpr bool logEnabled(int level, int moduleLevel)
+{
+  return level <= moduleLevel && level <= LOG_MAX_LEVEL;
+}
+
+enum LogArgType
+{
+  LOG_ARG_INT = 0,
+  LOG_ARG_UINT,
+  LOG_ARG_FLOAT,
+  LOG_ARG_STRING,
+};
+
+typedef struct
+{
+  uint8_t type; // LogArgType
+  union
+  {
+    int32_t i;
+    uint32_t u;
+    float f;
+    const char *s;
+  };
+} LogArg;
+
+typedef struct
+{
+  uint32_t time; // micros() when the record was written
+  uint8_t level;
+  uint8_t argCount;
+  const char *module;
+  const char *format;
+  LogArg args[LOG_MAX_ARGS];
+} LogRecord;
+
+// Turn one argument into a LogArg. Anything that is not a number or a
+// string does not compile.
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, LogArg>::type
+logArg(T value)
+{
+  LogArg arg;
+  arg.type = LOG_ARG_INT;
+  arg.i = (int32_t)value;
+  return arg;
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, LogArg>::type
+logArg(T value)
+{
+  LogArg arg;
+  arg.type = LOG_ARG_UINT;
+  arg.u = (uint32_t)value;
+  return arg;
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value, LogArg>::type
+logArg(T value)
+{
+  LogArg arg;
+  arg.type = LOG_ARG_FLOAT;
+  arg.f = (float)value;
+  return arg;
+}
+
+inline LogArg logArg(const char *value)
+{
+  LogArg arg;
+  arg.type = LOG_ARG_STRING;
+  arg.s = value;
+  return arg;
+}
+
+// Bounded multi-producer, single-consumer queue of log records. Producers
+// claim a slot with a compare-and-swap on head, and every slot carries a
+// sequence number that says whether it is free, being written or ready.
+class LogRing
+{
+public:
+  LogRing();
+
+  template <typename... Args>
+  void write(uint8_t level, const char *module, const char *format, Args... args)
+  {
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many arguments for one log record");
+    LogArg packed[sizeof...(Args) + 1] = {logArg(args)...};
+    push(level, module, format, packed, sizeof...(Args));
+  }
+
+  // Consumer side, loop() only. Returns false if the ring is empty.
+  bool take(LogRecord *record);
+
+  // Records lost to a full ring since boot
+  uint32_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+  void push(uint8_t level, const char *module, const char *format, const LogArg *args, uint8_t argCount);
+
+  struct Slot
+  {
+    std::atomic<uint32_t> sequence; // Equals the write position when free, position + 1 when ready
+    LogRecord record;
+  };
+
+  Slot slots[LOG_RING_SLOTS];
+  std::atomic<uint32_t> head; // Next write position
+  uint32_t tail;              // Next read position, consumer only
+  std::atomic<uint32_t> droppedCount;
+};
+
+extern LogRing logRing;
+
+// Format a record as one line, "time level module: message\n". Returns the
+// length written, cut to capacity - 1 and always NUL-terminated.
+size_t logFormat(const LogRecord &record, char *out, size_t capacity);
+
+#ifdef ARDUINO
+#include <HardwareSerial.h>
+
+// Print waiting records while the UART has room for a whole line, so loop()
+// never blocks on it. Reports records lost to a full ring first.
+void logDrain(HardwareSerial &out);
+#endif
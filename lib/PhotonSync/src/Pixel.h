@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// One pixel of the legacy packet format, a packet is a raw array of these.
+// Still sent by the senders' text path and accepted by the receiver.
+typedef struct __attribute__((packed))
+{
+  uint8_t index;
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+} Pixel;
@@ -0,0 +1,52 @@
+#include "PixelFader.h"
+#include "Interpolate.h"
+#include <string.h>
+
+PixelFader::PixelFader() : count(0)
+{
+}
+
+void PixelFader::start(const FadeCommand &fade, const RGB *shown, unsigned long startAt)
+{
+  if (count == MAX_ACTIVE_FADES)
+  {
+    // Drop the oldest fade, its pixels jump to their target
+    memmove(&fades[0], &fades[1], (MAX_ACTIVE_FADES - 1) * sizeof(ActiveFade));
+    count--;
+  }
+  fades[count].command = fade;
+  fades[count].startedAt = startAt;
+  count++;
+
+  memcpy(&from[fade.start], &shown[fade.start], fade.count * sizeof(RGB));
+}
+
+void PixelFader::compose(const RGB *frame, RGB *out, unsigned long now)
+{
+  memcpy(out, frame, FRAME_MAX_PIXELS * sizeof(RGB));
+
+  uint8_t kept = 0;
+  for (uint8_t f = 0; f < count; f++)
+  {
+    const FadeCommand &fade = fades[f].command;
+    unsigned long elapsed = now - fades[f].startedAt;
+    if ((long)elapsed < 0)
+    {
+      elapsed = 0; // Starts at a latch time still ahead
+    }
+    if (elapsed >= fade.durationMs)
+    {
+      continue; // Finished, the frame already holds the target
+    }
+
+    for (uint16_t i = fade.start; i < fade.start + fade.count; i++)
+    {
+      if (frame[i] == fade.target)
+      {
+        out[i] = lerpColor(from[i], fade.target, elapsed, fade.durationMs);
+      }
+    }
+    fades[kept++] = fades[f];
+  }
+  count = kept;
+}
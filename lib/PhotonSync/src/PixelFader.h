@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include "FrameProtocol.h"
+
+#define MAX_ACTIVE_FADES 8
+
+// Runs the FADE commands senders put in frames. Each fade starts from the
+// colours last shown and is interpolated locally on every render tick.
+// A pixel only follows its fade while the frame still holds the fade's
+// target, so a later frame that sets the pixel to something else wins.
+class PixelFader
+{
+public:
+  PixelFader();
+
+  // Begin a fade at time startAt, which may still be ahead, a latch time.
+  // Until then compose() holds the pixels at the colours shown holds now.
+  void start(const FadeCommand &fade, const RGB *shown, unsigned long startAt);
+
+  bool active() const { return count > 0; }
+
+  // Write frame into out with the running fades applied. Fades that have
+  // finished are dropped.
+  void compose(const RGB *frame, RGB *out, unsigned long now);
+
+private:
+  typedef struct
+  {
+    FadeCommand command;
+    unsigned long startedAt;
+  } ActiveFade;
+
+  ActiveFade fades[MAX_ACTIVE_FADES];
+  uint8_t count;
+  RGB from[FRAME_MAX_PIXELS]; // Colour each pixel had when its fade started
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+// One pixel colour as it travels over the air and sits in frame buffers
+typedef struct __attribute__((packed))
+{
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+} RGB;
+
+inline bool operator==(const RGB &a, const RGB &b)
+{
+  return a.red == b.red && a.green == b.green && a.blue == b.blue;
+}
+
+inline bool operator!=(const RGB &a, const RGB &b)
+{
+  return !(a == b);
+}
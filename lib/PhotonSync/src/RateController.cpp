@@ -0,0 +1,89 @@
+#include "RateController.h"
+#include "FramePacker.h"
+
+RateController::RateController()
+    : started(false), windowStart(0), windowDelivered(0), windowFailed(0), framesDone(0), framesHeld(0),
+      calmWindows(0), repairedFailed(0), repairedAt(0), lastFailed(0)
+{
+  setLevel(0);
+}
+
+bool RateController::update(unsigned long now, uint32_t delivered, uint32_t failed)
+{
+  lastFailed = failed;
+  if (!started || now - windowStart >= RATE_WINDOW_MS * 10)
+  {
+    // First call, or loop() stalled long enough that the counts say nothing
+    // about the air now
+    if (!started)
+    {
+      repairedFailed = failed;
+    }
+    started = true;
+    windowStart = now;
+    windowDelivered = delivered;
+    windowFailed = failed;
+    framesDone = 0;
+    framesHeld = 0;
+    return false;
+  }
+  if (now - windowStart < RATE_WINDOW_MS)
+  {
+    return false;
+  }
+
+  uint32_t lost = failed - windowFailed;
+  uint32_t done = (delivered - windowDelivered) + lost;
+  bool congested = framesHeld * 2 > framesDone ||
+                   (done >= RATE_MIN_SAMPLES && lost * 100 > done * RATE_LOSS_PERCENT);
+  uint8_t level = current.level;
+  if (congested)
+  {
+    calmWindows = 0;
+    level = level < RATE_MAX_LEVEL ? level + 1 : level;
+  }
+  else if (done > 0 && ++calmWindows >= RATE_CALM_WINDOWS)
+  {
+    calmWindows = 0;
+    level = level > 0 ? level - 1 : level;
+  }
+
+  windowStart = now;
+  windowDelivered = delivered;
+  windowFailed = failed;
+  framesDone = 0;
+  framesHeld = 0;
+  if (level == current.level)
+  {
+    return false;
+  }
+  setLevel(level);
+  return true;
+}
+
+void RateController::frameDone(bool held)
+{
+  framesDone++;
+  if (held)
+  {
+    framesHeld++;
+  }
+}
+
+bool RateController::repairDue(unsigned long now)
+{
+  if (lastFailed == repairedFailed || now - repairedAt < RATE_REPAIR_MS)
+  {
+    return false;
+  }
+  repairedFailed = lastFailed;
+  repairedAt = now;
+  return true;
+}
+
+void RateController::setLevel(uint8_t level)
+{
+  current.level = level;
+  current.batchPixels = PACKER_MAX_PIXELS << level;
+  current.quantizeBits = level;
+}
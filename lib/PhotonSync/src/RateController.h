@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RATE_WINDOW_MS 100      // Frames and send results are judged once per window
+#define RATE_MAX_QUEUED 0       // Packets a new frame may find in the TxRing and still go out
+#define RATE_MIN_SAMPLES 4      // Sends a window needs before its loss counts
+#define RATE_LOSS_PERCENT 10    // More failed sends than this in a window means the air is congested
+#define RATE_CALM_WINDOWS 10    // Windows without congestion before the level steps back down
+#define RATE_MAX_LEVEL 2        // Highest compression level
+#define RATE_REPAIR_MS 250      // Least time between repair keyframes, each costs a full frame of air time
+
+// How the sender should pack frames right now
+typedef struct
+{
+  uint8_t level;        // 0 on a clear link, up to RATE_MAX_LEVEL while congested
+  uint16_t batchPixels; // Changed legacy pixels that fill a batch before it is flushed
+  uint8_t quantizeBits; // Low bits dropped from every channel, 0 sends colours exactly
+} RatePacing;
+
+// Paces the sender to what the air carries, from the send callback's
+// delivery results and the depth of the TxRing. Driven from loop() with the
+// ring's counters, it keeps no state the send callback touches.
+//
+// Frame rate: a complete frame goes out only once the ring has drained to
+// RATE_MAX_QUEUED packets. Until then it stays in the FramePacker, where the
+// next frame overwrites it, so the ring never holds more than one frame of
+// backlog and the frame rate follows the completions. A slow or lossy link
+// shows fewer frames instead of older ones.
+//
+// Compression: a window in which most complete frames had to wait, or more
+// than RATE_LOSS_PERCENT of the unicasts failed after the MAC retries, is
+// congested and raises the level by one. RATE_CALM_WINDOWS windows with
+// traffic and no congestion lower it again. Each level drops one more low bit
+// of every channel, which turns small colour steps into no change at all and
+// a delta frame sends those for free, and doubles the legacy pixel batch.
+//
+// Repair: a failed send left some receiver pixels behind what the packer
+// thinks they show. repairDue() asks for a keyframe, at most one every
+// RATE_REPAIR_MS, instead of waiting up to PACKER_KEYFRAME_INTERVAL frames.
+//
+// Broadcasts are never acknowledged, so they only ever see the queue.
+class RateController
+{
+public:
+  RateController();
+
+  // Call every loop with the ring's running totals. Returns true when the
+  // pacing changed.
+  bool update(unsigned long now, uint32_t delivered, uint32_t failed);
+
+  // Whether a complete frame may be sent with queued packets in the ring
+  bool clearToSend(size_t queued) const { return queued <= RATE_MAX_QUEUED; }
+
+  // Count a complete frame, sent at once or held back by clearToSend()
+  void frameDone(bool held);
+
+  // True once after a send failed, the next frame should be a keyframe
+  bool repairDue(unsigned long now);
+
+  const RatePacing &pacing() const { return current; }
+
+private:
+  void setLevel(uint8_t level);
+
+  RatePacing current;
+  bool started;
+  unsigned long windowStart; // millis() the current window began
+  uint32_t windowDelivered;  // Totals at the start of the window
+  uint32_t windowFailed;
+  uint16_t framesDone; // This window
+  uint16_t framesHeld;
+  uint8_t calmWindows;
+  uint32_t repairedFailed; // Failures already repaired
+  unsigned long repairedAt;
+  uint32_t lastFailed;
+};
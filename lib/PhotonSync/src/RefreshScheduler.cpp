@@ -0,0 +1,67 @@
+#include "RefreshScheduler.h"
+
+#define AVERAGE_SHIFT 4 // The moving average weighs each new frame 1/16
+
+RefreshScheduler::RefreshScheduler(uint16_t maxFps)
+    : nextSlot(0), startedAt(0), rendered(0), dropped(0), frameUs(0), maxFrameUs(0), avgFrameUs(0)
+{
+  setMaxFps(maxFps);
+}
+
+void RefreshScheduler::setMaxFps(uint16_t maxFps)
+{
+  intervalUs = maxFps > 0 ? 1000000UL / maxFps : 0;
+  if (intervalUs < REFRESH_MIN_INTERVAL_US)
+  {
+    intervalUs = REFRESH_MIN_INTERVAL_US;
+  }
+}
+
+uint32_t RefreshScheduler::wait(uint32_t now) const
+{
+  // A slot more than one interval away is left over from before a long
+  // pause, where micros() wrapped past it
+  int32_t remaining = (int32_t)(nextSlot - now);
+  return remaining > 0 && (uint32_t)remaining <= intervalUs ? remaining : 0;
+}
+
+bool RefreshScheduler::begin(uint32_t now, bool newFrame, bool animating)
+{
+  if (!newFrame && !animating)
+  {
+    return false;
+  }
+
+  // Keep to the frame grid while we keep up, restart it after a pause or an
+  // overrun instead of rendering back to back to catch up
+  nextSlot += intervalUs;
+  int32_t ahead = (int32_t)(nextSlot - now);
+  if (ahead <= 0 || (uint32_t)ahead > intervalUs)
+  {
+    nextSlot = now + intervalUs;
+  }
+  startedAt = now;
+  return true;
+}
+
+void RefreshScheduler::end(uint32_t now)
+{
+  frameUs = now - startedAt;
+  if (frameUs > maxFrameUs)
+  {
+    maxFrameUs = frameUs;
+  }
+  avgFrameUs = rendered == 0 ? frameUs : avgFrameUs + ((int32_t)(frameUs - avgFrameUs) >> AVERAGE_SHIFT);
+  rendered++;
+}
+
+RefreshStats RefreshScheduler::stats() const
+{
+  RefreshStats stats;
+  stats.rendered = rendered;
+  stats.dropped = dropped.load(std::memory_order_relaxed);
+  stats.frameUs = frameUs;
+  stats.maxFrameUs = maxFrameUs;
+  stats.avgFrameUs = avgFrameUs;
+  return stats;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#define REFRESH_MIN_INTERVAL_US 1000 // Slots never open closer than this, also with no cap
+
+typedef struct
+{
+  uint32_t rendered;    // Frames shown
+  uint32_t dropped;     // Frames replaced by a newer one before they were shown
+  uint32_t frameUs;     // Duration of the last render, from its slot to the end of show()
+  uint32_t maxFrameUs;  // Longest render since boot
+  uint32_t avgFrameUs;  // Moving average of the render duration
+} RefreshStats;
+
+// Paces the render task to a target frame rate, RenderLoop asks it when to
+// draw. A render slot opens at most every 1/maxFps seconds, and a slot is
+// only used if there is something new to draw: a new frame, or an animation
+// (fade, idle) that moves on its own. Between slots the task sleeps instead
+// of re-sending the same colours to the LEDs, which leaves the CPU to the
+// WiFi stack.
+//
+// Times are micros(). Only frameDropped() and stats() may be called from
+// another task, stats() may then be one frame out of date.
+class RefreshScheduler
+{
+public:
+  RefreshScheduler(uint16_t maxFps);
+
+  // 0 renders as fast as frames arrive, up to one slot every
+  // REFRESH_MIN_INTERVAL_US
+  void setMaxFps(uint16_t maxFps);
+
+  // Microseconds until the next slot opens, 0 if it is open
+  uint32_t wait(uint32_t now) const;
+
+  // Claim the open slot if there is anything to draw. Returns false if not,
+  // the slot stays open for the next frame.
+  bool begin(uint32_t now, bool newFrame, bool animating);
+  void end(uint32_t now);
+
+  // The producer replaced a frame the renderer never took
+  void frameDropped() { dropped.fetch_add(1, std::memory_order_relaxed); }
+
+  RefreshStats stats() const;
+
+private:
+  uint32_t intervalUs;
+  uint32_t nextSlot;  // micros() the next slot opens at
+  uint32_t startedAt; // micros() the current render started at
+  uint32_t rendered;
+  std::atomic<uint32_t> dropped;
+  uint32_t frameUs;
+  uint32_t maxFrameUs;
+  uint32_t avgFrameUs;
+};
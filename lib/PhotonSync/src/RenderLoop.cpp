@@ -0,0 +1,36 @@
+#include "RenderLoop.h"
+
+RenderLoop::RenderLoop(const RenderHooks &hooks, RefreshScheduler &scheduler)
+    : hooks(hooks), scheduler(scheduler)
+{
+}
+
+void RenderLoop::step()
+{
+  // Frames that arrive before the slot replace each other, the newest is shown
+  uint32_t slotAt = hooks.now();
+  uint32_t wait = scheduler.wait(slotAt);
+  if (wait > 0)
+  {
+    hooks.sleep(wait);
+    return;
+  }
+
+  bool newFrame = hooks.takeFrame();
+  if (!scheduler.begin(slotAt, newFrame, hooks.animating()))
+  {
+    hooks.sleep(RENDER_IDLE_SLEEP_US);
+    return;
+  }
+
+  if (!hooks.draw(newFrame))
+  {
+    // Nothing on screen changed, an idle step that is still at the same
+    // brightness. Sleep until the next slot instead of asking again at once,
+    // but no longer: the animation may change in that slot.
+    uint32_t next = scheduler.wait(hooks.now());
+    hooks.sleep(next > 0 ? next : REFRESH_MIN_INTERVAL_US);
+    return;
+  }
+  scheduler.end(hooks.now());
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include "RefreshScheduler.h"
+
+#define RENDER_IDLE_SLEEP_US 100000 // Longest sleep with nothing to draw, the radio side wakes the task sooner
+
+// What the render task is made of, supplied by the platform glue. On the
+// device these are FreeRTOS task notifications and the receiver's frame
+// buffers; on a host they can be std::thread stand-ins.
+typedef struct
+{
+  uint32_t (*now)();            // micros()
+  void (*sleep)(uint32_t us);   // Block for up to us microseconds, return early when woken
+  bool (*takeFrame)();          // Take the newest published frame, true if there was one
+  bool (*animating)();          // Something on screen moves without a new frame
+  bool (*draw)(bool newFrame);  // Render and show, true if the LEDs were updated
+} RenderHooks;
+
+// One iteration of the render task: sleep until the scheduler's next slot,
+// then draw if a frame arrived or an animation is running. With nothing to
+// draw it sleeps until the radio side wakes it with the next frame.
+class RenderLoop
+{
+public:
+  RenderLoop(const RenderHooks &hooks, RefreshScheduler &scheduler);
+
+  void step();
+
+private:
+  RenderHooks hooks;
+  RefreshScheduler &scheduler;
+};
@@ -0,0 +1,127 @@
+#include "Scene.h"
+#include "Interpolate.h"
+#include <string.h>
+
+static uint32_t stepLength(const SceneStep &step)
+{
+  return (uint32_t)step.durationMs * (step.repeat > 0 ? step.repeat : 1);
+}
+
+uint32_t sceneLength(const Scene &scene)
+{
+  uint32_t length = 0;
+  for (uint8_t s = 0; s < scene.stepCount; s++)
+  {
+    length += stepLength(scene.steps[s]);
+  }
+  return length;
+}
+
+// Colour of pixel offset into the step's run, elapsed ms into the current cycle
+static RGB stepColor(const SceneStep &step, uint32_t offset, uint32_t elapsed)
+{
+  const uint32_t duration = step.durationMs;
+  switch (step.effect)
+  {
+  case SCENE_FADE:
+    return lerpColor(step.a, step.b, elapsed, duration);
+  case SCENE_PULSE:
+  {
+    uint32_t half = duration / 2;
+    if (elapsed < half)
+    {
+      return lerpColor(step.a, step.b, elapsed, half);
+    }
+    return lerpColor(step.b, step.a, elapsed - half, duration - half);
+  }
+  case SCENE_CHASE:
+  {
+    uint32_t width = step.width > 0 ? step.width : 1;
+    uint32_t head = elapsed * step.count / duration;
+    uint32_t behind = (offset + step.count - head) % step.count;
+    return behind < width ? step.a : step.b;
+  }
+  case SCENE_GRADIENT:
+  {
+    // One wave is 512 phase steps, a to b over the first half and back
+    uint32_t width = step.width > 0 ? step.width : step.count;
+    uint32_t phase = (offset * 512 / width + elapsed * 512 / duration) & 511;
+    uint32_t level = phase < 256 ? phase : 511 - phase;
+    return lerpColor(step.a, step.b, level, 255);
+  }
+  default:
+    return step.a;
+  }
+}
+
+bool renderScene(const Scene &scene, uint32_t elapsed, RGB *out, uint16_t size)
+{
+  uint32_t length = sceneLength(scene);
+  if (length == 0)
+  {
+    return false;
+  }
+  if (elapsed >= length)
+  {
+    if (!(scene.flags & SCENE_FLAG_LOOP))
+    {
+      return false;
+    }
+    elapsed %= length;
+  }
+
+  // Find the step running at elapsed
+  uint8_t s = 0;
+  while (elapsed >= stepLength(scene.steps[s]))
+  {
+    elapsed -= stepLength(scene.steps[s]);
+    s++;
+  }
+  const SceneStep &step = scene.steps[s];
+  uint32_t cycle = elapsed % step.durationMs;
+
+  uint32_t end = (uint32_t)step.start + step.count;
+  if (end > size)
+  {
+    end = size;
+  }
+  for (uint32_t i = step.start; i < end; i++)
+  {
+    out[i] = stepColor(step, i - step.start, cycle);
+  }
+  return true;
+}
+
+SceneEngine::SceneEngine() : playing(0), waiting(0)
+{
+  memset(seen, 0, sizeof(seen));
+  memset(startedAt, 0, sizeof(startedAt));
+}
+
+void SceneEngine::render(const SceneTable &table, RGB *out, uint16_t size, unsigned long now, unsigned long startAt)
+{
+  for (uint8_t slot = 0; slot < SCENE_SLOTS; slot++)
+  {
+    const uint8_t bit = 1 << slot;
+    if (table.triggers[slot] != seen[slot])
+    {
+      // Triggered again since the last render, the newest action wins
+      seen[slot] = table.triggers[slot];
+      startedAt[slot] = startAt;
+      playing = (table.playing & bit) ? playing | bit : playing & ~bit;
+      waiting |= bit;
+    }
+
+    // Only a start still ahead is held, once reached the elapsed time may
+    // wrap past 2^31 ms on a long run without looking negative
+    if ((waiting & bit) && (long)(now - startedAt[slot]) >= 0)
+    {
+      waiting &= ~bit;
+    }
+    unsigned long elapsed = (waiting & bit) ? 0 : now - startedAt[slot];
+    if ((playing & bit) && !renderScene(table.slots[slot], elapsed, out, size))
+    {
+      playing &= ~bit; // Finished, the frame's colours show again from this render on
+    }
+  }
+}
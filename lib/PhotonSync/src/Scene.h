@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include "RGB.h"
+
+// Effects the receiver plays on its own, so a looping or repeated effect
+// costs one LOAD packet up front and a two-byte TRIGGER record per play
+// instead of a stream of frames.
+//
+// A scene is a short script of steps played one after the other. Each step
+// runs one effect on a run of pixels for durationMs, repeat times over. A
+// scene flagged SCENE_FLAG_LOOP starts over after its last step, any other
+// scene stops there and its pixels show the frame's own colours again.
+//
+// Rendering is a pure function of the scene and the time since its trigger,
+// so every receiver that got the same TRIGGER draws the same pixels, and the
+// engine runs unchanged on a host.
+//
+// Effects, with colours a and b:
+//
+//   SCENE_FADE      a to b across each cycle
+//   SCENE_PULSE     a to b and back to a across each cycle
+//   SCENE_CHASE     width pixels of a over b, travelling the run once per cycle
+//   SCENE_GRADIENT  a to b and back spread over width pixels (0 for the whole
+//                   run), scrolled one wave per cycle
+
+#define SCENE_SLOTS 8     // Scenes a receiver holds, slot IDs 0 to SCENE_SLOTS - 1
+#define SCENE_MAX_STEPS 4 // Steps one scene can have
+#define SCENE_FLAG_LOOP 0x01
+
+enum SceneEffect
+{
+  SCENE_FADE = 1,
+  SCENE_PULSE,
+  SCENE_CHASE,
+  SCENE_GRADIENT,
+};
+
+enum SceneAction
+{
+  SCENE_STOP = 0,
+  SCENE_PLAY, // Start from the top, also if it is already playing
+};
+
+typedef struct
+{
+  uint8_t effect; // SceneEffect
+  uint16_t start;
+  uint16_t count;
+  RGB a;
+  RGB b;
+  uint16_t durationMs; // One cycle, never 0
+  uint8_t width;       // SCENE_CHASE and SCENE_GRADIENT only
+  uint8_t repeat;      // Cycles the step runs for, 0 counts as 1
+} SceneStep;
+
+typedef struct
+{
+  uint8_t flags; // SCENE_FLAG_*
+  uint8_t stepCount;
+  SceneStep steps[SCENE_MAX_STEPS];
+} Scene;
+
+// Every slot and what was last asked of it. Lives in the frame buffer, so it
+// reaches the renderer with the frames and a frame the renderer skips cannot
+// lose a trigger: the count moves on either way.
+typedef struct
+{
+  Scene slots[SCENE_SLOTS];
+  uint8_t triggers[SCENE_SLOTS]; // +1 for every TRIGGER of the slot
+  uint8_t playing;               // Bit per slot, set by SCENE_PLAY, cleared by SCENE_STOP
+} SceneTable;
+
+// Length of one pass through the scene, in milliseconds
+uint32_t sceneLength(const Scene &scene);
+
+// Draw the scene as it is elapsed ms after its trigger into out, indexed by
+// pixel index and size long. Steps are clipped to out. Returns false, drawing
+// nothing, once a scene that does not loop has finished.
+bool renderScene(const Scene &scene, uint32_t elapsed, RGB *out, uint16_t size);
+
+// Plays the scenes of a SceneTable on the renderer's clock
+class SceneEngine
+{
+public:
+  SceneEngine();
+
+  // Start and stop scenes the table has triggered since the last call, then
+  // draw the playing ones over out as they are at now. Higher slots draw over
+  // lower ones. Newly triggered scenes start at startAt, the latch time of a
+  // staged frame, and hold their first step until then.
+  void render(const SceneTable &table, RGB *out, uint16_t size, unsigned long now, unsigned long startAt);
+
+  // A scene is playing, the LEDs change without new frames
+  bool active() const { return playing != 0; }
+
+private:
+  uint8_t seen[SCENE_SLOTS]; // Trigger counts already acted on
+  unsigned long startedAt[SCENE_SLOTS];
+  uint8_t playing; // Bit per slot
+  uint8_t waiting; // Bit per slot whose startedAt is still ahead
+};
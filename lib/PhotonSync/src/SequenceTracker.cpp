@@ -0,0 +1,66 @@
+#include "SequenceTracker.h"
+#include <string.h>
+
+SequenceTracker::SequenceTracker()
+{
+  memset(senders, 0, sizeof(senders));
+  memset(&totals, 0, sizeof(totals));
+}
+
+SequenceTracker::Sender *SequenceTracker::find(const uint8_t *mac, unsigned long now, bool *fresh)
+{
+  Sender *oldest = &senders[0];
+  for (int i = 0; i < SEQ_MAX_SENDERS; i++)
+  {
+    Sender &sender = senders[i];
+    if (sender.used && memcmp(sender.mac, mac, 6) == 0)
+    {
+      *fresh = now - sender.lastSeen > SEQ_TIMEOUT_MS;
+      return &sender;
+    }
+    if (!sender.used || (oldest->used && now - sender.lastSeen > now - oldest->lastSeen))
+    {
+      oldest = &sender;
+    }
+  }
+
+  // New sender, take a free entry or the one heard from least recently
+  memcpy(oldest->mac, mac, 6);
+  oldest->used = true;
+  *fresh = true;
+  return oldest;
+}
+
+SequenceVerdict SequenceTracker::check(const uint8_t *mac, const FrameHeader &header, unsigned long now)
+{
+  bool fresh;
+  Sender *sender = find(mac, now, &fresh);
+  int16_t ahead = (int16_t)(header.sequence - sender->newest); // Wraps with the 16-bit counter
+
+  if (!fresh)
+  {
+    if (ahead == 0)
+    {
+      totals.duplicates++;
+      return SEQ_DUPLICATE;
+    }
+    if (header.flags & FRAME_FLAG_SEQ_RESET || ahead < -SEQ_REORDER_WINDOW)
+    {
+      totals.restarts++;
+    }
+    else if (ahead < 0)
+    {
+      totals.late++;
+      return SEQ_LATE;
+    }
+    else
+    {
+      totals.lost += ahead - 1;
+    }
+  }
+
+  sender->newest = header.sequence;
+  sender->lastSeen = now;
+  totals.received++;
+  return SEQ_ACCEPT;
+}
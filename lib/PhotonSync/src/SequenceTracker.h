@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include "FrameProtocol.h"
+
+#define SEQ_MAX_SENDERS 4       // Senders tracked at once, the least recently heard one is replaced
+#define SEQ_REORDER_WINDOW 1024 // A packet further behind than this means the sender restarted
+#define SEQ_TIMEOUT_MS 3000     // A sender silent this long starts over with its next packet
+
+enum SequenceVerdict
+{
+  SEQ_ACCEPT = 0,
+  SEQ_DUPLICATE, // Same sequence number as the newest packet, drop it
+  SEQ_LATE,      // Older than a packet already applied, drop it so it cannot overwrite newer colours
+};
+
+typedef struct
+{
+  uint32_t received;   // Packets accepted
+  uint32_t lost;       // Sequence numbers skipped, including the ones that later arrive late
+  uint32_t late;       // Packets dropped for arriving out of order
+  uint32_t duplicates; // Packets dropped as repeats
+  uint32_t restarts;   // Sender restarts, seen as FRAME_FLAG_SEQ_RESET or a jump back
+} SequenceStats;
+
+// Per-sender sequence numbers on the receiver. Every frame packet is checked
+// against the newest one from the same MAC before it is decoded.
+//
+// Runs on the WiFi task. The counters are plain 32-bit words, so loop() can
+// read them without a lock, possibly one packet out of date.
+class SequenceTracker
+{
+public:
+  SequenceTracker();
+
+  SequenceVerdict check(const uint8_t *mac, const FrameHeader &header, unsigned long now);
+
+  const SequenceStats &stats() const { return totals; }
+
+private:
+  typedef struct
+  {
+    uint8_t mac[6];
+    bool used;
+    uint16_t newest;        // Highest sequence number accepted
+    unsigned long lastSeen; // millis() of the last packet
+  } Sender;
+
+  Sender *find(const uint8_t *mac, unsigned long now, bool *fresh);
+
+  Sender senders[SEQ_MAX_SENDERS];
+  SequenceStats totals;
+};
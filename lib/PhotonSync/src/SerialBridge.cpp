@@ -0,0 +1,117 @@
+#include "SerialBridge.h"
+#include "Pixel.h"
+#include "Telemetry.h"
+#include <stdio.h>
+
+#define LOG_MODULE "serial"
+#define LOG_LEVEL LOG_LEVEL_WARN
+#include "Log.h"
+
+SerialBridge::SerialBridge(TxRing &ring, const PacketSink &sink, unsigned long flushIntervalMs)
+    : ring(ring), framePacker(sink, flushIntervalMs), adaptive(true), lineCount(0), repairCount(0)
+{
+}
+
+SerialEvent SerialBridge::feed(uint8_t byte, unsigned long now)
+{
+  SerialEvent event = serialParser.feed(byte);
+  switch (event)
+  {
+  case SERIAL_FRAME:
+    telemetry.count(TELEMETRY_SERIAL_FRAMES);
+    handleFrame(now);
+    break;
+  case SERIAL_TEXT_LINE:
+    handleLine(serialParser.line(), now);
+    break;
+  case SERIAL_BAD_FRAME:
+    telemetry.count(TELEMETRY_SERIAL_ERRORS);
+    LOG_INFO("Dropped a bad serial frame, errors so far: %u", serialParser.errors());
+    break;
+  default:
+    break;
+  }
+  return event;
+}
+
+void SerialBridge::poll(unsigned long now)
+{
+  updatePacing(now);
+  if (!adaptive || rateController.clearToSend(ring.queued()))
+  {
+    framePacker.poll(now);
+  }
+  ring.kick();
+}
+
+void SerialBridge::handleFrame(unsigned long now)
+{
+  if (serialParser.type() == SERIAL_TYPE_STATS_REQUEST)
+  {
+    return; // Answered by the caller
+  }
+
+  const uint8_t *body = serialParser.body();
+  size_t len = serialParser.bodyLength();
+  if (serialParser.type() != SERIAL_TYPE_PIXELS || len < 2 || (len - 2) % sizeof(RGB) != 0)
+  {
+    LOG_WARN("Invalid frame received over serial, type %u, %u bytes", serialParser.type(), len);
+    return;
+  }
+
+  // The frame is complete, send it now rather than waiting for the deadline.
+  // If the radio is still busy with the last one, poll() sends it once the
+  // ring drains, with whatever newer frames changed in the meantime.
+  uint16_t start = body[0] | (body[1] << 8);
+  framePacker.set(start, (const RGB *)&body[2], (len - 2) / sizeof(RGB), now);
+  bool clear = !adaptive || rateController.clearToSend(ring.queued());
+  rateController.frameDone(!clear);
+  if (clear)
+  {
+    framePacker.flush();
+  }
+}
+
+void SerialBridge::handleLine(const char *line, unsigned long now)
+// Legacy "index red green blue" text, one pixel per line
+{
+  if (line[0] == '\0')
+  {
+    return;
+  }
+
+  int index, red, green, blue;
+  if (sscanf(line, "%d %d %d %d", &index, &red, &green, &blue) != 4 || index <= 0 || index > 255)
+  {
+    LOG_WARN("Invalid pixel data received over serial.");
+    return;
+  }
+
+  Pixel pixel;
+  pixel.index = index;
+  pixel.red = red;
+  pixel.green = green;
+  pixel.blue = blue;
+  framePacker.add(pixel, now);
+  lineCount++;
+}
+
+void SerialBridge::updatePacing(unsigned long now)
+// Feed the send results to the rate controller and pass its pacing to the packer
+{
+  if (!adaptive)
+  {
+    return;
+  }
+  if (rateController.update(now, ring.delivered(), ring.failed()))
+  {
+    const RatePacing &pacing = rateController.pacing();
+    framePacker.setPacing(pacing.batchPixels, pacing.quantizeBits, now);
+    LOG_INFO("Compression level %u, %u bits dropped per channel", pacing.level, pacing.quantizeBits);
+  }
+  if (rateController.repairDue(now))
+  {
+    framePacker.requestKeyframe(); // A lost delta left a receiver behind
+    repairCount++;
+  }
+}
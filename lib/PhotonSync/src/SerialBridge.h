@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FramePacker.h"
+#include "RateController.h"
+#include "SerialFrameParser.h"
+#include "TxRing.h"
+
+// sender-gh's path from Grasshopper to the radio: parses the serial stream,
+// packs binary pixel frames and legacy text lines into frame packets and
+// paces them to the link with a RateController. Shared by sender-gh and the
+// simulator.
+//
+// The packer builds its packets in sink, which hands out slots of ring. Call
+// feed() with every serial byte and poll() every loop.
+class SerialBridge
+{
+public:
+  SerialBridge(TxRing &ring, const PacketSink &sink, unsigned long flushIntervalMs);
+
+  // Pace frames to the link, on by default. Off, every frame goes out at
+  // once with its colours exact, however far the ring is behind.
+  void setAdaptive(bool adaptive) { this->adaptive = adaptive; }
+
+  // One byte from the serial port. Pixel frames and text lines are handled
+  // here, a SERIAL_FRAME of another type is left to the caller, see parser().
+  SerialEvent feed(uint8_t byte, unsigned long now);
+
+  // Update the pacing, send pixels that waited long enough and retry a
+  // packet the radio refused
+  void poll(unsigned long now);
+
+  const SerialFrameParser &parser() const { return serialParser; }
+  FramePacker &packer() { return framePacker; }
+  const RateController &rate() const { return rateController; }
+
+  uint32_t textLines() const { return lineCount; }
+  uint32_t repairs() const { return repairCount; } // Keyframes sent to repair a failed send
+
+private:
+  void handleFrame(unsigned long now);
+  void handleLine(const char *line, unsigned long now);
+  void updatePacing(unsigned long now);
+
+  TxRing &ring;
+  SerialFrameParser serialParser;
+  FramePacker framePacker;
+  RateController rateController;
+  bool adaptive;
+  uint32_t lineCount;
+  uint32_t repairCount;
+};
@@ -0,0 +1,102 @@
+#include "SerialFrameParser.h"
+#include "Crc.h"
+#include <string.h>
+
+SerialFrameParser::SerialFrameParser()
+    : state(WAIT_SYNC1), length(0), received(0), crc(0), textLength(0), frameCount(0), errorCount(0)
+{
+  text[0] = '\0';
+}
+
+SerialEvent SerialFrameParser::feed(uint8_t byte)
+{
+  switch (state)
+  {
+  case WAIT_SYNC1:
+    if (byte == SERIAL_SYNC1)
+    {
+      state = WAIT_SYNC2;
+      return SERIAL_NONE;
+    }
+    // Text mode
+    if (byte == '\n')
+    {
+      text[textLength] = '\0';
+      textLength = 0;
+      return SERIAL_TEXT_LINE;
+    }
+    if (byte != '\r' && textLength < SERIAL_MAX_LINE)
+    {
+      text[textLength++] = byte;
+    }
+    return SERIAL_NONE;
+
+  case WAIT_SYNC2:
+    state = byte == SERIAL_SYNC2 ? LENGTH_LO : WAIT_SYNC1;
+    return SERIAL_NONE;
+
+  case LENGTH_LO:
+    length = byte;
+    crc = crc16(&byte, 1);
+    state = LENGTH_HI;
+    return SERIAL_NONE;
+
+  case LENGTH_HI:
+    length |= byte << 8;
+    crc = crc16(&byte, 1, crc);
+    if (length == 0 || length > SERIAL_MAX_PAYLOAD)
+    {
+      state = WAIT_SYNC1;
+      errorCount++;
+      return SERIAL_BAD_FRAME;
+    }
+    received = 0;
+    state = PAYLOAD;
+    return SERIAL_NONE;
+
+  case PAYLOAD:
+    payload[received++] = byte;
+    if (received == length)
+    {
+      crc = crc16(payload, length, crc);
+      state = CRC_LO;
+    }
+    return SERIAL_NONE;
+
+  case CRC_LO:
+    received = byte; // Reuse the counter for the low CRC byte
+    state = CRC_HI;
+    return SERIAL_NONE;
+
+  case CRC_HI:
+    state = WAIT_SYNC1;
+    textLength = 0; // Drop any text half-line the frame interrupted
+    if ((uint16_t)(received | (byte << 8)) != crc)
+    {
+      errorCount++;
+      return SERIAL_BAD_FRAME;
+    }
+    frameCount++;
+    return SERIAL_FRAME;
+  }
+  return SERIAL_NONE;
+}
+
+size_t writeSerialFrame(uint8_t *out, size_t capacity, uint8_t type, const uint8_t *body, size_t len)
+{
+  if (len + 1 > SERIAL_MAX_PAYLOAD || len + SERIAL_FRAME_OVERHEAD > capacity)
+  {
+    return 0;
+  }
+  uint16_t length = len + 1;
+  out[0] = SERIAL_SYNC1;
+  out[1] = SERIAL_SYNC2;
+  out[2] = length & 0xFF;
+  out[3] = length >> 8;
+  out[4] = type;
+  memcpy(&out[5], body, len);
+  uint16_t crc = crc16(&out[2], len + 3);
+  out[5 + len] = crc & 0xFF;
+  out[6 + len] = crc >> 8;
+  return len + SERIAL_FRAME_OVERHEAD;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FrameProtocol.h"
+
+// Binary frames from Grasshopper over serial:
+//
+//   0xA5 0x5A        sync
+//   len lo, hi       length of type + body
+//   type             SERIAL_TYPE_*
+//   body             len - 1 bytes
+//   crc lo, hi       CRC-16/CCITT-FALSE over len, type and body
+//
+// SERIAL_TYPE_PIXELS bodies are a 16-bit little-endian start index followed
+// by one RGB triple per pixel, a whole frame at a time.
+//
+// The same framing carries SERIAL_TYPE_STATS packets (see Telemetry.h) the
+// other way, and an empty SERIAL_TYPE_STATS_REQUEST asks for one.
+//
+// Bytes outside a binary frame are collected as text lines in the old
+// "index red green blue\n" format, so existing Grasshopper scripts keep
+// working. The sync byte is never valid ASCII, so the two cannot be confused.
+
+#define SERIAL_SYNC1 0xA5
+#define SERIAL_SYNC2 0x5A
+#define SERIAL_MAX_PAYLOAD (3 + FRAME_MAX_PIXELS * 3) // type + body, a whole FRAME_MAX_PIXELS frame
+#define SERIAL_MAX_LINE 32
+#define SERIAL_FRAME_OVERHEAD 7 // Sync, length, type and CRC around the body
+
+#define SERIAL_TYPE_PIXELS 0x01
+#define SERIAL_TYPE_STATS 0x02
+#define SERIAL_TYPE_STATS_REQUEST 0x03
+
+enum SerialEvent
+{
+  SERIAL_NONE = 0,   // Need more bytes
+  SERIAL_FRAME,      // A checked binary frame is ready, see type() and body()
+  SERIAL_TEXT_LINE,  // A text line is ready, see line()
+  SERIAL_BAD_FRAME,  // A binary frame was dropped: bad length or CRC
+};
+
+// Incremental, allocation-free parser. Feed it bytes as they arrive, in any
+// fragmentation. Whatever it returns stays valid until the next feed().
+class SerialFrameParser
+{
+public:
+  SerialFrameParser();
+
+  SerialEvent feed(uint8_t byte);
+
+  uint8_t type() const { return payload[0]; }
+  const uint8_t *body() const { return &payload[1]; }
+  size_t bodyLength() const { return length - 1; }
+  const char *line() const { return text; }
+
+  uint32_t frames() const { return frameCount; }
+  uint32_t errors() const { return errorCount; }
+
+private:
+  enum State
+  {
+    WAIT_SYNC1,
+    WAIT_SYNC2,
+    LENGTH_LO,
+    LENGTH_HI,
+    PAYLOAD,
+    CRC_LO,
+    CRC_HI,
+  };
+
+  State state;
+  uint16_t length;
+  uint16_t received;
+  uint16_t crc;
+  uint8_t payload[SERIAL_MAX_PAYLOAD];
+  char text[SERIAL_MAX_LINE + 1];
+  size_t textLength;
+  uint32_t frameCount;
+  uint32_t errorCount;
+};
+
+// Frame body as one serial frame. Returns the length written, 0 if it does
+// not fit in capacity or in SERIAL_MAX_PAYLOAD.
+size_t writeSerialFrame(uint8_t *out, size_t capacity, uint8_t type, const uint8_t *body, size_t len);
@@ -0,0 +1,281 @@
+#include "StateLog.h"
+#include "Crc.h"
+#include <string.h>
+
+#define LOG_HEADER_SIZE 4
+#define RECORD_OVERHEAD 4 // Length before the packet, CRC after it
+
+static const uint8_t LOG_HEADER[LOG_HEADER_SIZE] = {'P', 'S', 'L', STATE_LOG_VERSION};
+
+static bool sameScene(const Scene &a, const Scene &b)
+{
+  if (a.flags != b.flags || a.stepCount != b.stepCount)
+  {
+    return false;
+  }
+  for (uint8_t s = 0; s < a.stepCount && s < SCENE_MAX_STEPS; s++)
+  {
+    const SceneStep &x = a.steps[s];
+    const SceneStep &y = b.steps[s];
+    if (x.effect != y.effect || x.start != y.start || x.count != y.count || x.a != y.a || x.b != y.b ||
+        x.durationMs != y.durationMs || x.width != y.width || x.repeat != y.repeat)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A looping scene that is playing, the only kind restore plays again
+static bool looping(const SceneTable &scenes, uint8_t slot)
+{
+  return (scenes.playing & (1 << slot)) && (scenes.slots[slot].flags & SCENE_FLAG_LOOP);
+}
+
+StateLog::StateLog(StateStorage &storage)
+    : storage(storage), logSize(0), compactNext(true), savedFirst(0), savedCount(0)
+{
+  memset(saved, 0, sizeof(saved));
+  memset(&savedScenes, 0, sizeof(savedScenes));
+}
+
+size_t StateLog::restore(FrameTarget *target)
+{
+  logSize = 0;
+  compactNext = true;
+  size_t len = storage.read(buffer, sizeof(buffer));
+  if (len < LOG_HEADER_SIZE || memcmp(buffer, LOG_HEADER, LOG_HEADER_SIZE) != 0)
+  {
+    return 0; // No log, or one written by another version
+  }
+
+  size_t pos = LOG_HEADER_SIZE;
+  size_t applied = 0;
+  while (len - pos >= RECORD_OVERHEAD)
+  {
+    size_t packetLen = buffer[pos] | (buffer[pos + 1] << 8);
+    if (packetLen > len - pos - RECORD_OVERHEAD)
+    {
+      break;
+    }
+    uint16_t crc = buffer[pos + 2 + packetLen] | (buffer[pos + 3 + packetLen] << 8);
+    FrameHeader header;
+    if (crc16(&buffer[pos], 2 + packetLen) != crc ||
+        decodeFrame(&buffer[pos + 2], packetLen, &header, target) != FRAME_OK)
+    {
+      break;
+    }
+    applied++;
+    pos += RECORD_OVERHEAD + packetLen;
+  }
+  logSize = pos;
+  compactNext = pos != len; // Cut short by a reset, start over rather than append after the broken record
+
+  // What was restored is the base of the next delta
+  uint32_t end = (uint32_t)target->windowStart + target->windowCount;
+  end = end < target->size ? end : target->size;
+  uint16_t first = target->windowStart < end ? target->windowStart : end;
+  SceneTable none;
+  memset(&none, 0, sizeof(none));
+  remember(target->pixels, first, end - first, target->scenes != NULL ? *target->scenes : none);
+  return applied;
+}
+
+bool StateLog::save(const RGB *pixels, uint16_t first, uint16_t count, const SceneTable &scenes)
+{
+  // Clipped to the pixel buffer like a decode window
+  first = first < FRAME_MAX_PIXELS ? first : FRAME_MAX_PIXELS;
+  count = count < FRAME_MAX_PIXELS - first ? count : FRAME_MAX_PIXELS - first;
+  if (compactNext || first != savedFirst || count != savedCount)
+  {
+    return compact(pixels, first, count, scenes);
+  }
+
+  // The new records have to fit in what is left of STATE_LOG_MAX, or the log
+  // is compacted instead
+  const size_t limit = STATE_LOG_MAX - logSize;
+  size_t used = 0;
+  FrameHeader header = {0, 0, 0};
+
+  if (count > 0)
+  {
+    if (limit < RECORD_OVERHEAD + FRAME_HEADER_SIZE)
+    {
+      return compact(pixels, first, count, scenes);
+    }
+    uint16_t consumed;
+    size_t len = encodeFrame(&buffer[2], limit - RECORD_OVERHEAD, header, pixels, saved, first, count, &consumed);
+    if (consumed < count)
+    {
+      return compact(pixels, first, count, scenes);
+    }
+    if (len > FRAME_HEADER_SIZE)
+    {
+      sealRecord(&used, len);
+    }
+  }
+
+  if (limit - used < RECORD_OVERHEAD + FRAME_HEADER_SIZE)
+  {
+    return compact(pixels, first, count, scenes);
+  }
+  size_t len = encodeScenes(&buffer[used + 2], limit - used - RECORD_OVERHEAD, scenes, false);
+  if (len == 0)
+  {
+    return compact(pixels, first, count, scenes);
+  }
+  if (len > FRAME_HEADER_SIZE)
+  {
+    sealRecord(&used, len);
+  }
+
+  if (used == 0)
+  {
+    return true; // Nothing changed, nothing written
+  }
+  if (!storage.append(buffer, used))
+  {
+    compactNext = true; // Part of it may have made it, rewrite the log next time
+    return false;
+  }
+  logSize += used;
+  remember(pixels, first, count, scenes);
+  return true;
+}
+
+bool StateLog::compact(const RGB *pixels, uint16_t first, uint16_t count, const SceneTable &scenes)
+{
+  memcpy(buffer, LOG_HEADER, LOG_HEADER_SIZE);
+  size_t used = LOG_HEADER_SIZE;
+  FrameHeader header = {0, 0, 0};
+
+  if (count > 0)
+  {
+    uint16_t consumed;
+    size_t len = encodeFrame(&buffer[used + 2], sizeof(buffer) - used - RECORD_OVERHEAD, header,
+                             pixels, NULL, first, count, &consumed);
+    if (consumed < count)
+    {
+      return false; // Cannot happen for FRAME_MAX_PIXELS pixels
+    }
+    sealRecord(&used, len);
+  }
+
+  size_t len = encodeScenes(&buffer[used + 2], sizeof(buffer) - used - RECORD_OVERHEAD, scenes, true);
+  if (len > FRAME_HEADER_SIZE)
+  {
+    sealRecord(&used, len);
+  }
+
+  if (!storage.replace(buffer, used))
+  {
+    compactNext = true;
+    return false;
+  }
+  logSize = used;
+  compactNext = false;
+  remember(pixels, first, count, scenes);
+  return true;
+}
+
+void StateLog::sealRecord(size_t *used, size_t len)
+// Frame the packet already written at buffer[*used + 2] as a record
+{
+  uint8_t *record = &buffer[*used];
+  record[0] = len & 0xFF;
+  record[1] = len >> 8;
+  uint16_t crc = crc16(record, 2 + len);
+  record[2 + len] = crc & 0xFF;
+  record[3 + len] = crc >> 8;
+  *used += RECORD_OVERHEAD + len;
+}
+
+size_t StateLog::encodeScenes(uint8_t *out, size_t capacity, const SceneTable &scenes, bool all) const
+// One packet of LOADs for the scenes that changed and TRIGGERs for the loops
+// that started or stopped, or every loaded scene and playing loop with all.
+// Returns 0 if they do not fit.
+{
+  FrameWriter writer(out, capacity);
+  FrameHeader header = {0, 0, 0};
+  writer.begin(header);
+  for (uint8_t slot = 0; slot < SCENE_SLOTS; slot++)
+  {
+    const Scene &scene = scenes.slots[slot];
+    if (scene.stepCount == 0)
+    {
+      continue; // Never loaded
+    }
+    if ((all || !sameScene(scene, savedScenes.slots[slot])) && !writer.load(slot, scene))
+    {
+      return 0;
+    }
+
+    bool playing = looping(scenes, slot);
+    if (all ? playing : playing != looping(savedScenes, slot))
+    {
+      if (!writer.trigger(slot, playing ? SCENE_PLAY : SCENE_STOP))
+      {
+        return 0;
+      }
+    }
+  }
+  return writer.length();
+}
+
+void StateLog::remember(const RGB *pixels, uint16_t first, uint16_t count, const SceneTable &scenes)
+{
+  memcpy(&saved[first], &pixels[first], count * sizeof(RGB));
+  savedFirst = first;
+  savedCount = count;
+  memcpy(&savedScenes, &scenes, sizeof(SceneTable));
+}
+
+#ifdef ARDUINO
+size_t FsStateStorage::read(uint8_t *out, size_t capacity)
+{
+  // A reset between removing the old log and renaming the compacted one
+  // leaves only the compacted one
+  if (!fs.exists(STATE_LOG_FILE) && fs.exists(STATE_LOG_TEMP))
+  {
+    fs.rename(STATE_LOG_TEMP, STATE_LOG_FILE);
+  }
+
+  File file = fs.open(STATE_LOG_FILE, "r");
+  if (!file)
+  {
+    return 0;
+  }
+  size_t len = file.read(out, capacity);
+  file.close();
+  return len;
+}
+
+bool FsStateStorage::append(const uint8_t *data, size_t len)
+{
+  File file = fs.open(STATE_LOG_FILE, "a");
+  if (!file)
+  {
+    return false;
+  }
+  size_t written = file.write(data, len);
+  file.close();
+  return written == len;
+}
+
+bool FsStateStorage::replace(const uint8_t *data, size_t len)
+{
+  File file = fs.open(STATE_LOG_TEMP, "w");
+  if (!file)
+  {
+    return false;
+  }
+  size_t written = file.write(data, len);
+  file.close();
+  if (written != len)
+  {
+    return false;
+  }
+  fs.remove(STATE_LOG_FILE);
+  return fs.rename(STATE_LOG_TEMP, STATE_LOG_FILE);
+}
+#endif
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FrameProtocol.h"
+#include "Scene.h"
+
+// What a receiver showed, kept in flash so it comes back right after a reset
+// instead of the start colour.
+//
+// The log is append-only. Each save appends only what changed since the last
+// one: a delta frame packet for the pixels, and a packet with LOAD and TRIGGER
+// records for the scenes. Restoring replays the packets through decodeFrame().
+// Once the log would pass STATE_LOG_MAX it is compacted: rewritten as one
+// keyframe and every loaded scene, which becomes the new start of the log.
+//
+//   bytes 0-3  'P', 'S', 'L', STATE_LOG_VERSION
+//   then       records: length lo, hi, a frame packet of that length,
+//              CRC-16 of the length bytes and the packet, lo, hi
+//
+// A record cut short by a reset mid-write fails its CRC. Restoring stops
+// there and the next save compacts the log, dropping the broken tail.
+//
+// Only looping scenes are played again on restore. A one-shot effect that
+// already ran is not repeated.
+
+#define STATE_LOG_VERSION 1
+#define STATE_LOG_MAX 16384 // Largest log, also the buffer saves and restores go through
+#define STATE_LOG_FILE "/state.log"
+#define STATE_LOG_TEMP "/state.tmp" // A compacted log before it replaces STATE_LOG_FILE
+
+// Where the log lives. SPIFFS on the receiver, anything that can hold bytes
+// elsewhere.
+class StateStorage
+{
+public:
+  virtual ~StateStorage() {}
+
+  // Read the whole log, up to capacity bytes. Returns the length read, 0 if
+  // there is no log.
+  virtual size_t read(uint8_t *out, size_t capacity) = 0;
+
+  virtual bool append(const uint8_t *data, size_t len) = 0;
+
+  // Swap the whole log for data. A reset halfway must leave either the old
+  // log or the new one.
+  virtual bool replace(const uint8_t *data, size_t len) = 0;
+};
+
+class StateLog
+{
+public:
+  StateLog(StateStorage &storage);
+
+  // Replay the log into target, scenes included. Returns the number of
+  // records applied, 0 if there was nothing to restore.
+  size_t restore(FrameTarget *target);
+
+  // Record pixels [first, first + count) and the scenes if they changed since
+  // the last save. Pixels past FRAME_MAX_PIXELS are left out. Returns false if
+  // the storage refused the write.
+  bool save(const RGB *pixels, uint16_t first, uint16_t count, const SceneTable &scenes);
+
+  // Bytes in the log, as far as this log knows
+  size_t size() const { return logSize; }
+
+private:
+  bool compact(const RGB *pixels, uint16_t first, uint16_t count, const SceneTable &scenes);
+  void sealRecord(size_t *used, size_t len);
+  size_t encodeScenes(uint8_t *out, size_t capacity, const SceneTable &scenes, bool all) const;
+  void remember(const RGB *pixels, uint16_t first, uint16_t count, const SceneTable &scenes);
+
+  StateStorage &storage;
+  size_t logSize;
+  bool compactNext; // The log is missing or broken, the next save starts it over
+  uint16_t savedFirst;
+  uint16_t savedCount;
+  RGB saved[FRAME_MAX_PIXELS]; // Pixels as the log has them, the base of the next delta
+  SceneTable savedScenes;
+  uint8_t buffer[STATE_LOG_MAX];
+};
+
+#ifdef ARDUINO
+#include <FS.h>
+
+// The log as STATE_LOG_FILE on a flash file system. Compaction writes
+// STATE_LOG_TEMP and renames it over the log.
+class FsStateStorage : public StateStorage
+{
+public:
+  FsStateStorage(fs::FS &fs) : fs(fs) {}
+
+  size_t read(uint8_t *out, size_t capacity);
+  bool append(const uint8_t *data, size_t len);
+  bool replace(const uint8_t *data, size_t len);
+
+private:
+  fs::FS &fs;
+};
+#endif
@@ -0,0 +1,103 @@
+#include "Telemetry.h"
+#include "SerialFrameParser.h"
+
+Telemetry telemetry;
+
+Telemetry::Telemetry()
+{
+  for (int c = 0; c < TELEMETRY_COUNTERS; c++)
+  {
+    counters[c].store(0, std::memory_order_relaxed);
+  }
+  for (int h = 0; h < TELEMETRY_HISTOGRAMS; h++)
+  {
+    histograms[h].count.store(0, std::memory_order_relaxed);
+    histograms[h].sum.store(0, std::memory_order_relaxed);
+    histograms[h].max.store(0, std::memory_order_relaxed);
+    for (int b = 0; b < TELEMETRY_BUCKETS; b++)
+    {
+      histograms[h].buckets[b].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void Telemetry::record(TelemetryHistogram histogram, uint32_t us)
+{
+  Histogram &h = histograms[histogram];
+  int bucket = us < 2 ? 0 : 31 - __builtin_clz(us);
+  if (bucket >= TELEMETRY_BUCKETS)
+  {
+    bucket = TELEMETRY_BUCKETS - 1;
+  }
+  h.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  h.count.fetch_add(1, std::memory_order_relaxed);
+  h.sum.fetch_add(us, std::memory_order_relaxed);
+
+  // Only a new maximum pays for the compare-and-swap
+  uint32_t max = h.max.load(std::memory_order_relaxed);
+  while (us > max && !h.max.compare_exchange_weak(max, us, std::memory_order_relaxed))
+  {
+  }
+}
+
+void Telemetry::interval(TelemetryHistogram histogram, uint32_t now, uint32_t *last)
+{
+  if (*last != 0)
+  {
+    record(histogram, now - *last);
+  }
+  *last = now != 0 ? now : 1;
+}
+
+static uint8_t *putU32(uint8_t *out, uint32_t value)
+{
+  out[0] = value;
+  out[1] = value >> 8;
+  out[2] = value >> 16;
+  out[3] = value >> 24;
+  return out + 4;
+}
+
+size_t Telemetry::write(uint8_t *out, size_t capacity, TelemetryRole role, uint32_t nowMs) const
+{
+  if (capacity < TELEMETRY_PACKET_SIZE)
+  {
+    return 0;
+  }
+
+  uint8_t *p = out;
+  *p++ = TELEMETRY_VERSION;
+  *p++ = role;
+  p = putU32(p, nowMs);
+  *p++ = TELEMETRY_COUNTERS;
+  *p++ = TELEMETRY_HISTOGRAMS;
+  for (int c = 0; c < TELEMETRY_COUNTERS; c++)
+  {
+    p = putU32(p, counters[c].load(std::memory_order_relaxed));
+  }
+  for (int h = 0; h < TELEMETRY_HISTOGRAMS; h++)
+  {
+    const Histogram &histogram = histograms[h];
+    p = putU32(p, histogram.count.load(std::memory_order_relaxed));
+    p = putU32(p, histogram.sum.load(std::memory_order_relaxed));
+    p = putU32(p, histogram.max.load(std::memory_order_relaxed));
+    for (int b = 0; b < TELEMETRY_BUCKETS; b++)
+    {
+      p = putU32(p, histogram.buckets[b].load(std::memory_order_relaxed));
+    }
+  }
+  return p - out;
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void sendTelemetry(Print &out, TelemetryRole role)
+{
+  uint8_t body[TELEMETRY_PACKET_SIZE];
+  uint8_t frame[TELEMETRY_PACKET_SIZE + SERIAL_FRAME_OVERHEAD];
+  size_t len = telemetry.write(body, sizeof(body), role, millis());
+  len = writeSerialFrame(frame, sizeof(frame), SERIAL_TYPE_STATS, body, len);
+  out.write(frame, len);
+}
+#endif
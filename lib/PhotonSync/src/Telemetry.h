@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Link and render health counters, kept on every target and sent out as a
+// binary stats packet instead of printed as text.
+//
+// Counting is one relaxed atomic add and recording a duration a handful of
+// them, from any task, with no locks and no allocation. Everything is
+// preallocated in the telemetry object.
+//
+// Stats packet, little-endian, sent as a SERIAL_TYPE_STATS serial frame:
+//
+//   byte 0     TELEMETRY_VERSION
+//   byte 1     role (TelemetryRole)
+//   byte 2-5   millis() when the packet was built
+//   byte 6     TELEMETRY_COUNTERS
+//   byte 7     TELEMETRY_HISTOGRAMS
+//   then       one u32 per counter, in TelemetryCounter order
+//   then       per histogram in TelemetryHistogram order: u32 count, u32 sum,
+//              u32 max, then TELEMETRY_BUCKETS u32 bucket counts
+//
+// Bucket 0 counts values below 2 us, bucket i values in [2^i, 2^(i+1)) us,
+// the last bucket everything from 2^(TELEMETRY_BUCKETS-1) us up. Counters and
+// sums are totals since boot that wrap, readers take the difference between
+// two packets.
+
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_BUCKETS 16 // Up to 32 ms, longer values share the last bucket
+#define TELEMETRY_INTERVAL_MS 1000 // How often the targets send the stats packet
+
+enum TelemetryRole
+{
+  TELEMETRY_SENDER = 1,
+  TELEMETRY_RECEIVER,
+};
+
+enum TelemetryCounter
+{
+  TELEMETRY_PACKETS_SENT = 0, // Packets the radio accepted
+  TELEMETRY_PACKETS_ACKED,    // Packets the send callback reported delivered
+  TELEMETRY_PACKETS_FAILED,   // Packets the send callback reported lost
+  TELEMETRY_TX_REFUSED,       // Packets the radio refused, retried later
+  TELEMETRY_TX_RING_FULL,     // Packets that found the TX ring full
+  TELEMETRY_SERIAL_FRAMES,    // Binary frames received over serial
+  TELEMETRY_SERIAL_ERRORS,    // Binary frames dropped for a bad length or CRC
+  TELEMETRY_PACKETS_RECEIVED, // Packets the receive callback saw
+  TELEMETRY_PACKETS_DROPPED,  // Late or repeated packets
+  TELEMETRY_DECODE_ERRORS,    // Packets that failed to decode
+  TELEMETRY_FRAMES_PUBLISHED, // Complete frames handed to the renderer
+  TELEMETRY_FRAMES_RENDERED,  // Frames shown on the LEDs
+  TELEMETRY_FRAMES_DROPPED,   // Frames replaced before the renderer took them
+  TELEMETRY_COUNTERS,
+};
+
+enum TelemetryHistogram
+{
+  TELEMETRY_ACK_US = 0, // From starting a packet to its send callback
+  TELEMETRY_SHOW_US,    // One show() clocking the LEDs out
+  TELEMETRY_LOOP_US,    // Between two loop() passes, or two renders on a receiver. The spread is the jitter.
+  TELEMETRY_HISTOGRAMS,
+};
+
+#define TELEMETRY_HISTOGRAM_SIZE ((3 + TELEMETRY_BUCKETS) * 4)
+#define TELEMETRY_PACKET_SIZE (8 + TELEMETRY_COUNTERS * 4 + TELEMETRY_HISTOGRAMS * TELEMETRY_HISTOGRAM_SIZE)
+
+class Telemetry
+{
+public:
+  Telemetry();
+
+  void count(TelemetryCounter counter, uint32_t n = 1)
+  {
+    counters[counter].fetch_add(n, std::memory_order_relaxed);
+  }
+  void record(TelemetryHistogram histogram, uint32_t us);
+
+  // Record the time since the last call with the same tracker, for the loop
+  // period. The first call only starts timing.
+  void interval(TelemetryHistogram histogram, uint32_t now, uint32_t *last);
+
+  uint32_t counter(TelemetryCounter counter) const { return counters[counter].load(std::memory_order_relaxed); }
+
+  // Build the stats packet body. Returns its length, 0 if it does not fit.
+  // Counters may be a few events apart when other tasks count meanwhile.
+  size_t write(uint8_t *out, size_t capacity, TelemetryRole role, uint32_t nowMs) const;
+
+private:
+  struct Histogram
+  {
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> sum;
+    std::atomic<uint32_t> max;
+    std::atomic<uint32_t> buckets[TELEMETRY_BUCKETS];
+  };
+
+  std::atomic<uint32_t> counters[TELEMETRY_COUNTERS];
+  Histogram histograms[TELEMETRY_HISTOGRAMS];
+};
+
+// The target's counters, shared by the sketch and the library code it runs
+extern Telemetry telemetry;
+
+#ifdef ARDUINO
+#include <Print.h>
+
+// Send the stats packet as a serial frame. Arduino's TX buffer takes it
+// without blocking if it was sized for it with setTxBufferSize().
+void sendTelemetry(Print &out, TelemetryRole role);
+#endif
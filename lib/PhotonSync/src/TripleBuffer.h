@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Single-producer/single-consumer frame exchange without locks.
+//
+// The producer fills writeBuffer() and publish()es it. The consumer calls
+// update() to take the newest published buffer and reads it through
+// readBuffer(). The three buffers rotate by swapping indices, so neither side
+// ever blocks, no pixel is copied during the handoff, and the consumer never
+// sees a buffer the producer is still writing. Frames published faster than
+// the consumer takes them are dropped, the newest one wins.
+template <typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer() : middle(1), back(0), front(2) {}
+
+  // Producer side
+  T &writeBuffer() { return buffers[back]; }
+
+  // Hand the write buffer to the consumer. Returns true if this replaced a
+  // frame the consumer never took.
+  bool publish()
+  {
+    uint8_t previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+    back = previous & INDEX;
+    return previous & FRESH;
+  }
+
+  // Consumer side. Returns true if a newer frame was taken.
+  bool update()
+  {
+    if (!(middle.load(std::memory_order_relaxed) & FRESH))
+    {
+      return false;
+    }
+    front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  const T &readBuffer() const { return buffers[front]; }
+
+private:
+  static const uint8_t INDEX = 0x03;
+  static const uint8_t FRESH = 0x04; // Set while the middle buffer holds a frame the consumer has not taken
+
+  T buffers[3];
+  std::atomic<uint8_t> middle; // Index of the buffer in transit, plus the FRESH bit
+  uint8_t back;                // Owned by the producer
+  uint8_t front;               // Owned by the consumer
+};
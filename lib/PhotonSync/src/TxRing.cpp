@@ -0,0 +1,99 @@
+#include "TxRing.h"
+#include <string.h>
+
+TxRing::TxRing(TxTransport transport)
+    : transport(transport), head(0), tail(0), inFlight(false),
+      deliveredCount(0), failedCount(0), refusedCount(0), retriedCount(0), retries(0), fullCount(0)
+{
+}
+
+size_t TxRing::queued() const
+{
+  return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+uint8_t *TxRing::reserve()
+{
+  uint32_t h = head.load(std::memory_order_relaxed);
+  if (h - tail.load(std::memory_order_acquire) >= TX_RING_SLOTS)
+  {
+    fullCount++;
+    return NULL;
+  }
+  return slots[h % TX_RING_SLOTS].data;
+}
+
+void TxRing::commit(size_t len)
+{
+  uint32_t h = head.load(std::memory_order_relaxed);
+  slots[h % TX_RING_SLOTS].len = len;
+  head.store(h + 1, std::memory_order_release);
+  kick();
+}
+
+bool TxRing::push(const uint8_t *data, size_t len)
+{
+  uint8_t *slot = reserve();
+  if (slot == NULL || len > FRAME_MAX_PACKET)
+  {
+    return false;
+  }
+  memcpy(slot, data, len);
+  commit(len);
+  return true;
+}
+
+void TxRing::kick()
+{
+  for (;;)
+  {
+    bool idle = false;
+    if (!inFlight.compare_exchange_strong(idle, true))
+    {
+      return; // The packet in the air will start the next one when it completes
+    }
+
+    uint32_t t = tail.load(std::memory_order_acquire);
+    if (t != head.load(std::memory_order_acquire))
+    {
+      const Slot &slot = slots[t % TX_RING_SLOTS];
+      if (transport(slot.data, slot.len))
+      {
+        return; // onSent() releases inFlight
+      }
+      refusedCount.fetch_add(1, std::memory_order_relaxed);
+      inFlight.store(false);
+      return;
+    }
+
+    // Nothing to send. A commit that raced with us saw inFlight set and left
+    // its packet for us, so look once more after letting go.
+    inFlight.store(false);
+    if (tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire))
+    {
+      return;
+    }
+  }
+}
+
+void TxRing::onSent(bool delivered)
+{
+  if (tail.load(std::memory_order_relaxed) == head.load(std::memory_order_acquire))
+  {
+    return; // Not one of ours
+  }
+  if (!delivered && retries < TX_RING_RETRIES)
+  {
+    // Keep the slot, the next kick() sends the same packet again
+    retries++;
+    retriedCount.fetch_add(1, std::memory_order_relaxed);
+    inFlight.store(false);
+    kick();
+    return;
+  }
+  retries = 0;
+  (delivered ? deliveredCount : failedCount).fetch_add(1, std::memory_order_relaxed);
+  tail.fetch_add(1, std::memory_order_release);
+  inFlight.store(false);
+  kick();
+}
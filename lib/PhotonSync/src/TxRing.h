@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "FrameProtocol.h"
+
+#define TX_RING_SLOTS 8 // Packets that can wait for the radio, a power of two
+#define TX_RING_RETRIES 1 // Times a packet that was not acknowledged is sent again before it counts as failed
+
+// Starts sending one packet. Returns false if the radio refused it, in which
+// case the packet stays queued and is retried on the next kick().
+typedef bool (*TxTransport)(const uint8_t *data, size_t len);
+
+// Bounded lock-free queue between loop() and the radio's send callback.
+//
+// loop() is the only producer: it writes a packet into a slot with reserve()
+// and commit(), or copies one in with push(). At most one packet is in the
+// air at a time. Whoever finds the radio idle, loop() after a commit or the
+// send callback after a completion, claims it with a compare-and-swap on
+// inFlight and starts the next packet straight from its slot. The callback
+// reports every completion through onSent(), which frees the slot. A packet
+// that was not acknowledged keeps its slot and goes out again, up to
+// TX_RING_RETRIES times, before it counts as failed.
+//
+// When the ring is full, reserve() and push() fail at once instead of
+// blocking. The caller keeps its data and sends the newest version once room
+// frees up, so stale frames are coalesced instead of queued.
+class TxRing
+{
+public:
+  TxRing(TxTransport transport);
+
+  // Producer side. reserve() returns a FRAME_MAX_PACKET byte slot to build the
+  // next packet in, or NULL if the ring is full. commit() queues it.
+  uint8_t *reserve();
+  void commit(size_t len);
+  bool push(const uint8_t *data, size_t len);
+
+  // Start the next packet if the radio is idle. commit() calls this; call it
+  // every loop as well so a packet the transport refused is retried.
+  void kick();
+
+  // Completion side, called from the send callback once per started packet
+  void onSent(bool delivered);
+
+  size_t queued() const;
+  size_t space() const { return TX_RING_SLOTS - queued(); }
+
+  uint32_t delivered() const { return deliveredCount.load(std::memory_order_relaxed); }
+  uint32_t failed() const { return failedCount.load(std::memory_order_relaxed); }
+  uint32_t refused() const { return refusedCount.load(std::memory_order_relaxed); }
+  uint32_t retried() const { return retriedCount.load(std::memory_order_relaxed); }
+  uint32_t full() const { return fullCount; }
+
+private:
+  struct Slot
+  {
+    uint8_t data[FRAME_MAX_PACKET];
+    size_t len;
+  };
+
+  TxTransport transport;
+  Slot slots[TX_RING_SLOTS];
+  std::atomic<uint32_t> head; // Slots committed, written by the producer
+  std::atomic<uint32_t> tail; // Slots completed, written by whoever completes
+  std::atomic<bool> inFlight; // A packet is in the air, or someone is starting one
+  std::atomic<uint32_t> deliveredCount;
+  std::atomic<uint32_t> failedCount;  // Sent but not acknowledged
+  std::atomic<uint32_t> refusedCount; // Not accepted by the transport, retried
+  std::atomic<uint32_t> retriedCount; // Not acknowledged and sent again
+  uint8_t retries;                    // Times the packet at tail went out again, completion side only
+  uint32_t fullCount;                 // reserve() found no free slot, producer only
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <unity.h>
+
+// Timing for the bench_* suites. Each benchmark is a Unity test that times a
+// kernel with benchRun() and prints the result with benchReport(), so
+// `pio test -e native_bench -v` shows one line per measurement.
+
+#define BENCH_MIN_NS 200000000LL // Repeat a kernel for at least this long
+
+// Keeps results the compiler would otherwise optimise away
+static volatile uint32_t benchSink;
+
+// Nanoseconds per call of fn, averaged over as many calls as fit in BENCH_MIN_NS
+template <typename F>
+double benchRun(F fn)
+{
+  typedef std::chrono::steady_clock Clock;
+  fn(); // Warm the caches
+  long long calls = 0;
+  long long elapsed = 0;
+  Clock::time_point start = Clock::now();
+  for (long long batch = 1; elapsed < BENCH_MIN_NS; batch *= 2)
+  {
+    for (long long i = 0; i < batch; i++)
+    {
+      fn();
+    }
+    calls += batch;
+    elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+  }
+  return (double)elapsed / calls;
+}
+
+// One result line. items is how many units one call handles, 0 to leave the
+// rate out.
+inline void benchReport(const char *name, double ns, double items = 0, const char *unit = "")
+{
+  char line[160];
+  if (items > 0)
+  {
+    snprintf(line, sizeof(line), "%-40s %10.1f ns/call %10.2f M%s/s", name, ns, items * 1000.0 / ns, unit);
+  }
+  else
+  {
+    snprintf(line, sizeof(line), "%-40s %10.1f ns/call", name, ns);
+  }
+  TEST_MESSAGE(line);
+}
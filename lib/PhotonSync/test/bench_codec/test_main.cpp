@@ -0,0 +1,114 @@
+#include <unity.h>
+#include <string.h>
+#include "../bench.h"
+#include "FrameProtocol.h"
+
+// Encode and decode throughput of whole frames, the sender's and the
+// receiver's share of every frame
+
+#define BENCH_PIXELS FRAME_MAX_PIXELS
+#define BENCH_MAX_PACKETS 64
+
+static RGB frame[BENCH_PIXELS];
+static RGB previous[BENCH_PIXELS];
+static RGB shown[BENCH_PIXELS];
+static uint8_t packets[BENCH_MAX_PACKETS][FRAME_MAX_PACKET];
+static size_t lengths[BENCH_MAX_PACKETS];
+static FrameTarget target;
+
+void setUp(void)
+{
+  for (int i = 0; i < BENCH_PIXELS; i++)
+  {
+    frame[i].red = i * 7;
+    frame[i].green = i >> 3;
+    frame[i].blue = 255 - i;
+  }
+  memcpy(previous, frame, sizeof(frame));
+  for (int i = 0; i < BENCH_PIXELS; i += 10) // A tenth of the pixels change
+  {
+    frame[i].red ^= 0x55;
+  }
+  memset(&target, 0, sizeof(target));
+  target.pixels = shown;
+  target.size = BENCH_PIXELS;
+  target.windowCount = BENCH_PIXELS;
+}
+
+void tearDown(void)
+{
+}
+
+// All packets of one frame, returns how many
+static size_t encodeAll(const RGB *base)
+{
+  FrameHeader header = {0, 1, 0};
+  uint16_t done = 0;
+  size_t count = 0;
+  while (done < BENCH_PIXELS && count < BENCH_MAX_PACKETS)
+  {
+    uint16_t consumed;
+    lengths[count] = encodeFrame(packets[count], FRAME_MAX_PACKET, header, frame, base, done, BENCH_PIXELS - done,
+                                 &consumed);
+    done += consumed;
+    header.sequence++;
+    count++;
+  }
+  return count;
+}
+
+static void decodeAll(size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    FrameHeader header;
+    benchSink += decodeFrame(packets[i], lengths[i], &header, &target);
+  }
+}
+
+static void bench_encode_keyframe(void)
+{
+  size_t count = encodeAll(NULL);
+  double ns = benchRun([] { benchSink += encodeAll(NULL); });
+  benchReport("encode keyframe, 2048 px", ns, BENCH_PIXELS, "px");
+  char line[80];
+  snprintf(line, sizeof(line), "  %u packets per frame", (unsigned)count);
+  TEST_MESSAGE(line);
+}
+
+static void bench_encode_delta(void)
+{
+  size_t count = encodeAll(previous);
+  double ns = benchRun([] { benchSink += encodeAll(previous); });
+  benchReport("encode delta, 10% changed, 2048 px", ns, BENCH_PIXELS, "px");
+  char line[80];
+  snprintf(line, sizeof(line), "  %u packets per frame", (unsigned)count);
+  TEST_MESSAGE(line);
+}
+
+static void bench_decode_keyframe(void)
+{
+  size_t count = encodeAll(NULL);
+  double ns = benchRun([count] { decodeAll(count); });
+  benchReport("decode keyframe, 2048 px", ns, BENCH_PIXELS, "px");
+  TEST_ASSERT_EQUAL_MEMORY(frame, shown, sizeof(frame));
+}
+
+static void bench_decode_delta(void)
+{
+  memcpy(shown, previous, sizeof(shown));
+  size_t count = encodeAll(previous);
+  double ns = benchRun([count] { decodeAll(count); });
+  benchReport("decode delta, 10% changed, 2048 px", ns, BENCH_PIXELS, "px");
+  TEST_ASSERT_EQUAL_MEMORY(frame, shown, sizeof(frame));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(bench_encode_keyframe);
+  RUN_TEST(bench_encode_delta);
+  RUN_TEST(bench_decode_keyframe);
+  RUN_TEST(bench_decode_delta);
+  return UNITY_END();
+}
@@ -0,0 +1,124 @@
+#include <unity.h>
+#include <string.h>
+#include "../bench.h"
+#include "ColorLut.h"
+
+// One pass over the strip's GRB buffer. Before the LUT the receiver called
+// Adafruit_NeoPixel::setPixelColor once per LED, which scales each channel by
+// the brightness as it stores it and has no gamma; that path is copied here
+// as the baseline.
+
+#define BENCH_LEDS 1200
+#define BENCH_PIXELS 300
+
+static RGB pixels[BENCH_PIXELS];
+static LedSpan spans[BENCH_LEDS];
+static uint8_t grb[BENCH_LEDS * 3];
+static uint8_t brightness = 129; // Adafruit stores setBrightness(b) as b + 1
+
+// Adafruit_NeoPixel::setPixelColor for a GRB strip
+__attribute__((noinline)) static void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b)
+{
+  if (n < BENCH_LEDS)
+  {
+    if (brightness)
+    {
+      r = (r * brightness) >> 8;
+      g = (g * brightness) >> 8;
+      b = (b * brightness) >> 8;
+    }
+    uint8_t *p = &grb[n * 3];
+    p[1] = r;
+    p[0] = g;
+    p[2] = b;
+  }
+}
+
+void setUp(void)
+{
+  for (int i = 0; i < BENCH_PIXELS; i++)
+  {
+    RGB color = {(uint8_t)(i * 7), (uint8_t)(i * 13), (uint8_t)(255 - i)};
+    pixels[i] = color;
+  }
+}
+
+void tearDown(void)
+{
+}
+
+// ledsPerPixel LEDs show each pixel, one span per pixel
+static uint16_t layout(uint16_t ledsPerPixel)
+{
+  uint16_t count = BENCH_LEDS / ledsPerPixel;
+  for (uint16_t s = 0; s < count; s++)
+  {
+    LedSpan span = {(uint16_t)(s * ledsPerPixel), ledsPerPixel, (uint16_t)(s % BENCH_PIXELS)};
+    spans[s] = span;
+  }
+  return count;
+}
+
+static void bench_set_pixel_color(void)
+{
+  static uint16_t ledsPerPixel;
+  const uint16_t sizes[] = {1, 4};
+  for (int s = 0; s < 2; s++)
+  {
+    ledsPerPixel = sizes[s];
+    double ns = benchRun([] {
+      for (uint16_t i = 0; i < BENCH_LEDS; i++)
+      {
+        const RGB &color = pixels[(i / ledsPerPixel) % BENCH_PIXELS];
+        setPixelColor(i, color.red, color.green, color.blue);
+      }
+      benchSink += grb[0];
+    });
+    char name[64];
+    snprintf(name, sizeof(name), "before: setPixelColor, %u LEDs/pixel", ledsPerPixel);
+    benchReport(name, ns, BENCH_LEDS, "LED");
+  }
+}
+
+static void bench_lut_render(void)
+{
+  static ColorLut lut(2.2f);
+  static uint16_t spanCount;
+  const uint16_t sizes[] = {1, 4};
+  lut.setBrightness(128);
+  for (int d = 0; d < 2; d++)
+  {
+    lut.setDithering(d == 1);
+    for (int s = 0; s < 2; s++)
+    {
+      spanCount = layout(sizes[s]);
+      double ns = benchRun([] {
+        lut.render(pixels, spans, spanCount, grb);
+        benchSink += grb[0];
+      });
+      char name[64];
+      snprintf(name, sizeof(name), "LUT render%s, %u LEDs/pixel", d == 1 ? " dithered" : "", sizes[s]);
+      benchReport(name, ns, BENCH_LEDS, "LED");
+    }
+  }
+}
+
+static void bench_set_brightness(void)
+{
+  static ColorLut lut(2.2f);
+  static uint8_t level;
+  double ns = benchRun([] {
+    lut.setBrightness(++level | 1); // Never the current level, so the table is rebuilt
+    benchSink += lut.brightness();
+  });
+  benchReport("setBrightness, table rebuild", ns);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(bench_set_pixel_color);
+  RUN_TEST(bench_lut_render);
+  RUN_TEST(bench_set_brightness);
+  return UNITY_END();
+}
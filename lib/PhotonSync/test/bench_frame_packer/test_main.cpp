@@ -0,0 +1,122 @@
+#include <unity.h>
+#include <string.h>
+#include "../bench.h"
+#include "FramePacker.h"
+
+// Packets and time per frame on the sender. Before frame packets every
+// changed pixel was its own 4-byte esp_now_send.
+
+#define BENCH_PIXELS 600
+
+static RGB frame[BENCH_PIXELS];
+static uint32_t packets;
+static uint32_t bytes;
+
+static uint8_t *reservePacket()
+{
+  static uint8_t packet[DATASIZE];
+  return packet;
+}
+
+static void sendPacket(size_t len)
+{
+  packets++;
+  bytes += len;
+}
+
+static const PacketSink sink = {reservePacket, sendPacket};
+
+void setUp(void)
+{
+  packets = 0;
+  bytes = 0;
+}
+
+void tearDown(void)
+{
+}
+
+static uint32_t noise = 1;
+
+static uint8_t random8()
+{
+  noise = noise * 1664525 + 1013904223;
+  return noise >> 24;
+}
+
+// Gives every step-th pixel of frame a random colour, the worst case for the
+// run and delta records
+static void change(int step)
+{
+  for (int i = 0; i < BENCH_PIXELS; i += step)
+  {
+    frame[i].red = random8();
+    frame[i].green = random8();
+    frame[i].blue = random8();
+  }
+}
+
+static void report(const char *name, int frames, uint32_t legacyPackets)
+{
+  char line[160];
+  snprintf(line, sizeof(line), "%-40s %6.1f packets/frame (%u one per pixel), %6.0f bytes/frame", name,
+           (double)packets / frames, (unsigned)legacyPackets, (double)bytes / frames);
+  TEST_MESSAGE(line);
+}
+
+static void bench_packets_per_frame(void)
+{
+  const int frames = 64; // Two keyframe intervals
+  const int steps[] = {1, 10, BENCH_PIXELS};
+  const char *names[] = {"every pixel changed, 600 px", "10% changed, 600 px", "one pixel changed, 600 px"};
+  for (int s = 0; s < 3; s++)
+  {
+    FramePacker packer(sink, 10);
+    packets = 0;
+    bytes = 0;
+    for (int f = 0; f < frames; f++)
+    {
+      change(steps[s]);
+      packer.set(0, frame, BENCH_PIXELS, f);
+      TEST_ASSERT_TRUE(packer.flush());
+    }
+    report(names[s], frames, (BENCH_PIXELS + steps[s] - 1) / steps[s]);
+  }
+}
+
+static void bench_text_pixels_per_frame(void)
+{
+  // The legacy text path, 255 pixels changing per frame
+  const int frames = 64;
+  FramePacker packer(sink, 10);
+  for (int f = 0; f < frames; f++)
+  {
+    for (int i = 0; i < 255; i++)
+    {
+      Pixel pixel = {(uint8_t)(i + 1), random8(), random8(), random8()};
+      packer.add(pixel, f);
+    }
+    TEST_ASSERT_TRUE(packer.flush());
+  }
+  report("text lines, 255 px changed", frames, 255);
+}
+
+static void bench_pack_time(void)
+{
+  static FramePacker packer(sink, 10);
+  double ns = benchRun([] {
+    change(1);
+    packer.set(0, frame, BENCH_PIXELS, 0);
+    packer.flush();
+  });
+  benchReport("change, set, flush, every pixel, 600 px", ns, BENCH_PIXELS, "px");
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(bench_packets_per_frame);
+  RUN_TEST(bench_text_pixels_per_frame);
+  RUN_TEST(bench_pack_time);
+  return UNITY_END();
+}
@@ -0,0 +1,116 @@
+#include <unity.h>
+#include <string.h>
+#include "../bench.h"
+#include "FrameProtocol.h"
+#include "LedMap.h"
+
+// Building the span table for long strips, and walking it against the old
+// per-LED ledMap array when several LEDs show each pixel
+
+#define BENCH_PIXELS 100
+
+static LedSpan spans[MAX_NUM_LED];
+static uint16_t ledPixel[MAX_NUM_LED]; // The old ledMap, pixel index per LED
+static RGB pixels[BENCH_PIXELS];
+static uint8_t grb[MAX_NUM_LED * 3];
+static uint16_t spanCount;
+static uint16_t leds;
+
+void setUp(void)
+{
+  for (int i = 0; i < BENCH_PIXELS; i++)
+  {
+    RGB color = {(uint8_t)(i * 5), (uint8_t)(i * 11), (uint8_t)(200 - i)};
+    pixels[i] = color;
+  }
+}
+
+void tearDown(void)
+{
+}
+
+static void bench_build(void)
+{
+  static LedLayout layout;
+  static uint16_t segments[BENCH_PIXELS];
+  for (int i = 0; i < BENCH_PIXELS; i++)
+  {
+    segments[i] = 10 + i % 5;
+  }
+  const LedLayout layouts[] = {{1200, 0, BENCH_PIXELS, NULL, 0, false, 0},
+                               {MAX_NUM_LED, 0, BENCH_PIXELS, NULL, 0, false, 0},
+                               {MAX_NUM_LED, 0, BENCH_PIXELS, NULL, 0, true, 64},
+                               {1200, 0, BENCH_PIXELS, segments, BENCH_PIXELS, false, 0}};
+  const char *names[] = {"build, even split, 1200 LEDs", "build, even split, 2048 LEDs",
+                         "build, reversed serpentine, 2048 LEDs", "build, segments, 1200 LEDs"};
+  for (int l = 0; l < 4; l++)
+  {
+    layout = layouts[l];
+    double ns = benchRun([] {
+      spanCount = buildLedMap(layout, spans, MAX_NUM_LED);
+      benchSink += spanCount;
+    });
+    benchReport(names[l], ns, layout.ledCount, "LED");
+  }
+}
+
+static void layoutStrip(uint16_t ledCount)
+{
+  leds = ledCount;
+  LedLayout layout = {leds, 0, BENCH_PIXELS, NULL, 0, false, 0};
+  spanCount = buildLedMap(layout, spans, MAX_NUM_LED);
+  for (uint16_t s = 0; s < spanCount; s++)
+  {
+    for (uint16_t led = spans[s].firstLed; led < spans[s].firstLed + spans[s].count; led++)
+    {
+      ledPixel[led] = spans[s].pixel;
+    }
+  }
+}
+
+static void bench_walk(void)
+{
+  const uint16_t sizes[] = {1200, MAX_NUM_LED};
+  for (int s = 0; s < 2; s++)
+  {
+    layoutStrip(sizes[s]);
+    double before = benchRun([] {
+      for (uint16_t i = 0; i < leds; i++)
+      {
+        const RGB &color = pixels[ledPixel[i]];
+        grb[i * 3] = color.green;
+        grb[i * 3 + 1] = color.red;
+        grb[i * 3 + 2] = color.blue;
+      }
+      benchSink += grb[0];
+    });
+    double after = benchRun([] {
+      for (uint16_t s = 0; s < spanCount; s++)
+      {
+        const RGB &color = pixels[spans[s].pixel];
+        uint8_t *out = grb + spans[s].firstLed * 3;
+        for (uint16_t i = 0; i < spans[s].count; i++)
+        {
+          out[0] = color.green;
+          out[1] = color.red;
+          out[2] = color.blue;
+          out += 3;
+        }
+      }
+      benchSink += grb[0];
+    });
+    char name[64];
+    snprintf(name, sizeof(name), "before: ledMap per LED, %u LEDs", leds);
+    benchReport(name, before, leds, "LED");
+    snprintf(name, sizeof(name), "span table, %u LEDs", leds);
+    benchReport(name, after, leds, "LED");
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(bench_build);
+  RUN_TEST(bench_walk);
+  return UNITY_END();
+}
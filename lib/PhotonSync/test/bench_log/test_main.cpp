@@ -0,0 +1,83 @@
+#include <unity.h>
+#include <stdio.h>
+#include "../bench.h"
+
+#define LOG_MODULE "bench"
+#define LOG_LEVEL LOG_LEVEL_INFO
+#include "Log.h"
+
+// What a log call costs the task that makes it, against formatting the line
+// on the spot as Serial.printf did. Draining is loop()'s share, paid later.
+
+static LogRecord record;
+
+void setUp(void)
+{
+  while (logRing.take(&record))
+  {
+  }
+}
+
+void tearDown(void)
+{
+}
+
+static void bench_disabled_call(void)
+{
+  double ns = benchRun([] {
+    static uint32_t dropped = 0;
+    for (int i = 0; i < 100; i++)
+    {
+      LOG_DEBUG("Dropped packet %u from %s", ++dropped, "rx");
+    }
+    benchSink = dropped;
+  });
+  benchReport("LOG_DEBUG above the level", ns / 100);
+}
+
+static void bench_enabled_call(void)
+{
+  double ns = benchRun([] {
+    static uint32_t dropped = 0;
+    for (int i = 0; i < 16; i++)
+    {
+      LOG_INFO("Dropped %u frames, rssi %d, %s", ++dropped, -71, "rx");
+    }
+    // Make room again, loop() would
+    while (logRing.take(&record))
+    {
+    }
+  });
+  benchReport("LOG_INFO + take (16 records)", ns / 16);
+}
+
+static void bench_format(void)
+{
+  LOG_INFO("Dropped %u frames, rssi %d, %s", 12345u, -71, "rx");
+  logRing.take(&record);
+  double ns = benchRun([] {
+    static char line[LOG_LINE_MAX];
+    benchSink = logFormat(record, line, sizeof(line));
+  });
+  benchReport("logFormat() in loop()", ns);
+}
+
+static void bench_printf_baseline(void)
+{
+  double ns = benchRun([] {
+    static char line[LOG_LINE_MAX];
+    static uint32_t dropped = 0;
+    benchSink = snprintf(line, sizeof(line), "Dropped %u frames, rssi %d, %s\n", (unsigned)++dropped, -71, "rx");
+  });
+  benchReport("snprintf in the caller (baseline)", ns);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(bench_disabled_call);
+  RUN_TEST(bench_enabled_call);
+  RUN_TEST(bench_format);
+  RUN_TEST(bench_printf_baseline);
+  return UNITY_END();
+}
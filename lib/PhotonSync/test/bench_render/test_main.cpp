@@ -0,0 +1,159 @@
+#include <unity.h>
+#include <string.h>
+#include <unordered_map>
+#include "../bench.h"
+#include "ColorLut.h"
+#include "FrameComposer.h"
+#include "LedMap.h"
+#include "Pixel.h"
+
+// One render of the receiver's LED buffer from the frame it holds. The old
+// receiver kept pixels in a std::unordered_map and looked the colour up once
+// per LED; the map is rebuilt here as the baseline.
+
+#define BENCH_PIXELS 256
+#define LEGACY_PIXELS (FRAME_MAX_PACKET / sizeof(Pixel)) // Pixels in a full legacy packet
+
+static FrameBuffer frame;
+static LedSpan spans[MAX_NUM_LED];
+static int ledPixel[MAX_NUM_LED]; // The old ledMap, pixel index per LED
+static uint8_t grb[MAX_NUM_LED * 3];
+static std::unordered_map<int, Pixel> colorMap;
+
+void setUp(void)
+{
+  memset(&frame, 0, sizeof(frame));
+  colorMap.clear();
+  for (int i = 0; i < BENCH_PIXELS; i++)
+  {
+    RGB color = {(uint8_t)(i * 3), (uint8_t)(255 - i), (uint8_t)(i >> 1)};
+    frame.pixels[i] = color;
+    Pixel pixel = {(uint8_t)i, color.red, color.green, color.blue};
+    colorMap[i] = pixel;
+  }
+}
+
+void tearDown(void)
+{
+}
+
+static uint16_t layout(uint16_t leds)
+{
+  LedLayout layout = {leds, 0, BENCH_PIXELS, NULL, 0, false, 0};
+  uint16_t count = buildLedMap(layout, spans, MAX_NUM_LED);
+  for (uint16_t s = 0; s < count; s++)
+  {
+    for (uint16_t led = spans[s].firstLed; led < spans[s].firstLed + spans[s].count; led++)
+    {
+      ledPixel[led] = spans[s].pixel;
+    }
+  }
+  return count;
+}
+
+static void bench_map_lookup_per_led(void)
+{
+  static uint16_t leds;
+  const uint16_t sizes[] = {600, MAX_NUM_LED};
+  for (int s = 0; s < 2; s++)
+  {
+    leds = sizes[s];
+    layout(leds);
+    double ns = benchRun([] {
+      for (uint16_t i = 0; i < leds; i++)
+      {
+        const Pixel &pixel = colorMap[ledPixel[i]];
+        grb[i * 3] = pixel.green;
+        grb[i * 3 + 1] = pixel.red;
+        grb[i * 3 + 2] = pixel.blue;
+      }
+      benchSink += grb[0];
+    });
+    char name[64];
+    snprintf(name, sizeof(name), "before: unordered_map per LED, %u LEDs", leds);
+    benchReport(name, ns, leds, "LED");
+  }
+}
+
+static void bench_flat_buffer_per_led(void)
+{
+  static uint16_t leds;
+  const uint16_t sizes[] = {600, MAX_NUM_LED};
+  for (int s = 0; s < 2; s++)
+  {
+    leds = sizes[s];
+    layout(leds);
+    double ns = benchRun([] {
+      for (uint16_t i = 0; i < leds; i++)
+      {
+        const RGB &pixel = frame.pixels[ledPixel[i]];
+        grb[i * 3] = pixel.green;
+        grb[i * 3 + 1] = pixel.red;
+        grb[i * 3 + 2] = pixel.blue;
+      }
+      benchSink += grb[0];
+    });
+    char name[64];
+    snprintf(name, sizeof(name), "flat buffer per LED, %u LEDs", leds);
+    benchReport(name, ns, leds, "LED");
+  }
+}
+
+static void bench_render_frame(void)
+{
+  // What drawFrame() does now: compose fades and scenes, then the LUT over the spans
+  static FrameComposer composer;
+  static ColorLut lut(2.2f);
+  static uint16_t spanCount;
+  const uint16_t sizes[] = {600, MAX_NUM_LED};
+  for (int s = 0; s < 2; s++)
+  {
+    spanCount = layout(sizes[s]);
+    double ns = benchRun([] {
+      composer.compose(frame, false, 0, 0);
+      lut.render(composer.shown(), spans, spanCount, grb);
+      benchSink += grb[0];
+    });
+    char name[64];
+    snprintf(name, sizeof(name), "compose + LUT render, %u LEDs", sizes[s]);
+    benchReport(name, ns, sizes[s], "LED");
+  }
+}
+
+static void bench_receive_legacy_packet(void)
+{
+  static Pixel packet[LEGACY_PIXELS];
+  for (size_t i = 0; i < LEGACY_PIXELS; i++)
+  {
+    Pixel pixel = {(uint8_t)(i * 4), 1, 2, 3};
+    packet[i] = pixel;
+  }
+  double before = benchRun([] {
+    for (size_t i = 0; i < LEGACY_PIXELS; i++)
+    {
+      colorMap[packet[i].index] = packet[i];
+    }
+  });
+  benchReport("before: 62 legacy pixels into the map", before, LEGACY_PIXELS, "px");
+  double after = benchRun([] {
+    for (size_t i = 0; i < LEGACY_PIXELS; i++)
+    {
+      RGB &target = frame.pixels[packet[i].index];
+      target.red = packet[i].red;
+      target.green = packet[i].green;
+      target.blue = packet[i].blue;
+    }
+    benchSink += frame.pixels[0].red;
+  });
+  benchReport("62 legacy pixels into the flat buffer", after, LEGACY_PIXELS, "px");
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(bench_map_lookup_per_led);
+  RUN_TEST(bench_flat_buffer_per_led);
+  RUN_TEST(bench_render_frame);
+  RUN_TEST(bench_receive_legacy_packet);
+  return UNITY_END();
+}
@@ -0,0 +1,136 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "../bench.h"
+#include "FrameProtocol.h"
+#include "Scene.h"
+
+// The render task's cost of playing scenes, and the air time a scene saves
+// over streaming the same effect as frames
+
+#define BENCH_PIXELS 600
+#define FRAME_RATE 60
+
+static RGB out[BENCH_PIXELS];
+static SceneTable table;
+static Scene effect;
+
+static Scene wholeRun(uint8_t kind)
+{
+  Scene s;
+  memset(&s, 0, sizeof(s));
+  s.flags = SCENE_FLAG_LOOP;
+  s.stepCount = 1;
+  SceneStep step = {kind, 0, BENCH_PIXELS, {255, 40, 0}, {0, 40, 255}, 1000, 16, 0};
+  s.steps[0] = step;
+  return s;
+}
+
+void setUp(void)
+{
+  memset(&table, 0, sizeof(table));
+}
+
+void tearDown(void)
+{
+}
+
+static void bench_effects(void)
+{
+  const uint8_t kinds[] = {SCENE_FADE, SCENE_PULSE, SCENE_CHASE, SCENE_GRADIENT};
+  const char *names[] = {"fade", "pulse", "chase", "gradient"};
+  for (int k = 0; k < 4; k++)
+  {
+    effect = wholeRun(kinds[k]);
+    double ns = benchRun([] {
+      static uint32_t elapsed = 0;
+      elapsed += 17;
+      benchSink += renderScene(effect, elapsed, out, BENCH_PIXELS);
+    });
+    char name[64];
+    snprintf(name, sizeof(name), "renderScene %s, %u px", names[k], BENCH_PIXELS);
+    benchReport(name, ns, BENCH_PIXELS, "px");
+  }
+}
+
+static void bench_engine_all_slots(void)
+{
+  // Every slot playing over the whole run, the worst a render pass meets
+  static SceneEngine engine;
+  for (uint8_t slot = 0; slot < SCENE_SLOTS; slot++)
+  {
+    table.slots[slot] = wholeRun(SCENE_FADE + slot % 4);
+    table.triggers[slot] = 1;
+  }
+  table.playing = 0xFF;
+  double ns = benchRun([] {
+    static unsigned long now = 0;
+    now += 17;
+    engine.render(table, out, BENCH_PIXELS, now, 0);
+    benchSink += out[0].red;
+  });
+  char name[64];
+  snprintf(name, sizeof(name), "SceneEngine, %u slots over %u px", SCENE_SLOTS, BENCH_PIXELS);
+  benchReport(name, ns);
+}
+
+static void bench_engine_idle(void)
+{
+  static SceneEngine engine;
+  double ns = benchRun([] {
+    engine.render(table, out, BENCH_PIXELS, 1000, 1000);
+    benchSink += engine.active();
+  });
+  benchReport("SceneEngine, nothing playing", ns);
+}
+
+static void test_air_time_against_streaming(void)
+{
+  // A one second gradient as frames at FRAME_RATE, each encoded against the
+  // last, against loading the scene once and triggering it
+  static RGB frames[2][BENCH_PIXELS];
+  static uint8_t packet[FRAME_MAX_PACKET];
+  Scene gradient = wholeRun(SCENE_GRADIENT);
+  size_t streamed = 0;
+  uint32_t packets = 0;
+  for (int f = 0; f < FRAME_RATE; f++)
+  {
+    RGB *frame = frames[f % 2];
+    RGB *previous = f > 0 ? frames[(f + 1) % 2] : NULL;
+    renderScene(gradient, f * 1000 / FRAME_RATE, frame, BENCH_PIXELS);
+    FrameHeader header = {(uint8_t)(previous == NULL ? FRAME_FLAG_KEYFRAME : 0), (uint8_t)f, 0};
+    uint16_t done = 0;
+    while (done < BENCH_PIXELS)
+    {
+      uint16_t consumed;
+      streamed += encodeFrame(packet, sizeof(packet), header, frame, previous, done, BENCH_PIXELS - done, &consumed);
+      done += consumed;
+      packets++;
+    }
+  }
+
+  FrameHeader header = {FRAME_FLAG_LAST, 0, 0};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+  writer.load(0, gradient);
+  size_t load = writer.length();
+  writer.begin(header);
+  writer.trigger(0, SCENE_PLAY);
+  size_t trigger = writer.length();
+
+  char line[120];
+  snprintf(line, sizeof(line), "1 s gradient over %u px: streamed %u B in %u packets, scene %u B LOAD + %u B TRIGGER",
+           BENCH_PIXELS, (unsigned)streamed, (unsigned)packets, (unsigned)load, (unsigned)trigger);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN(streamed / 100, load + trigger);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(bench_effects);
+  RUN_TEST(bench_engine_all_slots);
+  RUN_TEST(bench_engine_idle);
+  RUN_TEST(test_air_time_against_streaming);
+  return UNITY_END();
+}
@@ -0,0 +1,168 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "../bench.h"
+#include "SerialBridge.h"
+
+// Frames per second sender-gh can take from Grasshopper. Before the binary
+// framing every pixel was a text line read into an Arduino String and parsed
+// with sscanf; that path is copied here with std::string as the baseline.
+
+#define BENCH_PIXELS 255 // The most the text format can address
+#define WIDE_PIXELS 600
+#define BAUD 115200
+
+static uint8_t binaryFrame[2 + FRAME_MAX_PIXELS * 3 + SERIAL_FRAME_OVERHEAD];
+static size_t binaryLength;
+static char textFrame[BENCH_PIXELS * 16];
+static size_t textLength;
+
+static bool transport(const uint8_t * /* data */, size_t /* len */)
+{
+  return true;
+}
+
+static TxRing ring(transport);
+
+static uint8_t *reservePacket()
+{
+  return ring.reserve();
+}
+
+static void sendPacket(size_t len)
+{
+  ring.commit(len);
+}
+
+static const PacketSink sink = {reservePacket, sendPacket};
+
+// The radio acknowledges at once
+static void drain(void)
+{
+  while (ring.queued() > 0)
+  {
+    ring.onSent(true);
+  }
+}
+
+static void buildBinary(uint16_t pixels, uint8_t shade)
+{
+  static uint8_t body[2 + FRAME_MAX_PIXELS * 3];
+  body[0] = 0;
+  body[1] = 0;
+  for (uint16_t i = 0; i < pixels; i++)
+  {
+    body[2 + i * 3] = i * 3 + shade;
+    body[3 + i * 3] = 255 - i;
+    body[4 + i * 3] = shade;
+  }
+  binaryLength = writeSerialFrame(binaryFrame, sizeof(binaryFrame), SERIAL_TYPE_PIXELS, body, 2 + pixels * 3);
+}
+
+// The same pixels as Grasshopper's text lines, indices from 1
+static void buildText(void)
+{
+  textLength = 0;
+  for (uint16_t i = 0; i < BENCH_PIXELS; i++)
+  {
+    textLength += sprintf(&textFrame[textLength], "%u %u %u %u\n", i + 1, (uint8_t)(i * 3), 255 - i, 0);
+  }
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void reportFps(const char *name, double ns, size_t bytes)
+{
+  char line[160];
+  snprintf(line, sizeof(line), "%-40s %10.1f us/frame %10.0f frames/s, serial at %u baud: %6.1f frames/s", name,
+           ns / 1000, 1e9 / ns, BAUD, BAUD / 10.0 / bytes);
+  TEST_MESSAGE(line);
+}
+
+static void bench_text_lines(void)
+{
+  buildText();
+  double ns = benchRun([] {
+    // readStringUntil('\n') appends one char at a time, then stringToPixel
+    std::string line;
+    for (size_t i = 0; i < textLength; i++)
+    {
+      if (textFrame[i] != '\n')
+      {
+        line += textFrame[i];
+        continue;
+      }
+      int index, red, green, blue;
+      sscanf(line.c_str(), "%d %d %d %d", &index, &red, &green, &blue);
+      benchSink += index + red + green + blue;
+      line = std::string();
+    }
+  });
+  reportFps("before: text lines + sscanf, 255 px", ns, textLength);
+}
+
+static void bench_parser(void)
+{
+  static SerialFrameParser parser;
+  const uint16_t sizes[] = {BENCH_PIXELS, WIDE_PIXELS, FRAME_MAX_PIXELS};
+  for (int s = 0; s < 3; s++)
+  {
+    buildBinary(sizes[s], 0);
+    double ns = benchRun([] {
+      for (size_t i = 0; i < binaryLength; i++)
+      {
+        if (parser.feed(binaryFrame[i]) == SERIAL_FRAME)
+        {
+          benchSink += parser.bodyLength();
+        }
+      }
+    });
+    char name[64];
+    snprintf(name, sizeof(name), "binary frame parser, %u px", sizes[s]);
+    reportFps(name, ns, binaryLength);
+  }
+}
+
+static void bench_bridge(void)
+{
+  // Parse, pack and queue for the radio, every pixel changing every frame
+  static SerialBridge *bridge;
+  static uint16_t pixels;
+  static unsigned long now;
+  const uint16_t sizes[] = {BENCH_PIXELS, WIDE_PIXELS};
+  for (int s = 0; s < 2; s++)
+  {
+    SerialBridge frameBridge(ring, sink, 10);
+    frameBridge.setAdaptive(false);
+    bridge = &frameBridge;
+    pixels = sizes[s];
+    double ns = benchRun([] {
+      buildBinary(pixels, now);
+      for (size_t i = 0; i < binaryLength; i++)
+      {
+        bridge->feed(binaryFrame[i], now);
+        drain();
+      }
+      now++;
+    });
+    char name[64];
+    snprintf(name, sizeof(name), "serial to radio queue, %u px", pixels);
+    reportFps(name, ns, binaryLength);
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(bench_text_lines);
+  RUN_TEST(bench_parser);
+  RUN_TEST(bench_bridge);
+  return UNITY_END();
+}
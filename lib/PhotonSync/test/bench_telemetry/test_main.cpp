@@ -0,0 +1,142 @@
+#include <unity.h>
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include "../bench.h"
+#include "SerialFrameParser.h"
+#include "Telemetry.h"
+
+// What telemetry costs the tasks that record it, and building the stats
+// packet once a second. The baseline is the text status line the targets
+// printed before, formatted with snprintf.
+
+static Telemetry stats;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void bench_count(void)
+{
+  double ns = benchRun([] {
+    for (int i = 0; i < 100; i++)
+    {
+      stats.count(TELEMETRY_PACKETS_RECEIVED);
+    }
+  });
+  benchReport("count()", ns / 100);
+}
+
+static void bench_record(void)
+{
+  double ns = benchRun([] {
+    static uint32_t us = 1;
+    for (int i = 0; i < 100; i++)
+    {
+      us = us * 1664525 + 1013904223;
+      stats.record(TELEMETRY_SHOW_US, us >> 18); // Up to 16 ms, mostly below the max
+    }
+  });
+  benchReport("record()", ns / 100);
+}
+
+static void bench_interval(void)
+{
+  double ns = benchRun([] {
+    static uint32_t now = 1;
+    static uint32_t last = 0;
+    for (int i = 0; i < 100; i++)
+    {
+      now += 16667;
+      stats.interval(TELEMETRY_LOOP_US, now, &last);
+    }
+  });
+  benchReport("interval()", ns / 100);
+}
+
+static void bench_stats_packet(void)
+{
+  double ns = benchRun([] {
+    static uint8_t body[TELEMETRY_PACKET_SIZE];
+    benchSink = stats.write(body, sizeof(body), TELEMETRY_RECEIVER, 1000);
+  });
+  benchReport("stats packet", ns);
+}
+
+static void bench_stats_frame(void)
+{
+  double ns = benchRun([] {
+    static uint8_t body[TELEMETRY_PACKET_SIZE];
+    static uint8_t frame[TELEMETRY_PACKET_SIZE + SERIAL_FRAME_OVERHEAD];
+    size_t len = stats.write(body, sizeof(body), TELEMETRY_RECEIVER, 1000);
+    benchSink = writeSerialFrame(frame, sizeof(frame), SERIAL_TYPE_STATS, body, len);
+  });
+  benchReport("stats packet as a serial frame (CRC)", ns);
+}
+
+static void bench_text_status_line(void)
+{
+  double ns = benchRun([] {
+    static char line[256];
+    benchSink = snprintf(line, sizeof(line),
+                         "sent %u acked %u failed %u refused %u full %u rx %u dropped %u errors %u "
+                         "published %u rendered %u replaced %u show %u us loop %u us",
+                         (unsigned)stats.counter(TELEMETRY_PACKETS_SENT), (unsigned)stats.counter(TELEMETRY_PACKETS_ACKED),
+                         (unsigned)stats.counter(TELEMETRY_PACKETS_FAILED), (unsigned)stats.counter(TELEMETRY_TX_REFUSED),
+                         (unsigned)stats.counter(TELEMETRY_TX_RING_FULL),
+                         (unsigned)stats.counter(TELEMETRY_PACKETS_RECEIVED),
+                         (unsigned)stats.counter(TELEMETRY_PACKETS_DROPPED),
+                         (unsigned)stats.counter(TELEMETRY_DECODE_ERRORS),
+                         (unsigned)stats.counter(TELEMETRY_FRAMES_PUBLISHED),
+                         (unsigned)stats.counter(TELEMETRY_FRAMES_RENDERED),
+                         (unsigned)stats.counter(TELEMETRY_FRAMES_DROPPED), 3012u, 16667u);
+  });
+  benchReport("text status line (baseline)", ns);
+}
+
+static std::atomic<bool> contending;
+
+static void contend(void)
+{
+  uint32_t us = 1;
+  while (contending.load(std::memory_order_relaxed))
+  {
+    stats.count(TELEMETRY_PACKETS_RECEIVED);
+    stats.record(TELEMETRY_SHOW_US, us++ & 0x3FFF);
+  }
+}
+
+static void bench_record_contended(void)
+{
+  // The WiFi task hammering the same counters from the other core
+  contending.store(true);
+  std::thread other(contend);
+  double ns = benchRun([] {
+    static uint32_t us = 1;
+    for (int i = 0; i < 100; i++)
+    {
+      stats.count(TELEMETRY_PACKETS_RECEIVED);
+      stats.record(TELEMETRY_SHOW_US, us++ & 0x3FFF);
+    }
+  });
+  contending.store(false);
+  other.join();
+  benchReport("count() + record(), contended", ns / 100);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(bench_count);
+  RUN_TEST(bench_record);
+  RUN_TEST(bench_interval);
+  RUN_TEST(bench_stats_packet);
+  RUN_TEST(bench_stats_frame);
+  RUN_TEST(bench_text_status_line);
+  RUN_TEST(bench_record_contended);
+  return UNITY_END();
+}
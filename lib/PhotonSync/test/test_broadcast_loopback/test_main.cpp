@@ -0,0 +1,218 @@
+#include <unity.h>
+#include <string.h>
+#include "FramePacker.h"
+#include "FrameReceiver.h"
+
+// One sender broadcasting to several receivers, each showing its own window
+// of the frame. The loopback sink stands in for the radio: every packet the
+// packer sends reaches every receiver, as a broadcast to FF:FF:FF:FF:FF:FF
+// does.
+
+#define RECEIVERS 4
+#define WINDOW 150
+#define FRAME_PIXELS (RECEIVERS * WINDOW)
+#define AIR_DELAY_US 800
+
+static const uint8_t SENDER_MAC[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+
+static FrameReceiver *receivers; // Fresh for every test, their sequence state included
+static uint32_t clockOffset[RECEIVERS]; // Each receiver's micros() minus the sender's
+static int listening;                  // Receivers the loopback reaches
+static int lossy;                      // Receiver that loses packets, -1 for none
+static uint32_t packets;
+static uint32_t senderNow; // Sender micros()
+static RGB frame[FRAME_PIXELS];
+static uint32_t noise;
+
+static uint32_t senderMicros()
+{
+  return senderNow;
+}
+
+static uint8_t packet[DATASIZE];
+
+static uint8_t *reservePacket()
+{
+  return packet;
+}
+
+static void sendPacket(size_t len)
+{
+  packets++;
+  for (int r = 0; r < listening; r++)
+  {
+    if (r == lossy && packets % 3 == 0)
+    {
+      continue;
+    }
+    uint32_t receivedAt = senderNow + clockOffset[r] + AIR_DELAY_US;
+    receivers[r].receive(SENDER_MAC, packet, len, receivedAt, receivedAt / 1000);
+  }
+  senderNow += 1000; // About what one packet takes on air
+}
+
+static const PacketSink loopback = {reservePacket, sendPacket};
+
+static void randomize(int step)
+{
+  for (int i = 0; i < FRAME_PIXELS; i += step)
+  {
+    noise = noise * 1664525 + 1013904223;
+    RGB color = {(uint8_t)(noise >> 8), (uint8_t)(noise >> 16), (uint8_t)(noise >> 24)};
+    frame[i] = color;
+  }
+}
+
+void setUp(void)
+{
+  receivers = new FrameReceiver[RECEIVERS];
+  for (int r = 0; r < RECEIVERS; r++)
+  {
+    receivers[r].setWindow(r * WINDOW, WINDOW);
+    clockOffset[r] = 123456789u * (r + 1); // Unrelated clocks
+  }
+  listening = RECEIVERS;
+  lossy = -1;
+  packets = 0;
+  senderNow = 5000000;
+  noise = 1;
+  memset(frame, 0, sizeof(frame));
+}
+
+void tearDown(void)
+{
+  delete[] receivers;
+}
+
+// Every receiver shows exactly its window of frame, and nothing else
+static void assertWindowsShown(void)
+{
+  const RGB black = {0, 0, 0};
+  for (int r = 0; r < listening; r++)
+  {
+    const RGB *shown = receivers[r].frame().pixels;
+    TEST_ASSERT_EQUAL_MEMORY(&frame[r * WINDOW], &shown[r * WINDOW], WINDOW * sizeof(RGB));
+    for (int i = 0; i < FRAME_PIXELS; i++)
+    {
+      if (i / WINDOW != r)
+      {
+        TEST_ASSERT_TRUE(shown[i] == black);
+      }
+    }
+  }
+}
+
+static void test_each_receiver_takes_its_window(void)
+{
+  FramePacker packer(loopback, 10);
+  for (int f = 0; f < 40; f++)
+  {
+    randomize(f == 0 ? 1 : 7);
+    packer.set(0, frame, FRAME_PIXELS, f);
+    TEST_ASSERT_TRUE(packer.flush());
+    for (int r = 0; r < RECEIVERS; r++)
+    {
+      TEST_ASSERT_TRUE(receivers[r].takeFrame());
+    }
+    assertWindowsShown();
+  }
+}
+
+static void test_airtime_does_not_grow_with_receivers(void)
+{
+  uint32_t sent[RECEIVERS];
+  for (int n = 1; n <= RECEIVERS; n++)
+  {
+    tearDown(); // A new sender, so new receivers too
+    setUp();
+    listening = n;
+    FramePacker packer(loopback, 10);
+    for (int f = 0; f < 40; f++)
+    {
+      randomize(5);
+      packer.set(0, frame, FRAME_PIXELS, f);
+      packer.flush();
+    }
+    sent[n - 1] = packets;
+  }
+  for (int r = 1; r < RECEIVERS; r++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(sent[0], sent[r]);
+  }
+  for (int r = 0; r < RECEIVERS; r++)
+  {
+    receivers[r].takeFrame();
+  }
+  assertWindowsShown();
+}
+
+static bool windowShown(int r)
+{
+  return memcmp(&frame[r * WINDOW], &receivers[r].frame().pixels[r * WINDOW], WINDOW * sizeof(RGB)) == 0;
+}
+
+static void test_lost_packets_heal_at_the_keyframe(void)
+{
+  FramePacker packer(loopback, 10);
+  lossy = 2;
+  int f = 0;
+  for (; f < 8; f++)
+  {
+    randomize(3);
+    packer.set(0, frame, FRAME_PIXELS, f);
+    packer.flush();
+  }
+  receivers[2].takeFrame();
+  TEST_ASSERT_FALSE(windowShown(2));
+  TEST_ASSERT_GREATER_THAN(0, receivers[2].sequenceStats().lost);
+
+  // Only the first window changes from here, so nothing but the keyframe
+  // resends what receiver 2 missed
+  lossy = -1;
+  int healedAt = -1;
+  for (; f < 8 + PACKER_KEYFRAME_INTERVAL && healedAt < 0; f++)
+  {
+    frame[f % WINDOW].red++;
+    packer.set(0, frame, FRAME_PIXELS, f);
+    packer.flush();
+    receivers[2].takeFrame();
+    healedAt = windowShown(2) ? f : -1;
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL(0, healedAt);
+  for (int r = 0; r < RECEIVERS; r++)
+  {
+    receivers[r].takeFrame();
+  }
+  assertWindowsShown();
+  TEST_ASSERT_EQUAL_UINT32(0, receivers[1].sequenceStats().lost);
+}
+
+static void test_latched_frames_agree_across_receivers(void)
+{
+  FramePacker packer(loopback, 10);
+  packer.setLatch(50, senderMicros);
+  randomize(1);
+  packer.set(0, frame, FRAME_PIXELS, 0);
+  TEST_ASSERT_TRUE(packer.flush());
+
+  uint32_t commitAt = senderNow - 2000; // Two COMMITs went out after the frame
+  for (int r = 0; r < RECEIVERS; r++)
+  {
+    TEST_ASSERT_TRUE(receivers[r].takeFrame());
+    const FrameBuffer &shown = receivers[r].frame();
+    TEST_ASSERT_TRUE(shown.latched);
+    // The same moment on every receiver's own clock
+    TEST_ASSERT_EQUAL_UINT32(commitAt + AIR_DELAY_US + 50000, shown.latchAt - clockOffset[r]);
+  }
+  assertWindowsShown();
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_each_receiver_takes_its_window);
+  RUN_TEST(test_airtime_does_not_grow_with_receivers);
+  RUN_TEST(test_lost_packets_heal_at_the_keyframe);
+  RUN_TEST(test_latched_frames_agree_across_receivers);
+  return UNITY_END();
+}
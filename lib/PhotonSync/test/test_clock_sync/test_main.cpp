@@ -0,0 +1,71 @@
+#include <unity.h>
+#include "ClockSync.h"
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_unsynced_until_the_first_sample(void)
+{
+  ClockSync clock;
+  TEST_ASSERT_FALSE(clock.synced());
+  clock.sample(1000, 5000);
+  TEST_ASSERT_TRUE(clock.synced());
+  TEST_ASSERT_EQUAL_UINT32(6000, clock.toLocal(2000));
+}
+
+static void test_fastest_delivery_sets_the_offset(void)
+{
+  ClockSync clock;
+  const uint32_t offset = 7000000;
+  const uint32_t delays[] = {900, 350, 2400, 600, 5000};
+  uint32_t senderTime = 0;
+  for (size_t i = 0; i < sizeof(delays) / sizeof(delays[0]); i++)
+  {
+    senderTime += 20000;
+    clock.sample(senderTime, senderTime + offset + delays[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(offset + 350, clock.toLocal(0));
+}
+
+static void test_old_samples_leave_the_window(void)
+{
+  ClockSync clock;
+  clock.sample(0, 100); // Fastest, but soon forgotten
+  for (uint32_t i = 1; i <= CLOCK_SYNC_SAMPLES; i++)
+  {
+    clock.sample(i * 1000, i * 1000 + 400);
+  }
+  TEST_ASSERT_EQUAL_UINT32(400, clock.toLocal(0));
+}
+
+static void test_a_new_clock_starts_over(void)
+{
+  ClockSync clock;
+  clock.sample(50000000, 50000200);
+  clock.sample(1000, 900000); // Sender rebooted
+  TEST_ASSERT_EQUAL_UINT32(900000, clock.toLocal(1000));
+}
+
+static void test_offsets_wrap_with_micros(void)
+{
+  ClockSync clock;
+  clock.sample(0xFFFFF000, 500);  // Offset 0x1000 + 500 after the wrap
+  clock.sample(0xFFFFFF00, 4440); // 100 us slower
+  TEST_ASSERT_EQUAL_UINT32(500 + 0x1000, clock.toLocal(0));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_unsynced_until_the_first_sample);
+  RUN_TEST(test_fastest_delivery_sets_the_offset);
+  RUN_TEST(test_old_samples_leave_the_window);
+  RUN_TEST(test_a_new_clock_starts_over);
+  RUN_TEST(test_offsets_wrap_with_micros);
+  return UNITY_END();
+}
@@ -0,0 +1,138 @@
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "ColorLut.h"
+
+// The gamma and brightness table and the GRB render pass
+
+static RGB pixels[4];
+static uint8_t grb[64 * 3];
+
+void setUp(void)
+{
+  memset(pixels, 0, sizeof(pixels));
+  memset(grb, 0xAA, sizeof(grb));
+}
+
+void tearDown(void)
+{
+}
+
+static void test_linear_full_brightness_is_identity(void)
+{
+  ColorLut lut(1.0f);
+  for (int v = 0; v < 256; v++)
+  {
+    RGB color = {(uint8_t)v, (uint8_t)(255 - v), (uint8_t)v};
+    RGB out = lut.apply(color);
+    TEST_ASSERT_TRUE(out == color);
+  }
+}
+
+static void test_gamma_curve_keeps_endpoints_and_order(void)
+{
+  ColorLut lut(2.2f);
+  RGB black = {0, 0, 0};
+  RGB white = {255, 255, 255};
+  TEST_ASSERT_TRUE(lut.apply(black) == black);
+  TEST_ASSERT_TRUE(lut.apply(white) == white);
+
+  uint8_t last = 0;
+  for (int v = 0; v < 256; v++)
+  {
+    RGB color = {(uint8_t)v, 0, 0};
+    uint8_t red = lut.apply(color).red;
+    TEST_ASSERT_GREATER_OR_EQUAL(last, red);
+    TEST_ASSERT_UINT32_WITHIN(1, (uint32_t)(powf(v / 255.0f, 2.2f) * 255 + 0.5f), red);
+    last = red;
+  }
+  RGB mid = {128, 128, 128};
+  TEST_ASSERT_UINT32_WITHIN(1, 56, lut.apply(mid).red); // Far below 128, the point of gamma
+}
+
+static void test_brightness_scales(void)
+{
+  ColorLut lut(1.0f);
+  RGB white = {255, 255, 255};
+  lut.setBrightness(128);
+  TEST_ASSERT_EQUAL_UINT8(128, lut.brightness());
+  TEST_ASSERT_UINT32_WITHIN(1, 128, lut.apply(white).green);
+  lut.setBrightness(0);
+  TEST_ASSERT_EQUAL_UINT8(0, lut.apply(white).green);
+  lut.setBrightness(255);
+  TEST_ASSERT_EQUAL_UINT8(255, lut.apply(white).green); // Nothing lost on the way back up
+}
+
+static void test_render_writes_grb_per_span(void)
+{
+  ColorLut lut(1.0f);
+  lut.setDithering(false);
+  RGB color = {10, 20, 30};
+  pixels[1] = color;
+  LedSpan spans[] = {{0, 2, 1}, {2, 3, LED_UNMAPPED}, {5, 1, 1}};
+  lut.render(pixels, spans, 3, grb);
+  const uint8_t expected[] = {20, 10, 30, 20, 10, 30, 0, 0, 0, 0, 0, 0, 0, 0, 0, 20, 10, 30};
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, grb, sizeof(expected));
+  TEST_ASSERT_EQUAL_UINT8(0xAA, grb[sizeof(expected)]); // Nothing past the last span
+}
+
+static void test_dithering_averages_to_the_fraction(void)
+{
+  // Gamma 2.2 at a quarter brightness leaves most low values between two
+  // output steps. Over the 8 frame pattern the dithered output averages to
+  // the table value, where plain rounding is off by up to half a step.
+  ColorLut lut(2.2f);
+  lut.setBrightness(64);
+  LedSpan span = {0, 1, 0};
+  for (int v = 40; v < 256; v += 23)
+  {
+    pixels[0].red = v;
+    double exact = powf(v / 255.0f, 2.2f) * 255 * 64 / 255;
+    uint32_t sum = 0;
+    uint8_t low = 255;
+    uint8_t high = 0;
+    for (int frame = 0; frame < 8; frame++)
+    {
+      lut.render(pixels, &span, 1, grb);
+      sum += grb[1];
+      low = grb[1] < low ? grb[1] : low;
+      high = grb[1] > high ? grb[1] : high;
+    }
+    TEST_ASSERT_TRUE(high - low <= 1); // Only ever the two neighbouring steps
+    TEST_ASSERT_TRUE(fabs(sum / 8.0 - exact) <= 1.0 / 8 + 0.01);
+  }
+}
+
+static void test_dithering_keeps_black_and_white(void)
+{
+  ColorLut lut(2.2f);
+  LedSpan span = {0, 64, 0};
+  RGB white = {255, 255, 255};
+  for (int frame = 0; frame < 8; frame++)
+  {
+    pixels[0] = white;
+    lut.render(pixels, &span, 1, grb);
+    for (int i = 0; i < 64 * 3; i++)
+    {
+      TEST_ASSERT_EQUAL_UINT8(255, grb[i]);
+    }
+    memset(pixels, 0, sizeof(pixels));
+    lut.render(pixels, &span, 1, grb);
+    for (int i = 0; i < 64 * 3; i++)
+    {
+      TEST_ASSERT_EQUAL_UINT8(0, grb[i]);
+    }
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_linear_full_brightness_is_identity);
+  RUN_TEST(test_gamma_curve_keeps_endpoints_and_order);
+  RUN_TEST(test_brightness_scales);
+  RUN_TEST(test_render_writes_grb_per_span);
+  RUN_TEST(test_dithering_averages_to_the_fraction);
+  RUN_TEST(test_dithering_keeps_black_and_white);
+  return UNITY_END();
+}
@@ -0,0 +1,302 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "Config.h"
+
+static PhotonConfig config;
+static ConfigError error;
+static uint8_t image[sizeof(PhotonConfig) + 64];
+
+void setUp(void)
+{
+  memset(&config, 0xAA, sizeof(config));
+  error.key = NULL;
+  error.message = NULL;
+}
+
+void tearDown(void)
+{
+}
+
+static const char EVERY_KEY[] =
+    "{\"Channel\": 6, \"Receiver_Address\": \"24:0a:C4:00:01:fF\", \"Broadcast\": true,"
+    " \"Num_Pixels\": 600, \"Pixel_Index\": 3, \"Start_Color\": [255, 128, 0],"
+    " \"Latch_Delay_Ms\": 40, \"Num_LED\": 1200, \"Reverse\": false, \"Serpentine\": 30,"
+    " \"Segments\": [100, 200], \"Max_FPS\": 120, \"Render_Core\": 1,"
+    " \"Render_Priority\": 5, \"Outputs\": [{\"Pin\": 13, \"LEDs\": 600}]}";
+
+static bool parse(const char *json)
+{
+  return parseConfig(json, strlen(json), &config, &error);
+}
+
+static void test_every_key_is_read(void)
+{
+  TEST_ASSERT_TRUE(parse(EVERY_KEY));
+  TEST_ASSERT_EQUAL_UINT32((1UL << 15) - 1, config.present);
+  TEST_ASSERT_EQUAL_UINT8(6, config.channel);
+  TEST_ASSERT_EQUAL_UINT8(0x0A, config.receiverAddress[1]);
+  TEST_ASSERT_EQUAL_UINT8(0xFF, config.receiverAddress[5]);
+  TEST_ASSERT_TRUE(config.broadcast);
+  TEST_ASSERT_EQUAL_UINT16(600, config.numPixels);
+  TEST_ASSERT_EQUAL_UINT8(128, config.startColor.green);
+  TEST_ASSERT_EQUAL_UINT16(40, config.latchDelayMs);
+  TEST_ASSERT_EQUAL_UINT16(1200, config.numLed);
+  TEST_ASSERT_FALSE(config.reverse);
+  TEST_ASSERT_EQUAL_UINT16(2, config.numSegments);
+  TEST_ASSERT_EQUAL_UINT16(200, config.segments[1]);
+  TEST_ASSERT_EQUAL_UINT16(120, config.maxFps);
+  TEST_ASSERT_EQUAL_UINT8(1, config.numOutputs);
+  TEST_ASSERT_EQUAL_UINT8(13, config.outputPins[0]);
+  TEST_ASSERT_EQUAL_UINT16(600, config.outputLeds[0]);
+}
+
+static void test_missing_keys_are_not_present(void)
+{
+  TEST_ASSERT_TRUE(parse("{\"Channel\": 1}"));
+  TEST_ASSERT_EQUAL_UINT32(CONFIG_CHANNEL, config.present);
+  TEST_ASSERT_EQUAL_UINT16(0, config.numSegments);
+}
+
+static void test_bad_values_name_their_key(void)
+{
+  TEST_ASSERT_FALSE(parse("{\"Channel\": 15}"));
+  TEST_ASSERT_EQUAL_STRING("Channel", error.key);
+  TEST_ASSERT_EQUAL_STRING("out of range", error.message);
+
+  TEST_ASSERT_FALSE(parse("{\"Num_LED\": \"600\"}"));
+  TEST_ASSERT_EQUAL_STRING("Num_LED", error.key);
+
+  TEST_ASSERT_FALSE(parse("{\"Reverse\": 1}"));
+  TEST_ASSERT_EQUAL_STRING("Reverse", error.key);
+
+  TEST_ASSERT_FALSE(parse("{\"Receiver_Address\": \"24:0A:C4:00:01\"}"));
+  TEST_ASSERT_EQUAL_STRING("Receiver_Address", error.key);
+
+  TEST_ASSERT_FALSE(parse("{\"Start_Color\": [1, 2]}"));
+  TEST_ASSERT_EQUAL_STRING("Start_Color", error.key);
+
+  TEST_ASSERT_FALSE(parse("{\"Outputs\": [{\"Pin\": 40, \"LEDs\": 1}]}"));
+  TEST_ASSERT_EQUAL_STRING("Outputs.Pin", error.key);
+}
+
+static void test_broken_json_is_rejected_whole(void)
+{
+  TEST_ASSERT_FALSE(parse("{\"Channel\": 1,"));
+  TEST_ASSERT_NULL(error.key);
+  TEST_ASSERT_FALSE(parse("[1, 2, 3]"));
+  TEST_ASSERT_NULL(error.key);
+}
+
+static void test_wrong_numbers_and_lists_are_rejected(void)
+{
+  TEST_ASSERT_FALSE(parse("{\"Channel\": -1}"));
+  TEST_ASSERT_EQUAL_STRING("Channel", error.key);
+  TEST_ASSERT_FALSE(parse("{\"Max_FPS\": 60.5}"));
+  TEST_ASSERT_EQUAL_STRING("Max_FPS", error.key);
+  TEST_ASSERT_FALSE(parse("{\"Num_LED\": 99999999999}"));
+  TEST_ASSERT_EQUAL_STRING("Num_LED", error.key);
+  TEST_ASSERT_FALSE(parse("{\"Render_Priority\": 0}"));
+  TEST_ASSERT_EQUAL_STRING("Render_Priority", error.key);
+  TEST_ASSERT_FALSE(parse("{\"Receiver_Address\": 12}"));
+  TEST_ASSERT_EQUAL_STRING("Receiver_Address", error.key);
+  TEST_ASSERT_FALSE(parse("{\"Start_Color\": [1, 2, 256]}"));
+  TEST_ASSERT_EQUAL_STRING("Start_Color", error.key);
+  TEST_ASSERT_FALSE(parse("{\"Start_Color\": \"red\"}"));
+  TEST_ASSERT_EQUAL_STRING("Start_Color", error.key);
+  TEST_ASSERT_FALSE(parse("{\"Segments\": [1, \"2\"]}"));
+  TEST_ASSERT_EQUAL_STRING("Segments", error.key);
+  TEST_ASSERT_FALSE(parse("{\"Outputs\": [13]}"));
+  TEST_ASSERT_EQUAL_STRING("Outputs", error.key);
+  TEST_ASSERT_FALSE(parse("{\"Outputs\": [{\"Pin\": 13}]}"));
+  TEST_ASSERT_EQUAL_STRING("Outputs.LEDs", error.key);
+  TEST_ASSERT_FALSE(parse("{\"Outputs\": [{}, {}, {}, {}, {}, {}, {}, {}, {}]}"));
+  TEST_ASSERT_EQUAL_STRING("Outputs", error.key);
+}
+
+static void test_too_many_segments_are_rejected(void)
+{
+  // One entry past the limit, built the way a generated config.json would be
+  static char json[32 + (CONFIG_MAX_SEGMENTS + 1) * 2];
+  size_t len = 0;
+  len += sprintf(&json[len], "{\"Segments\": [");
+  for (int i = 0; i <= CONFIG_MAX_SEGMENTS; i++)
+  {
+    len += sprintf(&json[len], i == 0 ? "1" : ",1");
+  }
+  sprintf(&json[len], "]}");
+  TEST_ASSERT_FALSE(parse(json));
+  TEST_ASSERT_EQUAL_STRING("Segments", error.key);
+
+  // The limit itself is fine
+  json[len - 2] = ']';
+  json[len - 1] = '}';
+  json[len] = 0;
+  TEST_ASSERT_TRUE(parse(json));
+  TEST_ASSERT_EQUAL_UINT16(CONFIG_MAX_SEGMENTS, config.numSegments);
+}
+
+static void test_empty_and_non_object_files_are_rejected(void)
+{
+  const char *files[] = {"", " \n", "null", "42", "\"config\"", "true", "{", "}", "{\"Channel\" 1}", "{\"Channel\": }"};
+  for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+  {
+    error.message = NULL;
+    TEST_ASSERT_FALSE_MESSAGE(parse(files[i]), files[i]);
+    TEST_ASSERT_NULL_MESSAGE(error.key, files[i]);
+    TEST_ASSERT_NOT_NULL_MESSAGE(error.message, files[i]);
+  }
+}
+
+static void test_truncated_file_is_rejected(void)
+{
+  // A config.json cut short by an interrupted upload, at every length
+  static char json[sizeof(EVERY_KEY)];
+  for (size_t len = 0; len < strlen(EVERY_KEY); len++)
+  {
+    memcpy(json, EVERY_KEY, len);
+    json[len] = 0;
+    error.message = NULL;
+    TEST_ASSERT_FALSE(parseConfig(json, len, &config, &error));
+    TEST_ASSERT_NOT_NULL(error.message);
+  }
+}
+
+// Whatever a damaged file holds, an accepted one stays inside the schema
+static void assertInSchema(const PhotonConfig &parsed)
+{
+  TEST_ASSERT_LESS_OR_EQUAL(14, parsed.channel);
+  TEST_ASSERT_LESS_OR_EQUAL(FRAME_MAX_PIXELS, parsed.numPixels);
+  TEST_ASSERT_LESS_THAN(FRAME_MAX_PIXELS, parsed.pixelIndex);
+  TEST_ASSERT_LESS_OR_EQUAL(1000, parsed.latchDelayMs);
+  TEST_ASSERT_LESS_OR_EQUAL(CONFIG_MAX_LEDS, parsed.numLed);
+  TEST_ASSERT_LESS_OR_EQUAL(CONFIG_MAX_LEDS, parsed.serpentine);
+  TEST_ASSERT_LESS_OR_EQUAL(1000, parsed.maxFps);
+  TEST_ASSERT_LESS_OR_EQUAL(1, parsed.renderCore);
+  TEST_ASSERT_LESS_OR_EQUAL(24, parsed.renderPriority);
+  TEST_ASSERT_TRUE(parsed.renderPriority >= 1 || !(parsed.present & CONFIG_RENDER_PRIORITY));
+  TEST_ASSERT_LESS_OR_EQUAL(CONFIG_MAX_SEGMENTS, parsed.numSegments);
+  TEST_ASSERT_LESS_OR_EQUAL(CONFIG_MAX_OUTPUTS, parsed.numOutputs);
+  for (uint8_t i = 0; i < parsed.numOutputs; i++)
+  {
+    TEST_ASSERT_LESS_OR_EQUAL(39, parsed.outputPins[i]);
+    TEST_ASSERT_LESS_OR_EQUAL(CONFIG_MAX_LEDS, parsed.outputLeds[i]);
+  }
+}
+
+static void test_damaged_files_never_load_bad_values(void)
+{
+  // Random bytes replaced with digits, signs and JSON punctuation
+  static const char noiseChars[] = "0123456789-+.e\"[]{}:, x";
+  static char json[sizeof(EVERY_KEY)];
+  uint32_t noise = 1;
+  uint32_t accepted = 0;
+  for (int run = 0; run < 5000; run++)
+  {
+    memcpy(json, EVERY_KEY, sizeof(EVERY_KEY));
+    for (int hits = 1 + run % 3; hits > 0; hits--)
+    {
+      noise = noise * 1664525 + 1013904223;
+      uint32_t at = (noise >> 8) % (sizeof(EVERY_KEY) - 1);
+      json[at] = noiseChars[(noise >> 24) % (sizeof(noiseChars) - 1)];
+    }
+    error.key = NULL;
+    error.message = NULL;
+    if (parseConfig(json, strlen(json), &config, &error))
+    {
+      assertInSchema(config);
+      accepted++;
+    }
+    else
+    {
+      TEST_ASSERT_NOT_NULL(error.message);
+    }
+  }
+  char line[64];
+  snprintf(line, sizeof(line), "%u of 5000 damaged files accepted", (unsigned)accepted);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_GREATER_THAN(0, accepted); // Some damage lands in harmless places
+}
+
+static void test_parse_mac(void)
+{
+  uint8_t mac[6];
+  TEST_ASSERT_TRUE(parseMac("01:23:45:67:89:AB", mac));
+  TEST_ASSERT_EQUAL_UINT8(0x01, mac[0]);
+  TEST_ASSERT_EQUAL_UINT8(0xAB, mac[5]);
+  TEST_ASSERT_FALSE(parseMac("01:23:45:67:89:AB:CD", mac));
+  TEST_ASSERT_FALSE(parseMac("01:23:45:67:89", mac));
+  TEST_ASSERT_FALSE(parseMac(NULL, mac));
+}
+
+static void test_image_round_trip(void)
+{
+  memset(&config, 0, sizeof(config));
+  config.present = CONFIG_CHANNEL | CONFIG_SEGMENTS;
+  config.channel = 11;
+  config.numSegments = 3;
+  config.segments[2] = 77;
+
+  size_t len = packConfig(config, 123, 0x4567, image, sizeof(image));
+  TEST_ASSERT_EQUAL(configImageSize(config), len);
+  TEST_ASSERT_LESS_THAN(sizeof(PhotonConfig), len); // Only the segments in use
+
+  PhotonConfig unpacked;
+  TEST_ASSERT_TRUE(unpackConfig(image, len, 123, 0x4567, &unpacked));
+  TEST_ASSERT_EQUAL_UINT8(11, unpacked.channel);
+  TEST_ASSERT_EQUAL_UINT16(77, unpacked.segments[2]);
+  TEST_ASSERT_TRUE(unpackConfig(image, len, 0, 0, &unpacked)); // Any config.json
+}
+
+static void test_image_of_another_file_or_damaged_is_refused(void)
+{
+  memset(&config, 0, sizeof(config));
+  config.channel = 3;
+  size_t len = packConfig(config, 100, 0x1111, image, sizeof(image));
+  PhotonConfig unpacked;
+  TEST_ASSERT_FALSE(unpackConfig(image, len, 101, 0x1111, &unpacked));
+  TEST_ASSERT_FALSE(unpackConfig(image, len, 100, 0x1112, &unpacked));
+  TEST_ASSERT_FALSE(unpackConfig(image, len - 1, 100, 0x1111, &unpacked));
+
+  image[len - 10] ^= 0x40;
+  TEST_ASSERT_FALSE(unpackConfig(image, len, 100, 0x1111, &unpacked));
+
+  TEST_ASSERT_EQUAL(0, packConfig(config, 100, 0x1111, image, len - 1));
+}
+
+static void test_every_single_bit_flip_in_the_image_is_refused(void)
+{
+  memset(&config, 0, sizeof(config));
+  config.channel = 3;
+  config.numSegments = 4;
+  config.segments[3] = 500;
+  size_t len = packConfig(config, 100, 0x1111, image, sizeof(image));
+  PhotonConfig unpacked;
+  for (size_t bit = 0; bit < len * 8; bit++)
+  {
+    image[bit / 8] ^= 1 << (bit % 8);
+    TEST_ASSERT_FALSE(unpackConfig(image, len, 100, 0x1111, &unpacked));
+    TEST_ASSERT_FALSE(unpackConfig(image, len, 0, 0, &unpacked));
+    image[bit / 8] ^= 1 << (bit % 8);
+  }
+  TEST_ASSERT_TRUE(unpackConfig(image, len, 100, 0x1111, &unpacked));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_every_key_is_read);
+  RUN_TEST(test_missing_keys_are_not_present);
+  RUN_TEST(test_bad_values_name_their_key);
+  RUN_TEST(test_broken_json_is_rejected_whole);
+  RUN_TEST(test_wrong_numbers_and_lists_are_rejected);
+  RUN_TEST(test_too_many_segments_are_rejected);
+  RUN_TEST(test_empty_and_non_object_files_are_rejected);
+  RUN_TEST(test_truncated_file_is_rejected);
+  RUN_TEST(test_damaged_files_never_load_bad_values);
+  RUN_TEST(test_parse_mac);
+  RUN_TEST(test_image_round_trip);
+  RUN_TEST(test_image_of_another_file_or_damaged_is_refused);
+  RUN_TEST(test_every_single_bit_flip_in_the_image_is_refused);
+  return UNITY_END();
+}
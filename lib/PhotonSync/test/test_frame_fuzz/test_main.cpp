@@ -0,0 +1,242 @@
+#include <unity.h>
+#include <string.h>
+#include "FrameProtocol.h"
+#include "Pixel.h"
+
+// Random frames through the encoder and decoder, and random damage to the
+// packets. Run it under -fsanitize=address to catch reads past a packet.
+
+#define FUZZ_ROUNDS 2000
+#define FUZZ_PIXELS 700 // Narrow and wide packets both
+
+static RGB frame[FUZZ_PIXELS];
+static RGB previous[FUZZ_PIXELS];
+static RGB shown[FRAME_MAX_PIXELS];
+static RGB before[FRAME_MAX_PIXELS];
+static FadeCommand fades[FRAME_MAX_FADES];
+static SceneTable scenes;
+static FrameTarget target;
+static uint32_t noise;
+
+static uint32_t random32()
+{
+  noise = noise * 1664525 + 1013904223;
+  return noise >> 8;
+}
+
+void setUp(void)
+{
+  noise = 12345;
+  memset(shown, 0, sizeof(shown));
+  memset(&scenes, 0, sizeof(scenes));
+  target.pixels = shown;
+  target.size = FRAME_MAX_PIXELS;
+  target.windowStart = 0;
+  target.windowCount = FRAME_MAX_PIXELS;
+  target.fades = fades;
+  target.maxFades = FRAME_MAX_FADES;
+  target.fadeCount = 0;
+  target.scenes = &scenes;
+}
+
+void tearDown(void)
+{
+}
+
+// A frame with runs, repeated colours, small steps and noise, like real content
+static void randomFrame(RGB *out, uint16_t count)
+{
+  uint16_t i = 0;
+  while (i < count)
+  {
+    uint16_t run = 1 + random32() % 40;
+    RGB color = {(uint8_t)random32(), (uint8_t)random32(), (uint8_t)random32()};
+    uint32_t kind = random32() % 4;
+    for (uint16_t j = 0; j < run && i < count; j++, i++)
+    {
+      if (kind == 0)
+      {
+        out[i] = color; // Run of one colour
+      }
+      else if (kind == 1)
+      {
+        out[i].red = previous[i].red + color.red % 8; // Same step for the whole run
+        out[i].green = previous[i].green + color.green % 8;
+        out[i].blue = previous[i].blue + color.blue % 8;
+      }
+      else if (kind == 2)
+      {
+        out[i] = previous[i]; // Unchanged
+      }
+      else
+      {
+        out[i].red = random32();
+        out[i].green = random32();
+        out[i].blue = random32();
+      }
+    }
+  }
+}
+
+// Encode pixels [first, first + count) of frame against base and decode every
+// packet into target
+static void roundTrip(const RGB *base, uint16_t first, uint16_t count)
+{
+  static uint8_t packet[FRAME_MAX_PACKET];
+  FrameHeader header = {0, 0, 0};
+  uint16_t done = 0;
+  while (done < count)
+  {
+    uint16_t consumed;
+    size_t len = encodeFrame(packet, sizeof(packet), header, frame, base, first + done, count - done, &consumed);
+    TEST_ASSERT_LESS_OR_EQUAL(FRAME_MAX_PACKET, len);
+    TEST_ASSERT_GREATER_THAN(0, consumed);
+    FrameHeader read;
+    TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, len, &read, &target));
+    done += consumed;
+    TEST_ASSERT_EQUAL(done == count, (read.flags & FRAME_FLAG_LAST) != 0);
+  }
+}
+
+static void test_random_frames_round_trip(void)
+{
+  memset(previous, 0, sizeof(previous));
+  for (int round = 0; round < FUZZ_ROUNDS; round++)
+  {
+    uint16_t first = random32() % FUZZ_PIXELS;
+    uint16_t count = 1 + random32() % (FUZZ_PIXELS - first);
+    randomFrame(frame, FUZZ_PIXELS);
+    bool keyframe = random32() % 4 == 0;
+    roundTrip(keyframe ? NULL : previous, first, count);
+    TEST_ASSERT_EQUAL_MEMORY(&frame[first], &shown[first], count * sizeof(RGB));
+    memcpy(&previous[first], &frame[first], count * sizeof(RGB));
+    TEST_ASSERT_EQUAL_MEMORY(previous, shown, sizeof(previous));
+  }
+}
+
+static void test_window_sees_only_its_pixels(void)
+{
+  const RGB black = {0, 0, 0};
+  memset(previous, 0, sizeof(previous));
+  randomFrame(frame, FUZZ_PIXELS);
+  target.windowStart = 250;
+  target.windowCount = 20; // Across the narrow limit
+  roundTrip(NULL, 0, FUZZ_PIXELS);
+  TEST_ASSERT_EQUAL_MEMORY(&frame[250], &shown[250], 20 * sizeof(RGB));
+  for (int i = 0; i < FRAME_MAX_PIXELS; i++)
+  {
+    if (i < 250 || i >= 270)
+    {
+      TEST_ASSERT_TRUE(shown[i] == black);
+    }
+  }
+}
+
+// Any result but FRAME_OK must leave the target exactly as it was
+static void decodeUntouchedUnlessOk(const uint8_t *packet, size_t len)
+{
+  memcpy(before, shown, sizeof(shown));
+  SceneTable scenesBefore = scenes;
+  target.fadeCount = 0;
+  FrameHeader read;
+  FrameDecodeResult result = decodeFrame(packet, len, &read, &target);
+  if (result != FRAME_OK)
+  {
+    TEST_ASSERT_EQUAL_MEMORY(before, shown, sizeof(shown));
+    TEST_ASSERT_EQUAL_MEMORY(&scenesBefore, &scenes, sizeof(scenes));
+    TEST_ASSERT_EQUAL_UINT8(0, target.fadeCount);
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(FRAME_MAX_FADES, target.fadeCount);
+}
+
+static void test_damaged_packets_never_write_half(void)
+{
+  static uint8_t packet[FRAME_MAX_PACKET];
+  static uint8_t damaged[FRAME_MAX_PACKET];
+  memset(previous, 0, sizeof(previous));
+  for (int round = 0; round < FUZZ_ROUNDS; round++)
+  {
+    randomFrame(frame, FUZZ_PIXELS);
+    FrameHeader header = {0, 0, (uint16_t)round};
+    uint16_t first = random32() % FUZZ_PIXELS;
+    uint16_t consumed;
+    size_t len = encodeFrame(packet, sizeof(packet), header, frame, previous, first, FUZZ_PIXELS - first,
+                             &consumed);
+
+    // Flip a few bits, cut the packet short, or both
+    memcpy(damaged, packet, len);
+    int flips = random32() % 4;
+    for (int f = 0; f < flips; f++)
+    {
+      damaged[random32() % len] ^= 1 << (random32() % 8);
+    }
+    size_t damagedLen = random32() % 3 == 0 ? random32() % (len + 1) : len;
+    decodeUntouchedUnlessOk(damaged, damagedLen);
+  }
+}
+
+static void test_random_bytes_never_write_half(void)
+{
+  static uint8_t packet[FRAME_MAX_PACKET];
+  for (int round = 0; round < FUZZ_ROUNDS * 5; round++)
+  {
+    size_t len = random32() % (FRAME_MAX_PACKET + 1);
+    for (size_t i = 0; i < len; i++)
+    {
+      packet[i] = random32();
+    }
+    if (len >= FRAME_HEADER_SIZE)
+    {
+      packet[0] = FRAME_MAGIC;
+      packet[1] = 1 + random32() % FRAME_VERSION;
+      packet[2] &= ~FRAME_FLAG_COMMIT;
+      if (packet[1] == FRAME_VERSION_BASIC)
+      {
+        packet[2] &= ~FRAME_FLAGS_V2;
+      }
+      if (len > FRAME_HEADER_SIZE)
+      {
+        packet[FRAME_HEADER_SIZE] = 1 + random32() % FRAME_OP_TRIGGER; // A real opcode to get further
+      }
+    }
+    decodeUntouchedUnlessOk(packet, len);
+  }
+}
+
+static void test_legacy_packets_are_never_frames(void)
+{
+  // Batched legacy packets as the text path sends them, any first index it
+  // accepts. 181 with red 1 or 2 once read as a version 1 or 2 header.
+  static Pixel legacy[FRAME_MAX_PACKET / sizeof(Pixel)];
+  for (int round = 0; round < FUZZ_ROUNDS; round++)
+  {
+    size_t count = 2 + random32() % (FRAME_MAX_PACKET / sizeof(Pixel) - 1);
+    for (size_t i = 0; i < count; i++)
+    {
+      Pixel pixel = {(uint8_t)(1 + random32() % 255), (uint8_t)random32(), (uint8_t)random32(), (uint8_t)random32()};
+      legacy[i] = pixel;
+    }
+    if (round < 512)
+    {
+      legacy[0].index = 181;
+      legacy[0].red = round % 4;
+      legacy[0].green = round / 4;
+    }
+    const uint8_t *packet = (const uint8_t *)legacy;
+    TEST_ASSERT_FALSE(isFramePacket(packet, count * sizeof(Pixel)));
+    FrameHeader read;
+    TEST_ASSERT_EQUAL(FRAME_NOT_FRAME, readFrameHeader(packet, count * sizeof(Pixel), &read));
+    decodeUntouchedUnlessOk(packet, count * sizeof(Pixel));
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_random_frames_round_trip);
+  RUN_TEST(test_window_sees_only_its_pixels);
+  RUN_TEST(test_damaged_packets_never_write_half);
+  RUN_TEST(test_random_bytes_never_write_half);
+  RUN_TEST(test_legacy_packets_are_never_frames);
+  return UNITY_END();
+}
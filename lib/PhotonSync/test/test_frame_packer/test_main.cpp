@@ -0,0 +1,216 @@
+#include <unity.h>
+#include <string.h>
+#include "FramePacker.h"
+
+// Every packet the packer sends is decoded into shown, as a receiver would
+static RGB shown[FRAME_MAX_PIXELS];
+static FrameTarget target;
+static int packets;
+static int commits;
+static int refuseAfter; // Packets the sink accepts before refusing, -1 for no limit
+static uint8_t lastFlags;
+static uint8_t lastFrameId;
+
+static uint8_t packet[DATASIZE];
+
+static uint8_t *reservePacket()
+{
+  if (refuseAfter == 0)
+  {
+    return NULL;
+  }
+  if (refuseAfter > 0)
+  {
+    refuseAfter--;
+  }
+  return packet;
+}
+
+static void sendPacket(size_t len)
+{
+  FrameHeader header;
+  FrameDecodeResult result = decodeFrame(packet, len, &header, &target);
+  if (result == FRAME_IS_COMMIT)
+  {
+    commits++;
+    return;
+  }
+  TEST_ASSERT_EQUAL(FRAME_OK, result);
+  TEST_ASSERT_LESS_OR_EQUAL(FRAME_MAX_PACKET, len);
+  lastFlags = header.flags;
+  lastFrameId = header.frameId;
+  packets++;
+}
+
+static const PacketSink sink = {reservePacket, sendPacket};
+
+static uint32_t senderMicros()
+{
+  return 1000;
+}
+
+void setUp(void)
+{
+  memset(shown, 0, sizeof(shown));
+  memset(&target, 0, sizeof(target));
+  target.pixels = shown;
+  target.size = FRAME_MAX_PIXELS;
+  target.windowCount = FRAME_MAX_PIXELS;
+  packets = 0;
+  commits = 0;
+  refuseAfter = -1;
+}
+
+void tearDown(void)
+{
+}
+
+static Pixel pixel(uint8_t index, uint8_t red, uint8_t green, uint8_t blue)
+{
+  Pixel p = {index, red, green, blue};
+  return p;
+}
+
+static RGB rgb(uint8_t red, uint8_t green, uint8_t blue)
+{
+  RGB color = {red, green, blue};
+  return color;
+}
+
+static void test_pixels_wait_for_the_deadline(void)
+{
+  FramePacker packer(sink, 20);
+  for (int i = 0; i < 10; i++)
+  {
+    packer.add(pixel(i * 3, i, 2 * i, 3 * i), 100);
+  }
+  TEST_ASSERT_TRUE(packer.poll(119));
+  TEST_ASSERT_EQUAL(0, packets);
+  TEST_ASSERT_EQUAL(10, packer.pending());
+
+  TEST_ASSERT_TRUE(packer.poll(120));
+  TEST_ASSERT_EQUAL(1, packets); // Ten pixels, one packet
+  TEST_ASSERT_EQUAL(0, packer.pending());
+  TEST_ASSERT_TRUE(shown[27] == rgb(9, 18, 27));
+}
+
+static void test_full_batch_goes_out_at_once(void)
+{
+  FramePacker packer(sink, 1000);
+  for (size_t i = 0; i < PACKER_MAX_PIXELS; i++)
+  {
+    packer.add(pixel(i, 1, 1, 1), 0);
+  }
+  TEST_ASSERT_EQUAL(1, packets);
+  TEST_ASSERT_EQUAL(0, packer.pending());
+}
+
+static void test_newest_value_of_a_pixel_wins(void)
+{
+  FramePacker packer(sink, 10);
+  packer.add(pixel(5, 1, 1, 1), 0);
+  packer.add(pixel(5, 9, 9, 9), 1);
+  TEST_ASSERT_EQUAL(1, packer.pending());
+  packer.flush();
+  TEST_ASSERT_TRUE(shown[5] == rgb(9, 9, 9));
+}
+
+static void test_only_changes_are_sent(void)
+{
+  static RGB frame[600];
+  for (int i = 0; i < 600; i++)
+  {
+    frame[i] = rgb(i, i >> 2, 100);
+  }
+  FramePacker packer(sink, 10);
+  packer.set(0, frame, 600, 0);
+  TEST_ASSERT_TRUE(packer.flush());
+  int keyframePackets = packets;
+  TEST_ASSERT_EQUAL_MEMORY(frame, shown, sizeof(frame));
+
+  // Unchanged pixels are left out of the delta, one changed pixel is one packet
+  frame[400] = rgb(0, 0, 0);
+  packets = 0;
+  packer.set(0, frame, 600, 1);
+  TEST_ASSERT_TRUE(packer.flush());
+  TEST_ASSERT_EQUAL(1, packets);
+  TEST_ASSERT_GREATER_THAN(1, keyframePackets);
+  TEST_ASSERT_FALSE(lastFlags & FRAME_FLAG_KEYFRAME);
+  TEST_ASSERT_EQUAL_MEMORY(frame, shown, sizeof(frame));
+}
+
+static void test_refused_frame_resumes_where_it_stopped(void)
+{
+  static RGB frame[600];
+  for (int i = 0; i < 600; i++)
+  {
+    frame[i] = rgb(i, 1, 2);
+  }
+  FramePacker packer(sink, 10);
+  refuseAfter = 2;
+  packer.set(0, frame, 600, 0);
+  TEST_ASSERT_FALSE(packer.flush());
+  uint8_t frameId = lastFrameId;
+
+  refuseAfter = -1;
+  TEST_ASSERT_TRUE(packer.poll(1));
+  TEST_ASSERT_EQUAL(frameId, lastFrameId); // Same frame, only the rest
+  TEST_ASSERT_TRUE(lastFlags & FRAME_FLAG_LAST);
+  TEST_ASSERT_EQUAL(8, packets); // As many as without the refusal
+  TEST_ASSERT_EQUAL_MEMORY(frame, shown, sizeof(frame));
+}
+
+static void test_keyframe_on_request(void)
+{
+  FramePacker packer(sink, 10);
+  packer.add(pixel(1, 1, 1, 1), 0);
+  packer.flush(); // The first frame is always a keyframe
+  TEST_ASSERT_TRUE(lastFlags & FRAME_FLAG_KEYFRAME);
+
+  packer.add(pixel(2, 1, 1, 1), 0);
+  packer.flush();
+  TEST_ASSERT_FALSE(lastFlags & FRAME_FLAG_KEYFRAME);
+
+  packer.requestKeyframe();
+  packer.add(pixel(3, 1, 1, 1), 0);
+  packer.flush();
+  TEST_ASSERT_TRUE(lastFlags & FRAME_FLAG_KEYFRAME);
+}
+
+static void test_latched_frames_are_staged_and_committed(void)
+{
+  FramePacker packer(sink, 10);
+  packer.setLatch(50, senderMicros);
+  packer.add(pixel(1, 1, 1, 1), 0);
+  TEST_ASSERT_TRUE(packer.flush());
+  TEST_ASSERT_TRUE(lastFlags & FRAME_FLAG_STAGED);
+  TEST_ASSERT_EQUAL(PACKER_COMMIT_REPEAT, commits);
+}
+
+static void test_pacing_drops_low_bits_and_restores_them(void)
+{
+  FramePacker packer(sink, 10);
+  packer.setPacing(PACKER_MAX_PIXELS, 2, 0);
+  packer.add(pixel(1, 0x81, 0x42, 0x07), 0);
+  packer.flush();
+  TEST_ASSERT_TRUE(shown[1] == rgb(0x82, 0x41, 0x04));
+
+  packer.setPacing(PACKER_MAX_PIXELS, 0, 1); // Link recovered
+  TEST_ASSERT_EQUAL(1, packer.pending());
+  packer.flush();
+  TEST_ASSERT_TRUE(shown[1] == rgb(0x81, 0x42, 0x07));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_pixels_wait_for_the_deadline);
+  RUN_TEST(test_full_batch_goes_out_at_once);
+  RUN_TEST(test_newest_value_of_a_pixel_wins);
+  RUN_TEST(test_only_changes_are_sent);
+  RUN_TEST(test_refused_frame_resumes_where_it_stopped);
+  RUN_TEST(test_keyframe_on_request);
+  RUN_TEST(test_latched_frames_are_staged_and_committed);
+  RUN_TEST(test_pacing_drops_low_bits_and_restores_them);
+  return UNITY_END();
+}
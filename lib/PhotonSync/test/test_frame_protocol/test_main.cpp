@@ -0,0 +1,249 @@
+#include <unity.h>
+#include <string.h>
+#include "FrameProtocol.h"
+
+static uint8_t packet[FRAME_MAX_PACKET];
+static RGB pixels[FRAME_MAX_PIXELS];
+static FadeCommand fades[FRAME_MAX_FADES];
+static FrameTarget target;
+
+void setUp(void)
+{
+  memset(packet, 0, sizeof(packet));
+  memset(pixels, 0, sizeof(pixels));
+  target.pixels = pixels;
+  target.size = FRAME_MAX_PIXELS;
+  target.windowStart = 0;
+  target.windowCount = FRAME_MAX_PIXELS;
+  target.fades = fades;
+  target.maxFades = FRAME_MAX_FADES;
+  target.fadeCount = 0;
+  target.scenes = NULL;
+}
+
+void tearDown(void)
+{
+}
+
+static RGB rgb(uint8_t red, uint8_t green, uint8_t blue)
+{
+  RGB color = {red, green, blue};
+  return color;
+}
+
+static void test_header_round_trip(void)
+{
+  FrameHeader header = {FRAME_FLAG_KEYFRAME | FRAME_FLAG_LAST, 42, 0x1234};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+  TEST_ASSERT_EQUAL(FRAME_HEADER_SIZE, writer.length());
+  TEST_ASSERT_TRUE(isFramePacket(packet, writer.length()));
+
+  FrameHeader read;
+  TEST_ASSERT_EQUAL(FRAME_OK, readFrameHeader(packet, writer.length(), &read));
+  TEST_ASSERT_EQUAL_HEX8(header.flags, read.flags);
+  TEST_ASSERT_EQUAL_UINT8(42, read.frameId);
+  TEST_ASSERT_EQUAL_UINT16(0x1234, read.sequence);
+}
+
+static void test_version_is_the_lowest_that_reads_the_packet(void)
+{
+  FrameHeader header = {FRAME_FLAG_LAST, 0, 0};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+  TEST_ASSERT_TRUE(writer.fill(0, 10, rgb(1, 2, 3)));
+  TEST_ASSERT_EQUAL_UINT8(FRAME_VERSION_BASIC, packet[1]);
+
+  TEST_ASSERT_TRUE(writer.fade(0, 10, rgb(4, 5, 6), 100));
+  TEST_ASSERT_EQUAL_UINT8(FRAME_VERSION, packet[1]);
+
+  header.flags = FRAME_FLAG_WIDE;
+  writer.begin(header);
+  TEST_ASSERT_EQUAL_UINT8(FRAME_VERSION, packet[1]);
+}
+
+static void test_bad_headers_are_rejected(void)
+{
+  FrameHeader header = {0, 0, 0};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+
+  FrameHeader read;
+  TEST_ASSERT_EQUAL(FRAME_NOT_FRAME, readFrameHeader(packet, FRAME_HEADER_SIZE - 1, &read));
+  packet[1] = FRAME_VERSION + 1;
+  TEST_ASSERT_EQUAL(FRAME_BAD_VERSION, readFrameHeader(packet, FRAME_HEADER_SIZE, &read));
+  packet[1] = 0;
+  TEST_ASSERT_EQUAL(FRAME_BAD_VERSION, readFrameHeader(packet, FRAME_HEADER_SIZE, &read));
+
+  // A version 1 packet cannot be wide, an old sender never wrote one
+  packet[1] = FRAME_VERSION_BASIC;
+  packet[2] = FRAME_FLAG_WIDE;
+  TEST_ASSERT_EQUAL(FRAME_BAD_VERSION, readFrameHeader(packet, FRAME_HEADER_SIZE, &read));
+
+  packet[0] = FRAME_MAGIC ^ 0xFF;
+  TEST_ASSERT_FALSE(isFramePacket(packet, FRAME_HEADER_SIZE));
+  TEST_ASSERT_EQUAL(FRAME_NOT_FRAME, readFrameHeader(packet, FRAME_HEADER_SIZE, &read));
+}
+
+static void test_records_decode(void)
+{
+  FrameHeader header = {FRAME_FLAG_LAST, 1, 1};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+  RGB colors[3] = {rgb(10, 20, 30), rgb(40, 50, 60), rgb(70, 80, 90)};
+  TEST_ASSERT_TRUE(writer.set(5, colors, 3));
+  TEST_ASSERT_TRUE(writer.extend(rgb(1, 1, 1)));
+  TEST_ASSERT_TRUE(writer.fill(100, 4, rgb(9, 9, 9)));
+  pixels[200] = rgb(250, 0, 10);
+  TEST_ASSERT_TRUE(writer.add(200, 1, rgb(10, 1, 250)));
+
+  FrameHeader read;
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, writer.length(), &read, &target));
+  TEST_ASSERT_TRUE(pixels[5] == colors[0]);
+  TEST_ASSERT_TRUE(pixels[7] == colors[2]);
+  TEST_ASSERT_TRUE(pixels[8] == rgb(1, 1, 1));
+  TEST_ASSERT_TRUE(pixels[9] == rgb(0, 0, 0));
+  TEST_ASSERT_TRUE(pixels[103] == rgb(9, 9, 9));
+  TEST_ASSERT_TRUE(pixels[104] == rgb(0, 0, 0));
+  TEST_ASSERT_TRUE(pixels[200] == rgb(4, 1, 4)); // Per channel, mod 256
+}
+
+static void test_fade_records_reach_the_target(void)
+{
+  FrameHeader header = {FRAME_FLAG_LAST, 0, 0};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+  TEST_ASSERT_TRUE(writer.fade(10, 20, rgb(255, 128, 0), 500));
+
+  FrameHeader read;
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, writer.length(), &read, &target));
+  TEST_ASSERT_EQUAL_UINT8(1, target.fadeCount);
+  TEST_ASSERT_EQUAL_UINT16(10, fades[0].start);
+  TEST_ASSERT_EQUAL_UINT16(20, fades[0].count);
+  TEST_ASSERT_EQUAL_UINT16(500, fades[0].durationMs);
+  TEST_ASSERT_TRUE(pixels[29] == rgb(255, 128, 0));
+}
+
+static void test_invalid_packet_writes_nothing(void)
+{
+  FrameHeader header = {FRAME_FLAG_LAST, 0, 0};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+  TEST_ASSERT_TRUE(writer.fill(0, 10, rgb(1, 2, 3)));
+  size_t len = writer.length();
+  packet[len++] = 0x7F; // Unknown opcode after a valid record
+  packet[len++] = 0;
+  packet[len++] = 1;
+
+  FrameHeader read;
+  TEST_ASSERT_EQUAL(FRAME_BAD_RECORD, decodeFrame(packet, len, &read, &target));
+  TEST_ASSERT_TRUE(pixels[0] == rgb(0, 0, 0));
+
+  TEST_ASSERT_EQUAL(FRAME_TRUNCATED, decodeFrame(packet, FRAME_HEADER_SIZE + 2, &read, &target));
+  TEST_ASSERT_TRUE(pixels[0] == rgb(0, 0, 0));
+}
+
+static void test_window_clips_records(void)
+{
+  FrameHeader header = {FRAME_FLAG_LAST, 0, 0};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+  TEST_ASSERT_TRUE(writer.fill(0, 100, rgb(7, 7, 7)));
+  target.windowStart = 40;
+  target.windowCount = 20;
+
+  FrameHeader read;
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, writer.length(), &read, &target));
+  TEST_ASSERT_TRUE(pixels[39] == rgb(0, 0, 0));
+  TEST_ASSERT_TRUE(pixels[40] == rgb(7, 7, 7));
+  TEST_ASSERT_TRUE(pixels[59] == rgb(7, 7, 7));
+  TEST_ASSERT_TRUE(pixels[60] == rgb(0, 0, 0));
+}
+
+static void test_writer_refuses_what_does_not_fit(void)
+{
+  FrameHeader header = {0, 0, 0};
+  FrameWriter writer(packet, FRAME_HEADER_SIZE + 6);
+  writer.begin(header);
+  TEST_ASSERT_FALSE(writer.fill(0, 0, rgb(1, 1, 1)));   // Empty run
+  TEST_ASSERT_FALSE(writer.fill(250, 10, rgb(1, 1, 1))); // Past pixel 255 in a narrow packet
+  TEST_ASSERT_TRUE(writer.fill(0, 10, rgb(1, 1, 1)));
+  TEST_ASSERT_FALSE(writer.fill(10, 10, rgb(1, 1, 1))); // Full
+  TEST_ASSERT_EQUAL(FRAME_HEADER_SIZE + 6, writer.length());
+}
+
+static void test_commit_round_trip(void)
+{
+  FrameHeader header = {FRAME_FLAG_COMMIT, 9, 300};
+  FrameCommit commit = {0xDEADBEEF, 250};
+  size_t len = writeCommit(packet, sizeof(packet), header, commit);
+  TEST_ASSERT_EQUAL(FRAME_COMMIT_SIZE, len);
+  TEST_ASSERT_EQUAL_UINT8(FRAME_VERSION, packet[1]);
+
+  FrameHeader readHeader;
+  FrameCommit read;
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeCommit(packet, len, &readHeader, &read));
+  TEST_ASSERT_EQUAL_UINT8(9, readHeader.frameId);
+  TEST_ASSERT_EQUAL_UINT32(0xDEADBEEF, read.senderTime);
+  TEST_ASSERT_EQUAL_UINT16(250, read.latchDelayMs);
+
+  TEST_ASSERT_EQUAL(FRAME_IS_COMMIT, decodeFrame(packet, len, &readHeader, &target));
+  TEST_ASSERT_EQUAL(FRAME_TRUNCATED, decodeCommit(packet, len - 1, &readHeader, &read));
+  TEST_ASSERT_EQUAL(0, writeCommit(packet, FRAME_COMMIT_SIZE - 1, header, commit));
+}
+
+static void test_encode_keyframe_then_delta(void)
+{
+  static RGB frame[FRAME_NARROW_PIXELS];
+  static RGB previous[FRAME_NARROW_PIXELS];
+  for (int i = 0; i < FRAME_NARROW_PIXELS; i++)
+  {
+    frame[i] = rgb(i, 255 - i, i / 2);
+  }
+
+  // Keyframe, as many packets as it takes
+  FrameHeader header = {0, 1, 0};
+  uint16_t done = 0;
+  while (done < FRAME_NARROW_PIXELS)
+  {
+    uint16_t consumed;
+    size_t len = encodeFrame(packet, sizeof(packet), header, frame, NULL, done, FRAME_NARROW_PIXELS - done,
+                             &consumed);
+    TEST_ASSERT_GREATER_THAN(0, consumed);
+    FrameHeader read;
+    TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, len, &read, &target));
+    TEST_ASSERT_TRUE((read.flags & FRAME_FLAG_KEYFRAME) != 0);
+    TEST_ASSERT_EQUAL(done + consumed == FRAME_NARROW_PIXELS, (read.flags & FRAME_FLAG_LAST) != 0);
+    done += consumed;
+    header.sequence++;
+  }
+  TEST_ASSERT_EQUAL_MEMORY(frame, pixels, sizeof(frame));
+
+  // One changed pixel is one small delta packet
+  memcpy(previous, frame, sizeof(frame));
+  frame[77] = rgb(1, 2, 3);
+  uint16_t consumed;
+  size_t len = encodeFrame(packet, sizeof(packet), header, frame, previous, 0, FRAME_NARROW_PIXELS, &consumed);
+  TEST_ASSERT_EQUAL(FRAME_NARROW_PIXELS, consumed);
+  TEST_ASSERT_LESS_OR_EQUAL(FRAME_HEADER_SIZE + 6, len);
+  FrameHeader read;
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, len, &read, &target));
+  TEST_ASSERT_FALSE((read.flags & FRAME_FLAG_KEYFRAME) != 0);
+  TEST_ASSERT_EQUAL_MEMORY(frame, pixels, sizeof(frame));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_header_round_trip);
+  RUN_TEST(test_version_is_the_lowest_that_reads_the_packet);
+  RUN_TEST(test_bad_headers_are_rejected);
+  RUN_TEST(test_records_decode);
+  RUN_TEST(test_fade_records_reach_the_target);
+  RUN_TEST(test_invalid_packet_writes_nothing);
+  RUN_TEST(test_window_clips_records);
+  RUN_TEST(test_writer_refuses_what_does_not_fit);
+  RUN_TEST(test_commit_round_trip);
+  RUN_TEST(test_encode_keyframe_then_delta);
+  return UNITY_END();
+}
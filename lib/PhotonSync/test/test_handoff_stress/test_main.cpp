@@ -0,0 +1,172 @@
+#include <unity.h>
+#include <atomic>
+#include <string.h>
+#include <thread>
+#include "TripleBuffer.h"
+#include "TxRing.h"
+
+// The lock-free handoffs with a real thread on each side, as on the ESP32
+// with the WiFi task and the render task or loop() and the send callback.
+// Build with -fsanitize=thread to have every access checked as well.
+
+#define STRESS_FRAMES 200000
+#define STRESS_PACKETS 200000
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// Every word holds the frame number, a torn read shows as a mismatch
+typedef struct
+{
+  uint32_t words[256];
+} Frame;
+
+static void test_triple_buffer_never_tears(void)
+{
+  static TripleBuffer<Frame> frames;
+  std::atomic<bool> done(false);
+
+  std::thread producer([&done] {
+    for (uint32_t n = 1; n <= STRESS_FRAMES; n++)
+    {
+      Frame &frame = frames.writeBuffer();
+      for (int i = 0; i < 256; i++)
+      {
+        frame.words[i] = n;
+      }
+      frames.publish();
+    }
+    done.store(true);
+  });
+
+  uint32_t last = 0;
+  uint32_t taken = 0;
+  bool torn = false;
+  bool backwards = false;
+  for (;;)
+  {
+    bool finished = done.load(); // Before update(), so the last frame is taken
+    if (frames.update())
+    {
+      const Frame &frame = frames.readBuffer();
+      uint32_t n = frame.words[0];
+      for (int i = 1; i < 256; i++)
+      {
+        torn = torn || frame.words[i] != n;
+      }
+      backwards = backwards || n <= last;
+      last = n;
+      taken++;
+    }
+    else if (finished)
+    {
+      break;
+    }
+  }
+  producer.join();
+
+  TEST_ASSERT_FALSE(torn);
+  TEST_ASSERT_FALSE(backwards);
+  TEST_ASSERT_EQUAL_UINT32(STRESS_FRAMES, last); // The newest frame always arrives
+  TEST_ASSERT_GREATER_THAN(0, taken);
+}
+
+// The radio: the transport posts the packet, a second thread completes it.
+// Failures are flagged and checked on the main thread, Unity asserts only there.
+static std::atomic<bool> airBusy;
+static std::atomic<bool> overlapped;
+static uint8_t air[FRAME_MAX_PACKET];
+static size_t airLength;
+
+static bool transport(const uint8_t *data, size_t len)
+{
+  if (airBusy.load())
+  {
+    overlapped.store(true); // Only ever one packet may be in the air
+  }
+  memcpy(air, data, len);
+  airLength = len;
+  airBusy.store(true, std::memory_order_release);
+  return true;
+}
+
+static void test_tx_ring_delivers_everything_in_order(void)
+{
+  static TxRing ring(transport);
+  airBusy.store(false);
+  overlapped.store(false);
+  std::atomic<bool> producing(true);
+  uint32_t resends = 0;
+  bool outOfOrder = false;
+  bool badLength = false;
+
+  std::thread radio([&] {
+    uint32_t noise = 1;
+    uint32_t previous = 0xFFFFFFFF;
+    uint32_t expected = 0; // Next new sequence number
+    while (producing.load() || ring.queued() > 0)
+    {
+      if (!airBusy.load(std::memory_order_acquire))
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      uint32_t sequence;
+      memcpy(&sequence, air, sizeof(sequence));
+      badLength = badLength || airLength != sizeof(sequence) + sequence % 16;
+      if (sequence == previous)
+      {
+        resends++;
+      }
+      else
+      {
+        outOfOrder = outOfOrder || sequence != expected;
+        expected = sequence + 1;
+      }
+      previous = sequence;
+
+      noise = noise * 1664525 + 1013904223;
+      airBusy.store(false);
+      ring.onSent(noise >> 28 != 0); // One in sixteen is not acknowledged
+    }
+  });
+
+  uint8_t packet[sizeof(uint32_t) + 16];
+  memset(packet, 0, sizeof(packet));
+  for (uint32_t sequence = 0; sequence < STRESS_PACKETS;)
+  {
+    memcpy(packet, &sequence, sizeof(sequence));
+    if (ring.push(packet, sizeof(sequence) + sequence % 16))
+    {
+      sequence++;
+    }
+    else
+    {
+      ring.kick();
+      std::this_thread::yield();
+    }
+  }
+  producing.store(false);
+  radio.join();
+
+  TEST_ASSERT_FALSE(overlapped.load());
+  TEST_ASSERT_FALSE(outOfOrder);
+  TEST_ASSERT_FALSE(badLength);
+  TEST_ASSERT_EQUAL_UINT32(STRESS_PACKETS, ring.delivered() + ring.failed());
+  TEST_ASSERT_EQUAL_UINT32(resends, ring.retried());
+  TEST_ASSERT_GREATER_THAN(0, ring.failed()); // Some failed twice
+  TEST_ASSERT_EQUAL(0, ring.queued());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_triple_buffer_never_tears);
+  RUN_TEST(test_tx_ring_delivers_everything_in_order);
+  return UNITY_END();
+}
@@ -0,0 +1,89 @@
+#include <unity.h>
+#include "IdleAnimation.h"
+
+// The idle envelope on a simulated millis() clock
+
+#define HOLD_MS 1000
+#define FADE_MS 500
+#define OFF_MS 250
+#define PERIOD_MS (HOLD_MS + FADE_MS + OFF_MS + FADE_MS)
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_envelope_phases(void)
+{
+  IdleAnimation idle(HOLD_MS, FADE_MS, OFF_MS);
+  TEST_ASSERT_FALSE(idle.active());
+  idle.start(10000);
+  TEST_ASSERT_TRUE(idle.active());
+
+  TEST_ASSERT_EQUAL_UINT8(255, idle.brightness(10000));
+  TEST_ASSERT_EQUAL_UINT8(255, idle.brightness(10000 + HOLD_MS - 1));
+  TEST_ASSERT_EQUAL_UINT8(255, idle.brightness(10000 + HOLD_MS));               // Fade out starts
+  TEST_ASSERT_UINT32_WITHIN(1, 128, idle.brightness(10000 + HOLD_MS + FADE_MS / 2));
+  TEST_ASSERT_EQUAL_UINT8(0, idle.brightness(10000 + HOLD_MS + FADE_MS));       // Off
+  TEST_ASSERT_EQUAL_UINT8(0, idle.brightness(10000 + HOLD_MS + FADE_MS + OFF_MS)); // Fade in starts
+  TEST_ASSERT_UINT32_WITHIN(1, 127, idle.brightness(10000 + PERIOD_MS - FADE_MS / 2));
+  TEST_ASSERT_EQUAL_UINT8(255, idle.brightness(10000 + PERIOD_MS)); // Next period
+
+  idle.stop();
+  TEST_ASSERT_FALSE(idle.active());
+}
+
+static void test_fades_are_monotonic(void)
+{
+  IdleAnimation idle(HOLD_MS, FADE_MS, OFF_MS);
+  idle.start(0);
+  for (unsigned long t = HOLD_MS + 1; t < HOLD_MS + FADE_MS; t++)
+  {
+    TEST_ASSERT_LESS_OR_EQUAL(idle.brightness(t - 1), idle.brightness(t));
+  }
+  for (unsigned long t = HOLD_MS + FADE_MS + OFF_MS + 1; t < PERIOD_MS; t++)
+  {
+    TEST_ASSERT_GREATER_OR_EQUAL(idle.brightness(t - 1), idle.brightness(t));
+  }
+}
+
+static void test_brightness_depends_only_on_time(void)
+{
+  // A loop that ticks every millisecond and one that stalls for 37 ms at a
+  // time see the same brightness whenever they ask at the same moment
+  IdleAnimation idle(HOLD_MS, FADE_MS, OFF_MS);
+  idle.start(500);
+  uint8_t dense[3 * PERIOD_MS];
+  for (unsigned long t = 0; t < 3 * PERIOD_MS; t++)
+  {
+    dense[t] = idle.brightness(500 + t);
+  }
+  for (unsigned long t = 0; t < 3 * PERIOD_MS; t += 37)
+  {
+    TEST_ASSERT_EQUAL_UINT8(dense[t], idle.brightness(500 + t));
+  }
+  TEST_ASSERT_EQUAL_UINT8(dense[123], idle.brightness(500 + 123 + 2 * PERIOD_MS));
+}
+
+static void test_millis_wraps(void)
+{
+  IdleAnimation idle(HOLD_MS, FADE_MS, OFF_MS);
+  unsigned long start = (unsigned long)0 - 200; // 200 ms before millis() wraps
+  idle.start(start);
+  TEST_ASSERT_EQUAL_UINT8(255, idle.brightness(start + 150));
+  TEST_ASSERT_EQUAL_UINT8(255, idle.brightness(start + 250)); // After the wrap
+  TEST_ASSERT_UINT32_WITHIN(1, 128, idle.brightness(start + HOLD_MS + FADE_MS / 2));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_envelope_phases);
+  RUN_TEST(test_fades_are_monotonic);
+  RUN_TEST(test_brightness_depends_only_on_time);
+  RUN_TEST(test_millis_wraps);
+  return UNITY_END();
+}
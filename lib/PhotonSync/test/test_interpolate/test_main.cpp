@@ -0,0 +1,191 @@
+#include <unity.h>
+#include <string.h>
+#include "FrameComposer.h"
+#include "Interpolate.h"
+
+// The fade kernel and the receiver's fades on a simulated millis() clock
+
+static FrameBuffer frame;
+
+void setUp(void)
+{
+  memset(&frame, 0, sizeof(frame));
+}
+
+void tearDown(void)
+{
+}
+
+static void test_channel_endpoints_are_exact(void)
+{
+  const uint16_t durations[] = {1, 7, 50, 1000, 65535};
+  for (int d = 0; d < 5; d++)
+  {
+    for (int from = 0; from < 256; from += 15)
+    {
+      for (int to = 0; to < 256; to += 17)
+      {
+        TEST_ASSERT_EQUAL_UINT8(from, lerpChannel(from, to, 0, durations[d]));
+        TEST_ASSERT_EQUAL_UINT8(to, lerpChannel(from, to, durations[d], durations[d]));
+        TEST_ASSERT_EQUAL_UINT8(to, lerpChannel(from, to, durations[d] + 1000, durations[d]));
+      }
+    }
+  }
+  // A zero duration is already finished
+  TEST_ASSERT_EQUAL_UINT8(200, lerpChannel(10, 200, 0, 0));
+}
+
+static void test_channel_is_monotonic(void)
+{
+  const uint16_t durations[] = {3, 50, 255, 256, 1000, 65535};
+  const uint8_t pairs[][2] = {{0, 255}, {255, 0}, {10, 11}, {11, 10}, {100, 100}, {37, 201}};
+  for (int d = 0; d < 6; d++)
+  {
+    for (int p = 0; p < 6; p++)
+    {
+      uint8_t from = pairs[p][0];
+      uint8_t to = pairs[p][1];
+      uint8_t last = from;
+      for (uint32_t t = 1; t <= durations[d]; t++)
+      {
+        uint8_t value = lerpChannel(from, to, t, durations[d]);
+        if (to >= from)
+        {
+          TEST_ASSERT_GREATER_OR_EQUAL(last, value);
+          TEST_ASSERT_LESS_OR_EQUAL(to, value);
+        }
+        else
+        {
+          TEST_ASSERT_LESS_OR_EQUAL(last, value);
+          TEST_ASSERT_GREATER_OR_EQUAL(to, value);
+        }
+        last = value;
+      }
+      TEST_ASSERT_EQUAL_UINT8(to, last);
+    }
+  }
+}
+
+static void test_old_step_fade_fell_short(void)
+{
+  // sendFade stepped by (end - start) / steps and never reached the end colour
+  uint8_t start = 0;
+  uint8_t end = 255;
+  int steps = 50;
+  int step = (end - start) / steps;
+  TEST_ASSERT_EQUAL(250, start + step * steps);
+
+  RGB from = {0, 0, 0};
+  RGB to = {255, 100, 3};
+  RGB reached = lerpColor(from, to, 500, 500);
+  TEST_ASSERT_TRUE(reached == to);
+}
+
+static void test_fader_runs_from_shown_to_target(void)
+{
+  FrameComposer composer;
+  const RGB red = {255, 0, 0};
+  const RGB blue = {0, 0, 255};
+  for (int i = 0; i < 10; i++)
+  {
+    frame.pixels[i] = red;
+  }
+  composer.compose(frame, true, 0, 0);
+  TEST_ASSERT_TRUE(composer.shown()[5] == red);
+
+  // The frame holds the target, the fade starts from what is shown
+  FadeCommand fade = {2, 6, blue, 400};
+  for (int i = 2; i < 8; i++)
+  {
+    frame.pixels[i] = blue;
+  }
+  frame.fades[0] = fade;
+  frame.fadeCount = 1;
+  composer.compose(frame, true, 1000, 1000);
+  TEST_ASSERT_TRUE(composer.animating());
+  TEST_ASSERT_TRUE(composer.shown()[2] == red);
+  TEST_ASSERT_TRUE(composer.shown()[1] == red); // Outside the fade
+  TEST_ASSERT_TRUE(composer.shown()[8] == red);
+
+  frame.fadeCount = 0;
+  uint8_t lastRed = 255;
+  for (unsigned long now = 1001; now < 1400; now += 7)
+  {
+    composer.compose(frame, false, now, 0);
+    const RGB &pixel = composer.shown()[4];
+    TEST_ASSERT_LESS_OR_EQUAL(lastRed, pixel.red);
+    TEST_ASSERT_EQUAL_UINT8(255 - pixel.red, pixel.blue);
+    lastRed = pixel.red;
+  }
+  composer.compose(frame, false, 1400, 0);
+  TEST_ASSERT_TRUE(composer.shown()[4] == blue);
+  TEST_ASSERT_FALSE(composer.animating());
+}
+
+static void test_fade_waits_for_its_latch_time(void)
+{
+  FrameComposer composer;
+  const RGB white = {255, 255, 255};
+  FadeCommand fade = {0, 1, white, 100};
+  frame.pixels[0] = white;
+  frame.fades[0] = fade;
+  frame.fadeCount = 1;
+  composer.compose(frame, true, 500, 600); // Latched 100 ms ahead
+  TEST_ASSERT_EQUAL_UINT8(0, composer.shown()[0].red);
+  frame.fadeCount = 0;
+  composer.compose(frame, false, 599, 0);
+  TEST_ASSERT_EQUAL_UINT8(0, composer.shown()[0].red);
+  composer.compose(frame, false, 650, 0);
+  TEST_ASSERT_UINT32_WITHIN(1, 127, composer.shown()[0].red);
+  composer.compose(frame, false, 700, 0);
+  TEST_ASSERT_TRUE(composer.shown()[0] == white);
+}
+
+static void test_later_frame_wins_over_fade(void)
+{
+  FrameComposer composer;
+  const RGB green = {0, 255, 0};
+  const RGB other = {9, 9, 9};
+  FadeCommand fade = {0, 2, green, 1000};
+  frame.pixels[0] = green;
+  frame.pixels[1] = green;
+  frame.fades[0] = fade;
+  frame.fadeCount = 1;
+  composer.compose(frame, true, 0, 0);
+
+  frame.fadeCount = 0;
+  frame.pixels[1] = other; // Set to something else mid-fade
+  composer.compose(frame, true, 500, 500);
+  TEST_ASSERT_UINT32_WITHIN(1, 127, composer.shown()[0].green);
+  TEST_ASSERT_TRUE(composer.shown()[1] == other);
+}
+
+static void test_millis_wraps_mid_fade(void)
+{
+  FrameComposer composer;
+  const RGB white = {255, 255, 255};
+  FadeCommand fade = {0, 1, white, 200};
+  unsigned long start = (unsigned long)0 - 100;
+  frame.pixels[0] = white;
+  frame.fades[0] = fade;
+  frame.fadeCount = 1;
+  composer.compose(frame, true, start, start);
+  frame.fadeCount = 0;
+  composer.compose(frame, false, start + 100, 0); // millis() is 0 again
+  TEST_ASSERT_UINT32_WITHIN(1, 127, composer.shown()[0].red);
+  composer.compose(frame, false, start + 200, 0);
+  TEST_ASSERT_TRUE(composer.shown()[0] == white);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_channel_endpoints_are_exact);
+  RUN_TEST(test_channel_is_monotonic);
+  RUN_TEST(test_old_step_fade_fell_short);
+  RUN_TEST(test_fader_runs_from_shown_to_target);
+  RUN_TEST(test_fade_waits_for_its_latch_time);
+  RUN_TEST(test_later_frame_wins_over_fade);
+  RUN_TEST(test_millis_wraps_mid_fade);
+  return UNITY_END();
+}
@@ -0,0 +1,197 @@
+#include <unity.h>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "FramePacker.h"
+#include "FrameReceiver.h"
+
+// Several receivers hearing one sender's broadcast with jittered delivery,
+// each on its own drifting clock. Measures, in true time, how far apart the
+// receivers show the same frame: with latched frames at the latch time the
+// COMMIT gives, and without, as soon as the frame's last packet arrives.
+
+#define RECEIVERS 6
+#define FRAME_PIXELS 300
+#define FRAMES 900          // 30 s at 30 frames/s
+#define FRAME_INTERVAL_US 33333
+#define LATCH_MS 40
+#define LOSS_PERCENT 2
+
+static const uint8_t SENDER_MAC[6] = {3, 3, 3, 3, 3, 3};
+
+typedef struct
+{
+  std::vector<uint8_t> data;
+  double sentAt; // True time in microseconds
+  int frame;     // Sender frame number the packet belongs to
+} SentPacket;
+
+static std::vector<SentPacket> sent;
+static double senderTrueNow;
+static int senderFrame;
+static uint32_t noise;
+
+static uint32_t random32()
+{
+  noise = noise * 1664525 + 1013904223;
+  return noise >> 8;
+}
+
+static double uniform()
+{
+  return (random32() & 0xFFFFFF) / (double)0x1000000;
+}
+
+// Transit plus the WiFi task's callback delay: mostly a few hundred
+// microseconds, with a long tail when the receiver is busy
+static double deliveryDelay()
+{
+  double delay = 250 + 400 * uniform();
+  if (random32() % 10 == 0)
+  {
+    delay += -3000 * log(1 - uniform());
+  }
+  return delay;
+}
+
+static uint32_t senderMicros()
+{
+  return (uint32_t)(int64_t)(senderTrueNow + 4000000000.0); // Wraps during the run
+}
+
+static uint8_t buffer[DATASIZE];
+
+static uint8_t *reservePacket()
+{
+  return buffer;
+}
+
+static void sendPacket(size_t len)
+{
+  SentPacket packet;
+  packet.data.assign(buffer, buffer + len);
+  packet.sentAt = senderTrueNow;
+  packet.frame = senderFrame;
+  sent.push_back(packet);
+  senderTrueNow += 300; // Air time
+}
+
+static const PacketSink capture = {reservePacket, sendPacket};
+
+static double percentile(std::vector<double> values, double p)
+{
+  std::sort(values.begin(), values.end());
+  return values[(size_t)(p * (values.size() - 1))];
+}
+
+void setUp(void)
+{
+  sent.clear();
+  senderTrueNow = 0;
+  noise = 1;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_latch_spread_across_receivers(void)
+{
+  static RGB frame[FRAME_PIXELS];
+  FramePacker packer(capture, 10);
+  packer.setLatch(LATCH_MS, senderMicros);
+  for (senderFrame = 0; senderFrame < FRAMES; senderFrame++)
+  {
+    senderTrueNow = senderFrame * (double)FRAME_INTERVAL_US;
+    for (int i = 0; i < FRAME_PIXELS; i += 7)
+    {
+      frame[(i + senderFrame) % FRAME_PIXELS].red++;
+    }
+    packer.set(0, frame, FRAME_PIXELS, (unsigned long)(senderTrueNow / 1000));
+    TEST_ASSERT_TRUE(packer.flush());
+  }
+
+  // Every receiver hears the whole stream on its own clock, in order
+  static std::vector<double> latchedAt[RECEIVERS];   // True time each frame is shown, latched
+  static std::vector<double> arrivedAt[RECEIVERS];   // True time it would be shown on arrival
+  for (int r = 0; r < RECEIVERS; r++)
+  {
+    latchedAt[r].assign(FRAMES, -1);
+    arrivedAt[r].assign(FRAMES, -1);
+    FrameReceiver *receiver = new FrameReceiver();
+    double offset = 1e9 * (r + 1) / 7; // Unrelated clocks
+    double rate = 1 + (r - 2.5) * 20e-6; // +-50 ppm crystals
+    double last = 0;
+    for (size_t p = 0; p < sent.size(); p++)
+    {
+      if (random32() % 100 < LOSS_PERCENT)
+      {
+        continue;
+      }
+      double trueAt = std::max(last, sent[p].sentAt + deliveryDelay());
+      last = trueAt;
+      uint32_t local = (uint32_t)(int64_t)(offset + trueAt * rate);
+      const uint8_t *data = &sent[p].data[0];
+      FrameHeader header;
+      readFrameHeader(data, sent[p].data.size(), &header);
+      if ((header.flags & FRAME_FLAG_LAST) && arrivedAt[r][sent[p].frame] < 0)
+      {
+        arrivedAt[r][sent[p].frame] = trueAt + 2000 * uniform(); // Until loop() notices newData
+      }
+      receiver->receive(SENDER_MAC, data, sent[p].data.size(), local, local / 1000);
+      if (receiver->takeFrame() && receiver->frame().latched)
+      {
+        // Back from the receiver's clock to true time
+        double latchLocal = offset + trueAt * rate + (int32_t)(receiver->frame().latchAt - local);
+        latchedAt[r][sent[p].frame] = (latchLocal - offset) / rate;
+        TEST_ASSERT_GREATER_THAN(0, latchWait(receiver->frame(), local)); // Still ahead when it arrives
+      }
+    }
+    delete receiver;
+  }
+
+  std::vector<double> latchSpread;
+  std::vector<double> arrivalSpread;
+  for (int f = CLOCK_SYNC_SAMPLES; f < FRAMES; f++)
+  {
+    double latchMin = 1e18, latchMax = -1e18, arriveMin = 1e18, arriveMax = -1e18;
+    bool all = true;
+    for (int r = 0; r < RECEIVERS; r++)
+    {
+      all = all && latchedAt[r][f] >= 0 && arrivedAt[r][f] >= 0;
+      latchMin = std::min(latchMin, latchedAt[r][f]);
+      latchMax = std::max(latchMax, latchedAt[r][f]);
+      arriveMin = std::min(arriveMin, arrivedAt[r][f]);
+      arriveMax = std::max(arriveMax, arrivedAt[r][f]);
+    }
+    if (all)
+    {
+      latchSpread.push_back(latchMax - latchMin);
+      arrivalSpread.push_back(arriveMax - arriveMin);
+    }
+  }
+
+  char line[160];
+  snprintf(line, sizeof(line), "%u frames on all %d receivers, spread median / p99 / max in us", (unsigned)latchSpread.size(),
+           RECEIVERS);
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line), "  shown on arrival  %8.0f %8.0f %8.0f", percentile(arrivalSpread, 0.5),
+           percentile(arrivalSpread, 0.99), percentile(arrivalSpread, 1));
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line), "  latched           %8.0f %8.0f %8.0f", percentile(latchSpread, 0.5),
+           percentile(latchSpread, 0.99), percentile(latchSpread, 1));
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_GREATER_THAN(FRAMES * 3 / 4, latchSpread.size()); // A lost COMMIT costs a frame, rarely
+  TEST_ASSERT_LESS_THAN(1000, percentile(latchSpread, 0.99));     // Within one LED refresh
+  TEST_ASSERT_LESS_THAN(percentile(arrivalSpread, 0.5) / 2, percentile(latchSpread, 0.5));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_latch_spread_across_receivers);
+  return UNITY_END();
+}
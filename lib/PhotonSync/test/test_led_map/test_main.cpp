@@ -0,0 +1,151 @@
+#include <unity.h>
+#include <string.h>
+#include "LedMap.h"
+
+// Span tables for the layouts config.json can describe
+
+static LedSpan spans[MAX_NUM_LED];
+static uint16_t ledPixel[MAX_NUM_LED];
+
+void setUp(void)
+{
+  memset(spans, 0, sizeof(spans));
+}
+
+void tearDown(void)
+{
+}
+
+// Build the map, check the spans cover every LED once in order, and expand
+// them into ledPixel
+static uint16_t build(const LedLayout &layout)
+{
+  uint16_t count = buildLedMap(layout, spans, MAX_NUM_LED);
+  uint16_t next = 0;
+  for (uint16_t s = 0; s < count; s++)
+  {
+    TEST_ASSERT_EQUAL_UINT16(next, spans[s].firstLed);
+    TEST_ASSERT_GREATER_THAN(0, spans[s].count);
+    if (s > 0)
+    {
+      TEST_ASSERT_TRUE(spans[s].pixel != spans[s - 1].pixel); // Neighbours are merged
+    }
+    for (uint16_t i = 0; i < spans[s].count; i++)
+    {
+      ledPixel[next++] = spans[s].pixel;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT16(layout.ledCount, next);
+  return count;
+}
+
+static void test_even_split(void)
+{
+  LedLayout layout = {8, 10, 4, NULL, 0, false, 0};
+  TEST_ASSERT_EQUAL_UINT16(4, build(layout));
+  const uint16_t expected[] = {10, 10, 11, 11, 12, 12, 13, 13};
+  TEST_ASSERT_EQUAL_MEMORY(expected, ledPixel, sizeof(expected));
+}
+
+static void test_uneven_split_reaches_the_end(void)
+{
+  // The old mapLED left the trailing 10 % 4 LEDs unmapped
+  LedLayout layout = {10, 0, 4, NULL, 0, false, 0};
+  build(layout);
+  const uint16_t expected[] = {0, 0, 0, 1, 1, 1, 2, 2, 3, 3};
+  TEST_ASSERT_EQUAL_MEMORY(expected, ledPixel, sizeof(expected));
+
+  for (uint16_t leds = 1; leds <= 300; leds += 7)
+  {
+    for (uint16_t pixels = 1; pixels <= 64; pixels += 3)
+    {
+      LedLayout odd = {leds, 0, pixels, NULL, 0, false, 0};
+      build(odd);
+      uint16_t last = 0;
+      for (uint16_t led = 0; led < leds; led++)
+      {
+        TEST_ASSERT_TRUE(ledPixel[led] != LED_UNMAPPED);
+        TEST_ASSERT_GREATER_OR_EQUAL(last, ledPixel[led]);
+        last = ledPixel[led];
+      }
+      TEST_ASSERT_EQUAL_UINT16((pixels < leds ? pixels : leds) - 1, last); // More pixels than LEDs drops the rest
+    }
+  }
+}
+
+static void test_segments(void)
+{
+  const uint16_t segments[] = {3, 1, 2};
+  LedLayout layout = {8, 5, 3, segments, 3, false, 0};
+  TEST_ASSERT_EQUAL_UINT16(4, build(layout));
+  const uint16_t expected[] = {5, 5, 5, 6, 7, 7, LED_UNMAPPED, LED_UNMAPPED}; // Past the last segment stays dark
+  TEST_ASSERT_EQUAL_MEMORY(expected, ledPixel, sizeof(expected));
+}
+
+static void test_reverse(void)
+{
+  LedLayout layout = {7, 0, 3, NULL, 0, true, 0};
+  build(layout);
+  const uint16_t expected[] = {2, 2, 1, 1, 0, 0, 0};
+  TEST_ASSERT_EQUAL_MEMORY(expected, ledPixel, sizeof(expected));
+}
+
+static void test_serpentine(void)
+{
+  // Three rows of four with a short last row; one pixel per LED so the
+  // positions show directly
+  LedLayout layout = {10, 0, 10, NULL, 0, false, 4};
+  build(layout);
+  const uint16_t expected[] = {0, 1, 2, 3, 7, 6, 5, 4, 8, 9};
+  TEST_ASSERT_EQUAL_MEMORY(expected, ledPixel, sizeof(expected));
+
+  LedLayout both = {10, 0, 10, NULL, 0, true, 4};
+  build(both);
+  const uint16_t reversed[] = {9, 8, 4, 5, 6, 7, 3, 2, 1, 0};
+  TEST_ASSERT_EQUAL_MEMORY(reversed, ledPixel, sizeof(reversed));
+}
+
+static void test_no_pixels_is_dark(void)
+{
+  LedLayout layout = {5, 0, 0, NULL, 0, false, 0};
+  TEST_ASSERT_EQUAL_UINT16(1, build(layout));
+  TEST_ASSERT_EQUAL_UINT16(LED_UNMAPPED, spans[0].pixel);
+}
+
+static void test_too_many_spans(void)
+{
+  LedLayout layout = {100, 0, 100, NULL, 0, false, 0};
+  TEST_ASSERT_EQUAL_UINT16(0, buildLedMap(layout, spans, 99));
+  TEST_ASSERT_EQUAL_UINT16(100, buildLedMap(layout, spans, 100));
+}
+
+static void test_longest_strip(void)
+{
+  LedLayout layout = {MAX_NUM_LED, 0, 600, NULL, 0, true, 32};
+  TEST_ASSERT_GREATER_THAN(0, build(layout));
+  uint16_t seen[600];
+  memset(seen, 0, sizeof(seen));
+  for (uint16_t led = 0; led < MAX_NUM_LED; led++)
+  {
+    TEST_ASSERT_LESS_THAN(600, ledPixel[led]);
+    seen[ledPixel[led]]++;
+  }
+  for (int p = 0; p < 600; p++)
+  {
+    TEST_ASSERT_TRUE(seen[p] == 3 || seen[p] == 4); // 2048 / 600 rounded both ways
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_even_split);
+  RUN_TEST(test_uneven_split_reaches_the_end);
+  RUN_TEST(test_segments);
+  RUN_TEST(test_reverse);
+  RUN_TEST(test_serpentine);
+  RUN_TEST(test_no_pixels_is_dark);
+  RUN_TEST(test_too_many_spans);
+  RUN_TEST(test_longest_strip);
+  return UNITY_END();
+}
@@ -0,0 +1,144 @@
+#include <unity.h>
+#include <string.h>
+#include "LedMap.h"
+#include "LedOutputs.h"
+
+// How the LED buffer is split over the strips, and the show time model the
+// receiver prints at boot. The RMT translator itself needs the ESP-IDF driver
+// and is not covered here.
+
+static LedOutput outputs[MAX_OUTPUTS];
+
+void setUp(void)
+{
+  memset(outputs, 0, sizeof(outputs));
+}
+
+void tearDown(void)
+{
+}
+
+// Every LED of the buffer belongs to exactly one output, in order
+static void assertContiguous(uint8_t count, uint16_t leds)
+{
+  uint16_t next = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT16(next, outputs[i].firstLed);
+    TEST_ASSERT_GREATER_THAN(0, outputs[i].count);
+    next += outputs[i].count;
+  }
+  TEST_ASSERT_EQUAL_UINT16(leds, next);
+  TEST_ASSERT_EQUAL_UINT16(leds, totalLeds(outputs, count));
+}
+
+static void test_strips_are_laid_end_to_end(void)
+{
+  const uint8_t pins[] = {23, 22, 21};
+  const uint16_t counts[] = {100, 50, 150};
+  TEST_ASSERT_EQUAL_UINT8(3, planOutputs(pins, counts, 3, MAX_NUM_LED, outputs));
+  assertContiguous(3, 300);
+  TEST_ASSERT_EQUAL_UINT8(22, outputs[1].pin);
+  TEST_ASSERT_EQUAL_UINT16(100, outputs[1].firstLed);
+  TEST_ASSERT_EQUAL_UINT16(150, outputs[2].firstLed);
+}
+
+static void test_strips_past_the_buffer_are_cut(void)
+{
+  const uint8_t pins[] = {1, 2, 3, 4};
+  const uint16_t counts[] = {1000, 1000, 1000, 1000};
+  TEST_ASSERT_EQUAL_UINT8(3, planOutputs(pins, counts, 4, MAX_NUM_LED, outputs));
+  assertContiguous(3, MAX_NUM_LED);
+  TEST_ASSERT_EQUAL_UINT16(MAX_NUM_LED - 2000, outputs[2].count);
+}
+
+static void test_empty_strips_are_skipped(void)
+{
+  const uint8_t pins[] = {1, 2, 3};
+  const uint16_t counts[] = {0, 60, 0};
+  TEST_ASSERT_EQUAL_UINT8(1, planOutputs(pins, counts, 3, MAX_NUM_LED, outputs));
+  assertContiguous(1, 60);
+  TEST_ASSERT_EQUAL_UINT8(2, outputs[0].pin);
+}
+
+static void test_at_most_max_outputs(void)
+{
+  uint8_t pins[MAX_OUTPUTS + 2];
+  uint16_t counts[MAX_OUTPUTS + 2];
+  for (uint8_t i = 0; i < MAX_OUTPUTS + 2; i++)
+  {
+    pins[i] = i;
+    counts[i] = 10;
+  }
+  TEST_ASSERT_EQUAL_UINT8(MAX_OUTPUTS, planOutputs(pins, counts, MAX_OUTPUTS + 2, MAX_NUM_LED, outputs));
+  assertContiguous(MAX_OUTPUTS, MAX_OUTPUTS * 10);
+}
+
+static void test_serpentine_rows_span_strips(void)
+{
+  // Two strips of one row each, the second running backwards: its first LED
+  // is the end of the row
+  const uint8_t pins[] = {1, 2};
+  const uint16_t counts[] = {10, 10};
+  uint8_t count = planOutputs(pins, counts, 2, MAX_NUM_LED, outputs);
+  LedLayout layout = {totalLeds(outputs, count), 0, 20, NULL, 0, false, 10};
+  static LedSpan spans[MAX_NUM_LED];
+  uint16_t spanCount = buildLedMap(layout, spans, MAX_NUM_LED);
+  uint16_t ledPixel[20];
+  for (uint16_t s = 0; s < spanCount; s++)
+  {
+    for (uint16_t i = 0; i < spans[s].count; i++)
+    {
+      ledPixel[spans[s].firstLed + i] = spans[s].pixel;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT16(0, ledPixel[outputs[0].firstLed]);
+  TEST_ASSERT_EQUAL_UINT16(19, ledPixel[outputs[1].firstLed]);
+  TEST_ASSERT_EQUAL_UINT16(10, ledPixel[outputs[1].firstLed + outputs[1].count - 1]);
+}
+
+static void test_strip_time(void)
+{
+  // 24 bits of 1.25 us per LED, then the reset
+  TEST_ASSERT_EQUAL_UINT32(LED_RESET_US, stripTimeUs(0));
+  TEST_ASSERT_EQUAL_UINT32(3000 + LED_RESET_US, stripTimeUs(100));
+  TEST_ASSERT_EQUAL_UINT32(61440 + LED_RESET_US, stripTimeUs(2048));
+}
+
+static void test_parallel_strips_take_the_longest(void)
+{
+  const uint8_t pins[] = {1, 2, 3, 4, 5};
+  const uint16_t counts[] = {410, 410, 410, 410, 408};
+  uint8_t count = planOutputs(pins, counts, 5, MAX_NUM_LED, outputs);
+  assertContiguous(count, 2048);
+  uint32_t parallel = frameTimeUs(outputs, count, true);
+  uint32_t serial = frameTimeUs(outputs, count, false);
+  TEST_ASSERT_EQUAL_UINT32(stripTimeUs(410), parallel);
+  TEST_ASSERT_EQUAL_UINT32(4 * stripTimeUs(410) + stripTimeUs(408), serial);
+  // 2048 LEDs: 12.4 ms split over five strips, 61.7 ms one after the other
+  TEST_ASSERT_LESS_THAN(12500, parallel);
+  TEST_ASSERT_GREATER_THAN(61000, serial);
+}
+
+static void test_uneven_strips_are_bound_by_the_longest(void)
+{
+  const uint8_t pins[] = {1, 2, 3};
+  const uint16_t counts[] = {50, 900, 50};
+  uint8_t count = planOutputs(pins, counts, 3, MAX_NUM_LED, outputs);
+  TEST_ASSERT_EQUAL_UINT32(stripTimeUs(900), frameTimeUs(outputs, count, true));
+  TEST_ASSERT_EQUAL_UINT32(0, frameTimeUs(outputs, 0, true));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_strips_are_laid_end_to_end);
+  RUN_TEST(test_strips_past_the_buffer_are_cut);
+  RUN_TEST(test_empty_strips_are_skipped);
+  RUN_TEST(test_at_most_max_outputs);
+  RUN_TEST(test_serpentine_rows_span_strips);
+  RUN_TEST(test_strip_time);
+  RUN_TEST(test_parallel_strips_take_the_longest);
+  RUN_TEST(test_uneven_strips_are_bound_by_the_longest);
+  return UNITY_END();
+}
@@ -0,0 +1,174 @@
+#include <unity.h>
+#include <string.h>
+#include <thread>
+
+#define LOG_MODULE "test"
+#define LOG_LEVEL LOG_LEVEL_INFO
+#include "Log.h"
+
+// Levels, the record ring and the deferred formatter
+
+static LogRecord record;
+static char line[LOG_LINE_MAX];
+static int evaluated;
+
+static int sideEffect(void)
+{
+  return ++evaluated;
+}
+
+// Drop whatever earlier tests left in the shared ring
+static void drainRing(void)
+{
+  while (logRing.take(&record))
+  {
+  }
+}
+
+// The message part of a formatted line, after "time level module: "
+static const char *message(void)
+{
+  logFormat(record, line, sizeof(line));
+  const char *colon = strstr(line, ": ");
+  return colon != NULL ? colon + 2 : line;
+}
+
+void setUp(void)
+{
+  drainRing();
+  evaluated = 0;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_levels_above_the_module_compile_away(void)
+{
+  LOG_DEBUG("%d", sideEffect());
+  TEST_ASSERT_EQUAL(0, evaluated); // Arguments are not evaluated
+  TEST_ASSERT_FALSE(logRing.take(&record));
+
+  LOG_INFO("%d", sideEffect());
+  LOG_ERROR("%d", sideEffect());
+  TEST_ASSERT_EQUAL(2, evaluated);
+  TEST_ASSERT_TRUE(logRing.take(&record));
+  TEST_ASSERT_EQUAL_UINT8(LOG_LEVEL_INFO, record.level);
+  TEST_ASSERT_EQUAL_STRING("test", record.module);
+  TEST_ASSERT_TRUE(logRing.take(&record));
+  TEST_ASSERT_EQUAL_UINT8(LOG_LEVEL_ERROR, record.level);
+  TEST_ASSERT_FALSE(logRing.take(&record));
+}
+
+static void test_line_format(void)
+{
+  LOG_WARN("Dropped %u frames, rssi %d, %s at %.1f%%", 3u, -71, "rx", 12.5f);
+  TEST_ASSERT_TRUE(logRing.take(&record));
+  TEST_ASSERT_EQUAL_STRING("Dropped 3 frames, rssi -71, rx at 12.5%\n", message());
+  TEST_ASSERT_TRUE(strstr(line, " W test: ") == line + 10); // After the 10 digit time
+}
+
+static void test_widths_and_bad_arguments(void)
+{
+  LOG_INFO("[%5u|%-4d|%04X|%c]", 42u, -7, 0xBEEFu, 'x');
+  TEST_ASSERT_TRUE(logRing.take(&record));
+  TEST_ASSERT_EQUAL_STRING("[   42|-7  |BEEF|x]\n", message());
+
+  // Missing arguments and unknown conversions print a question mark
+  LOG_INFO("%u %s %q", 1u);
+  TEST_ASSERT_TRUE(logRing.take(&record));
+  TEST_ASSERT_EQUAL_STRING("1 ? ?\n", message());
+
+  LOG_INFO("%s", (const char *)NULL);
+  TEST_ASSERT_TRUE(logRing.take(&record));
+  TEST_ASSERT_EQUAL_STRING("?\n", message());
+}
+
+static void test_long_lines_are_cut(void)
+{
+  static const char longText[] = "0123456789012345678901234567890123456789012345678901234567890123456789"
+                                 "0123456789012345678901234567890123456789012345678901234567890123456789";
+  LOG_INFO("%s%s", longText, longText);
+  TEST_ASSERT_TRUE(logRing.take(&record));
+  size_t length = logFormat(record, line, sizeof(line));
+  TEST_ASSERT_EQUAL(LOG_LINE_MAX - 1, length);
+  TEST_ASSERT_EQUAL_CHAR('\n', line[length - 1]);
+  TEST_ASSERT_EQUAL_CHAR('\0', line[length]);
+
+  char tiny[4];
+  TEST_ASSERT_EQUAL(3, logFormat(record, tiny, sizeof(tiny)));
+  TEST_ASSERT_EQUAL_CHAR('\n', tiny[2]);
+  TEST_ASSERT_EQUAL(0, logFormat(record, tiny, 1));
+  TEST_ASSERT_EQUAL_CHAR('\0', tiny[0]);
+}
+
+static void test_full_ring_counts_drops(void)
+{
+  uint32_t droppedBefore = logRing.dropped();
+  for (uint32_t i = 0; i < LOG_RING_SLOTS + 10; i++)
+  {
+    LOG_INFO("%u", i);
+  }
+  TEST_ASSERT_EQUAL_UINT32(10, logRing.dropped() - droppedBefore);
+  for (uint32_t i = 0; i < LOG_RING_SLOTS; i++)
+  {
+    TEST_ASSERT_TRUE(logRing.take(&record));
+    TEST_ASSERT_EQUAL_UINT32(i, record.args[0].u); // The oldest are kept, in order
+  }
+  TEST_ASSERT_FALSE(logRing.take(&record));
+}
+
+static void produce(uint32_t task)
+{
+  for (uint32_t i = 0; i < 20000; i++)
+  {
+    LOG_INFO("%u %u", task, i);
+  }
+}
+
+static void test_racing_tasks_account_for_every_record(void)
+{
+  // Four tasks log while loop() drains: every record is taken or dropped,
+  // and each task's records are taken in the order it wrote them
+  uint32_t droppedBefore = logRing.dropped();
+  std::thread tasks[4];
+  for (uint32_t t = 0; t < 4; t++)
+  {
+    tasks[t] = std::thread(produce, t);
+  }
+  uint32_t taken = 0;
+  int32_t last[4] = {-1, -1, -1, -1};
+  bool ordered = true;
+  bool running = true;
+  while (running)
+  {
+    running = taken + (logRing.dropped() - droppedBefore) < 80000;
+    while (logRing.take(&record))
+    {
+      uint32_t task = record.args[0].u;
+      int32_t index = (int32_t)record.args[1].u;
+      ordered = ordered && task < 4 && index > last[task];
+      last[task < 4 ? task : 0] = index;
+      taken++;
+    }
+  }
+  for (uint32_t t = 0; t < 4; t++)
+  {
+    tasks[t].join();
+  }
+  TEST_ASSERT_TRUE(ordered);
+  TEST_ASSERT_EQUAL_UINT32(80000, taken + logRing.dropped() - droppedBefore);
+  TEST_ASSERT_GREATER_THAN(0, taken);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_levels_above_the_module_compile_away);
+  RUN_TEST(test_line_format);
+  RUN_TEST(test_widths_and_bad_arguments);
+  RUN_TEST(test_long_lines_are_cut);
+  RUN_TEST(test_full_ring_counts_drops);
+  RUN_TEST(test_racing_tasks_account_for_every_record);
+  return UNITY_END();
+}
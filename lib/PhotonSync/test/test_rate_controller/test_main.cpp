@@ -0,0 +1,123 @@
+#include <unity.h>
+#include "RateController.h"
+#include "FramePacker.h"
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// One window of sends with the given results and frames, returns update()'s verdict
+static bool window(RateController &rate, unsigned long *now, uint32_t *delivered, uint32_t *failed,
+                   uint32_t newDelivered, uint32_t newFailed, int frames, int held)
+{
+  for (int i = 0; i < frames; i++)
+  {
+    rate.frameDone(i < held);
+  }
+  *delivered += newDelivered;
+  *failed += newFailed;
+  *now += RATE_WINDOW_MS;
+  return rate.update(*now, *delivered, *failed);
+}
+
+static void test_starts_uncompressed(void)
+{
+  RateController rate;
+  TEST_ASSERT_EQUAL_UINT8(0, rate.pacing().level);
+  TEST_ASSERT_EQUAL_UINT8(0, rate.pacing().quantizeBits);
+  TEST_ASSERT_EQUAL_UINT16(PACKER_MAX_PIXELS, rate.pacing().batchPixels);
+  TEST_ASSERT_TRUE(rate.clearToSend(0));
+  TEST_ASSERT_FALSE(rate.clearToSend(RATE_MAX_QUEUED + 1));
+}
+
+static void test_loss_raises_the_level(void)
+{
+  RateController rate;
+  unsigned long now = 1000;
+  uint32_t delivered = 0, failed = 0;
+  TEST_ASSERT_FALSE(rate.update(now, delivered, failed)); // Starts the first window
+
+  TEST_ASSERT_FALSE(window(rate, &now, &delivered, &failed, 20, 1, 3, 0)); // 5% is fine
+  TEST_ASSERT_TRUE(window(rate, &now, &delivered, &failed, 20, 5, 3, 0));  // 20% is not
+  TEST_ASSERT_EQUAL_UINT8(1, rate.pacing().level);
+  TEST_ASSERT_EQUAL_UINT8(1, rate.pacing().quantizeBits);
+  TEST_ASSERT_EQUAL_UINT16(PACKER_MAX_PIXELS * 2, rate.pacing().batchPixels);
+
+  TEST_ASSERT_TRUE(window(rate, &now, &delivered, &failed, 20, 5, 3, 0));
+  TEST_ASSERT_FALSE(window(rate, &now, &delivered, &failed, 20, 5, 3, 0)); // Already at the top
+  TEST_ASSERT_EQUAL_UINT8(RATE_MAX_LEVEL, rate.pacing().level);
+}
+
+static void test_held_frames_raise_the_level(void)
+{
+  RateController rate;
+  unsigned long now = 0;
+  uint32_t delivered = 0, failed = 0;
+  rate.update(now, delivered, failed);
+  TEST_ASSERT_TRUE(window(rate, &now, &delivered, &failed, 10, 0, 4, 3));
+  TEST_ASSERT_EQUAL_UINT8(1, rate.pacing().level);
+}
+
+static void test_calm_windows_lower_the_level(void)
+{
+  RateController rate;
+  unsigned long now = 0;
+  uint32_t delivered = 0, failed = 0;
+  rate.update(now, delivered, failed);
+  window(rate, &now, &delivered, &failed, 10, 10, 1, 0);
+  TEST_ASSERT_EQUAL_UINT8(1, rate.pacing().level);
+
+  for (int i = 1; i < RATE_CALM_WINDOWS; i++)
+  {
+    TEST_ASSERT_FALSE(window(rate, &now, &delivered, &failed, 10, 0, 1, 0));
+  }
+  // Idle windows say nothing about the air and do not count
+  TEST_ASSERT_FALSE(window(rate, &now, &delivered, &failed, 0, 0, 0, 0));
+  TEST_ASSERT_TRUE(window(rate, &now, &delivered, &failed, 10, 0, 1, 0));
+  TEST_ASSERT_EQUAL_UINT8(0, rate.pacing().level);
+}
+
+static void test_stalled_loop_starts_a_new_window(void)
+{
+  RateController rate;
+  unsigned long now = 0;
+  uint32_t delivered = 0, failed = 0;
+  rate.update(now, delivered, failed);
+  failed += 100;
+  now += RATE_WINDOW_MS * 10;
+  TEST_ASSERT_FALSE(rate.update(now, delivered, failed));
+  TEST_ASSERT_EQUAL_UINT8(0, rate.pacing().level);
+}
+
+static void test_repairs_are_rate_limited(void)
+{
+  RateController rate;
+  unsigned long now = 0;
+  rate.update(now, 0, 3); // Failures from before the start need no repair
+  TEST_ASSERT_FALSE(rate.repairDue(now));
+
+  now = RATE_REPAIR_MS;
+  rate.update(now, 0, 4);
+  TEST_ASSERT_TRUE(rate.repairDue(now));
+  TEST_ASSERT_FALSE(rate.repairDue(now)); // Once per failure
+
+  rate.update(now + 1, 0, 5);
+  TEST_ASSERT_FALSE(rate.repairDue(now + 1)); // Too soon after the last one
+  TEST_ASSERT_TRUE(rate.repairDue(now + RATE_REPAIR_MS));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_starts_uncompressed);
+  RUN_TEST(test_loss_raises_the_level);
+  RUN_TEST(test_held_frames_raise_the_level);
+  RUN_TEST(test_calm_windows_lower_the_level);
+  RUN_TEST(test_stalled_loop_starts_a_new_window);
+  RUN_TEST(test_repairs_are_rate_limited);
+  return UNITY_END();
+}
@@ -0,0 +1,287 @@
+#include <unity.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "FrameReceiver.h"
+#include "SerialBridge.h"
+
+// sender-gh's whole path on a simulated clock, through a link that turns
+// congested and clears again: Grasshopper frames over serial into a
+// SerialBridge, its TxRing onto a mock radio, delivered packets into a
+// FrameReceiver. The same trace runs with the pacing on and off.
+//
+// Pixel 0 of every frame carries the frame number in the top six bits of red
+// and green, which quantizing leaves alone, so the receiver side can tell how
+// old the frame it shows is.
+
+#define FRAME_PIXELS 600
+#define FRAME_INTERVAL_US 33333 // Grasshopper at 30 frames/s
+#define TICK_US 100
+#define CLEAR_US_PER_BYTE 8     // 1 Mbit/s
+#define CONGESTED_US_PER_BYTE 32
+#define AIR_OVERHEAD_US 200
+#define CONGESTED_LOSS_PERCENT 40 // Per attempt, before the ring's retry
+
+// The trace: clear, congested, clear again
+#define CONGESTED_FROM_US 3000000
+#define CONGESTED_UNTIL_US 9000000
+#define TRACE_US 13000000
+
+static const uint8_t SENDER_MAC[6] = {5, 5, 5, 5, 5, 5};
+
+static FrameReceiver *receiver;
+static TxRing *ring;
+static uint8_t air[FRAME_MAX_PACKET];
+static size_t airLength;
+static bool airBusy;
+static uint64_t now;
+static uint64_t doneAt;
+static uint32_t noise;
+
+typedef struct
+{
+  std::vector<uint32_t> latencyUs[3]; // Age of each newly shown frame, per phase
+  uint8_t levelAt[TRACE_US / 100000]; // Compression level every 100 ms
+  size_t maxQueued;
+  uint32_t published;
+  uint32_t repairs;
+  bool exactAtEnd;
+} TraceResult;
+
+static uint32_t random32()
+{
+  noise = noise * 1664525 + 1013904223;
+  return noise >> 8;
+}
+
+static bool congested(uint64_t at)
+{
+  return at >= CONGESTED_FROM_US && at < CONGESTED_UNTIL_US;
+}
+
+static int phase(uint64_t at)
+{
+  return at < CONGESTED_FROM_US ? 0 : at < CONGESTED_UNTIL_US ? 1 : 2;
+}
+
+static bool transport(const uint8_t *data, size_t len)
+{
+  memcpy(air, data, len);
+  airLength = len;
+  airBusy = true;
+  doneAt = now + AIR_OVERHEAD_US + len * (congested(now) ? CONGESTED_US_PER_BYTE : CLEAR_US_PER_BYTE);
+  return true;
+}
+
+static uint8_t *reservePacket()
+{
+  return ring->reserve();
+}
+
+static void sendPacket(size_t len)
+{
+  ring->commit(len);
+}
+
+static const PacketSink sink = {reservePacket, sendPacket};
+
+// A lost packet never reaches the receiver and is not acknowledged
+static void radioTick(void)
+{
+  if (!airBusy || now < doneAt)
+  {
+    return;
+  }
+  airBusy = false;
+  bool lost = congested(now) && random32() % 100 < CONGESTED_LOSS_PERCENT;
+  if (!lost)
+  {
+    receiver->receive(SENDER_MAC, air, airLength, (uint32_t)now, (unsigned long)(now / 1000));
+  }
+  ring->onSent(!lost);
+}
+
+// Frame n as Grasshopper sends it: a slow fade everywhere and a block of
+// twenty pixels moving along
+static void buildFrame(uint32_t n, RGB *frame)
+{
+  for (int i = 0; i < FRAME_PIXELS; i++)
+  {
+    RGB color = {(uint8_t)(i / 3), 40, (uint8_t)(n / 2)};
+    frame[i] = color;
+  }
+  for (int i = 0; i < 20; i++)
+  {
+    RGB block = {255, 255, 255};
+    frame[1 + (n * 3 + i) % (FRAME_PIXELS - 1)] = block;
+  }
+  frame[0].red = (n & 63) << 2;
+  frame[0].green = ((n >> 6) & 63) << 2;
+}
+
+static uint32_t frameNumber(const RGB &pixel)
+{
+  return (pixel.red >> 2) | (pixel.green >> 2) << 6;
+}
+
+static void runTrace(bool adaptive, TraceResult *result)
+{
+  static RGB frame[FRAME_PIXELS];
+  static uint8_t body[2 + FRAME_PIXELS * 3];
+  static uint8_t serial[sizeof(body) + SERIAL_FRAME_OVERHEAD];
+  static uint64_t sentAt[TRACE_US / FRAME_INTERVAL_US + 2];
+  SerialBridge *bridge = new SerialBridge(*ring, sink, 10);
+  bridge->setAdaptive(adaptive);
+  memset(result->levelAt, 0, sizeof(result->levelAt));
+  result->maxQueued = 0;
+  result->published = 0;
+
+  uint32_t frames = 0;
+  uint32_t shown = 0;
+  for (now = 0; now < TRACE_US + 1000000; now += TICK_US) // A second to drain at the end
+  {
+    if (now < TRACE_US && now % FRAME_INTERVAL_US < TICK_US)
+    {
+      buildFrame(frames, frame);
+      body[0] = 0;
+      body[1] = 0;
+      memcpy(&body[2], frame, sizeof(frame));
+      size_t len = writeSerialFrame(serial, sizeof(serial), SERIAL_TYPE_PIXELS, body, sizeof(body));
+      for (size_t i = 0; i < len; i++)
+      {
+        bridge->feed(serial[i], now / 1000);
+      }
+      sentAt[frames++] = now;
+    }
+    radioTick();
+    bridge->poll(now / 1000);
+    result->maxQueued = std::max(result->maxQueued, ring->queued());
+    if (now % 100000 == 0 && now < TRACE_US)
+    {
+      result->levelAt[now / 100000] = bridge->rate().pacing().level;
+    }
+    if (receiver->takeFrame())
+    {
+      result->published++;
+      uint32_t n = frameNumber(receiver->frame().pixels[0]);
+      if (n >= shown && n < frames && now < TRACE_US)
+      {
+        result->latencyUs[phase(sentAt[n])].push_back((uint32_t)(now - sentAt[n]));
+      }
+      shown = n;
+    }
+  }
+  result->repairs = bridge->repairs();
+  result->exactAtEnd = memcmp(frame, receiver->frame().pixels, sizeof(frame)) == 0;
+  delete bridge;
+}
+
+static uint32_t percentile(std::vector<uint32_t> values, int percent)
+{
+  if (values.empty())
+  {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[(values.size() - 1) * percent / 100];
+}
+
+static void report(const char *name, const TraceResult &result)
+{
+  char line[160];
+  snprintf(line, sizeof(line), "%s: %u frames shown, max %u queued, %u repairs, age p50/p95 in ms:", name,
+           (unsigned)result.published, (unsigned)result.maxQueued, (unsigned)result.repairs);
+  TEST_MESSAGE(line);
+  const char *phases[] = {"clear", "congested", "clear again"};
+  for (int p = 0; p < 3; p++)
+  {
+    snprintf(line, sizeof(line), "  %-12s %4u shown %6.1f %6.1f", phases[p], (unsigned)result.latencyUs[p].size(),
+             percentile(result.latencyUs[p], 50) / 1000.0, percentile(result.latencyUs[p], 95) / 1000.0);
+    TEST_MESSAGE(line);
+  }
+  // The level at every change, in tenths of a second
+  int used = snprintf(line, sizeof(line), "  level");
+  for (int t = 0; t < TRACE_US / 100000 && used < (int)sizeof(line) - 12; t++)
+  {
+    if (t == 0 || result.levelAt[t] != result.levelAt[t - 1])
+    {
+      used += snprintf(line + used, sizeof(line) - used, " %d@%d.%d", result.levelAt[t], t / 10, t % 10);
+    }
+  }
+  TEST_MESSAGE(line);
+}
+
+void setUp(void)
+{
+  receiver = new FrameReceiver();
+  ring = new TxRing(transport);
+  airBusy = false;
+  now = 0;
+  noise = 1;
+}
+
+void tearDown(void)
+{
+  delete ring;
+  delete receiver;
+}
+
+static void test_pacing_follows_congestion(void)
+{
+  static TraceResult result;
+  runTrace(true, &result);
+  report("paced", result);
+
+  // Clear: every frame shown, no compression
+  for (int t = 0; t < CONGESTED_FROM_US / 100000; t++)
+  {
+    TEST_ASSERT_EQUAL_UINT8(0, result.levelAt[t]);
+  }
+  TEST_ASSERT_UINT32_WITHIN(2, CONGESTED_FROM_US / FRAME_INTERVAL_US, result.latencyUs[0].size());
+
+  // Congested: compression within a second, and repairs no more often than
+  // RATE_REPAIR_MS allows
+  bool raised = false;
+  for (int t = CONGESTED_FROM_US / 100000; t < CONGESTED_FROM_US / 100000 + 10; t++)
+  {
+    raised = raised || result.levelAt[t] > 0;
+  }
+  TEST_ASSERT_TRUE(raised);
+  TEST_ASSERT_GREATER_THAN(0, result.repairs);
+  TEST_ASSERT_LESS_OR_EQUAL((TRACE_US / 1000) / RATE_REPAIR_MS + 1, result.repairs);
+  TEST_ASSERT_GREATER_THAN(0, result.latencyUs[1].size());
+
+  // Clear again: back to exact colours within the calm windows of each level
+  int calmBy = (CONGESTED_UNTIL_US / 100000) + RATE_MAX_LEVEL * (RATE_CALM_WINDOWS + 1) + 1;
+  for (int t = calmBy; t < TRACE_US / 100000; t++)
+  {
+    TEST_ASSERT_EQUAL_UINT8(0, result.levelAt[t]);
+  }
+  TEST_ASSERT_TRUE(result.exactAtEnd);
+}
+
+static void test_pacing_shows_newer_frames_than_queueing(void)
+{
+  static TraceResult paced;
+  static TraceResult queued;
+  runTrace(true, &paced);
+  tearDown();
+  setUp();
+  runTrace(false, &queued);
+  report("unpaced", queued);
+
+  // A keyframe alone fills the ring either way; without pacing what waits in
+  // it is older, and so are the frames shown during congestion
+  TEST_ASSERT_LESS_THAN(percentile(queued.latencyUs[1], 95), percentile(paced.latencyUs[1], 95));
+  TEST_ASSERT_LESS_OR_EQUAL(percentile(queued.latencyUs[1], 50), percentile(paced.latencyUs[1], 50));
+  TEST_ASSERT_TRUE(queued.exactAtEnd); // Both get there once the link clears
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_pacing_follows_congestion);
+  RUN_TEST(test_pacing_shows_newer_frames_than_queueing);
+  return UNITY_END();
+}
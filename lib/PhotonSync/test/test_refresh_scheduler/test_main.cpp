@@ -0,0 +1,196 @@
+#include <unity.h>
+#include "RefreshScheduler.h"
+
+// The receiver's loop() against the scheduler on a simulated micros() clock:
+// frames arrive every frameEveryUs, a render takes renderUs, and the loop
+// sleeps for whatever wait() returns
+
+#define IDLE_LOOP_US 100 // A loop() pass with nothing to do
+
+typedef struct
+{
+  uint32_t start;        // micros() the run starts at
+  uint32_t durationUs;
+  uint32_t frameEveryUs; // 0 for no frames
+  uint32_t renderUs;
+  bool animating;
+} Run;
+
+typedef struct
+{
+  uint32_t renders;
+  uint32_t minGapUs; // Shortest time between two render starts
+  uint32_t sleptUs;
+  uint32_t arrived;
+} RunResult;
+
+static RunResult simulate(RefreshScheduler &scheduler, const Run &run)
+{
+  RunResult result = {0, 0xFFFFFFFF, 0, 0};
+  uint32_t now = run.start;
+  uint32_t nextFrame = run.start;
+  uint32_t pending = 0; // Frames published since the last render
+  uint32_t lastRender = 0;
+  for (uint32_t elapsed = 0; elapsed < run.durationUs; elapsed = now - run.start)
+  {
+    while (run.frameEveryUs > 0 && (int32_t)(now - nextFrame) >= 0)
+    {
+      if (pending > 0)
+      {
+        scheduler.frameDropped(); // The TripleBuffer replaced one the renderer never took
+      }
+      pending++;
+      result.arrived++;
+      nextFrame += run.frameEveryUs;
+    }
+
+    uint32_t wait = scheduler.wait(now);
+    if (wait > 0)
+    {
+      // Sleep, but a new frame does not wake the loop before the slot
+      now += wait;
+      result.sleptUs += wait;
+      continue;
+    }
+    if (!scheduler.begin(now, pending > 0, run.animating))
+    {
+      now += IDLE_LOOP_US;
+      result.sleptUs += IDLE_LOOP_US;
+      continue;
+    }
+    if (result.renders > 0 && now - lastRender < result.minGapUs)
+    {
+      result.minGapUs = now - lastRender;
+    }
+    lastRender = now;
+    pending = 0;
+    now += run.renderUs;
+    scheduler.end(now);
+    result.renders++;
+  }
+  return result;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_nothing_new_renders_nothing(void)
+{
+  RefreshScheduler scheduler(60);
+  Run run = {0, 1000000, 0, 3000, false};
+  RunResult result = simulate(scheduler, run);
+  TEST_ASSERT_EQUAL_UINT32(0, result.renders);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.stats().rendered);
+  TEST_ASSERT_EQUAL_UINT32(run.durationUs, result.sleptUs);
+}
+
+static void test_fast_frames_are_capped(void)
+{
+  RefreshScheduler scheduler(60);
+  Run run = {0, 1000000, 5000, 3000, false}; // 200 frames/s arrive
+  RunResult result = simulate(scheduler, run);
+  TEST_ASSERT_UINT32_WITHIN(1, 60, result.renders);
+  TEST_ASSERT_GREATER_OR_EQUAL(1000000 / 60 - 1, result.minGapUs);
+  RefreshStats stats = scheduler.stats();
+  TEST_ASSERT_EQUAL_UINT32(result.renders, stats.rendered);
+  TEST_ASSERT_EQUAL_UINT32(result.arrived - result.renders, stats.dropped);
+  TEST_ASSERT_GREATER_THAN(run.durationUs * 3 / 4, result.sleptUs); // The CPU is left to WiFi
+}
+
+static void test_slow_frames_render_once_each(void)
+{
+  RefreshScheduler scheduler(60);
+  Run run = {0, 1000000, 50000, 3000, false}; // 20 frames/s
+  RunResult result = simulate(scheduler, run);
+  TEST_ASSERT_EQUAL_UINT32(result.arrived, result.renders);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.stats().dropped);
+}
+
+static void test_animation_renders_at_the_cap(void)
+{
+  RefreshScheduler scheduler(50);
+  Run run = {0, 1000000, 0, 2000, true};
+  RunResult result = simulate(scheduler, run);
+  TEST_ASSERT_UINT32_WITHIN(1, 50, result.renders);
+  TEST_ASSERT_GREATER_OR_EQUAL(20000 - 1, result.minGapUs);
+}
+
+static void test_overrun_does_not_catch_up(void)
+{
+  // Every render takes longer than the interval: render back to back, but
+  // never twice inside one render time to make up for lost slots
+  RefreshScheduler scheduler(100);
+  Run run = {0, 1000000, 0, 15000, true};
+  RunResult result = simulate(scheduler, run);
+  TEST_ASSERT_UINT32_WITHIN(1, 1000000 / 15000, result.renders);
+  TEST_ASSERT_GREATER_OR_EQUAL(15000, result.minGapUs);
+}
+
+static void test_uncapped_keeps_the_minimum_interval(void)
+{
+  RefreshScheduler scheduler(0);
+  Run run = {0, 100000, 0, 100, true};
+  RunResult result = simulate(scheduler, run);
+  TEST_ASSERT_UINT32_WITHIN(1, 100000 / REFRESH_MIN_INTERVAL_US, result.renders);
+  TEST_ASSERT_GREATER_OR_EQUAL(REFRESH_MIN_INTERVAL_US, result.minGapUs);
+}
+
+static void test_micros_wraps(void)
+{
+  RefreshScheduler scheduler(60);
+  Run run = {0xFFFFFFFF - 500000, 1000000, 5000, 3000, false}; // Wraps halfway
+  RunResult result = simulate(scheduler, run);
+  TEST_ASSERT_UINT32_WITHIN(1, 60, result.renders);
+  TEST_ASSERT_GREATER_OR_EQUAL(1000000 / 60 - 1, result.minGapUs);
+}
+
+static void test_long_pause_does_not_stall(void)
+{
+  RefreshScheduler scheduler(60);
+  TEST_ASSERT_TRUE(scheduler.begin(1000, true, false));
+  scheduler.end(2000);
+  // Nothing for over half of micros()' range, the old slot now looks far ahead
+  uint32_t later = 1000 + 0x80000000u + 5000;
+  TEST_ASSERT_LESS_OR_EQUAL(1000000 / 60, scheduler.wait(later));
+  TEST_ASSERT_TRUE(scheduler.begin(later + scheduler.wait(later), true, false));
+}
+
+static void test_frame_time_stats(void)
+{
+  RefreshScheduler scheduler(60);
+  uint32_t now = 0;
+  const uint32_t durations[] = {2000, 4000, 3000, 9000, 3000};
+  for (int i = 0; i < 5; i++)
+  {
+    now += scheduler.wait(now);
+    TEST_ASSERT_TRUE(scheduler.begin(now, true, false));
+    now += durations[i];
+    scheduler.end(now);
+  }
+  RefreshStats stats = scheduler.stats();
+  TEST_ASSERT_EQUAL_UINT32(5, stats.rendered);
+  TEST_ASSERT_EQUAL_UINT32(3000, stats.frameUs);
+  TEST_ASSERT_EQUAL_UINT32(9000, stats.maxFrameUs);
+  TEST_ASSERT_GREATER_THAN(2000, stats.avgFrameUs);
+  TEST_ASSERT_LESS_THAN(9000, stats.avgFrameUs);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_new_renders_nothing);
+  RUN_TEST(test_fast_frames_are_capped);
+  RUN_TEST(test_slow_frames_render_once_each);
+  RUN_TEST(test_animation_renders_at_the_cap);
+  RUN_TEST(test_overrun_does_not_catch_up);
+  RUN_TEST(test_uncapped_keeps_the_minimum_interval);
+  RUN_TEST(test_micros_wraps);
+  RUN_TEST(test_long_pause_does_not_stall);
+  RUN_TEST(test_frame_time_stats);
+  return UNITY_END();
+}
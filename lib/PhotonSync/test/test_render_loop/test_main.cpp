@@ -0,0 +1,301 @@
+#include <unity.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include "FrameReceiver.h"
+#include "RenderLoop.h"
+
+// The receiver's task layout with std::thread stand-ins: a radio thread
+// decodes packets into a FrameReceiver and wakes the render thread, which
+// runs RenderLoop with a condition variable in place of the FreeRTOS task
+// notification. Build with -fsanitize=thread to check the handoff as well.
+//
+// Unity asserts only run on the main thread, the threads record what they saw.
+
+#define FRAME_PIXELS 600
+#define MAX_FPS 100
+#define SHOW_US 2000 // WS2812 output for a few hundred LEDs
+
+static const uint8_t SENDER_MAC[6] = {4, 4, 4, 4, 4, 4};
+static const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+static FrameReceiver *receiver;
+static RefreshScheduler *scheduler;
+
+// The task notification: a flag the radio side gives and sleep() takes
+static std::mutex notifyMutex;
+static std::condition_variable notifyCondition;
+static bool notified;
+
+static std::atomic<bool> running;
+static std::atomic<uint32_t> steps;
+static std::atomic<uint32_t> draws;
+static std::atomic<uint32_t> torn;
+static std::atomic<uint32_t> backwards;
+static std::atomic<int> lastDrawn;
+static std::atomic<bool> animatingNow;
+
+static uint32_t hostMicros()
+{
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started)
+      .count();
+}
+
+static void hostSleep(uint32_t us)
+{
+  std::unique_lock<std::mutex> lock(notifyMutex);
+  notifyCondition.wait_for(lock, std::chrono::microseconds(us), [] { return notified; });
+  notified = false;
+}
+
+static void wake()
+{
+  std::lock_guard<std::mutex> lock(notifyMutex);
+  notified = true;
+  notifyCondition.notify_one();
+}
+
+static bool takeFrame()
+{
+  return receiver->takeFrame();
+}
+
+static bool animating()
+{
+  return animatingNow.load();
+}
+
+static bool draw(bool newFrame)
+{
+  if (newFrame)
+  {
+    // Every pixel of frame n has red n, a mix means a torn frame
+    const RGB *pixels = receiver->frame().pixels;
+    int n = pixels[0].red;
+    for (int i = 0; i < FRAME_PIXELS; i++)
+    {
+      if (pixels[i].red != n || pixels[i].green != (uint8_t)i)
+      {
+        torn++;
+        break;
+      }
+    }
+    if (n < lastDrawn.load())
+    {
+      backwards++;
+    }
+    lastDrawn.store(n);
+  }
+  std::this_thread::sleep_for(std::chrono::microseconds(SHOW_US));
+  draws++;
+  return true;
+}
+
+static void renderTask()
+{
+  RenderHooks hooks = {hostMicros, hostSleep, takeFrame, animating, draw};
+  RenderLoop loop(hooks, *scheduler);
+  while (running.load())
+  {
+    loop.step();
+    steps++;
+  }
+}
+
+// Send frames 1 to count, intervalUs apart, as the WiFi task would receive them
+static void radioTask(int count, uint32_t intervalUs)
+{
+  static RGB frame[FRAME_PIXELS];
+  static uint8_t packet[FRAME_MAX_PACKET];
+  uint16_t sequence = 0;
+  for (int n = 1; n <= count; n++)
+  {
+    for (int i = 0; i < FRAME_PIXELS; i++)
+    {
+      RGB color = {(uint8_t)n, (uint8_t)i, (uint8_t)(n ^ i)};
+      frame[i] = color;
+    }
+    FrameHeader header = {FRAME_FLAG_KEYFRAME, (uint8_t)n, 0};
+    uint16_t done = 0;
+    while (done < FRAME_PIXELS)
+    {
+      uint16_t consumed;
+      header.sequence = sequence++;
+      size_t len = encodeFrame(packet, sizeof(packet), header, frame, NULL, done, FRAME_PIXELS - done, &consumed);
+      done += consumed;
+      ReceiveResult result = receiver->receive(SENDER_MAC, packet, len, hostMicros(), hostMicros() / 1000);
+      if (result == RECEIVE_REPLACED)
+      {
+        scheduler->frameDropped();
+      }
+      if (result != RECEIVE_NOTHING)
+      {
+        wake();
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(intervalUs));
+  }
+}
+
+void setUp(void)
+{
+  receiver = new FrameReceiver();
+  scheduler = new RefreshScheduler(MAX_FPS);
+  notified = false;
+  running.store(true);
+  steps.store(0);
+  draws.store(0);
+  torn.store(0);
+  backwards.store(0);
+  lastDrawn.store(0);
+  animatingNow.store(false);
+}
+
+void tearDown(void)
+{
+  delete scheduler;
+  delete receiver;
+}
+
+static void test_frames_cross_whole_and_the_newest_is_shown(void)
+{
+  std::thread render(renderTask);
+  std::thread radio(radioTask, 250, 2000); // About 400 frames/s, four times the cap
+  radio.join();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // Long enough to render the last one
+  running.store(false);
+  wake();
+  render.join();
+
+  RefreshStats stats = scheduler->stats();
+  char line[120];
+  snprintf(line, sizeof(line), "%u rendered, %u dropped, %u steps, max frame %u us", (unsigned)stats.rendered,
+           (unsigned)stats.dropped, (unsigned)steps.load(), (unsigned)stats.maxFrameUs);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL_UINT32(0, torn.load());
+  TEST_ASSERT_EQUAL_UINT32(0, backwards.load());
+  TEST_ASSERT_EQUAL(250, lastDrawn.load());
+  TEST_ASSERT_EQUAL_UINT32(draws.load(), stats.rendered);
+  TEST_ASSERT_EQUAL_UINT32(250, stats.rendered + stats.dropped); // Every frame was shown or counted as dropped
+  TEST_ASSERT_GREATER_THAN(0, stats.dropped);
+  TEST_ASSERT_GREATER_OR_EQUAL(SHOW_US, stats.maxFrameUs);
+}
+
+static void test_idle_task_sleeps(void)
+{
+  std::thread render(renderTask);
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  running.store(false);
+  wake();
+  render.join();
+  TEST_ASSERT_EQUAL_UINT32(0, draws.load());
+  // One step per RENDER_IDLE_SLEEP_US, not a busy loop
+  TEST_ASSERT_LESS_OR_EQUAL(300000 / RENDER_IDLE_SLEEP_US + 2, steps.load());
+}
+
+static void test_animation_renders_at_the_cap(void)
+{
+  animatingNow.store(true);
+  std::thread render(renderTask);
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  running.store(false);
+  wake();
+  render.join();
+  // At most MAX_FPS a second, and most of them despite the host's scheduling
+  TEST_ASSERT_LESS_OR_EQUAL(MAX_FPS / 2 + 1, draws.load());
+  TEST_ASSERT_GREATER_THAN(MAX_FPS / 4, draws.load());
+}
+
+static void test_wake_beats_the_idle_sleep(void)
+{
+  std::thread render(renderTask);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20)); // The task is asleep for up to RENDER_IDLE_SLEEP_US
+  uint32_t sentAt = hostMicros();
+  radioTask(1, 0);
+  while (lastDrawn.load() != 1 && hostMicros() - sentAt < 1000000)
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  uint32_t latency = hostMicros() - sentAt;
+  char line[80];
+  snprintf(line, sizeof(line), "Shown %u us after it was sent", (unsigned)latency);
+  TEST_MESSAGE(line);
+  running.store(false);
+  wake();
+  render.join();
+  TEST_ASSERT_EQUAL(1, lastDrawn.load());
+  TEST_ASSERT_LESS_THAN(RENDER_IDLE_SLEEP_US / 2, latency);
+}
+
+// A simulated clock for the step-by-step tests: sleeping moves it on
+static uint32_t simulatedNow;
+static uint32_t longestSleep;
+static uint32_t shortestSleep;
+
+static uint32_t simulatedMicros()
+{
+  return simulatedNow;
+}
+
+static void simulatedSleep(uint32_t us)
+{
+  longestSleep = us > longestSleep ? us : longestSleep;
+  shortestSleep = us < shortestSleep ? us : shortestSleep;
+  simulatedNow += us;
+}
+
+static bool noFrame()
+{
+  return false;
+}
+
+static bool alwaysAnimating()
+{
+  return true;
+}
+
+static bool unchanged(bool newFrame)
+{
+  (void)newFrame;
+  draws++;
+  return false; // An idle step still at the same brightness
+}
+
+static void test_unchanged_draw_sleeps_until_the_next_slot(void)
+{
+  // An idle fade must not start up to RENDER_IDLE_SLEEP_US late: after a draw
+  // that changed nothing the task asks again in the next slot
+  RenderHooks hooks = {simulatedMicros, simulatedSleep, noFrame, alwaysAnimating, unchanged};
+  const uint16_t caps[] = {MAX_FPS, 0};
+  const uint32_t intervals[] = {1000000 / MAX_FPS, REFRESH_MIN_INTERVAL_US};
+  for (int c = 0; c < 2; c++)
+  {
+    RefreshScheduler paced(caps[c]);
+    RenderLoop loop(hooks, paced);
+    simulatedNow = 12345;
+    longestSleep = 0;
+    shortestSleep = UINT32_MAX;
+    draws.store(0);
+    for (int i = 0; i < 1000; i++)
+    {
+      loop.step();
+    }
+    TEST_ASSERT_EQUAL_UINT32(intervals[c], longestSleep);
+    TEST_ASSERT_GREATER_THAN(0, shortestSleep); // Never asks again at once
+    TEST_ASSERT_EQUAL_UINT32((simulatedNow - 12345) / intervals[c], draws.load()); // Once per slot
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_frames_cross_whole_and_the_newest_is_shown);
+  RUN_TEST(test_idle_task_sleeps);
+  RUN_TEST(test_animation_renders_at_the_cap);
+  RUN_TEST(test_wake_beats_the_idle_sleep);
+  RUN_TEST(test_unchanged_draw_sleeps_until_the_next_slot);
+  return UNITY_END();
+}
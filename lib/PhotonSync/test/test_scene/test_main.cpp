@@ -0,0 +1,329 @@
+#include <unity.h>
+#include <string.h>
+#include "FrameProtocol.h"
+#include "Scene.h"
+
+// Each effect's colours, step timing and clipping, the engine's triggers, and
+// LOAD and TRIGGER records through the codec
+
+#define PIXELS 64
+
+static const RGB RED = {255, 0, 0};
+static const RGB BLUE = {0, 0, 255};
+static const RGB UNTOUCHED = {1, 2, 3};
+
+static RGB out[PIXELS + 8]; // The tail guards against writes past size
+static SceneTable table;
+static SceneEngine *engine;
+
+static SceneStep step(uint8_t effect, uint16_t start, uint16_t count, uint16_t durationMs, uint8_t width = 0,
+                      uint8_t repeat = 0)
+{
+  SceneStep s = {effect, start, count, RED, BLUE, durationMs, width, repeat};
+  return s;
+}
+
+static Scene scene(const SceneStep &first, uint8_t flags = 0)
+{
+  Scene s;
+  memset(&s, 0, sizeof(s));
+  s.flags = flags;
+  s.stepCount = 1;
+  s.steps[0] = first;
+  return s;
+}
+
+static void assertColor(const RGB &expected, const RGB &actual)
+{
+  TEST_ASSERT_EQUAL_UINT8(expected.red, actual.red);
+  TEST_ASSERT_EQUAL_UINT8(expected.green, actual.green);
+  TEST_ASSERT_EQUAL_UINT8(expected.blue, actual.blue);
+}
+
+void setUp(void)
+{
+  for (int i = 0; i < PIXELS + 8; i++)
+  {
+    out[i] = UNTOUCHED;
+  }
+  memset(&table, 0, sizeof(table));
+  engine = new SceneEngine();
+}
+
+void tearDown(void)
+{
+  delete engine;
+}
+
+static void test_fade_runs_from_a_to_b_then_stops(void)
+{
+  Scene fade = scene(step(SCENE_FADE, 0, 4, 1000));
+  TEST_ASSERT_EQUAL_UINT32(1000, sceneLength(fade));
+  TEST_ASSERT_TRUE(renderScene(fade, 0, out, PIXELS));
+  assertColor(RED, out[3]);
+  TEST_ASSERT_TRUE(renderScene(fade, 500, out, PIXELS));
+  TEST_ASSERT_EQUAL_UINT8(128, out[0].red);
+  TEST_ASSERT_EQUAL_UINT8(127, out[0].blue);
+  TEST_ASSERT_TRUE(renderScene(fade, 999, out, PIXELS));
+  TEST_ASSERT_LESS_OR_EQUAL(1, out[0].red);
+  assertColor(UNTOUCHED, out[4]); // Outside the run
+
+  out[0] = UNTOUCHED;
+  TEST_ASSERT_FALSE(renderScene(fade, 1000, out, PIXELS)); // Finished, draws nothing
+  assertColor(UNTOUCHED, out[0]);
+}
+
+static void test_pulse_turns_at_half_time(void)
+{
+  Scene pulse = scene(step(SCENE_PULSE, 0, 1, 1000), SCENE_FLAG_LOOP);
+  renderScene(pulse, 0, out, PIXELS);
+  assertColor(RED, out[0]);
+  renderScene(pulse, 500, out, PIXELS);
+  assertColor(BLUE, out[0]);
+  renderScene(pulse, 250, out, PIXELS);
+  TEST_ASSERT_EQUAL_UINT8(128, out[0].red);
+  renderScene(pulse, 1000, out, PIXELS); // Looped back to the start
+  assertColor(RED, out[0]);
+}
+
+static void test_chase_travels_the_run_once_per_cycle(void)
+{
+  Scene chase = scene(step(SCENE_CHASE, 8, 16, 1600, 3), SCENE_FLAG_LOOP);
+  renderScene(chase, 0, out, PIXELS);
+  for (int i = 0; i < 16; i++)
+  {
+    assertColor(i < 3 ? RED : BLUE, out[8 + i]);
+  }
+  renderScene(chase, 500, out, PIXELS); // Head at pixel 5 of the run
+  for (int i = 0; i < 16; i++)
+  {
+    assertColor(i >= 5 && i < 8 ? RED : BLUE, out[8 + i]);
+  }
+  renderScene(chase, 1500, out, PIXELS); // Head at 15, the tail wraps to the front
+  for (int i = 0; i < 16; i++)
+  {
+    assertColor(i == 15 || i < 2 ? RED : BLUE, out[8 + i]);
+  }
+}
+
+static void test_gradient_scrolls_one_wave_per_cycle(void)
+{
+  Scene gradient = scene(step(SCENE_GRADIENT, 0, 32, 1000), SCENE_FLAG_LOOP);
+  renderScene(gradient, 0, out, PIXELS);
+  assertColor(RED, out[0]);
+  assertColor(BLUE, out[16]); // Half way along the wave
+  TEST_ASSERT_INT_WITHIN(1, out[8].red, out[24].red); // Symmetric about the middle, to a step
+
+  static RGB later[PIXELS + 8];
+  renderScene(gradient, 250, later, PIXELS); // A quarter cycle moves it a quarter of the run
+  for (int i = 0; i < 24; i++)
+  {
+    assertColor(out[i + 8], later[i]);
+  }
+}
+
+static void test_steps_play_in_order_with_repeats(void)
+{
+  Scene s;
+  memset(&s, 0, sizeof(s));
+  s.stepCount = 3;
+  s.steps[0] = step(SCENE_FADE, 0, 1, 100, 0, 3); // 300 ms
+  s.steps[1] = step(SCENE_FADE, 1, 1, 200);       // 200 ms
+  s.steps[2] = step(SCENE_CHASE, 2, 2, 50, 1, 0); // 50 ms
+  TEST_ASSERT_EQUAL_UINT32(550, sceneLength(s));
+
+  renderScene(s, 250, out, PIXELS); // Half way through the third repeat
+  TEST_ASSERT_EQUAL_UINT8(128, out[0].red);
+  assertColor(UNTOUCHED, out[1]);
+  renderScene(s, 300, out, PIXELS); // Second step starts
+  assertColor(RED, out[1]);
+  assertColor(UNTOUCHED, out[2]);
+  renderScene(s, 525, out, PIXELS);
+  assertColor(BLUE, out[2]);
+  assertColor(RED, out[3]);
+  TEST_ASSERT_FALSE(renderScene(s, 550, out, PIXELS));
+
+  s.flags = SCENE_FLAG_LOOP;
+  out[0] = UNTOUCHED;
+  TEST_ASSERT_TRUE(renderScene(s, 550 * 1000 + 10, out, PIXELS)); // Any number of passes later
+  TEST_ASSERT_EQUAL_UINT8(255 - 25, out[0].red);
+}
+
+static void test_runs_are_clipped_to_the_buffer(void)
+{
+  Scene fade = scene(step(SCENE_CHASE, PIXELS - 4, 200, 1000, 8), SCENE_FLAG_LOOP);
+  TEST_ASSERT_TRUE(renderScene(fade, 0, out, PIXELS));
+  assertColor(RED, out[PIXELS - 1]);
+  for (int i = PIXELS; i < PIXELS + 8; i++)
+  {
+    assertColor(UNTOUCHED, out[i]);
+  }
+
+  Scene past = scene(step(SCENE_FADE, PIXELS + 2, 4, 1000));
+  TEST_ASSERT_TRUE(renderScene(past, 0, out, PIXELS)); // Plays, but has nothing to draw here
+  assertColor(UNTOUCHED, out[PIXELS + 2]);
+}
+
+static void test_engine_starts_at_the_latch_time(void)
+{
+  table.slots[0] = scene(step(SCENE_FADE, 0, 1, 1000));
+  table.triggers[0] = 1;
+  table.playing = 1;
+  engine->render(table, out, PIXELS, 5000, 5200); // Triggered by a frame that latches at 5200
+  TEST_ASSERT_TRUE(engine->active());
+  assertColor(RED, out[0]); // Holds the first colour until then
+  engine->render(table, out, PIXELS, 5200, 5200);
+  assertColor(RED, out[0]);
+  engine->render(table, out, PIXELS, 5700, 5700);
+  TEST_ASSERT_EQUAL_UINT8(128, out[0].red);
+
+  out[0] = UNTOUCHED;
+  engine->render(table, out, PIXELS, 6200, 6200);
+  TEST_ASSERT_FALSE(engine->active()); // Finished
+  assertColor(UNTOUCHED, out[0]);
+}
+
+static void test_engine_restarts_stops_and_layers(void)
+{
+  table.slots[0] = scene(step(SCENE_FADE, 0, 4, 1000), SCENE_FLAG_LOOP);
+  table.slots[3] = scene(step(SCENE_FADE, 2, 4, 1000), SCENE_FLAG_LOOP);
+  table.slots[3].steps[0].a = BLUE;
+  table.triggers[0] = 1;
+  table.triggers[3] = 1;
+  table.playing = 1 | 1 << 3;
+  engine->render(table, out, PIXELS, 0, 0);
+  assertColor(RED, out[1]);
+  assertColor(BLUE, out[2]); // The higher slot draws over
+
+  // Played again, it starts over, even though the playing bit did not change
+  engine->render(table, out, PIXELS, 600, 600);
+  TEST_ASSERT_EQUAL_UINT8(102, out[0].red);
+  table.triggers[0]++;
+  engine->render(table, out, PIXELS, 700, 700);
+  assertColor(RED, out[0]);
+
+  // Stopped: the slot no longer draws, the other carries on
+  table.triggers[3]++;
+  table.playing &= ~(1 << 3);
+  out[4] = UNTOUCHED;
+  engine->render(table, out, PIXELS, 800, 800);
+  assertColor(UNTOUCHED, out[4]);
+  TEST_ASSERT_TRUE(engine->active());
+
+  // Two triggers between renders: the newest action wins
+  table.triggers[0] += 2;
+  table.playing &= ~1;
+  engine->render(table, out, PIXELS, 900, 900);
+  TEST_ASSERT_FALSE(engine->active());
+}
+
+static void test_engine_across_a_millis_wrap(void)
+{
+  table.slots[1] = scene(step(SCENE_FADE, 0, 1, 1000));
+  table.triggers[1] = 1;
+  table.playing = 2;
+  unsigned long start = (unsigned long)0 - 300;
+  engine->render(table, out, PIXELS, start, start);
+  engine->render(table, out, PIXELS, start + 500, start + 500);
+  TEST_ASSERT_EQUAL_UINT8(128, out[0].red);
+  TEST_ASSERT_TRUE(engine->active());
+}
+
+static void test_engine_keeps_looping_past_half_the_clock(void)
+{
+  // 2^31 ms, 24.8 days on the receivers, after the trigger the time since it
+  // still counts as elapsed, not as a start ahead
+  static RGB expected[PIXELS + 8];
+  const unsigned long half = (unsigned long)1 << (sizeof(unsigned long) * 8 - 1);
+  table.slots[0] = scene(step(SCENE_FADE, 0, PIXELS, 1000), SCENE_FLAG_LOOP);
+  table.triggers[0] = 1;
+  table.playing = 1;
+  engine->render(table, out, PIXELS, 1000, 1000);
+  for (unsigned long t = half - 600; t < half + 1500; t += 300)
+  {
+    engine->render(table, out, PIXELS, 1000 + t, 1000 + t);
+    memcpy(expected, out, sizeof(out));
+    renderScene(table.slots[0], (uint32_t)t, expected, PIXELS);
+    TEST_ASSERT_EQUAL_MEMORY(expected, out, sizeof(RGB) * PIXELS);
+  }
+  TEST_ASSERT_TRUE(out[0].red != RED.red); // Not frozen on the first colour
+}
+
+static void test_receivers_on_different_clocks_draw_the_same(void)
+{
+  // Rendering depends only on the time since the trigger
+  static RGB other[PIXELS + 8];
+  SceneEngine *second = new SceneEngine();
+  table.slots[0] = scene(step(SCENE_GRADIENT, 0, PIXELS, 700, 20), SCENE_FLAG_LOOP);
+  table.triggers[0] = 1;
+  table.playing = 1;
+  for (unsigned long t = 0; t < 3000; t += 37)
+  {
+    engine->render(table, out, PIXELS, 1000 + t, 1000);
+    second->render(table, other, PIXELS, 987654 + t, 987654);
+    TEST_ASSERT_EQUAL_MEMORY(out, other, sizeof(RGB) * PIXELS);
+  }
+  delete second;
+}
+
+static void test_load_and_trigger_records(void)
+{
+  static uint8_t packet[FRAME_MAX_PACKET];
+  static RGB pixels[FRAME_MAX_PIXELS];
+  Scene loaded;
+  memset(&loaded, 0, sizeof(loaded));
+  loaded.flags = SCENE_FLAG_LOOP;
+  loaded.stepCount = 2;
+  loaded.steps[0] = step(SCENE_CHASE, 300, 600, 2000, 12, 4);
+  loaded.steps[1] = step(SCENE_PULSE, 0, 10, 500);
+
+  FrameHeader header = {FRAME_FLAG_LAST, 1, 0};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+  TEST_ASSERT_TRUE(writer.load(5, loaded));
+  size_t loadLength = writer.length();
+  TEST_ASSERT_TRUE(writer.trigger(5, SCENE_PLAY));
+  TEST_ASSERT_EQUAL(3, writer.length() - loadLength); // A play costs three bytes
+  TEST_ASSERT_FALSE(writer.load(SCENE_SLOTS, loaded));
+  TEST_ASSERT_FALSE(writer.trigger(SCENE_SLOTS, SCENE_PLAY));
+
+  FrameTarget target;
+  memset(&target, 0, sizeof(target));
+  target.pixels = pixels;
+  target.size = FRAME_MAX_PIXELS;
+  target.windowCount = FRAME_MAX_PIXELS;
+  target.scenes = &table;
+  FrameHeader read;
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, writer.length(), &read, &target));
+  TEST_ASSERT_EQUAL_MEMORY(&loaded, &table.slots[5], sizeof(Scene));
+  TEST_ASSERT_EQUAL_UINT8(1, table.triggers[5]);
+  TEST_ASSERT_EQUAL_HEX8(1 << 5, table.playing);
+
+  // The same packet again plays it again
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, writer.length(), &read, &target));
+  TEST_ASSERT_EQUAL_UINT8(2, table.triggers[5]);
+
+  writer.begin(header);
+  writer.trigger(5, SCENE_STOP);
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, writer.length(), &read, &target));
+  TEST_ASSERT_EQUAL_UINT8(3, table.triggers[5]);
+  TEST_ASSERT_EQUAL_HEX8(0, table.playing);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_fade_runs_from_a_to_b_then_stops);
+  RUN_TEST(test_pulse_turns_at_half_time);
+  RUN_TEST(test_chase_travels_the_run_once_per_cycle);
+  RUN_TEST(test_gradient_scrolls_one_wave_per_cycle);
+  RUN_TEST(test_steps_play_in_order_with_repeats);
+  RUN_TEST(test_runs_are_clipped_to_the_buffer);
+  RUN_TEST(test_engine_starts_at_the_latch_time);
+  RUN_TEST(test_engine_restarts_stops_and_layers);
+  RUN_TEST(test_engine_across_a_millis_wrap);
+  RUN_TEST(test_engine_keeps_looping_past_half_the_clock);
+  RUN_TEST(test_receivers_on_different_clocks_draw_the_same);
+  RUN_TEST(test_load_and_trigger_records);
+  return UNITY_END();
+}
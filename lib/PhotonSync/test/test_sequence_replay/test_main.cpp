@@ -0,0 +1,177 @@
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "FrameReceiver.h"
+
+// Packet traces replayed into a FrameReceiver with packets reordered,
+// duplicated and dropped, as ESP-NOW's retries and lost acknowledgements
+// deliver them. Every pixel's red channel holds the number of the frame that
+// set it, so a late packet overwriting newer colours shows as red going back.
+
+#define FRAME_PIXELS 600
+#define FRAMES 250 // Frame numbers fit the red channel
+
+static const uint8_t SENDER_MAC[6] = {2, 2, 2, 2, 2, 2};
+
+typedef std::vector<uint8_t> Packet;
+static std::vector<Packet> packets;
+static FrameReceiver *receiver;
+static uint32_t noise;
+
+static uint32_t random32()
+{
+  noise = noise * 1664525 + 1013904223;
+  return noise >> 8;
+}
+
+// Every frame as keyframe packets, sequence numbers running on across frames
+static void buildPackets(void)
+{
+  static RGB frame[FRAME_PIXELS];
+  static uint8_t packet[FRAME_MAX_PACKET];
+  packets.clear();
+  uint16_t sequence = 0;
+  for (int f = 1; f <= FRAMES; f++)
+  {
+    for (int i = 0; i < FRAME_PIXELS; i++)
+    {
+      RGB color = {(uint8_t)f, (uint8_t)random32(), (uint8_t)random32()};
+      frame[i] = color;
+    }
+    FrameHeader header = {FRAME_FLAG_KEYFRAME, (uint8_t)f, 0};
+    uint16_t done = 0;
+    while (done < FRAME_PIXELS)
+    {
+      uint16_t consumed;
+      header.sequence = sequence++;
+      size_t len = encodeFrame(packet, sizeof(packet), header, frame, NULL, done, FRAME_PIXELS - done, &consumed);
+      packets.push_back(Packet(packet, packet + len));
+      done += consumed;
+    }
+  }
+}
+
+void setUp(void)
+{
+  noise = 1;
+  buildPackets();
+  receiver = new FrameReceiver();
+}
+
+void tearDown(void)
+{
+  delete receiver;
+}
+
+// Deliver one packet, then check no pixel went back to an older frame
+static void deliver(const Packet &packet, uint8_t *newest)
+{
+  receiver->receive(SENDER_MAC, &packet[0], packet.size(), 0, 0);
+  if (receiver->takeFrame())
+  {
+    const RGB *pixels = receiver->frame().pixels;
+    for (int i = 0; i < FRAME_PIXELS; i++)
+    {
+      TEST_ASSERT_GREATER_OR_EQUAL(newest[i], pixels[i].red);
+      newest[i] = pixels[i].red;
+    }
+  }
+}
+
+static void test_clean_trace(void)
+{
+  static uint8_t newest[FRAME_PIXELS];
+  memset(newest, 0, sizeof(newest));
+  for (size_t p = 0; p < packets.size(); p++)
+  {
+    deliver(packets[p], newest);
+  }
+  const SequenceStats &stats = receiver->sequenceStats();
+  TEST_ASSERT_EQUAL_UINT32(packets.size(), stats.received);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.lost);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.late);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.duplicates);
+  for (int i = 0; i < FRAME_PIXELS; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT8(FRAMES, newest[i]);
+  }
+}
+
+static void test_reordered_duplicated_and_dropped(void)
+{
+  static uint8_t newest[FRAME_PIXELS];
+  memset(newest, 0, sizeof(newest));
+  uint32_t swapped = 0;
+  uint32_t repeated = 0;
+  uint32_t dropped = 0;
+  size_t tail = packets.size() - 40; // The last frames arrive clean
+
+  for (size_t p = 0; p < packets.size(); p++)
+  {
+    uint32_t roll = p < tail ? random32() % 100 : 99;
+    if (roll < 5)
+    {
+      dropped++; // Lost on air
+    }
+    else if (roll < 10 && p + 1 < tail)
+    {
+      // The next packet overtakes this one, which then arrives late
+      deliver(packets[p + 1], newest);
+      deliver(packets[p], newest);
+      swapped++;
+      p++;
+    }
+    else if (roll < 15)
+    {
+      // Delivered, but the acknowledgement was lost and the sender retried
+      deliver(packets[p], newest);
+      deliver(packets[p], newest);
+      repeated++;
+    }
+    else
+    {
+      deliver(packets[p], newest);
+    }
+  }
+
+  const SequenceStats &stats = receiver->sequenceStats();
+  TEST_ASSERT_GREATER_THAN(0, swapped);
+  TEST_ASSERT_GREATER_THAN(0, repeated);
+  TEST_ASSERT_GREATER_THAN(0, dropped);
+  TEST_ASSERT_EQUAL_UINT32(dropped + swapped, stats.lost); // A late packet was counted lost when it was skipped
+  TEST_ASSERT_EQUAL_UINT32(swapped, stats.late);
+  TEST_ASSERT_EQUAL_UINT32(repeated, stats.duplicates);
+  TEST_ASSERT_EQUAL_UINT32(packets.size() - dropped - swapped, stats.received);
+  for (int i = 0; i < FRAME_PIXELS; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT8(FRAMES, newest[i]); // The newest frame won
+  }
+}
+
+static void test_duplicate_burst_after_a_gap(void)
+{
+  // A retry of an old packet arriving well after newer ones is late, not a duplicate
+  static uint8_t newest[FRAME_PIXELS];
+  memset(newest, 0, sizeof(newest));
+  for (size_t p = 0; p < 50; p++)
+  {
+    deliver(packets[p], newest);
+  }
+  for (size_t p = 40; p < 50; p++)
+  {
+    deliver(packets[p], newest);
+  }
+  const SequenceStats &stats = receiver->sequenceStats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats.duplicates); // Only the newest one repeated
+  TEST_ASSERT_EQUAL_UINT32(9, stats.late);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.lost);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_clean_trace);
+  RUN_TEST(test_reordered_duplicated_and_dropped);
+  RUN_TEST(test_duplicate_burst_after_a_gap);
+  return UNITY_END();
+}
@@ -0,0 +1,111 @@
+#include <unity.h>
+#include "SequenceTracker.h"
+
+static const uint8_t SENDER_A[6] = {0xAA, 1, 2, 3, 4, 5};
+static const uint8_t SENDER_B[6] = {0xBB, 1, 2, 3, 4, 5};
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static SequenceVerdict check(SequenceTracker &tracker, const uint8_t *mac, uint16_t sequence, unsigned long now,
+                             uint8_t flags = 0)
+{
+  FrameHeader header = {flags, 0, sequence};
+  return tracker.check(mac, header, now);
+}
+
+static void test_in_order_packets_are_accepted(void)
+{
+  SequenceTracker tracker;
+  for (uint16_t sequence = 100; sequence < 110; sequence++)
+  {
+    TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_A, sequence, 0));
+  }
+  TEST_ASSERT_EQUAL_UINT32(10, tracker.stats().received);
+  TEST_ASSERT_EQUAL_UINT32(0, tracker.stats().lost);
+}
+
+static void test_repeats_and_late_packets_are_dropped(void)
+{
+  SequenceTracker tracker;
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_A, 10, 0));
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_A, 13, 1)); // 11 and 12 missing
+  TEST_ASSERT_EQUAL(SEQ_DUPLICATE, check(tracker, SENDER_A, 13, 2));
+  TEST_ASSERT_EQUAL(SEQ_LATE, check(tracker, SENDER_A, 11, 3));
+
+  const SequenceStats &stats = tracker.stats();
+  TEST_ASSERT_EQUAL_UINT32(2, stats.received);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.lost);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.duplicates);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.late);
+}
+
+static void test_sequence_wraps(void)
+{
+  SequenceTracker tracker;
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_A, 0xFFFE, 0));
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_A, 0xFFFF, 0));
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_A, 0, 0));
+  TEST_ASSERT_EQUAL(SEQ_LATE, check(tracker, SENDER_A, 0xFFFF, 0));
+  TEST_ASSERT_EQUAL_UINT32(0, tracker.stats().lost);
+}
+
+static void test_sender_restart_is_accepted(void)
+{
+  SequenceTracker tracker;
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_A, 5000, 0));
+
+  // Flagged, or too far behind to be reordering
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_A, 4990, 1, FRAME_FLAG_SEQ_RESET));
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_A, 4990 - SEQ_REORDER_WINDOW - 1, 2));
+  TEST_ASSERT_EQUAL_UINT32(2, tracker.stats().restarts);
+
+  // Silent past the timeout, anything goes
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_A, 3, 3 + SEQ_TIMEOUT_MS + 1));
+}
+
+static void test_senders_are_tracked_apart(void)
+{
+  SequenceTracker tracker;
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_A, 50, 0));
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_B, 10, 0));
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, SENDER_B, 11, 0));
+  TEST_ASSERT_EQUAL(SEQ_LATE, check(tracker, SENDER_A, 49, 0));
+}
+
+static void test_least_recently_heard_sender_is_replaced(void)
+{
+  SequenceTracker tracker;
+  uint8_t mac[6] = {0, 0, 0, 0, 0, 0};
+  for (int i = 0; i < SEQ_MAX_SENDERS; i++)
+  {
+    mac[0] = i;
+    TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, mac, 100, i));
+  }
+  mac[0] = SEQ_MAX_SENDERS;
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, mac, 100, 10)); // Replaces sender 0
+
+  // Sender 0 is new again, its old packet number means nothing
+  mac[0] = 0;
+  TEST_ASSERT_EQUAL(SEQ_ACCEPT, check(tracker, mac, 100, 11));
+  // Sender 2 is still known
+  mac[0] = 2;
+  TEST_ASSERT_EQUAL(SEQ_DUPLICATE, check(tracker, mac, 100, 12));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_in_order_packets_are_accepted);
+  RUN_TEST(test_repeats_and_late_packets_are_dropped);
+  RUN_TEST(test_sequence_wraps);
+  RUN_TEST(test_sender_restart_is_accepted);
+  RUN_TEST(test_senders_are_tracked_apart);
+  RUN_TEST(test_least_recently_heard_sender_is_replaced);
+  return UNITY_END();
+}
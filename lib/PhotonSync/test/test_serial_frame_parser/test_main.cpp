@@ -0,0 +1,275 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "SerialFrameParser.h"
+
+static uint8_t stream[SERIAL_MAX_PAYLOAD + SERIAL_FRAME_OVERHEAD];
+static uint8_t body[SERIAL_MAX_PAYLOAD];
+
+void setUp(void)
+{
+  for (size_t i = 0; i < sizeof(body); i++)
+  {
+    body[i] = i * 7;
+  }
+}
+
+void tearDown(void)
+{
+}
+
+// Feed bytes until the parser reports something, returns SERIAL_NONE if it never did
+static SerialEvent feedAll(SerialFrameParser &parser, const uint8_t *data, size_t len, size_t *used)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    SerialEvent event = parser.feed(data[i]);
+    if (event != SERIAL_NONE)
+    {
+      *used = i + 1;
+      return event;
+    }
+  }
+  *used = len;
+  return SERIAL_NONE;
+}
+
+static void test_frame_round_trip(void)
+{
+  size_t len = writeSerialFrame(stream, sizeof(stream), SERIAL_TYPE_PIXELS, body, 32);
+  TEST_ASSERT_EQUAL(32 + SERIAL_FRAME_OVERHEAD, len);
+
+  SerialFrameParser parser;
+  size_t used;
+  TEST_ASSERT_EQUAL(SERIAL_FRAME, feedAll(parser, stream, len, &used));
+  TEST_ASSERT_EQUAL(len, used);
+  TEST_ASSERT_EQUAL_UINT8(SERIAL_TYPE_PIXELS, parser.type());
+  TEST_ASSERT_EQUAL(32, parser.bodyLength());
+  TEST_ASSERT_EQUAL_MEMORY(body, parser.body(), 32);
+  TEST_ASSERT_EQUAL_UINT32(1, parser.frames());
+}
+
+static void test_whole_frame_of_max_pixels_fits(void)
+{
+  size_t bodyLength = SERIAL_MAX_PAYLOAD - 1;
+  TEST_ASSERT_EQUAL(2 + FRAME_MAX_PIXELS * 3, bodyLength);
+  size_t len = writeSerialFrame(stream, sizeof(stream), SERIAL_TYPE_PIXELS, body, bodyLength);
+  TEST_ASSERT_EQUAL(bodyLength + SERIAL_FRAME_OVERHEAD, len);
+  TEST_ASSERT_EQUAL(0, writeSerialFrame(stream, sizeof(stream), SERIAL_TYPE_PIXELS, body, bodyLength + 1));
+
+  SerialFrameParser parser;
+  size_t used;
+  TEST_ASSERT_EQUAL(SERIAL_FRAME, feedAll(parser, stream, len, &used));
+  TEST_ASSERT_EQUAL_MEMORY(body, parser.body(), bodyLength);
+}
+
+static void test_bad_crc_drops_the_frame(void)
+{
+  size_t len = writeSerialFrame(stream, sizeof(stream), SERIAL_TYPE_PIXELS, body, 10);
+  stream[8] ^= 0x01;
+
+  SerialFrameParser parser;
+  size_t used;
+  TEST_ASSERT_EQUAL(SERIAL_BAD_FRAME, feedAll(parser, stream, len, &used));
+  TEST_ASSERT_EQUAL_UINT32(1, parser.errors());
+  TEST_ASSERT_EQUAL_UINT32(0, parser.frames());
+
+  // The next good frame goes through
+  len = writeSerialFrame(stream, sizeof(stream), SERIAL_TYPE_STATS_REQUEST, body, 0);
+  TEST_ASSERT_EQUAL(SERIAL_FRAME, feedAll(parser, stream, len, &used));
+  TEST_ASSERT_EQUAL_UINT8(SERIAL_TYPE_STATS_REQUEST, parser.type());
+  TEST_ASSERT_EQUAL(0, parser.bodyLength());
+}
+
+static void test_impossible_length_is_rejected_at_once(void)
+{
+  const uint8_t header[] = {SERIAL_SYNC1, SERIAL_SYNC2, 0xFF, 0xFF};
+  SerialFrameParser parser;
+  size_t used;
+  TEST_ASSERT_EQUAL(SERIAL_BAD_FRAME, feedAll(parser, header, sizeof(header), &used));
+  TEST_ASSERT_EQUAL(sizeof(header), used);
+}
+
+static void test_text_lines_between_frames(void)
+{
+  const char *text = "12 255 0 128\r\n";
+  SerialFrameParser parser;
+  size_t used;
+  TEST_ASSERT_EQUAL(SERIAL_TEXT_LINE, feedAll(parser, (const uint8_t *)text, strlen(text), &used));
+  TEST_ASSERT_EQUAL_STRING("12 255 0 128", parser.line());
+
+  size_t len = writeSerialFrame(stream, sizeof(stream), SERIAL_TYPE_PIXELS, body, 5);
+  TEST_ASSERT_EQUAL(SERIAL_FRAME, feedAll(parser, stream, len, &used));
+
+  TEST_ASSERT_EQUAL(SERIAL_TEXT_LINE, feedAll(parser, (const uint8_t *)"3 1 2 3\n", 8, &used));
+  TEST_ASSERT_EQUAL_STRING("3 1 2 3", parser.line());
+}
+
+static void test_long_text_lines_are_cut(void)
+{
+  char text[SERIAL_MAX_LINE + 11];
+  memset(text, 'x', sizeof(text) - 1);
+  text[sizeof(text) - 1] = '\n';
+
+  SerialFrameParser parser;
+  size_t used;
+  TEST_ASSERT_EQUAL(SERIAL_TEXT_LINE, feedAll(parser, (const uint8_t *)text, sizeof(text), &used));
+  TEST_ASSERT_EQUAL(SERIAL_MAX_LINE, strlen(parser.line()));
+}
+
+// A stream of binary frames with a text line now and then. Frame n's body is
+// n as 16 bits, then 0 to 62 bytes of its low byte.
+#define STREAM_FRAMES 1000
+static uint8_t longStream[STREAM_FRAMES * (64 + SERIAL_FRAME_OVERHEAD + 16)];
+static size_t frameAt[STREAM_FRAMES + 1]; // Offset where each frame starts, and the end of the stream
+static uint32_t noise;
+
+static uint32_t random32()
+{
+  noise = noise * 1664525 + 1013904223;
+  return noise >> 8;
+}
+
+static size_t buildStream(void)
+{
+  size_t len = 0;
+  for (int n = 0; n < STREAM_FRAMES; n++)
+  {
+    if (n % 5 == 0)
+    {
+      len += sprintf((char *)&longStream[len], "%d 1 2 3\n", n % 256);
+    }
+    size_t bodyLength = 2 + n % 63;
+    memset(body, n, bodyLength);
+    body[0] = n & 0xFF;
+    body[1] = n >> 8;
+    frameAt[n] = len;
+    len += writeSerialFrame(&longStream[len], sizeof(longStream) - len, SERIAL_TYPE_PIXELS, body, bodyLength);
+  }
+  frameAt[STREAM_FRAMES] = len;
+  return len;
+}
+
+// Feed the stream in pieces of random size, as UART reads return them, and
+// mark the frames that come out. Every frame must be one that was sent.
+static int parseInPieces(SerialFrameParser &parser, const uint8_t *data, size_t len, bool *seen, int *lines)
+{
+  int frames = 0;
+  size_t pos = 0;
+  while (pos < len)
+  {
+    size_t piece = 1 + random32() % 97;
+    for (size_t i = pos; i < pos + piece && i < len; i++)
+    {
+      SerialEvent event = parser.feed(data[i]);
+      if (event == SERIAL_FRAME)
+      {
+        const uint8_t *read = parser.body();
+        int n = read[0] | (read[1] << 8);
+        TEST_ASSERT_LESS_THAN(STREAM_FRAMES, n);
+        TEST_ASSERT_EQUAL(2 + n % 63, parser.bodyLength());
+        for (size_t b = 2; b < parser.bodyLength(); b++)
+        {
+          TEST_ASSERT_EQUAL_UINT8(n & 0xFF, read[b]);
+        }
+        seen[n] = true;
+        frames++;
+      }
+      else if (event == SERIAL_TEXT_LINE)
+      {
+        (*lines)++;
+      }
+    }
+    pos += piece;
+  }
+  return frames;
+}
+
+static void test_fragmented_stream(void)
+{
+  noise = 1;
+  size_t len = buildStream();
+  static bool seen[STREAM_FRAMES];
+  memset(seen, 0, sizeof(seen));
+  int lines = 0;
+  SerialFrameParser parser;
+  TEST_ASSERT_EQUAL(STREAM_FRAMES, parseInPieces(parser, longStream, len, seen, &lines));
+  TEST_ASSERT_EQUAL(STREAM_FRAMES / 5, lines);
+  TEST_ASSERT_EQUAL_UINT32(0, parser.errors());
+}
+
+static void test_corrupt_stream_never_yields_a_bad_frame(void)
+{
+  // A damaged length makes the parser wait for that many bytes before the
+  // CRC fails, so it may miss what follows for up to one full frame
+  const size_t resync = SERIAL_MAX_PAYLOAD + SERIAL_FRAME_OVERHEAD;
+  static bool seen[STREAM_FRAMES];
+  static bool damaged[STREAM_FRAMES];
+  static size_t startsAt[STREAM_FRAMES];      // Where each frame starts in the damaged stream
+  static size_t damagedBefore[STREAM_FRAMES]; // End of the last damaged frame before it, 0 for none
+  int checked = 0;
+  uint32_t errors = 0;
+  for (uint32_t seed = 1; seed <= 20; seed++)
+  {
+    noise = seed;
+    size_t len = buildStream();
+
+    // Damage one frame in 250: a flipped bit anywhere in it, or bytes lost
+    size_t cut = 0;
+    size_t lastDamage = 0;
+    for (int n = 0; n < STREAM_FRAMES; n++)
+    {
+      startsAt[n] = frameAt[n] - cut;
+      damagedBefore[n] = lastDamage;
+      damaged[n] = random32() % 250 == 0;
+      if (!damaged[n])
+      {
+        continue;
+      }
+      size_t at = frameAt[n] + random32() % (frameAt[n + 1] - frameAt[n]);
+      if (random32() % 2 == 0)
+      {
+        longStream[at - cut] ^= 1 << (random32() % 8);
+      }
+      else
+      {
+        size_t lost = 1 + random32() % 3;
+        lost = at + lost > len ? len - at : lost;
+        memmove(&longStream[at - cut], &longStream[at - cut + lost], len - at - lost);
+        cut += lost;
+      }
+      lastDamage = frameAt[n + 1] - cut;
+    }
+    len -= cut;
+
+    memset(seen, 0, sizeof(seen));
+    int lines = 0;
+    SerialFrameParser parser;
+    parseInPieces(parser, longStream, len, seen, &lines);
+    errors += parser.errors();
+    for (int n = 0; n < STREAM_FRAMES; n++)
+    {
+      if (!damaged[n] && (damagedBefore[n] == 0 || startsAt[n] - damagedBefore[n] >= resync))
+      {
+        TEST_ASSERT_TRUE(seen[n]); // Back in sync
+        checked++;
+      }
+    }
+  }
+  TEST_ASSERT_GREATER_THAN(0, errors);
+  TEST_ASSERT_GREATER_THAN(20 * STREAM_FRAMES / 2, checked);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_frame_round_trip);
+  RUN_TEST(test_whole_frame_of_max_pixels_fits);
+  RUN_TEST(test_bad_crc_drops_the_frame);
+  RUN_TEST(test_impossible_length_is_rejected_at_once);
+  RUN_TEST(test_text_lines_between_frames);
+  RUN_TEST(test_long_text_lines_are_cut);
+  RUN_TEST(test_fragmented_stream);
+  RUN_TEST(test_corrupt_stream_never_yields_a_bad_frame);
+  return UNITY_END();
+}
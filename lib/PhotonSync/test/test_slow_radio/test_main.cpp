@@ -0,0 +1,181 @@
+#include <unity.h>
+#include <string.h>
+#include "FramePacker.h"
+#include "FrameReceiver.h"
+#include "TxRing.h"
+
+// The sender's TX path against a radio slower than the frames coming in, on
+// a simulated clock. The mock transport keeps each packet on air for its
+// length at 1 Mbit/s and completes it through onSent() as the send callback
+// would. Packets that go out reach a FrameReceiver.
+
+#define FRAME_PIXELS 600
+#define TICK_US 100
+#define AIR_US_PER_BYTE 8 // 1 Mbit/s
+#define AIR_OVERHEAD_US 200
+
+static const uint8_t SENDER_MAC[6] = {1, 1, 1, 1, 1, 1};
+
+static FrameReceiver *receiver;
+static uint8_t air[FRAME_MAX_PACKET];
+static size_t airLength;
+static bool airBusy;
+static bool overlapped;
+static uint64_t now;    // Simulated micros()
+static uint64_t doneAt; // When the packet on air completes
+static uint32_t started;
+static uint32_t noise;
+
+static bool transport(const uint8_t *data, size_t len)
+{
+  overlapped = overlapped || airBusy;
+  memcpy(air, data, len);
+  airLength = len;
+  airBusy = true;
+  doneAt = now + AIR_OVERHEAD_US + len * AIR_US_PER_BYTE;
+  started++;
+  return true;
+}
+
+static TxRing *ring;
+
+static uint8_t *reservePacket()
+{
+  return ring->reserve();
+}
+
+static void sendPacket(size_t len)
+{
+  ring->commit(len);
+}
+
+static const PacketSink sink = {reservePacket, sendPacket};
+
+static uint32_t random32()
+{
+  noise = noise * 1664525 + 1013904223;
+  return noise >> 8;
+}
+
+// Complete the packet on air once its time is up. One acknowledgement in
+// ackLoss is lost although the packet arrived, so the ring sends it again.
+static void radioTick(uint32_t ackLoss)
+{
+  if (!airBusy || now < doneAt)
+  {
+    return;
+  }
+  airBusy = false;
+  receiver->receive(SENDER_MAC, air, airLength, (uint32_t)now, (unsigned long)(now / 1000));
+  ring->onSent(ackLoss == 0 || random32() % ackLoss != 0);
+}
+
+void setUp(void)
+{
+  receiver = new FrameReceiver();
+  ring = new TxRing(transport);
+  airBusy = false;
+  overlapped = false;
+  now = 0;
+  started = 0;
+  noise = 1;
+}
+
+void tearDown(void)
+{
+  delete ring;
+  delete receiver;
+}
+
+static void test_newest_frame_wins_when_the_radio_falls_behind(void)
+{
+  static RGB frame[FRAME_PIXELS];
+  FramePacker packer(sink, 10);
+  const uint32_t frameIntervalUs = 5000; // 200 frames/s of 600 random pixels, far more than the air carries
+  uint32_t produced = 0;
+  uint32_t published = 0;
+  uint32_t refusedFlushes = 0;
+  uint64_t lastFrameAt = 0;
+
+  for (; now < 2000000; now += TICK_US)
+  {
+    if (now % frameIntervalUs == 0)
+    {
+      for (int i = 0; i < FRAME_PIXELS; i++)
+      {
+        RGB color = {(uint8_t)random32(), (uint8_t)random32(), (uint8_t)random32()};
+        frame[i] = color;
+      }
+      packer.set(0, frame, FRAME_PIXELS, now / 1000);
+      refusedFlushes += !packer.flush();
+      produced++;
+      lastFrameAt = now;
+    }
+    radioTick(10);
+    ring->kick();
+    packer.poll(now / 1000);
+    published += receiver->takeFrame();
+  }
+
+  // Stop producing and let the ring drain, the last frame must arrive whole
+  uint64_t stoppedAt = now;
+  while ((packer.pending() > 0 || ring->queued() > 0 || airBusy) && now < stoppedAt + 1000000)
+  {
+    now += TICK_US;
+    radioTick(10);
+    ring->kick();
+    packer.poll(now / 1000);
+    published += receiver->takeFrame();
+  }
+  TEST_ASSERT_EQUAL(0, packer.pending());
+  TEST_ASSERT_EQUAL(0, ring->queued());
+  TEST_ASSERT_EQUAL_MEMORY(frame, receiver->frame().pixels, sizeof(frame));
+
+  TEST_ASSERT_FALSE(overlapped); // Never more than one packet on air
+  TEST_ASSERT_GREATER_THAN(0, refusedFlushes);
+  TEST_ASSERT_GREATER_THAN(0, ring->full()); // Backpressure, not blocking
+  TEST_ASSERT_LESS_THAN(produced / 2, published); // Stale frames were coalesced away
+  TEST_ASSERT_GREATER_THAN(0, ring->retried());
+  // The last frame only waited for what was already queued, a few frames of air time
+  TEST_ASSERT_LESS_THAN(100000, now - lastFrameAt);
+}
+
+static void test_frames_pass_untouched_when_the_radio_keeps_up(void)
+{
+  static RGB frame[FRAME_PIXELS];
+  FramePacker packer(sink, 10);
+  uint32_t produced = 0;
+  uint32_t published = 0;
+  for (; now < 1000000; now += TICK_US)
+  {
+    if (now % 50000 == 0) // 20 frames/s, a few pixels each
+    {
+      for (int i = 0; i < 10; i++)
+      {
+        frame[random32() % FRAME_PIXELS].red++;
+      }
+      packer.set(0, frame, FRAME_PIXELS, now / 1000);
+      TEST_ASSERT_TRUE(packer.flush());
+      produced++;
+    }
+    radioTick(0);
+    ring->kick();
+    if (receiver->takeFrame())
+    {
+      published++;
+      TEST_ASSERT_EQUAL_MEMORY(frame, receiver->frame().pixels, sizeof(frame));
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(produced, published);
+  TEST_ASSERT_EQUAL_UINT32(0, ring->full());
+  TEST_ASSERT_EQUAL_UINT32(0, ring->failed());
+  TEST_ASSERT_EQUAL_UINT32(started, ring->delivered());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_newest_frame_wins_when_the_radio_falls_behind);
+  RUN_TEST(test_frames_pass_untouched_when_the_radio_keeps_up);
+  return UNITY_END();
+}
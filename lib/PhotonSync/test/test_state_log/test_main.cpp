@@ -0,0 +1,370 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "StateLog.h"
+
+// The log in RAM, in place of SPIFFS
+class MemoryStorage : public StateStorage
+{
+public:
+  MemoryStorage() : len(0), writes(0), written(0), replaced(0), fail(false) {}
+
+  size_t read(uint8_t *out, size_t capacity)
+  {
+    size_t n = len < capacity ? len : capacity;
+    memcpy(out, data, n);
+    return n;
+  }
+
+  bool append(const uint8_t *bytes, size_t n)
+  {
+    if (fail || len + n > sizeof(data))
+    {
+      return false;
+    }
+    memcpy(&data[len], bytes, n);
+    len += n;
+    writes++;
+    written += n;
+    return true;
+  }
+
+  bool replace(const uint8_t *bytes, size_t n)
+  {
+    if (fail || n > sizeof(data))
+    {
+      return false;
+    }
+    memcpy(data, bytes, n);
+    len = n;
+    writes++;
+    written += n;
+    replaced++;
+    return true;
+  }
+
+  uint8_t data[STATE_LOG_MAX];
+  size_t len;
+  int writes;
+  size_t written; // Bytes put to flash, the wear
+  int replaced;   // Compactions
+  bool fail;
+};
+
+static MemoryStorage storage;
+static RGB pixels[FRAME_MAX_PIXELS];
+static RGB restored[FRAME_MAX_PIXELS];
+static SceneTable scenes;
+static SceneTable restoredScenes;
+static FrameTarget target;
+
+void setUp(void)
+{
+  storage = MemoryStorage();
+  memset(pixels, 0, sizeof(pixels));
+  memset(restored, 0, sizeof(restored));
+  memset(&scenes, 0, sizeof(scenes));
+  memset(&restoredScenes, 0, sizeof(restoredScenes));
+  target.pixels = restored;
+  target.size = FRAME_MAX_PIXELS;
+  target.windowStart = 0;
+  target.windowCount = FRAME_MAX_PIXELS;
+  target.fades = NULL;
+  target.maxFades = 0;
+  target.fadeCount = 0;
+  target.scenes = &restoredScenes;
+}
+
+void tearDown(void)
+{
+}
+
+static void paint(uint16_t count, uint8_t seed)
+{
+  for (uint16_t i = 0; i < count; i++)
+  {
+    pixels[i].red = i + seed;
+    pixels[i].green = i * 3;
+    pixels[i].blue = seed;
+  }
+}
+
+static Scene loopingChase()
+{
+  Scene scene;
+  memset(&scene, 0, sizeof(scene));
+  scene.flags = SCENE_FLAG_LOOP;
+  scene.stepCount = 1;
+  scene.steps[0].effect = SCENE_CHASE;
+  scene.steps[0].count = 60;
+  scene.steps[0].a.red = 255;
+  scene.steps[0].durationMs = 1000;
+  scene.steps[0].width = 3;
+  return scene;
+}
+
+static void test_nothing_to_restore_without_a_log(void)
+{
+  StateLog log(storage);
+  TEST_ASSERT_EQUAL(0, log.restore(&target));
+}
+
+static void test_saved_pixels_come_back(void)
+{
+  paint(300, 1);
+  {
+    StateLog log(storage);
+    TEST_ASSERT_TRUE(log.save(pixels, 0, 300, scenes));
+  }
+
+  StateLog log(storage); // After a reset
+  TEST_ASSERT_GREATER_THAN(0, log.restore(&target));
+  TEST_ASSERT_EQUAL_MEMORY(pixels, restored, 300 * sizeof(RGB));
+  TEST_ASSERT_EQUAL(storage.len, log.size());
+}
+
+static void test_later_saves_append_deltas(void)
+{
+  StateLog log(storage);
+  paint(300, 1);
+  TEST_ASSERT_TRUE(log.save(pixels, 0, 300, scenes));
+  size_t first = storage.len;
+
+  pixels[10].red ^= 0xFF;
+  TEST_ASSERT_TRUE(log.save(pixels, 0, 300, scenes));
+  TEST_ASSERT_LESS_THAN(32, storage.len - first); // One small record
+
+  int writes = storage.writes;
+  TEST_ASSERT_TRUE(log.save(pixels, 0, 300, scenes));
+  TEST_ASSERT_EQUAL(writes, storage.writes); // Unchanged, nothing written
+
+  StateLog after(storage);
+  TEST_ASSERT_EQUAL(2, after.restore(&target));
+  TEST_ASSERT_EQUAL_MEMORY(pixels, restored, 300 * sizeof(RGB));
+}
+
+static void test_looping_scene_is_restored_playing(void)
+{
+  StateLog log(storage);
+  scenes.slots[2] = loopingChase();
+  scenes.playing = 1 << 2;
+  TEST_ASSERT_TRUE(log.save(pixels, 0, 60, scenes));
+
+  StateLog after(storage);
+  TEST_ASSERT_GREATER_THAN(0, after.restore(&target));
+  TEST_ASSERT_EQUAL_UINT8(1, restoredScenes.slots[2].stepCount);
+  TEST_ASSERT_EQUAL_UINT8(SCENE_CHASE, restoredScenes.slots[2].steps[0].effect);
+  TEST_ASSERT_EQUAL_UINT8(1 << 2, restoredScenes.playing);
+}
+
+static void test_torn_record_stops_the_restore(void)
+{
+  StateLog log(storage);
+  paint(100, 1);
+  TEST_ASSERT_TRUE(log.save(pixels, 0, 100, scenes));
+  size_t good = storage.len;
+  RGB kept[100];
+  memcpy(kept, pixels, sizeof(kept));
+
+  paint(100, 2);
+  TEST_ASSERT_TRUE(log.save(pixels, 0, 100, scenes));
+  storage.len = good + (storage.len - good) / 2; // Reset halfway through the append
+
+  StateLog after(storage);
+  TEST_ASSERT_EQUAL(1, after.restore(&target));
+  TEST_ASSERT_EQUAL_MEMORY(kept, restored, sizeof(kept));
+  TEST_ASSERT_EQUAL(good, after.size());
+
+  // The next save drops the broken tail
+  TEST_ASSERT_TRUE(after.save(pixels, 0, 100, scenes));
+  StateLog again(storage);
+  TEST_ASSERT_EQUAL(1, again.restore(&target));
+  TEST_ASSERT_EQUAL_MEMORY(pixels, restored, 100 * sizeof(RGB));
+}
+
+static void test_log_is_compacted_before_it_overflows(void)
+{
+  StateLog log(storage);
+  for (int i = 0; i < 400; i++)
+  {
+    paint(FRAME_MAX_PIXELS, i);
+    TEST_ASSERT_TRUE(log.save(pixels, 0, FRAME_MAX_PIXELS, scenes));
+    TEST_ASSERT_LESS_OR_EQUAL(STATE_LOG_MAX, storage.len);
+  }
+
+  StateLog after(storage);
+  TEST_ASSERT_GREATER_THAN(0, after.restore(&target));
+  TEST_ASSERT_EQUAL_MEMORY(pixels, restored, sizeof(pixels));
+}
+
+static void test_refused_write_is_reported(void)
+{
+  StateLog log(storage);
+  paint(50, 1);
+  storage.fail = true;
+  TEST_ASSERT_FALSE(log.save(pixels, 0, 50, scenes));
+  storage.fail = false;
+  TEST_ASSERT_TRUE(log.save(pixels, 0, 50, scenes));
+
+  StateLog after(storage);
+  TEST_ASSERT_GREATER_THAN(0, after.restore(&target));
+  TEST_ASSERT_EQUAL_MEMORY(pixels, restored, 50 * sizeof(RGB));
+}
+
+// Saves that each change a few pixels, like a receiver between button
+// presses. Remembers the pixels and the log length after every save.
+#define HISTORY 40
+#define HISTORY_PIXELS 200
+static RGB history[HISTORY][HISTORY_PIXELS];
+static size_t historyEnd[HISTORY];
+
+static void saveHistory(StateLog &log)
+{
+  paint(HISTORY_PIXELS, 7);
+  for (int k = 0; k < HISTORY; k++)
+  {
+    if (k > 0)
+    {
+      for (int i = 0; i < 3; i++)
+      {
+        pixels[(k * 37 + i * 11) % HISTORY_PIXELS].green += 29;
+      }
+    }
+    TEST_ASSERT_TRUE(log.save(pixels, 0, HISTORY_PIXELS, scenes));
+    memcpy(history[k], pixels, sizeof(history[k]));
+    historyEnd[k] = storage.len;
+  }
+}
+
+static void test_reset_at_every_byte_of_an_append(void)
+{
+  StateLog log(storage);
+  saveHistory(log);
+  static uint8_t full[STATE_LOG_MAX];
+  size_t fullLen = storage.len;
+  memcpy(full, storage.data, fullLen);
+
+  // The last save cut at every length: the one before it comes back whole
+  for (size_t cut = historyEnd[HISTORY - 2]; cut < fullLen; cut++)
+  {
+    memcpy(storage.data, full, fullLen);
+    storage.len = cut;
+    memset(restored, 0, sizeof(restored));
+    StateLog after(storage);
+    TEST_ASSERT_EQUAL(HISTORY - 1, after.restore(&target));
+    TEST_ASSERT_EQUAL_MEMORY(history[HISTORY - 2], restored, sizeof(history[0]));
+
+    // And the next save leaves a log that restores to it
+    TEST_ASSERT_TRUE(after.save(history[HISTORY - 1], 0, HISTORY_PIXELS, scenes));
+    memset(restored, 0, sizeof(restored));
+    StateLog again(storage);
+    TEST_ASSERT_GREATER_THAN(0, again.restore(&target));
+    TEST_ASSERT_EQUAL_MEMORY(history[HISTORY - 1], restored, sizeof(history[0]));
+  }
+}
+
+static void test_flipped_bit_stops_at_its_record(void)
+{
+  // Flash that went bad under one record: everything saved before it is
+  // restored, nothing from it or after it
+  StateLog log(storage);
+  saveHistory(log);
+  static uint8_t full[STATE_LOG_MAX];
+  size_t fullLen = storage.len;
+  memcpy(full, storage.data, fullLen);
+
+  for (size_t at = 0; at < fullLen; at += 3)
+  {
+    memcpy(storage.data, full, fullLen);
+    storage.len = fullLen;
+    storage.data[at] ^= 1 << (at % 8);
+    int kept = 0;
+    while (kept < HISTORY && historyEnd[kept] <= at)
+    {
+      kept++;
+    }
+    memset(restored, 0, sizeof(restored));
+    StateLog after(storage);
+    TEST_ASSERT_EQUAL(at < 4 ? 0 : kept, after.restore(&target)); // The first 4 bytes are the log header
+    if (kept > 0 && at >= 4)
+    {
+      TEST_ASSERT_EQUAL_MEMORY(history[kept - 1], restored, sizeof(history[0]));
+    }
+  }
+}
+
+static void test_refused_compaction_keeps_the_old_log(void)
+{
+  // A full flash refusing the compacted log: the old one still restores
+  static RGB lastGood[FRAME_MAX_PIXELS];
+  StateLog log(storage);
+  uint8_t seed = 1;
+  do
+  {
+    paint(FRAME_MAX_PIXELS, seed++); // Every pixel changes, each delta is a whole frame
+    TEST_ASSERT_TRUE(log.save(pixels, 0, FRAME_MAX_PIXELS, scenes));
+  } while (log.size() + 3 * FRAME_MAX_PIXELS + 64 <= STATE_LOG_MAX);
+  memcpy(lastGood, pixels, sizeof(lastGood));
+  TEST_ASSERT_EQUAL(1, storage.replaced);
+
+  // The next frame does not fit behind the log
+  paint(FRAME_MAX_PIXELS, seed);
+  storage.fail = true;
+  TEST_ASSERT_FALSE(log.save(pixels, 0, FRAME_MAX_PIXELS, scenes));
+  storage.fail = false;
+
+  StateLog after(storage);
+  TEST_ASSERT_GREATER_THAN(0, after.restore(&target));
+  TEST_ASSERT_EQUAL_MEMORY(lastGood, restored, sizeof(restored));
+
+  // Once the flash takes it, the compacted log replaces the old one
+  TEST_ASSERT_TRUE(log.save(pixels, 0, FRAME_MAX_PIXELS, scenes));
+  TEST_ASSERT_EQUAL(2, storage.replaced);
+  StateLog again(storage);
+  TEST_ASSERT_EQUAL(1, again.restore(&target));
+  TEST_ASSERT_EQUAL_MEMORY(pixels, restored, sizeof(restored));
+}
+
+static void test_flash_wear_of_small_changes(void)
+{
+  // An hour of saves once a second, each changing a handful of pixels
+  StateLog log(storage);
+  paint(600, 1);
+  uint32_t noise = 1;
+  for (int second = 0; second < 3600; second++)
+  {
+    for (int i = 0; i < 5; i++)
+    {
+      noise = noise * 1664525 + 1013904223;
+      pixels[(noise >> 8) % 600].blue = noise >> 24;
+    }
+    TEST_ASSERT_TRUE(log.save(pixels, 0, 600, scenes));
+  }
+  memset(restored, 0, sizeof(restored));
+  StateLog after(storage);
+  TEST_ASSERT_GREATER_THAN(0, after.restore(&target));
+  TEST_ASSERT_EQUAL_MEMORY(pixels, restored, 600 * sizeof(RGB));
+
+  char line[120];
+  snprintf(line, sizeof(line), "3600 saves of 5 changed pixels: %u B written, %u per save, %d compactions",
+           (unsigned)storage.written, (unsigned)(storage.written / 3600), storage.replaced);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN(600 * 3 * 3600 / 10, storage.written); // A tenth of rewriting the frame each time
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_to_restore_without_a_log);
+  RUN_TEST(test_saved_pixels_come_back);
+  RUN_TEST(test_later_saves_append_deltas);
+  RUN_TEST(test_looping_scene_is_restored_playing);
+  RUN_TEST(test_torn_record_stops_the_restore);
+  RUN_TEST(test_log_is_compacted_before_it_overflows);
+  RUN_TEST(test_refused_write_is_reported);
+  RUN_TEST(test_reset_at_every_byte_of_an_append);
+  RUN_TEST(test_flipped_bit_stops_at_its_record);
+  RUN_TEST(test_refused_compaction_keeps_the_old_log);
+  RUN_TEST(test_flash_wear_of_small_changes);
+  return UNITY_END();
+}
@@ -0,0 +1,183 @@
+#include <unity.h>
+#include <string.h>
+#include <thread>
+#include "SerialFrameParser.h"
+#include "Telemetry.h"
+
+// Counters, histogram buckets and the stats packet layout a reader decodes
+
+static Telemetry *stats;
+static uint8_t packet[TELEMETRY_PACKET_SIZE];
+
+static uint32_t getU32(const uint8_t *in)
+{
+  return in[0] | in[1] << 8 | in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+static uint32_t packetCounter(TelemetryCounter counter)
+{
+  return getU32(&packet[8 + counter * 4]);
+}
+
+// Field of a histogram: 0 count, 1 sum, 2 max, 3 + i bucket i
+static uint32_t packetHistogram(TelemetryHistogram histogram, int field)
+{
+  return getU32(&packet[8 + TELEMETRY_COUNTERS * 4 + histogram * TELEMETRY_HISTOGRAM_SIZE + field * 4]);
+}
+
+void setUp(void)
+{
+  stats = new Telemetry();
+}
+
+void tearDown(void)
+{
+  delete stats;
+}
+
+static void test_packet_layout(void)
+{
+  stats->count(TELEMETRY_PACKETS_SENT);
+  stats->count(TELEMETRY_FRAMES_DROPPED, 7);
+  stats->record(TELEMETRY_SHOW_US, 3000);
+  TEST_ASSERT_EQUAL(TELEMETRY_PACKET_SIZE, stats->write(packet, sizeof(packet), TELEMETRY_RECEIVER, 0x12345678));
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_VERSION, packet[0]);
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_RECEIVER, packet[1]);
+  TEST_ASSERT_EQUAL_UINT32(0x12345678, getU32(&packet[2]));
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_COUNTERS, packet[6]);
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_HISTOGRAMS, packet[7]);
+  TEST_ASSERT_EQUAL_UINT32(1, packetCounter(TELEMETRY_PACKETS_SENT));
+  TEST_ASSERT_EQUAL_UINT32(7, packetCounter(TELEMETRY_FRAMES_DROPPED));
+  TEST_ASSERT_EQUAL_UINT32(0, packetCounter(TELEMETRY_PACKETS_ACKED));
+  TEST_ASSERT_EQUAL_UINT32(1, packetHistogram(TELEMETRY_SHOW_US, 0));
+  TEST_ASSERT_EQUAL_UINT32(3000, packetHistogram(TELEMETRY_SHOW_US, 1));
+  TEST_ASSERT_EQUAL_UINT32(3000, packetHistogram(TELEMETRY_SHOW_US, 2));
+  TEST_ASSERT_EQUAL_UINT32(1, packetHistogram(TELEMETRY_SHOW_US, 3 + 11)); // 2048 <= 3000 < 4096
+  TEST_ASSERT_EQUAL_UINT32(0, packetHistogram(TELEMETRY_ACK_US, 0));
+
+  TEST_ASSERT_EQUAL(0, stats->write(packet, TELEMETRY_PACKET_SIZE - 1, TELEMETRY_RECEIVER, 0));
+}
+
+static void test_bucket_edges(void)
+{
+  const uint32_t values[] = {0, 1, 2, 3, 4, 32767, 32768, 0xFFFFFFFF};
+  const int buckets[] = {0, 0, 1, 1, 2, 14, 15, 15};
+  for (int i = 0; i < 8; i++)
+  {
+    Telemetry one;
+    one.record(TELEMETRY_LOOP_US, values[i]);
+    one.write(packet, sizeof(packet), TELEMETRY_SENDER, 0);
+    for (int b = 0; b < TELEMETRY_BUCKETS; b++)
+    {
+      TEST_ASSERT_EQUAL_UINT32(b == buckets[i], packetHistogram(TELEMETRY_LOOP_US, 3 + b));
+    }
+  }
+}
+
+static void test_max_only_grows(void)
+{
+  stats->record(TELEMETRY_ACK_US, 500);
+  stats->record(TELEMETRY_ACK_US, 9000);
+  stats->record(TELEMETRY_ACK_US, 20);
+  stats->write(packet, sizeof(packet), TELEMETRY_SENDER, 0);
+  TEST_ASSERT_EQUAL_UINT32(3, packetHistogram(TELEMETRY_ACK_US, 0));
+  TEST_ASSERT_EQUAL_UINT32(9520, packetHistogram(TELEMETRY_ACK_US, 1));
+  TEST_ASSERT_EQUAL_UINT32(9000, packetHistogram(TELEMETRY_ACK_US, 2));
+}
+
+static void test_interval(void)
+{
+  uint32_t last = 0;
+  stats->interval(TELEMETRY_LOOP_US, 1000, &last); // Only starts timing
+  stats->interval(TELEMETRY_LOOP_US, 3000, &last);
+  stats->interval(TELEMETRY_LOOP_US, 0xFFFFFF00, &last);
+  stats->interval(TELEMETRY_LOOP_US, 0, &last); // micros() wrapped onto 0
+  stats->interval(TELEMETRY_LOOP_US, 100, &last);
+  stats->write(packet, sizeof(packet), TELEMETRY_SENDER, 0);
+  TEST_ASSERT_EQUAL_UINT32(4, packetHistogram(TELEMETRY_LOOP_US, 0));
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFF00 - 3000, packetHistogram(TELEMETRY_LOOP_US, 2));
+  TEST_ASSERT_EQUAL_UINT32(1, packetHistogram(TELEMETRY_LOOP_US, 3 + 8)); // 256 across the wrap
+  TEST_ASSERT_EQUAL_UINT32(1, packetHistogram(TELEMETRY_LOOP_US, 3 + 6)); // 0 is stored as 1, so 99
+}
+
+static void test_stats_frame_reaches_the_parser(void)
+{
+  stats->count(TELEMETRY_SERIAL_FRAMES, 42);
+  uint8_t body[TELEMETRY_PACKET_SIZE];
+  uint8_t frame[TELEMETRY_PACKET_SIZE + SERIAL_FRAME_OVERHEAD];
+  size_t len = stats->write(body, sizeof(body), TELEMETRY_SENDER, 5);
+  len = writeSerialFrame(frame, sizeof(frame), SERIAL_TYPE_STATS, body, len);
+  TEST_ASSERT_EQUAL(sizeof(frame), len);
+
+  SerialFrameParser *parser = new SerialFrameParser();
+  SerialEvent event = SERIAL_NONE;
+  for (size_t i = 0; i < len; i++)
+  {
+    event = parser->feed(frame[i]);
+  }
+  TEST_ASSERT_EQUAL(SERIAL_FRAME, event);
+  TEST_ASSERT_EQUAL_UINT8(SERIAL_TYPE_STATS, parser->type());
+  TEST_ASSERT_EQUAL(TELEMETRY_PACKET_SIZE, parser->bodyLength());
+  memcpy(packet, parser->body(), TELEMETRY_PACKET_SIZE);
+  TEST_ASSERT_EQUAL_UINT32(42, packetCounter(TELEMETRY_SERIAL_FRAMES));
+  delete parser;
+}
+
+static void recordMany(int seed)
+{
+  for (int i = 0; i < 100000; i++)
+  {
+    stats->count(TELEMETRY_PACKETS_RECEIVED);
+    stats->record(TELEMETRY_SHOW_US, (uint32_t)(seed * 100000 + i));
+  }
+}
+
+static void test_tasks_lose_no_counts(void)
+{
+  // Four tasks record while another keeps building packets
+  std::thread tasks[4];
+  for (int t = 0; t < 4; t++)
+  {
+    tasks[t] = std::thread(recordMany, t);
+  }
+  uint32_t snapshots = 0;
+  uint32_t previous = 0;
+  bool monotonic = true;
+  while (previous < 400000)
+  {
+    uint8_t snapshot[TELEMETRY_PACKET_SIZE];
+    stats->write(snapshot, sizeof(snapshot), TELEMETRY_RECEIVER, 0);
+    uint32_t received = getU32(&snapshot[8 + TELEMETRY_PACKETS_RECEIVED * 4]);
+    monotonic = monotonic && received >= previous;
+    previous = received;
+    snapshots++;
+  }
+  for (int t = 0; t < 4; t++)
+  {
+    tasks[t].join();
+  }
+  stats->write(packet, sizeof(packet), TELEMETRY_RECEIVER, 0);
+  TEST_ASSERT_TRUE(monotonic);
+  TEST_ASSERT_GREATER_THAN(1, snapshots);
+  TEST_ASSERT_EQUAL_UINT32(400000, packetCounter(TELEMETRY_PACKETS_RECEIVED));
+  TEST_ASSERT_EQUAL_UINT32(400000, packetHistogram(TELEMETRY_SHOW_US, 0));
+  TEST_ASSERT_EQUAL_UINT32(399999, packetHistogram(TELEMETRY_SHOW_US, 2));
+  uint32_t bucketed = 0;
+  for (int b = 0; b < TELEMETRY_BUCKETS; b++)
+  {
+    bucketed += packetHistogram(TELEMETRY_SHOW_US, 3 + b);
+  }
+  TEST_ASSERT_EQUAL_UINT32(400000, bucketed);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_packet_layout);
+  RUN_TEST(test_bucket_edges);
+  RUN_TEST(test_max_only_grows);
+  RUN_TEST(test_interval);
+  RUN_TEST(test_stats_frame_reaches_the_parser);
+  RUN_TEST(test_tasks_lose_no_counts);
+  return UNITY_END();
+}
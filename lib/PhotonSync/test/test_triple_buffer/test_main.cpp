@@ -0,0 +1,71 @@
+#include <unity.h>
+#include "TripleBuffer.h"
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_nothing_to_take_before_the_first_publish(void)
+{
+  TripleBuffer<int> frames;
+  TEST_ASSERT_FALSE(frames.update());
+}
+
+static void test_published_buffer_reaches_the_consumer(void)
+{
+  TripleBuffer<int> frames;
+  frames.writeBuffer() = 1;
+  TEST_ASSERT_FALSE(frames.publish());
+  TEST_ASSERT_TRUE(frames.update());
+  TEST_ASSERT_EQUAL(1, frames.readBuffer());
+
+  // Taken once, the read buffer stays put
+  TEST_ASSERT_FALSE(frames.update());
+  TEST_ASSERT_EQUAL(1, frames.readBuffer());
+}
+
+static void test_newest_frame_wins(void)
+{
+  TripleBuffer<int> frames;
+  frames.writeBuffer() = 1;
+  TEST_ASSERT_FALSE(frames.publish());
+  frames.writeBuffer() = 2;
+  TEST_ASSERT_TRUE(frames.publish()); // Replaced 1, never taken
+  frames.writeBuffer() = 3;
+  TEST_ASSERT_TRUE(frames.publish());
+
+  TEST_ASSERT_TRUE(frames.update());
+  TEST_ASSERT_EQUAL(3, frames.readBuffer());
+  TEST_ASSERT_FALSE(frames.update());
+}
+
+static void test_producer_never_writes_the_read_buffer(void)
+{
+  TripleBuffer<int> frames;
+  for (int i = 1; i <= 100; i++)
+  {
+    int &write = frames.writeBuffer();
+    TEST_ASSERT_TRUE(&write != &frames.readBuffer());
+    write = i;
+    frames.publish();
+    if (i % 3 == 0)
+    {
+      TEST_ASSERT_TRUE(frames.update());
+      TEST_ASSERT_EQUAL(i, frames.readBuffer());
+    }
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_to_take_before_the_first_publish);
+  RUN_TEST(test_published_buffer_reaches_the_consumer);
+  RUN_TEST(test_newest_frame_wins);
+  RUN_TEST(test_producer_never_writes_the_read_buffer);
+  return UNITY_END();
+}
@@ -0,0 +1,143 @@
+#include <unity.h>
+#include <string.h>
+#include "TxRing.h"
+
+// A radio that takes one packet at a time and completes it when told to
+static uint8_t sentFirstByte[64];
+static size_t sentCount;
+static bool refuse;
+
+static bool transport(const uint8_t *data, size_t len)
+{
+  if (refuse)
+  {
+    return false;
+  }
+  TEST_ASSERT_GREATER_THAN(0, len);
+  sentFirstByte[sentCount++ % 64] = data[0];
+  return true;
+}
+
+void setUp(void)
+{
+  sentCount = 0;
+  refuse = false;
+}
+
+void tearDown(void)
+{
+}
+
+static bool pushByte(TxRing &ring, uint8_t value)
+{
+  uint8_t data[4] = {value, 0, 0, 0};
+  return ring.push(data, sizeof(data));
+}
+
+static void test_packets_go_out_in_order_one_at_a_time(void)
+{
+  TxRing ring(transport);
+  TEST_ASSERT_TRUE(pushByte(ring, 1));
+  TEST_ASSERT_TRUE(pushByte(ring, 2));
+  TEST_ASSERT_TRUE(pushByte(ring, 3));
+  TEST_ASSERT_EQUAL(1, sentCount); // The others wait for the first completion
+  TEST_ASSERT_EQUAL(3, ring.queued());
+
+  ring.onSent(true);
+  ring.onSent(true);
+  ring.onSent(true);
+  TEST_ASSERT_EQUAL(3, sentCount);
+  TEST_ASSERT_EQUAL_UINT8(1, sentFirstByte[0]);
+  TEST_ASSERT_EQUAL_UINT8(2, sentFirstByte[1]);
+  TEST_ASSERT_EQUAL_UINT8(3, sentFirstByte[2]);
+  TEST_ASSERT_EQUAL(0, ring.queued());
+  TEST_ASSERT_EQUAL_UINT32(3, ring.delivered());
+}
+
+static void test_full_ring_fails_at_once(void)
+{
+  TxRing ring(transport);
+  for (int i = 0; i < TX_RING_SLOTS; i++)
+  {
+    TEST_ASSERT_TRUE(pushByte(ring, i));
+  }
+  TEST_ASSERT_EQUAL(0, ring.space());
+  TEST_ASSERT_NULL(ring.reserve());
+  TEST_ASSERT_FALSE(pushByte(ring, 99));
+  TEST_ASSERT_EQUAL_UINT32(2, ring.full());
+
+  ring.onSent(true);
+  TEST_ASSERT_EQUAL(1, ring.space());
+  TEST_ASSERT_NOT_NULL(ring.reserve());
+}
+
+static void test_refused_packet_is_retried_on_kick(void)
+{
+  TxRing ring(transport);
+  refuse = true;
+  TEST_ASSERT_TRUE(pushByte(ring, 7));
+  TEST_ASSERT_EQUAL(0, sentCount);
+  TEST_ASSERT_EQUAL_UINT32(1, ring.refused());
+
+  refuse = false;
+  ring.kick();
+  TEST_ASSERT_EQUAL(1, sentCount);
+  TEST_ASSERT_EQUAL_UINT8(7, sentFirstByte[0]);
+  TEST_ASSERT_EQUAL(1, ring.queued());
+}
+
+static void test_unacknowledged_packet_is_resent_once(void)
+{
+  TxRing ring(transport);
+  TEST_ASSERT_TRUE(pushByte(ring, 5));
+  TEST_ASSERT_TRUE(pushByte(ring, 6));
+
+  ring.onSent(false); // Resent
+  TEST_ASSERT_EQUAL(2, sentCount);
+  TEST_ASSERT_EQUAL_UINT8(5, sentFirstByte[1]);
+  TEST_ASSERT_EQUAL_UINT32(1, ring.retried());
+  TEST_ASSERT_EQUAL_UINT32(0, ring.failed());
+
+  ring.onSent(false); // Out of retries, counts as failed
+  TEST_ASSERT_EQUAL_UINT32(1, ring.failed());
+  TEST_ASSERT_EQUAL_UINT8(6, sentFirstByte[2]);
+
+  ring.onSent(true);
+  TEST_ASSERT_EQUAL_UINT32(1, ring.delivered());
+  TEST_ASSERT_EQUAL(0, ring.queued());
+}
+
+static void test_completion_with_nothing_queued_is_ignored(void)
+{
+  TxRing ring(transport);
+  ring.onSent(true);
+  TEST_ASSERT_EQUAL_UINT32(0, ring.delivered());
+  TEST_ASSERT_TRUE(pushByte(ring, 1));
+  TEST_ASSERT_EQUAL(1, sentCount);
+}
+
+static void test_reserve_and_commit_build_in_place(void)
+{
+  TxRing ring(transport);
+  uint8_t *slot = ring.reserve();
+  TEST_ASSERT_NOT_NULL(slot);
+  slot[0] = 42;
+  ring.commit(1);
+  TEST_ASSERT_EQUAL_UINT8(42, sentFirstByte[0]);
+
+  uint8_t big[FRAME_MAX_PACKET + 1];
+  memset(big, 0, sizeof(big));
+  TEST_ASSERT_FALSE(ring.push(big, sizeof(big)));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_packets_go_out_in_order_one_at_a_time);
+  RUN_TEST(test_full_ring_fails_at_once);
+  RUN_TEST(test_refused_packet_is_retried_on_kick);
+  RUN_TEST(test_unacknowledged_packet_is_resent_once);
+  RUN_TEST(test_completion_with_nothing_queued_is_ignored);
+  RUN_TEST(test_reserve_and_commit_build_in_place);
+  return UNITY_END();
+}
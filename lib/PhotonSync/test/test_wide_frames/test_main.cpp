@@ -0,0 +1,201 @@
+#include <unity.h>
+#include <string.h>
+#include "FrameProtocol.h"
+#include "FrameReceiver.h"
+#include "Pixel.h"
+
+// Frames past pixel 255: 16-bit record fields behind FRAME_FLAG_WIDE, and
+// the narrow and legacy packets older senders and receivers still use
+
+static uint8_t packet[FRAME_MAX_PACKET];
+static RGB frame[FRAME_MAX_PIXELS];
+static RGB shown[FRAME_MAX_PIXELS + 16]; // Room for a sentinel past the target
+static FrameTarget target;
+
+void setUp(void)
+{
+  memset(packet, 0, sizeof(packet));
+  memset(shown, 0, sizeof(shown));
+  memset(&target, 0, sizeof(target));
+  target.pixels = shown;
+  target.size = FRAME_MAX_PIXELS;
+  target.windowCount = FRAME_MAX_PIXELS;
+  for (int i = 0; i < FRAME_MAX_PIXELS; i++)
+  {
+    RGB color = {(uint8_t)(i * 31), (uint8_t)(i >> 3), (uint8_t)(i * 7 + 1)};
+    frame[i] = color;
+  }
+}
+
+void tearDown(void)
+{
+}
+
+static RGB rgb(uint8_t red, uint8_t green, uint8_t blue)
+{
+  RGB color = {red, green, blue};
+  return color;
+}
+
+static void test_full_frame_round_trip(void)
+{
+  FrameHeader header = {FRAME_FLAG_KEYFRAME, 1, 0};
+  uint16_t done = 0;
+  size_t bytes = 0;
+  int packets = 0;
+  while (done < FRAME_MAX_PIXELS)
+  {
+    uint16_t consumed;
+    size_t len = encodeFrame(packet, sizeof(packet), header, frame, NULL, done, FRAME_MAX_PIXELS - done, &consumed);
+    FrameHeader read;
+    TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, len, &read, &target));
+    TEST_ASSERT_TRUE(read.flags & FRAME_FLAG_WIDE); // The range reaches past 255
+    TEST_ASSERT_EQUAL_UINT8(FRAME_VERSION, packet[1]);
+    done += consumed;
+    bytes += len;
+    packets++;
+    header.sequence++;
+  }
+  TEST_ASSERT_EQUAL_MEMORY(frame, shown, sizeof(frame));
+
+  // 3 bytes a pixel plus headers, against 4 for a legacy Pixel
+  TEST_ASSERT_LESS_THAN(FRAME_MAX_PIXELS * 3 + packets * 16, bytes);
+  TEST_ASSERT_LESS_THAN(FRAME_MAX_PIXELS * 4 / (FRAME_MAX_PACKET / sizeof(Pixel)), packets);
+}
+
+static void test_small_frames_stay_narrow(void)
+{
+  FrameHeader header = {FRAME_FLAG_KEYFRAME, 1, 0};
+  uint16_t consumed;
+  size_t len = encodeFrame(packet, sizeof(packet), header, frame, NULL, 200, 56, &consumed);
+  TEST_ASSERT_EQUAL_UINT16(56, consumed);
+  TEST_ASSERT_FALSE(packet[2] & FRAME_FLAG_WIDE);
+  TEST_ASSERT_EQUAL_UINT8(FRAME_VERSION_BASIC, packet[1]); // A first-generation receiver reads it
+
+  len = encodeFrame(packet, sizeof(packet), header, frame, NULL, 200, 57, &consumed);
+  TEST_ASSERT_TRUE(packet[2] & FRAME_FLAG_WIDE);
+  TEST_ASSERT_EQUAL_UINT8(FRAME_VERSION, packet[1]);
+  FrameHeader read;
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, len, &read, &target));
+  TEST_ASSERT_TRUE(shown[256] == frame[256]);
+}
+
+static void test_wide_records(void)
+{
+  FrameHeader header = {FRAME_FLAG_WIDE | FRAME_FLAG_LAST, 2, 7};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+  TEST_ASSERT_EQUAL_UINT32(0xFFFF, writer.maxRun());
+  TEST_ASSERT_TRUE(writer.fill(300, 1000, rgb(1, 2, 3))); // Longer than a narrow run
+  TEST_ASSERT_TRUE(writer.set(1500, &frame[1500], 40));
+  TEST_ASSERT_TRUE(writer.fade(2000, 48, rgb(9, 8, 7), 250));
+  TEST_ASSERT_FALSE(writer.fill(2047, 0, rgb(0, 0, 0)));
+
+  FadeCommand fades[FRAME_MAX_FADES];
+  target.fades = fades;
+  target.maxFades = FRAME_MAX_FADES;
+  FrameHeader read;
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, writer.length(), &read, &target));
+  TEST_ASSERT_TRUE(shown[299] == rgb(0, 0, 0));
+  TEST_ASSERT_TRUE(shown[300] == rgb(1, 2, 3));
+  TEST_ASSERT_TRUE(shown[1299] == rgb(1, 2, 3));
+  TEST_ASSERT_TRUE(shown[1300] == rgb(0, 0, 0));
+  TEST_ASSERT_EQUAL_MEMORY(&frame[1500], &shown[1500], 40 * sizeof(RGB));
+  TEST_ASSERT_TRUE(shown[2047] == rgb(9, 8, 7));
+  TEST_ASSERT_EQUAL_UINT8(1, target.fadeCount);
+  TEST_ASSERT_EQUAL_UINT16(2000, fades[0].start);
+  TEST_ASSERT_EQUAL_UINT16(48, fades[0].count);
+}
+
+static void test_narrow_writer_refuses_wide_fields(void)
+{
+  FrameHeader header = {0, 0, 0};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+  TEST_ASSERT_EQUAL_UINT32(0xFF, writer.maxRun());
+  TEST_ASSERT_TRUE(writer.fill(0, 255, rgb(1, 1, 1)));
+  TEST_ASSERT_TRUE(writer.fill(255, 1, rgb(1, 1, 1)));
+  size_t length = writer.length();
+  TEST_ASSERT_FALSE(writer.fill(0, 256, rgb(1, 1, 1)));
+  TEST_ASSERT_FALSE(writer.fill(256, 1, rgb(1, 1, 1)));
+  TEST_ASSERT_FALSE(writer.fill(200, 100, rgb(1, 1, 1)));
+  TEST_ASSERT_EQUAL(length, writer.length()); // Untouched
+}
+
+static void test_wide_record_is_clipped_to_the_target(void)
+{
+  const RGB sentinel = rgb(0xEE, 0xEE, 0xEE);
+  for (int i = 1000; i < FRAME_MAX_PIXELS + 16; i++)
+  {
+    shown[i] = sentinel;
+  }
+  target.size = 1000; // A receiver with a smaller buffer
+  FrameHeader header = {FRAME_FLAG_WIDE | FRAME_FLAG_LAST, 0, 0};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+  TEST_ASSERT_TRUE(writer.fill(990, 60000, rgb(5, 5, 5)));
+  FrameHeader read;
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(packet, writer.length(), &read, &target));
+  TEST_ASSERT_TRUE(shown[999] == rgb(5, 5, 5));
+  for (int i = 1000; i < FRAME_MAX_PIXELS + 16; i++)
+  {
+    TEST_ASSERT_TRUE(shown[i] == sentinel);
+  }
+}
+
+static void test_truncated_wide_record_writes_nothing(void)
+{
+  FrameHeader header = {FRAME_FLAG_WIDE | FRAME_FLAG_LAST, 0, 0};
+  FrameWriter writer(packet, sizeof(packet));
+  writer.begin(header);
+  TEST_ASSERT_TRUE(writer.fill(10, 5, rgb(5, 5, 5)));
+  size_t fillEnd = writer.length();
+  TEST_ASSERT_TRUE(writer.set(600, &frame[600], 20));
+  FrameHeader read;
+  for (size_t len = FRAME_HEADER_SIZE + 1; len < writer.length(); len++)
+  {
+    if (len == fillEnd)
+    {
+      continue; // A whole packet holding only the FILL
+    }
+    TEST_ASSERT_EQUAL(FRAME_TRUNCATED, decodeFrame(packet, len, &read, &target));
+    TEST_ASSERT_TRUE(shown[10] == rgb(0, 0, 0));
+  }
+}
+
+static void test_receiver_mixes_legacy_and_wide_packets(void)
+{
+  static FrameReceiver receiver;
+  const uint8_t mac[6] = {1, 2, 3, 4, 5, 6};
+
+  // An old sender's Pixel packet, then a new sender's wide frame. The first
+  // pixel would read as a version 1 header under a magic of 181.
+  Pixel legacy[3] = {{181, 1, 20, 30}, {128, 40, 50, 60}, {255, 70, 80, 90}};
+  TEST_ASSERT_EQUAL(RECEIVE_PUBLISHED, receiver.receive(mac, (const uint8_t *)legacy, sizeof(legacy), 0, 0));
+  TEST_ASSERT_TRUE(receiver.takeFrame());
+  TEST_ASSERT_TRUE(receiver.frame().pixels[181] == rgb(1, 20, 30));
+  TEST_ASSERT_TRUE(receiver.frame().pixels[255] == rgb(70, 80, 90));
+
+  FrameHeader header = {FRAME_FLAG_LAST, 1, 0};
+  uint16_t consumed;
+  size_t len = encodeFrame(packet, sizeof(packet), header, frame, NULL, 1200, 60, &consumed);
+  TEST_ASSERT_EQUAL_UINT16(60, consumed);
+  TEST_ASSERT_EQUAL(RECEIVE_PUBLISHED, receiver.receive(mac, packet, len, 1000, 1));
+  TEST_ASSERT_TRUE(receiver.takeFrame());
+  const RGB *pixels = receiver.frame().pixels;
+  TEST_ASSERT_TRUE(pixels[128] == rgb(40, 50, 60)); // The legacy pixels are kept
+  TEST_ASSERT_EQUAL_MEMORY(&frame[1200], &pixels[1200], 60 * sizeof(RGB));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_full_frame_round_trip);
+  RUN_TEST(test_small_frames_stay_narrow);
+  RUN_TEST(test_wide_records);
+  RUN_TEST(test_narrow_writer_refuses_wide_fields);
+  RUN_TEST(test_wide_record_is_clipped_to_the_target);
+  RUN_TEST(test_truncated_wide_record_writes_nothing);
+  RUN_TEST(test_receiver_mixes_legacy_and_wide_packets);
+  return UNITY_END();
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <LedOutputs.h>
+
+// Drives up to MAX_OUTPUTS WS2812 strips at once, one RMT channel per strip.
+// show() starts every channel without blocking and then waits for all of
+// them, so a frame takes as long as the longest strip rather than the sum.
+class RmtStrips
+{
+public:
+  RmtStrips();
+
+  // Claim one RMT channel per output. Returns false if a channel could not
+  // be set up, the outputs before it still work.
+  bool begin(const LedOutput *outputs, uint8_t count);
+
+  // Send the GRB bytes of every output's LEDs from the shared LED buffer.
+  // The buffer must not change until show() returns.
+  void show(const uint8_t *grb);
+
+private:
+  LedOutput outputs[MAX_OUTPUTS];
+  uint8_t count;
+};
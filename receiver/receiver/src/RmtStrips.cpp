@@ -0,0 +1,70 @@
+#include "RmtStrips.h"
+#include <driver/rmt.h>
+#include <esp_attr.h>
+
+// RMT ticks of 25 ns (80 MHz APB clock / 2)
+#define RMT_CLOCK_DIV 2
+#define T0H_TICKS 16 // 0.40 us
+#define T0L_TICKS 34 // 0.85 us
+#define T1H_TICKS 32 // 0.80 us
+#define T1L_TICKS 18 // 0.45 us
+
+static const rmt_item32_t BIT_ZERO = {{{T0H_TICKS, 1, T0L_TICKS, 0}}};
+static const rmt_item32_t BIT_ONE = {{{T1H_TICKS, 1, T1L_TICKS, 0}}};
+
+// Called by the RMT driver from its interrupt as the channel's memory drains,
+// turns GRB bytes into one RMT item per bit, most significant bit first
+static void IRAM_ATTR translateGrb(const void *src, rmt_item32_t *dest, size_t srcSize,
+                                   size_t wantedItems, size_t *translatedSize, size_t *itemCount)
+{
+  const uint8_t *bytes = (const uint8_t *)src;
+  size_t size = 0;
+  size_t items = 0;
+  while (size < srcSize && items + 8 <= wantedItems)
+  {
+    uint8_t byte = bytes[size];
+    for (int bit = 7; bit >= 0; bit--)
+    {
+      *dest++ = byte & (1 << bit) ? BIT_ONE : BIT_ZERO;
+    }
+    items += 8;
+    size++;
+  }
+  *translatedSize = size;
+  *itemCount = items;
+}
+
+RmtStrips::RmtStrips() : count(0)
+{
+}
+
+bool RmtStrips::begin(const LedOutput *requested, uint8_t requestedCount)
+{
+  count = 0;
+  for (uint8_t i = 0; i < requestedCount && i < MAX_OUTPUTS; i++)
+  {
+    rmt_channel_t channel = (rmt_channel_t)i;
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)requested[i].pin, channel);
+    config.clk_div = RMT_CLOCK_DIV;
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(channel, 0, 0) != ESP_OK ||
+        rmt_translator_init(channel, translateGrb) != ESP_OK)
+    {
+      return false;
+    }
+    outputs[count++] = requested[i];
+  }
+  return true;
+}
+
+void RmtStrips::show(const uint8_t *grb)
+{
+  // Start every strip, then wait for all of them
+  for (uint8_t i = 0; i < count; i++)
+  {
+    rmt_write_sample((rmt_channel_t)i, &grb[outputs[i].firstLed * 3], outputs[i].count * 3, false);
+  }
+  for (uint8_t i = 0; i < count; i++)
+  {
+    rmt_wait_tx_done((rmt_channel_t)i, portMAX_DELAY);
+  }
+}
@@ -1,57 +1,121 @@
 #include <esp_now.h>
 #include <WiFi.h>
 #include <esp_wifi.h>
-#include <Adafruit_NeoPixel.h>
-#include <ArduinoJson.h> // Library for handling JSON
 #include <FS.h>
 #include "SPIFFS.h" // Library for using SPIFFS
 #include <iostream>
-#include <unordered_map>
 #include <iterator>
+#include <atomic>
 #include <stdio.h>
-
-#define CONFIG_FILE "/config.json"
-#define NEOPIXEL_PIN 23
+#include <FrameProtocol.h>
+#include <Pixel.h>
+#include <Telemetry.h>
+#include <Config.h>
+#include <FrameReceiver.h>
+#include <FrameComposer.h>
+#include <IdleAnimation.h>
+#include <ColorLut.h>
+#include <LedMap.h>
+#include <RefreshScheduler.h>
+#include <RenderLoop.h>
+#include <LedOutputs.h>
+#include <StateLog.h>
+#include "RmtStrips.h"
+
+#define LOG_MODULE "rx"
+#define LOG_LEVEL LOG_LEVEL_WARN // LOG_LEVEL_INFO prints the link and render stats, LOG_LEVEL_DEBUG every dropped packet
+#include <Log.h>
+
+#define NEOPIXEL_PIN 23 // Strip pin when config.json lists no Outputs
 #define VERBOS false
-#define NUM_LED 8 // The number of physical LEDs connected
-#define MAX_NUM_PIXELS 64
+#define DEFAULT_NUM_LED 8 // The number of physical LEDs connected, unless config.json says otherwise
+#define IDLE_HOLD_MS 1500 // Idle animation: time at full brightness
+#define IDLE_FADE_MS 500  // Idle animation: time to fade out, and again to fade back in
+#define IDLE_OFF_MS 500   // Idle animation: time spent dark
+#define GAMMA 2.2f        // Gamma correction applied to every colour sent to the LEDs
+#define STATS_INTERVAL_MS 5000 // How often the link counters are logged at LOG_LEVEL_INFO
+#define SERIAL_TX_BUFFER 1024  // Room for a stats packet, so sending one never blocks
+#define DEFAULT_MAX_FPS 60     // Render rate cap, unless config.json says otherwise
+#define DEFAULT_RENDER_CORE 1  // The WiFi stack runs on core 0
+#define DEFAULT_RENDER_PRIORITY 2 // Above loop(), below the WiFi task
+#define RENDER_STACK_SIZE 4096
+#define STATE_SAVE_INTERVAL_MS 5000 // How often what is shown is saved to flash, more often wears it faster
 
 // Define variables for configuration with default values
 int Channel = 0;
 int Num_Pixels = 1;                   // THe number of Pixels we will be displaying
 int Pixel_Index = 0;                  // The index of the first pixel we will be displaying
+int Num_LED = DEFAULT_NUM_LED;        // The number of physical LEDs connected, the sum of Outputs if those are listed
+uint16_t Segments[FRAME_MAX_PIXELS];  // LEDs per displayed pixel, used instead of an even split when Num_Segments > 0
+int Num_Segments = 0;
+bool Reverse = false;                 // The strip is fed from its far end
+int Serpentine = 0;                   // LEDs per row of a zig-zag layout, 0 for a straight strip
+bool Broadcast = false;               // Senders broadcast to every receiver, keep the factory MAC and pick our window out of each frame
+int Max_FPS = DEFAULT_MAX_FPS;        // Renders per second at most, 0 for as fast as frames arrive
+int Render_Core = DEFAULT_RENDER_CORE; // Core the render task is pinned to
+int Render_Priority = DEFAULT_RENDER_PRIORITY; // FreeRTOS priority of the render task
+uint8_t Output_Pins[MAX_OUTPUTS];     // Pin of each strip, in chain order
+uint16_t Output_LEDs[MAX_OUTPUTS];    // LEDs on each strip
+int Num_Outputs = 0;                  // 0 drives Num_LED LEDs on NEOPIXEL_PIN
+static_assert(CONFIG_MAX_OUTPUTS <= MAX_OUTPUTS, "config.json may list more Outputs than the receiver drives");
 uint8_t Start_Color[3] = {255, 0, 0}; // Default shows red color to indicated config was not loaded
 uint8_t Receiver_Address[] = {0x11, 0x11, 0x11, 0x11, 0x11, 0x11};
 
-// NeoPixel configuration
-Adafruit_NeoPixel pixelOutput(NUM_LED, NEOPIXEL_PIN, NEO_GRB + NEO_KHZ800); // Placeholder values, will be initialized later
-
-// Define structure to hold the data to be received
-typedef struct __attribute__((packed))
-{
-  uint8_t index;
-  uint8_t red;
-  uint8_t green;
-  uint8_t blue; // Data received
-} Pixel;
+// LED output
+LedOutput outputs[MAX_OUTPUTS];      // Strips, each showing a slice of ledBuffer
+uint8_t outputCount = 0;
+RmtStrips strips;                    // Sends all strips at once
+uint8_t ledBuffer[MAX_NUM_LED * 3];  // GRB bytes of every LED, in chain order
 
 // Global Objects
 Pixel currentColor;
-bool newData = false;
-std::unordered_map<int, Pixel> colorMap; // Dictionary holding all recieved pixel values. Key = pixel index, Value= Pixel
-int ledMap[MAX_NUM_PIXELS];
+FrameReceiver receiver;                // Decodes packets on the WiFi task and hands whole frames to the render task
+IdleAnimation idle(IDLE_HOLD_MS, IDLE_FADE_MS, IDLE_OFF_MS);
+int idleBrightness = -1;               // Brightness of the last idle step shown, -1 before the first one
+FrameComposer composer;                // Runs the frame's fades and scenes, one step per render
+ColorLut colorLut(GAMMA);              // Gamma and brightness, applied while filling the NeoPixel buffer
+LedSpan ledMap[MAX_NUM_LED]; // Runs of LEDs showing the same pixel, in LED order
+uint16_t ledSpans = 0;
+unsigned long statsPrintedAt = 0;
+unsigned long telemetrySentAt = 0;
+uint32_t lastShowAt = 0;               // micros() of the last show(), for the render period
+RefreshScheduler refresh(DEFAULT_MAX_FPS); // Paces renders, and only renders when something changed
+TaskHandle_t renderTaskHandle = NULL;  // Woken by onDataRecv when a frame is published
+FrameBuffer stateSnapshot;             // The shown frame, copied by the render task when loop() asks to save it
+std::atomic<bool> snapshotWanted(false); // Set by loop() when a save is due, the render task fills stateSnapshot
+std::atomic<bool> snapshotReady(false);  // Set by the render task, stateSnapshot is loop()'s until it saves it
+std::atomic<uint32_t> framesTaken(0);    // Frames the render task took, a save is due only if this moved
+uint32_t framesSaved = 0;              // framesTaken at the last snapshot
+FsStateStorage stateStorage(SPIFFS);
+StateLog stateLog(stateStorage);       // The last frame and scenes, restored at boot
+unsigned long stateSavedAt = 0;
 
 // Function prototypes
-void fillFadeToBlack(unsigned long fadeTime, Pixel color);
-void fillFadeFromBlack(unsigned long fadeTime, Pixel color);
+bool renderIdle(unsigned long now);
+void renderTask(void *parameter);
+uint32_t renderNow();
+void renderSleep(uint32_t us);
+bool takeFrame();
+bool animating();
+bool drawFrame(bool newFrame);
+void showLeds();
+void wakeRenderer();
+void printStats(unsigned long now);
 void onDataRecv(const uint8_t *mac_addr, const uint8_t *data, int data_len);
+void handOver(ReceiveResult result);
+void waitForLatch(uint32_t latchAt);
+bool restoreState();
+void saveState(unsigned long now);
 void loadConfig();
+void planStrips();
 void mapLED();
+void fillLeds(RGB color);
 //---------------------------------------------------------------------------------------
 
 void setup()
 {
   // Begin Setup
+  Serial.setTxBufferSize(SERIAL_TX_BUFFER);
   Serial.begin(115200);
   Serial.println("Setup started...");
   Serial.print("Running on core: ");
@@ -70,21 +134,23 @@ void setup()
 
   // Load configuration from JSON file
   loadConfig();
+  planStrips();
   mapLED();
+  refresh.setMaxFps(Max_FPS);
 
-  currentColor = {0, Start_Color[0], Start_Color[1], Start_Color[2]};
-  pixelOutput.updateLength(NUM_LED);
+  receiver.setWindow(Pixel_Index, Num_Pixels);
+  bool restored = restoreState();
 
-  // pixelOutput = new Adafruit_NeoPixel(Num_Pixels, NEOPIXEL_PIN, NEO_GRB + NEO_KHZ800);
+  currentColor = {0, Start_Color[0], Start_Color[1], Start_Color[2]};
 
   // Initialize Wi-Fi
   WiFi.mode(WIFI_STA);
   Serial.println("Connecting to WiFi...");
 
-  // Manually define MAC address
+  // Manually define MAC address, broadcast frames reach every receiver without it
   Serial.print("[OLD] ESP32 Board MAC Address:  ");
   Serial.println(WiFi.macAddress());
-  if (ESP_OK != esp_wifi_set_mac(WIFI_IF_STA, &Receiver_Address[0]))
+  if (!Broadcast && ESP_OK != esp_wifi_set_mac(WIFI_IF_STA, &Receiver_Address[0]))
   {
     Serial.println("Failed to reassign MAC Address, using default");
     Serial.println(Receiver_Address[0]);
@@ -92,12 +158,18 @@ void setup()
   Serial.print("[NEW] ESP32 Board MAC Address:  ");
   Serial.println(WiFi.macAddress());
 
-  // Initialize NeoPixel
+  // Initialize the strips
   Serial.println("Starting light");
-  pixelOutput.begin();
-  pixelOutput.setBrightness(255);
-  pixelOutput.fill(pixelOutput.Color(currentColor.red, currentColor.green, currentColor.blue)); // Set initial color of LEDs
-  pixelOutput.show();
+  if (!strips.begin(outputs, outputCount))
+  {
+    Serial.println("Failed to set up every LED output");
+  }
+  if (!restored)
+  {
+    fillLeds(colorLut.apply({currentColor.red, currentColor.green, currentColor.blue})); // Set initial color of LEDs
+    strips.show(ledBuffer);
+    idle.start(millis());
+  }
 
   // Initialize ESP-NOW
   if (esp_now_init() != ESP_OK)
@@ -106,6 +178,14 @@ void setup()
     return;
   }
 
+  // Rendering gets its own task on its own core, away from the WiFi stack
+  if (xTaskCreatePinnedToCore(renderTask, "render", RENDER_STACK_SIZE, NULL, Render_Priority,
+                              &renderTaskHandle, Render_Core) != pdPASS)
+  {
+    Serial.println("Failed to start the render task");
+    return;
+  }
+
   // Register callback function to handle received data
   esp_now_register_recv_cb(onDataRecv);
 
@@ -114,173 +194,305 @@ void setup()
 
 void loop()
 {
-  // Serial.println("Starting Loop");
-  // Serial.print("Running on core: ");
-  // Serial.println(xPortGetCoreID());
-
-  if (!newData)
+  // Rendering runs in renderTask, loop() only reports
+  unsigned long now = millis();
+  if (now - telemetrySentAt >= TELEMETRY_INTERVAL_MS)
   {
-    delay(1500);
-    // Serial.println("No new data");
-    fillFadeToBlack(500, currentColor); // Fade off to red in 2 seconds
-    delay(500);
-    fillFadeFromBlack(500, currentColor); // Fade back to original color in 2 seconds
-    return;
+    telemetrySentAt = now;
+    sendTelemetry(Serial, TELEMETRY_RECEIVER);
   }
+  printStats(now);
+  saveState(now);
+  logDrain(Serial);
+  delay(100);
+}
+
+void renderTask(void *parameter)
+{
+  Serial.print("Render task running on core: ");
+  Serial.println(xPortGetCoreID());
 
-  for (int i = 0; i < NUM_LED; i++)
+  RenderHooks hooks = {renderNow, renderSleep, takeFrame, animating, drawFrame};
+  RenderLoop renderLoop(hooks, refresh);
+  for (;;)
   {
-    pixelOutput.setPixelColor(i, colorMap[ledMap[i]].red, colorMap[ledMap[i]].green, colorMap[ledMap[i]].blue);
-    // Serial.println(i);
+    renderLoop.step();
   }
-  pixelOutput.setBrightness(255);
-  pixelOutput.show();
-  
-  // for (int i = 0; i < Num_Pixels; i++)
-  // {
-  //   String text = "ColorMap- " + String(i) + ": " + String(colorMap[i].red) + ", " + String(colorMap[i].green) + ", " + String(colorMap[i].blue);
-  //   Serial.println(text);
-  // }
-  // String text1 = "ColorMap- 0: " + String(colorMap[0].red) + ", " + String(colorMap[0].green) + ", " + String(colorMap[0].blue);
-  // String text2 = "ColorMap- 1: " + String(colorMap[1].red) + ", " + String(colorMap[1].green) + ", " + String(colorMap[1].blue);
-  // Serial.println(text1);
-  // Serial.println(text2);
 }
 
-void onDataRecv(const uint8_t *mac_addr, const uint8_t *data, int data_len)
+uint32_t renderNow()
 {
-  // Serial.println("Data Received, running onDataDecv");
-  // Serial.print("Running on core: ");
-  // Serial.println(xPortGetCoreID());
+  return micros();
+}
 
-  // Check if the received data is the correct size
-  if (data_len % sizeof(Pixel) == 0)
-  {
-    int numPixels = data_len / sizeof(Pixel); // Calculate the number of pixels
-    Pixel receivedData[numPixels];            // Local array to hold received data
+void renderSleep(uint32_t us)
+{
+  // Whole ticks, rounded up. The scheduler keeps its frame grid, so
+  // oversleeping a slot does not add up.
+  TickType_t ticks = pdMS_TO_TICKS((us + 999) / 1000);
+  ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+}
 
-    // Copy received data to local variable
-    memcpy(receivedData, data, data_len);
+bool takeFrame()
+{
+  bool taken = receiver.takeFrame();
+  if (taken)
+  {
+    framesTaken.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (snapshotWanted.load(std::memory_order_acquire))
+  {
+    // Only the render task may read the frame it holds, copy it for loop()
+    const FrameBuffer &current = receiver.frame();
+    memcpy(stateSnapshot.pixels, current.pixels, sizeof(current.pixels));
+    memcpy(&stateSnapshot.scenes, &current.scenes, sizeof(current.scenes));
+    snapshotWanted.store(false, std::memory_order_relaxed);
+    snapshotReady.store(true, std::memory_order_release);
+  }
+  return taken;
+}
 
-    for (int i = 0; i < numPixels; ++i)
-    {
-      int index = receivedData[i].index;
-      colorMap[index] = receivedData[i];
-    }
+bool animating()
+{
+  return composer.animating() || idle.active();
+}
 
-    newData = true;
+void wakeRenderer()
+// Runs on the WiFi task, and on loop() to ask for a snapshot
+{
+  if (renderTaskHandle != NULL)
+  {
+    xTaskNotifyGive(renderTaskHandle);
   }
 }
 
-void loadConfig()
+bool drawFrame(bool newFrame)
 {
-  Serial.println("Starting loadConfig");
-  Serial.print("Running on core: ");
-  Serial.println(xPortGetCoreID());
+  if (!newFrame && !composer.animating())
+  {
+    return renderIdle(millis()); // No data yet, advance the idle animation by one step
+  }
 
-  if (!SPIFFS.exists(CONFIG_FILE))
+  // A frame preempts the idle animation on the first tick it is available
+  if (idle.active())
   {
-    Serial.println("Config file does not exist");
-    return;
+    idle.stop();
+    colorLut.setBrightness(255);
   }
-  else if (VERBOS)
+  const FrameBuffer &current = receiver.frame();
+  unsigned long now = millis();
+  uint32_t wait = newFrame ? latchWait(current, micros()) : 0;
+  composer.compose(current, newFrame, now, now + (wait + 500) / 1000);
+
+  // Gamma, brightness and GRB ordering in one pass straight into the LED buffer
+  colorLut.render(composer.shown(), ledMap, ledSpans, ledBuffer);
+  if (wait > 0)
   {
-    Serial.println("Your file exists at least");
+    waitForLatch(current.latchAt);
   }
+  showLeds();
+  return true;
+}
+
+void showLeds()
+// Clock ledBuffer out to every strip, timing the show and the render period
+{
+  uint32_t start = micros();
+  strips.show(ledBuffer);
+  telemetry.record(TELEMETRY_SHOW_US, micros() - start);
+  telemetry.interval(TELEMETRY_LOOP_US, start, &lastShowAt);
+  telemetry.count(TELEMETRY_FRAMES_RENDERED);
+}
 
-  File configFile = SPIFFS.open(CONFIG_FILE, "r");
-  if (!configFile)
+void onDataRecv(const uint8_t *mac_addr, const uint8_t *data, int data_len)
+{
+  handOver(receiver.receive(mac_addr, data, data_len, micros(), millis()));
+}
+
+void handOver(ReceiveResult result)
+// Runs on the WiFi task, and once in setup() for a restored frame
+{
+  if (result == RECEIVE_NOTHING)
   {
-    Serial.println("Failed to open config file");
     return;
   }
-  else if (VERBOS)
+  if (result == RECEIVE_REPLACED)
   {
-    Serial.println("we read them files to filth girl");
+    refresh.frameDropped();
   }
+  wakeRenderer();
+}
 
-  size_t size = configFile.size();
-  if (size > 1024)
+void waitForLatch(uint32_t latchAt)
+// Hold the rendered frame until its latch time, so every receiver shows it on the same tick
+{
+  int32_t wait = (int32_t)(latchAt - micros());
+  if (wait <= 0)
   {
-    Serial.println("Config file size is too large");
     return;
   }
-
-  if (VERBOS)
+  if (wait > 2000)
+  {
+    delay(wait / 1000 - 1); // Let other tasks run, then spin for the last millisecond
+  }
+  while ((int32_t)(latchAt - micros()) > 0)
   {
-    Serial.print("Config file size: ");
-    Serial.print(size);
-    Serial.println(" , she's a thiccc bitch");
   }
+}
 
-  // Allocate a buffer to store contents of the file
-  std::unique_ptr<char[]> buf(new char[size]);
+void loadConfig()
+{
+  Serial.println("Starting loadConfig");
+  Serial.print("Running on core: ");
+  Serial.println(xPortGetCoreID());
 
-  // Read data from the file into the buffer
-  configFile.readBytes(buf.get(), size);
+  static PhotonConfig config; // Too big for the loop task's stack
+  ConfigSource source = loadConfigFile(SPIFFS, &config);
+  if (VERBOS)
+  {
+    Serial.print("Config loaded from ");
+    Serial.println(configSourceName(source));
+  }
 
-  // Parse the JSON object in the file
-  DynamicJsonDocument doc(1024);
-  DeserializationError error = deserializeJson(doc, buf.get());
-  if (error)
+  // Keys config.json leaves out keep their defaults. Ranges were checked
+  // when the file was parsed.
+  if (config.present & CONFIG_CHANNEL)
   {
-    Serial.println("Failed to parse config file");
-    return;
+    Channel = config.channel;
   }
-  else if (VERBOS)
+  if (config.present & CONFIG_NUM_PIXELS)
+  {
+    Num_Pixels = config.numPixels;
+  }
+  if (config.present & CONFIG_PIXEL_INDEX)
   {
-    Serial.println("Please welcum to the stage, J. SON-DHEIM!");
+    Pixel_Index = config.pixelIndex;
+  }
+  if (config.present & CONFIG_RECEIVER_ADDRESS)
+  {
+    memcpy(Receiver_Address, config.receiverAddress, 6);
+  }
+  if (config.present & CONFIG_START_COLOR)
+  {
+    Start_Color[0] = config.startColor.red;
+    Start_Color[1] = config.startColor.green;
+    Start_Color[2] = config.startColor.blue;
+  }
+  if (config.present & CONFIG_BROADCAST)
+  {
+    Broadcast = config.broadcast;
   }
 
-  // Extract values
-  Channel = doc["Channel"];
-  Num_Pixels = doc["Num_Pixels"];
-  Pixel_Index = doc["Pixel_Index"];
-  const char *receiverAddressStr = doc["Receiver_Address"];
-  sscanf(receiverAddressStr, "%x:%x:%x:%x:%x:%x",
-         &Receiver_Address[0], &Receiver_Address[1], &Receiver_Address[2],
-         &Receiver_Address[3], &Receiver_Address[4], &Receiver_Address[5]);
-  JsonArray startColor = doc["Start_Color"];
-  for (int i = 0; i < 3; i++)
+  // LED layout and rendering
+  if (config.present & CONFIG_NUM_LED)
+  {
+    Num_LED = config.numLed;
+  }
+  if (config.present & CONFIG_REVERSE)
+  {
+    Reverse = config.reverse;
+  }
+  if (config.present & CONFIG_SERPENTINE)
   {
-    Start_Color[i] = startColor[i];
+    Serpentine = config.serpentine;
   }
+  if (config.present & CONFIG_SEGMENTS)
+  {
+    Num_Segments = config.numSegments;
+    memcpy(Segments, config.segments, config.numSegments * sizeof(uint16_t));
+  }
+  if (config.present & CONFIG_OUTPUTS)
+  {
+    Num_Outputs = config.numOutputs;
+    memcpy(Output_Pins, config.outputPins, config.numOutputs);
+    memcpy(Output_LEDs, config.outputLeds, config.numOutputs * sizeof(uint16_t));
+  }
+  if (config.present & CONFIG_MAX_FPS)
+  {
+    Max_FPS = config.maxFps;
+  }
+  if (config.present & CONFIG_RENDER_CORE)
+  {
+    Render_Core = config.renderCore;
+  }
+  if (config.present & CONFIG_RENDER_PRIORITY)
+  {
+    Render_Priority = config.renderPriority;
+  }
+
   String message = "Red: " + String(Start_Color[0]) + ", Green: " + String(Start_Color[1]) + ", Blue: " + String(Start_Color[2]);
   Serial.println(message);
+}
 
-  configFile.close();
+void planStrips()
+// Lay the configured strips end to end in the LED buffer, Num_LED becomes their total
+{
+  if (Num_Outputs == 0)
+  {
+    Output_Pins[0] = NEOPIXEL_PIN;
+    Output_LEDs[0] = Num_LED;
+    Num_Outputs = 1;
+  }
+  outputCount = planOutputs(Output_Pins, Output_LEDs, Num_Outputs, MAX_NUM_LED, outputs);
+  Num_LED = totalLeds(outputs, outputCount);
+
+  if (VERBOS)
+  {
+    Serial.print("Outputs (pin, first LED, count): ");
+    for (int i = 0; i < outputCount; i++)
+    {
+      Serial.print(outputs[i].pin);
+      Serial.print(" ");
+      Serial.print(outputs[i].firstLed);
+      Serial.print(" ");
+      Serial.print(outputs[i].count);
+      Serial.print(", ");
+    }
+    Serial.println();
+    Serial.print("Show time in us, parallel/one by one: ");
+    Serial.print(frameTimeUs(outputs, outputCount, true));
+    Serial.print("/");
+    Serial.println(frameTimeUs(outputs, outputCount, false));
+  }
 }
 
 void mapLED()
-// This function assigns the colorMap key fro the appropriate Pixel index to each LED
+// This function assigns the frame buffer index of the appropriate Pixel to each LED
 {
   Serial.println("Starting mapLED");
   Serial.print("Running on core: ");
   Serial.println(xPortGetCoreID());
 
-  int groupSize = NUM_LED / Num_Pixels;
-  int remainder = NUM_LED % Num_Pixels;
-
-  for (int i = 0; i < Num_Pixels; i++) // for each pixel that will be displayed
+  // Never map past the end of the frame buffer
+  if (Pixel_Index < 0 || Pixel_Index >= FRAME_MAX_PIXELS)
   {
-    int usedRemainders = 0;
-    int ii = 0;
-    for (ii; ii < groupSize; ii++) // set the group size worth of
-    {
-      ledMap[(i * groupSize) + ii + usedRemainders] = Pixel_Index + i; // This should be the key in colorMap that matches the correct color to be displayed.
-    }
-    if (remainder < 0)
-    {
-      ledMap[(i * groupSize) + ii + usedRemainders + 1];
-      remainder = remainder - 1;
-    }
+    Pixel_Index = 0;
   }
-  if (true)
+  if (Num_Pixels < 0 || Pixel_Index + Num_Pixels > FRAME_MAX_PIXELS)
   {
-    Serial.print("LED Map: ");
-    for (int i = 0; i < NUM_LED; i++)
+    Num_Pixels = FRAME_MAX_PIXELS - Pixel_Index;
+  }
+
+  LedLayout layout;
+  layout.ledCount = Num_LED;
+  layout.pixelIndex = Pixel_Index;
+  layout.numPixels = Num_Pixels;
+  layout.segments = Num_Segments > 0 ? Segments : NULL;
+  layout.segmentCount = Num_Segments;
+  layout.reverse = Reverse;
+  layout.serpentine = Serpentine;
+  ledSpans = buildLedMap(layout, ledMap, MAX_NUM_LED);
+
+  if (VERBOS)
+  {
+    Serial.print("LED Map (first LED, count, pixel): ");
+    for (int i = 0; i < ledSpans; i++)
     {
-      Serial.print(ledMap[i]);
+      Serial.print(ledMap[i].firstLed);
+      Serial.print(" ");
+      Serial.print(ledMap[i].count);
+      Serial.print(" ");
+      Serial.print(ledMap[i].pixel);
       Serial.print(", ");
     }
     Serial.println();
@@ -289,30 +501,90 @@ void mapLED()
   Serial.println("LED to Pixel map generated");
 }
 
-void fillFadeToBlack(unsigned long fadeTime, Pixel color)
+bool restoreState()
+// Show what was shown before the reset, if it was saved. Returns true if it was.
+{
+  size_t records = stateLog.restore(receiver.target());
+  if (records == 0)
+  {
+    return false;
+  }
+  if (VERBOS)
+  {
+    Serial.print("Restored the saved state, records: ");
+    Serial.println(records);
+  }
+  handOver(receiver.publish()); // The render task shows it as soon as it starts
+  return true;
+}
+
+void saveState(unsigned long now)
+// Asks the render task for a copy of the shown frame when a save is due and
+// new frames were shown, then writes the copy on a later loop()
+{
+  if (snapshotReady.load(std::memory_order_acquire))
+  {
+    if (!stateLog.save(stateSnapshot.pixels, Pixel_Index, Num_Pixels, stateSnapshot.scenes))
+    {
+      LOG_WARN("Could not save the state to flash");
+    }
+    snapshotReady.store(false, std::memory_order_relaxed);
+    return;
+  }
+
+  uint32_t taken = framesTaken.load(std::memory_order_relaxed);
+  if (now - stateSavedAt < STATE_SAVE_INTERVAL_MS || taken == framesSaved ||
+      snapshotWanted.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+  stateSavedAt = now;
+  framesSaved = taken;
+  snapshotWanted.store(true, std::memory_order_release);
+  wakeRenderer(); // It may be asleep until the next frame
+}
+
+bool renderIdle(unsigned long now)
+// Returns true if the LEDs were updated
+{
+  int brightness = idle.brightness(now);
+  if (brightness == idleBrightness)
+  {
+    return false; // Nothing changed since the last step
+  }
+  idleBrightness = brightness;
+
+  colorLut.setBrightness(brightness);
+  RGB color = colorLut.apply({currentColor.red, currentColor.green, currentColor.blue});
+  fillLeds(color);
+  showLeds();
+  return true;
+}
+
+void printStats(unsigned long now)
 {
-  unsigned long startTime = millis();
-  for (int i = 255; i >= 0; i--)
+  if (now - statsPrintedAt < STATS_INTERVAL_MS)
   {
-    pixelOutput.setBrightness(i);
-    pixelOutput.fill(pixelOutput.Color(color.red, color.green, color.blue));
-    pixelOutput.show();
-    unsigned long elapsedTime = millis() - startTime;
-    delay((fadeTime / 255) - (elapsedTime % (fadeTime / 255)));
+    return;
   }
-  pixelOutput.fill(0, 0, 0);
-  pixelOutput.show();
+  statsPrintedAt = now;
+
+  const SequenceStats &stats = receiver.sequenceStats();
+  LOG_INFO("Link: received %u, lost %u, late %u, duplicates %u, restarts %u",
+           stats.received, stats.lost, stats.late, stats.duplicates, stats.restarts);
+
+  RefreshStats render = refresh.stats();
+  LOG_INFO("Render: frames %u, dropped %u, frame time last/avg/max us %u/%u/%u",
+           render.rendered, render.dropped, render.frameUs, render.avgFrameUs, render.maxFrameUs);
 }
 
-void fillFadeFromBlack(unsigned long fadeTime, Pixel color)
+void fillLeds(RGB color)
+// Every LED the same colour, already corrected
 {
-  unsigned long startTime = millis();
-  for (int i = 0; i <= 255; i++)
-  {
-    pixelOutput.setBrightness(i);
-    pixelOutput.fill(pixelOutput.Color(color.red, color.green, color.blue));
-    pixelOutput.show();
-    unsigned long elapsedTime = millis() - startTime;
-    delay((fadeTime / 255) - (elapsedTime % (fadeTime / 255)));
+  for (int i = 0; i < Num_LED; i++)
+  {
+    ledBuffer[i * 3] = color.green;
+    ledBuffer[i * 3 + 1] = color.red;
+    ledBuffer[i * 3 + 2] = color.blue;
   }
 }
@@ -3,65 +3,51 @@
 #include <esp_wifi.h>
 #include <SPIFFS.h>
 #include <FS.h>
-#include <ArduinoJson.h>
 #include "SPIFFS.h" // Library for using SPIFFS
-#include <vector>
-#include <sstream>
-#include <string>
 #include <cstdint>
+#include <TxRing.h>
+#include <SerialBridge.h>
+#include <EspNowSender.h>
+#include <Config.h>
+#include <Telemetry.h>
+
+#define LOG_MODULE "serial"
+#define LOG_LEVEL LOG_LEVEL_WARN
+#include <Log.h>
 
-#define CONFIG_FILE "/config.json"
 #define VERBOS true
-#define DATASIZE 250
+#define FLUSH_INTERVAL_MS 5 // How long a pixel may wait for more pixels to share its packet
+#define SERIAL_BAUD 921600    // Grasshopper's serial port must match
+#define SERIAL_RX_BUFFER 8192 // Room for a whole binary frame while loop() is busy sending
+#define SERIAL_CHUNK 64       // Bytes taken from the UART per read
+#define SERIAL_TX_BUFFER 1024 // Room for a stats packet, so sending one never blocks
 
 // Define variables for configuration with default values
 int Channel = 0;
 uint8_t Receiver_Address[] = {0x11, 0x11, 0x11, 0x11, 0x11, 0x11};
-
-// Define structure to hold the data to be received
-typedef struct __attribute__((packed))
-{
-  uint8_t index;
-  uint8_t red;
-  uint8_t green;
-  uint8_t blue; // Data received
-} Pixel;
-
-String pixelToString(const Pixel &pixel)
-{
-  String result = String(pixel.index) + " " +
-                  String(pixel.red) + " " +
-                  String(pixel.green) + " " +
-                  String(pixel.blue);
-  return result;
-}
-
-Pixel stringToPixel(const String &str)
-{
-  Pixel pixel;
-  int index, red, green, blue;
-  sscanf(str.c_str(), "%d %d %d %d", &index, &red, &green, &blue);
-  pixel.index = static_cast<uint8_t>(index);
-  pixel.red = static_cast<uint8_t>(red);
-  pixel.green = static_cast<uint8_t>(green);
-  pixel.blue = static_cast<uint8_t>(blue);
-  return pixel;
-}
-
-// Global Objects
-String success;
-esp_now_peer_info_t peerInfo;
-Pixel currentColor; // Variable for current color
+bool Broadcast = false; // Send every frame to all receivers, each one shows its own pixel window
+const uint8_t BROADCAST_ADDRESS[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+int Latch_Delay_Ms = 0; // Receivers hold each frame until this long after it was sent and show it together, 0 shows frames as they arrive
 
 // Prototype Functions
-void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status);
+uint8_t *reservePacket();
+void queuePacket(size_t len);
+uint32_t packetClock();
 void loadConfig();
+
+TxRing txRing(espNowSend);                          // Packets waiting for the radio
+const PacketSink packetSink = {reservePacket, queuePacket};
+SerialBridge bridge(txRing, packetSink, FLUSH_INTERVAL_MS); // Packs Grasshopper's frames and paces them to the air
+unsigned long telemetrySentAt = 0;
+uint32_t loopAt = 0; // micros() of the last loop(), for the loop period
 //---------------------------------------------------------------------------------------
 
 void setup()
 {
   // Begin Setup
-  Serial.begin(115200);
+  Serial.setRxBufferSize(SERIAL_RX_BUFFER);
+  Serial.setTxBufferSize(SERIAL_TX_BUFFER);
+  Serial.begin(SERIAL_BAUD);
   Serial.println("Setup started...");
 
   // Initialize SPIFFS
@@ -77,174 +63,107 @@ void setup()
 
   // Load configuration from JSON file
   loadConfig();
+  bridge.packer().setLatch(Latch_Delay_Ms, packetClock);
 
-  // Initialize Wi-Fi
-  WiFi.mode(WIFI_STA);
-  Serial.println("Connecting to WiFi...");
-
-  // Initialize ESP Now
-  if (esp_now_init() != ESP_OK)
+  // Initialize Wi-Fi and ESP-NOW, one broadcast peer drives any number of receivers
+  if (!beginEspNowSender(Broadcast ? BROADCAST_ADDRESS : Receiver_Address, Channel, &txRing, VERBOS))
   {
-    Serial.println("Error initializing ESP-NOW");
     return;
   }
-  else if (VERBOS)
+}
+
+void loop()
+{
+  telemetry.interval(TELEMETRY_LOOP_US, micros(), &loopAt);
+
+  // Take whatever serial data has arrived without waiting for more
+  uint8_t chunk[SERIAL_CHUNK];
+  size_t n = Serial.available();
+  if (n > sizeof(chunk))
   {
-    Serial.println("She's giving ESP-Ussy");
+    n = sizeof(chunk);
   }
+  n = n > 0 ? Serial.readBytes(chunk, n) : 0;
 
-  // Register callback
-  esp_now_register_send_cb(OnDataSent);
-
-  // Register peer
-  memcpy(peerInfo.peer_addr, Receiver_Address, 6);
-  peerInfo.channel = Channel;
-  peerInfo.encrypt = false;
-  if (VERBOS)
+  unsigned long now = millis();
+  for (size_t i = 0; i < n; i++)
   {
-    Serial.print("Broadcasting at the bus stop on ");
-    for (int i = 0; i < 6; i++)
+    if (bridge.feed(chunk[i], now) == SERIAL_FRAME && bridge.parser().type() == SERIAL_TYPE_STATS_REQUEST)
     {
-      // Print each byte with a colon separator
-      Serial.print(peerInfo.peer_addr[i], HEX);
-      Serial.print(":");
+      sendTelemetry(Serial, TELEMETRY_SENDER);
     }
-    Serial.println();
   }
 
-  // Add peer
-  if (esp_now_add_peer(&peerInfo) != ESP_OK)
-  {
-    Serial.println("Failed to add peer");
-    return;
-  }
-  else if (VERBOS)
+  if (n == 0)
   {
-    Serial.println("and you are on the list ;)");
+    delay(1);
   }
-}
 
-void loop()
-{
-  Serial.println("Starting Loop...");
+  // Send the queued pixels once their packet is full or they have waited long
+  // enough, and retry a packet the radio refused
+  now = millis();
+  bridge.poll(now);
 
-  // Check for incoming serial data
-  if (Serial.available())
+  if (now - telemetrySentAt >= TELEMETRY_INTERVAL_MS)
   {
-    String incomingString = Serial.readStringUntil('\n');
-    Serial.println(incomingString);
-
-    // Attempt to convert the string to a Pixel
-    Pixel receivedPixel = stringToPixel(incomingString);
-
-    // If conversion was successful, broadcast the pixel
-    if (receivedPixel.index != 0)
-    { // Check for valid index
-      // Assign received pixel to currentColor
-      currentColor = receivedPixel;
-
-      // Broadcast the pixel over ESP-NOW
-      esp_err_t result = esp_now_send(peerInfo.peer_addr, (uint8_t *)&currentColor, sizeof(currentColor));
-
-      if (result == ESP_OK)
-      {
-        Serial.println("Pixel broadcast successful!");
-      }
-      else
-      {
-        Serial.println("Error broadcasting pixel...");
-      }
-    }
-    else
-    {
-      Serial.println("Invalid pixel data received over serial.");
-    }
-  }
-  else
-  {
-    delay(500);
+    telemetrySentAt = now;
+    sendTelemetry(Serial, TELEMETRY_SENDER);
   }
+  logDrain(Serial);
 
   // ... other loop code
 }
 
-void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status)
+uint8_t *reservePacket()
+// Sink for packer, which encodes straight into the ring slot. A full ring has
+// none, the packer keeps its pixels pending and sends their newest values
+// once the radio catches up.
 {
-  Serial.print("\r\nLast Packet Send Status:\t");
-  Serial.println(status == ESP_NOW_SEND_SUCCESS ? "Delivery Success" : "Delivery Fail");
-  if (status == 0)
-  {
-    success = "Delivery Success :)";
-  }
-  else
+  uint8_t *slot = txRing.reserve();
+  if (slot == NULL)
   {
-    success = "Delivery Fail :(";
+    telemetry.count(TELEMETRY_TX_RING_FULL);
   }
+  return slot;
 }
 
-void loadConfig()
+void queuePacket(size_t len)
 {
-  if (!SPIFFS.exists(CONFIG_FILE))
-  {
-    Serial.println("Config file does not exist");
-    return;
-  }
-  else if (VERBOS)
-  {
-    Serial.println("Your file exists at least");
-  }
+  txRing.commit(len);
+}
 
-  File configFile = SPIFFS.open(CONFIG_FILE, "r");
-  if (!configFile)
-  {
-    Serial.println("Failed to open config file");
-    return;
-  }
-  else if (VERBOS)
+uint32_t packetClock()
+{
+  return micros();
+}
+
+void loadConfig()
+{
+  static PhotonConfig config; // Too big for the loop task's stack
+  ConfigSource source = loadConfigFile(SPIFFS, &config);
+  if (VERBOS)
   {
-    Serial.println("we read them files to filth girl");
+    Serial.print("Config loaded from ");
+    Serial.println(configSourceName(source));
   }
 
-  size_t size = configFile.size();
-  if (size > 1024)
+  // Keys config.json leaves out keep their defaults
+  if (config.present & CONFIG_CHANNEL)
   {
-    Serial.println("Config file size is too large");
-    return;
+    Channel = config.channel;
   }
-
-  if (VERBOS)
+  if (config.present & CONFIG_RECEIVER_ADDRESS)
   {
-    Serial.print("Config file size: ");
-    Serial.print(size);
-    Serial.println(" , she's a thiccc bitch");
+    memcpy(Receiver_Address, config.receiverAddress, 6);
   }
-
-  // Allocate a buffer to store contents of the file
-  std::unique_ptr<char[]> buf(new char[size]);
-
-  // Read data from the file into the buffer
-  configFile.readBytes(buf.get(), size);
-
-  // Parse the JSON object in the file
-  DynamicJsonDocument doc(1024);
-  DeserializationError error = deserializeJson(doc, buf.get());
-  if (error)
+  if (config.present & CONFIG_BROADCAST)
   {
-    Serial.println("Failed to parse config file");
-    return;
+    Broadcast = config.broadcast;
   }
-  else if (VERBOS)
+  if (config.present & CONFIG_LATCH_DELAY)
   {
-    Serial.println("Please welcum to the stage, J. SON-DHEIM!");
+    Latch_Delay_Ms = config.latchDelayMs;
   }
 
-  // Extract values
-  Channel = doc["Channel"];
-  const char *receiverAddressStr = doc["Receiver_Address"];
-  sscanf(receiverAddressStr, "%x:%x:%x:%x:%x:%x",
-         &Receiver_Address[0], &Receiver_Address[1], &Receiver_Address[2],
-         &Receiver_Address[3], &Receiver_Address[4], &Receiver_Address[5]);
-  configFile.close();
-
   Serial.println("LEts go girls");
 }
@@ -2,14 +2,26 @@
 #include <WiFi.h>
 #include <esp_wifi.h>
 #include <SPIFFS.h>
-#include <ArduinoJson.h> // Library for handling JSON
 #include <FS.h>
 #include "SPIFFS.h" // Library for using SPIFFS
+#include <FrameProtocol.h>
+#include <TxRing.h>
+#include <EspNowSender.h>
+#include <Config.h>
+#include <Telemetry.h>
+
+#define LOG_MODULE "fade"
+#define LOG_LEVEL LOG_LEVEL_INFO
+#include <Log.h>
 
-#define CONFIG_FILE "/config.json"
 #define RED_BUTTON 12
 #define BLUE_BUTTON 13
 #define VERBOS true
+#define FADE_DURATION_MS 1000 // How long the receiver takes to fade out after a button press
+#define RED_SCENE 0           // Receiver scene slots of the button fades
+#define BLUE_SCENE 1
+#define SCENE_RELOAD_MS 5000  // How often the scenes are loaded again, for receivers that started late
+#define SERIAL_TX_BUFFER 1024 // Room for a stats packet, so sending one never blocks
 
 // Define variables for configuration with default values
 int Channel = 0;
@@ -17,29 +29,32 @@ int Num_Pixels = 1;                     // THe number of Pixels we will be displ
 int Pixel_Index = 0;                    // The index of the first pixel we will be displaying
 uint8_t Start_Color[3] = {255, 255, 0}; // Default shows red color to indicated config was not loaded
 uint8_t Receiver_Address[] = {0x11, 0x11, 0x11, 0x11, 0x11, 0x11};
-
-// Define structure to hold the data to be received
-typedef struct __attribute__((packed))
-{
-  uint8_t index;
-  uint8_t red;
-  uint8_t green;
-  uint8_t blue; // Data received
-} Pixel;
+bool Broadcast = false; // Send every frame to all receivers, each one shows its own pixel window
+const uint8_t BROADCAST_ADDRESS[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 
 // Global Objects
-String success;
-esp_now_peer_info_t peerInfo;
+uint16_t sequence = 0; // Frame packet sequence number, +1 per packet
+uint8_t frameId = 0;   // Frame ID, +1 per frame
+unsigned long fadeEndsAt = 0; // millis() when the last fade finishes on the receiver
+unsigned long scenesSentAt = 0;
+bool scenesSent = false;
+unsigned long telemetrySentAt = 0;
+uint32_t loopAt = 0; // micros() of the last loop(), for the loop period
 
 // Prototype Functions
-void sendFade(Pixel startColor, Pixel endColor, int steps, int duration);
-void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status);
+FrameHeader nextHeader();
+Scene fadeScene(uint16_t pixel, RGB color);
+bool sendScenes();
+bool sendTrigger(uint8_t slot);
 void loadConfig();
+
+TxRing txRing(espNowSend); // Packets waiting for the radio
 //---------------------------------------------------------------------------------------
 
 void setup()
 {
   // Begin Setup
+  Serial.setTxBufferSize(SERIAL_TX_BUFFER);
   Serial.begin(115200);
   Serial.println("Setup started...");
 
@@ -57,89 +72,60 @@ void setup()
   // Load configuration from JSON file
   loadConfig();
 
-  // Initialize Wi-Fi
-  WiFi.mode(WIFI_STA);
-  Serial.println("Connecting to WiFi...");
-
-  // Initialize ESP Now
-  if (esp_now_init() != ESP_OK)
+  // Initialize Wi-Fi and ESP-NOW, one broadcast peer drives any number of receivers
+  if (!beginEspNowSender(Broadcast ? BROADCAST_ADDRESS : Receiver_Address, Channel, &txRing, VERBOS))
   {
-    Serial.println("Error initializing ESP-NOW");
     return;
   }
-  else if (VERBOS)
+}
+
+void loop()
+{
+  telemetry.interval(TELEMETRY_LOOP_US, micros(), &loopAt);
+  unsigned long now = millis();
+  if (now - telemetrySentAt >= TELEMETRY_INTERVAL_MS)
   {
-    Serial.println("She's giving ESP-Ussy");
+    telemetrySentAt = now;
+    sendTelemetry(Serial, TELEMETRY_SENDER);
   }
+  logDrain(Serial);
 
-  // Register callback
-  esp_now_register_send_cb(OnDataSent);
+  // Serial.println("Loop started...");
 
-  // Register peer
-  memcpy(peerInfo.peer_addr, Receiver_Address, 6);
-  peerInfo.channel = Channel;
-  peerInfo.encrypt = false;
-  if (VERBOS)
+  // The receivers play the fades themselves, a button press only triggers one
+  if (!scenesSent || now - scenesSentAt >= SCENE_RELOAD_MS)
   {
-    Serial.print("Broadcasting at the bus stop on ");
-    for (int i = 0; i < 6; i++)
-    {
-      // Print each byte with a colon separator
-      Serial.print(peerInfo.peer_addr[i], HEX);
-      Serial.print(":");
-    }
-    Serial.println();
+    scenesSent = sendScenes();
+    scenesSentAt = now;
   }
 
-  // Add peer
-  if (esp_now_add_peer(&peerInfo) != ESP_OK)
+  // Let the running fade finish before a held button starts the next one
+  if ((long)(millis() - fadeEndsAt) < 0)
   {
-    Serial.println("Failed to add peer");
+    delay(1);
     return;
   }
-  else if (VERBOS)
-  {
-    Serial.println("and you are on the list ;)");
-  }
-}
-
-void loop()
-{
-  // Serial.println("Loop started...");
-
-  // Send first data: 0, 255, 0, 0
-  Pixel red;
-  red.index = 0; // First hexadecimal value
-  red.red = 255; // Second hexadecimal value
-  red.green = 0; // Third hexadecimal value
-  red.blue = 0;  // Fourth hexadecimal value
-
-  // Send second data: 0, 0, 0, 255
-  Pixel blue;
-  blue.index = 1;  // First hexadecimal value
-  blue.red = 0;    // Second hexadecimal value
-  blue.green = 0;  // Third hexadecimal value
-  blue.blue = 255; // Fourth hexadecimal value
-
-  
 
   // Send data to all peers
   if (digitalRead(RED_BUTTON) == HIGH)
   {
-    Serial.println("Sending data Red fade");
-    Pixel black = {0, 0, 0, 0};
-
-    sendFade(red, black, 50, 1000);
+    LOG_INFO("Sending data Red fade");
+    if (sendTrigger(RED_SCENE))
+    {
+      fadeEndsAt = millis() + FADE_DURATION_MS;
+    }
     delay(100);
   }
   else if (digitalRead(BLUE_BUTTON) == HIGH)
   {
-    Serial.println("Sending data Blue fade");
-    Pixel black = {1, 0, 0, 0};
-
-    sendFade(blue, black, 50, 1000);
+    LOG_INFO("Sending data Blue fade");
+    if (sendTrigger(BLUE_SCENE))
+    {
+      fadeEndsAt = millis() + FADE_DURATION_MS;
+    }
     delay(100);
   }
+  txRing.kick(); // Retry a packet the radio refused
   delay(1);
 }
 
@@ -148,133 +134,104 @@ void onDataRecv(const uint8_t *mac_addr, const uint8_t *data, int data_len)
   // This device is only a sender, not handling received data
 }
 
-void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status)
+FrameHeader nextHeader()
+// Header of the next single-packet frame
 {
-  Serial.print("\r\nLast Packet Send Status:\t");
-  Serial.println(status == ESP_NOW_SEND_SUCCESS ? "Delivery Success" : "Delivery Fail");
-  if (status == 0)
-  {
-    success = "Delivery Success :)";
-  }
-  else
+  FrameHeader header = {FRAME_FLAG_LAST, frameId++, sequence++};
+  if (header.sequence == 0)
   {
-    success = "Delivery Fail :(";
+    header.flags |= FRAME_FLAG_SEQ_RESET; // Receivers forget what they knew about us
   }
+  return header;
 }
 
-void sendFade(Pixel startColor, Pixel endColor, int steps, int duration)
+Scene fadeScene(uint16_t pixel, RGB color)
+// One pixel shows color, then fades to black over FADE_DURATION_MS
 {
-  // Calculate step size for each color component
-  int stepR = (endColor.red - startColor.red) / steps;
-  int stepG = (endColor.green - startColor.green) / steps;
-  int stepB = (endColor.blue - startColor.blue) / steps;
-  
-  int index = startColor.index;
-
-  // Calculate delay between steps
-  int stepDelay = duration / steps;
+  Scene scene;
+  memset(&scene, 0, sizeof(scene));
+  scene.stepCount = 1;
+  SceneStep &fade = scene.steps[0];
+  fade.effect = SCENE_FADE;
+  fade.start = pixel;
+  fade.count = 1;
+  fade.a = color;
+  fade.b = {0, 0, 0};
+  fade.durationMs = FADE_DURATION_MS;
+  return scene;
+}
 
-  // Perform fading
-  for (int i = 0; i <= steps; i++)
+bool sendScenes()
+// Load the button fades into the receivers' scene slots, both in one packet
+{
+  uint8_t *packet = txRing.reserve();
+  if (packet == NULL)
   {
-    // Calculate intermediate color values based on current step
-    uint8_t r = startColor.red + (stepR * i);
-    uint8_t g = startColor.green + (stepG * i);
-    uint8_t b = startColor.blue + (stepB * i);
-
-    // Create a Pixel structure to store the current color
-    Pixel currentColor = {index, r, g, b};
-
-    // Send the current color data using ESP-NOW
-    esp_err_t result = esp_now_send(Receiver_Address, (uint8_t *)&currentColor, sizeof(currentColor));
-
-    if (result != ESP_OK)
-    {
-      Serial.println("Error sending color data over ESP-NOW");
-      return;
-    }
-
-    // Delay for a short time to observe the color transition
-    delay(stepDelay);
+    telemetry.count(TELEMETRY_TX_RING_FULL);
+    return false;
   }
-  esp_err_t result = esp_now_send(Receiver_Address, (uint8_t *)&endColor, sizeof(endColor));
 
-  if (result != ESP_OK)
+  FrameWriter writer(packet, FRAME_MAX_PACKET);
+  writer.begin(nextHeader());
+  writer.load(RED_SCENE, fadeScene(0, {255, 0, 0}));
+  writer.load(BLUE_SCENE, fadeScene(1, {0, 0, 255}));
+  txRing.commit(writer.length());
+  return true;
+}
+
+bool sendTrigger(uint8_t slot)
+// Play a loaded scene, one three-byte record instead of the colours
+{
+  uint8_t *packet = txRing.reserve();
+  if (packet == NULL)
   {
-    Serial.println("Error sending color data over ESP-NOW");
-    return;
+    telemetry.count(TELEMETRY_TX_RING_FULL);
+    LOG_WARN("Radio is busy, dropping the fade");
+    return false;
   }
+
+  FrameWriter writer(packet, FRAME_MAX_PACKET);
+  writer.begin(nextHeader());
+  writer.trigger(slot, SCENE_PLAY);
+  txRing.commit(writer.length());
+  return true;
 }
 
 void loadConfig()
 {
-  if (!SPIFFS.exists(CONFIG_FILE))
-  {
-    Serial.println("Config file does not exist");
-    return;
-  }
-  else if (VERBOS)
+  static PhotonConfig config; // Too big for the loop task's stack
+  ConfigSource source = loadConfigFile(SPIFFS, &config);
+  if (VERBOS)
   {
-    Serial.println("Your file exists at least");
+    Serial.print("Config loaded from ");
+    Serial.println(configSourceName(source));
   }
 
-  File configFile = SPIFFS.open(CONFIG_FILE, "r");
-  if (!configFile)
+  // Keys config.json leaves out keep their defaults
+  if (config.present & CONFIG_CHANNEL)
   {
-    Serial.println("Failed to open config file");
-    return;
+    Channel = config.channel;
   }
-  else if (VERBOS)
+  if (config.present & CONFIG_NUM_PIXELS)
   {
-    Serial.println("we read them files to filth girl");
+    Num_Pixels = config.numPixels;
   }
-
-  size_t size = configFile.size();
-  if (size > 1024)
+  if (config.present & CONFIG_PIXEL_INDEX)
   {
-    Serial.println("Config file size is too large");
-    return;
+    Pixel_Index = config.pixelIndex;
   }
-
-  if (VERBOS)
+  if (config.present & CONFIG_RECEIVER_ADDRESS)
   {
-    Serial.print("Config file size: ");
-    Serial.print(size);
-    Serial.println(" , she's a thiccc bitch");
+    memcpy(Receiver_Address, config.receiverAddress, 6);
   }
-
-  // Allocate a buffer to store contents of the file
-  std::unique_ptr<char[]> buf(new char[size]);
-
-  // Read data from the file into the buffer
-  configFile.readBytes(buf.get(), size);
-
-  // Parse the JSON object in the file
-  DynamicJsonDocument doc(1024);
-  DeserializationError error = deserializeJson(doc, buf.get());
-  if (error)
-  {
-    Serial.println("Failed to parse config file");
-    return;
-  }
-  else if (VERBOS)
+  if (config.present & CONFIG_BROADCAST)
   {
-    Serial.println("Please welcum to the stage, J. SON-DHEIM!");
+    Broadcast = config.broadcast;
   }
-
-  // Extract values
-  Channel = doc["Channel"];
-  Num_Pixels = doc["Num_Pixels"];
-  Pixel_Index = doc["Pixel_Index"];
-  const char *receiverAddressStr = doc["Receiver_Address"];
-  sscanf(receiverAddressStr, "%x:%x:%x:%x:%x:%x",
-         &Receiver_Address[0], &Receiver_Address[1], &Receiver_Address[2],
-         &Receiver_Address[3], &Receiver_Address[4], &Receiver_Address[5]);
-  JsonArray startColor = doc["Start_Color"];
-  for (int i = 0; i < 3; i++)
+  if (config.present & CONFIG_START_COLOR)
   {
-    Start_Color[i] = startColor[i];
+    Start_Color[0] = config.startColor.red;
+    Start_Color[1] = config.startColor.green;
+    Start_Color[2] = config.startColor.blue;
   }
-
-  configFile.close();
-}
\ No newline at end of file
+}
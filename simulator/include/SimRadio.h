@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+#include "esp_now.h"
+
+// 802.11b frame around an ESP-NOW payload at the default 1 Mbps rate:
+// long PLCP preamble and header, MAC header, vendor action header and FCS
+#define AIR_PREAMBLE_US 192
+#define AIR_OVERHEAD_BYTES 43
+#define AIR_ACK_US 314 // SIFS plus the ACK a unicast waits for
+
+// How the simulated air treats each packet
+typedef struct
+{
+  double loss;        // Chance one transmission is lost, 0-1
+  uint8_t retries;    // Unicast only: times a lost transmission is sent again, each with its own air time.
+                      // A unicast lost every time reports ESP_NOW_SEND_FAIL.
+  uint32_t latencyUs; // Delay from the end of the air time to the receive callback
+  uint32_t jitterUs;  // Up to this much extra delay, uniform. Lets packets overtake each other.
+  uint32_t rateKbps;  // PHY rate, ESP-NOW sends at 1 Mbps unless told otherwise
+  bool broadcast;     // No ACK is waited for, every send reports success
+} RadioModel;
+
+typedef struct
+{
+  uint32_t sent;           // Packets put on the air
+  uint32_t lost;           // Packets that never arrived
+  uint32_t retries;        // Transmissions repeated after a loss
+  uint32_t bytes;          // Payload bytes put on the air
+  uint32_t deliveredBytes; // Payload bytes that arrived
+  uint64_t airtimeUs;      // Time the air was busy
+} RadioStats;
+
+// One sender and one receiver sharing the air. esp_now_send() queues a
+// packet behind whatever is on the air. advance() then runs the send and
+// receive callbacks in time order, with simNow set to when each happens, so
+// callbacks that send again see the right time.
+class SimRadio
+{
+public:
+  SimRadio();
+
+  void configure(const RadioModel &model, uint32_t seed);
+
+  esp_err_t send(const uint8_t *data, size_t len);
+  void setSendCallback(esp_now_send_cb_t cb) { sendCallback = cb; }
+  void setRecvCallback(esp_now_recv_cb_t cb) { recvCallback = cb; }
+
+  // Run every callback due by now
+  void advance(uint64_t now);
+
+  uint64_t airtimeUs(size_t len) const;
+  const RadioStats &stats() const { return totals; }
+
+private:
+  struct Event
+  {
+    uint64_t at;
+    bool delivery; // Receive callback if true, send callback if false
+    bool delivered;
+    uint8_t data[ESP_NOW_MAX_DATA_LEN];
+    size_t len;
+  };
+
+  RadioModel model;
+  std::mt19937 random;
+  std::vector<Event> events; // Unordered, advance() picks the earliest
+  uint64_t airFreeAt;        // simNow when the packet on the air is done
+  esp_now_send_cb_t sendCallback;
+  esp_now_recv_cb_t recvCallback;
+  RadioStats totals;
+};
+
+extern SimRadio radio;
+extern uint64_t simNow; // Simulated time in microseconds since the start
+
+#define SENDER_MAC {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01}
@@ -0,0 +1,142 @@
+#include "SimRadio.h"
+#include <string.h>
+
+SimRadio radio;
+uint64_t simNow = 0;
+
+static const uint8_t senderMac[] = SENDER_MAC;
+
+SimRadio::SimRadio() : random(1), airFreeAt(0), sendCallback(NULL), recvCallback(NULL)
+{
+  RadioModel defaults = {0.0, 0, 0, 0, 1000, false};
+  model = defaults;
+  memset(&totals, 0, sizeof(totals));
+}
+
+void SimRadio::configure(const RadioModel &model, uint32_t seed)
+{
+  this->model = model;
+  if (this->model.rateKbps == 0)
+  {
+    this->model.rateKbps = 1000;
+  }
+  random.seed(seed);
+}
+
+uint64_t SimRadio::airtimeUs(size_t len) const
+{
+  uint64_t us = AIR_PREAMBLE_US + (AIR_OVERHEAD_BYTES + len) * 8000ULL / model.rateKbps;
+  return model.broadcast ? us : us + AIR_ACK_US;
+}
+
+esp_err_t SimRadio::send(const uint8_t *data, size_t len)
+{
+  if (len == 0 || len > ESP_NOW_MAX_DATA_LEN)
+  {
+    return ESP_ERR_ESPNOW_ARG;
+  }
+
+  // A lost unicast goes out again until it gets through or runs out of
+  // retries, keeping the air busy all the while
+  uint8_t attempts = model.broadcast ? 1 : model.retries + 1;
+  bool lost = true;
+  uint64_t start = airFreeAt > simNow ? airFreeAt : simNow;
+  uint64_t airtime = airtimeUs(len);
+  for (uint8_t attempt = 0; attempt < attempts && lost; attempt++)
+  {
+    if (attempt > 0)
+    {
+      totals.retries++;
+    }
+    lost = std::uniform_real_distribution<double>(0.0, 1.0)(random) < model.loss;
+    start += airtime;
+    totals.airtimeUs += airtime;
+  }
+  airFreeAt = start;
+  totals.sent++;
+  totals.bytes += len;
+  if (lost)
+  {
+    totals.lost++;
+  }
+  else
+  {
+    totals.deliveredBytes += len;
+  }
+
+  Event done;
+  done.at = airFreeAt;
+  done.delivery = false;
+  done.delivered = model.broadcast || !lost;
+  done.len = 0;
+  events.push_back(done);
+
+  if (!lost)
+  {
+    Event arrival;
+    arrival.at = airFreeAt + model.latencyUs;
+    if (model.jitterUs > 0)
+    {
+      arrival.at += std::uniform_int_distribution<uint32_t>(0, model.jitterUs)(random);
+    }
+    arrival.delivery = true;
+    arrival.delivered = true;
+    memcpy(arrival.data, data, len);
+    arrival.len = len;
+    events.push_back(arrival);
+  }
+  return ESP_OK;
+}
+
+void SimRadio::advance(uint64_t now)
+{
+  for (;;)
+  {
+    // Callbacks may send, which adds events, so look for the earliest every time
+    size_t next = events.size();
+    for (size_t i = 0; i < events.size(); i++)
+    {
+      if (events[i].at <= now && (next == events.size() || events[i].at < events[next].at))
+      {
+        next = i;
+      }
+    }
+    if (next == events.size())
+    {
+      break;
+    }
+
+    Event event = events[next];
+    events[next] = events.back();
+    events.pop_back();
+
+    uint64_t saved = simNow;
+    simNow = event.at;
+    if (event.delivery && recvCallback != NULL)
+    {
+      recvCallback(senderMac, event.data, (int)event.len);
+    }
+    else if (!event.delivery && sendCallback != NULL)
+    {
+      sendCallback(senderMac, event.delivered ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+    }
+    simNow = saved;
+  }
+}
+
+esp_err_t esp_now_send(const uint8_t * /* peer_addr */, const uint8_t *data, size_t len)
+{
+  return radio.send(data, len);
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb)
+{
+  radio.setSendCallback(cb);
+  return ESP_OK;
+}
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb)
+{
+  radio.setRecvCallback(cb);
+  return ESP_OK;
+}
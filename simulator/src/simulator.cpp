@@ -0,0 +1,770 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <esp_now.h>
+#include <FrameProtocol.h>
+#include <SerialFrameParser.h>
+#include <TxRing.h>
+#include <SerialBridge.h>
+#include <FrameReceiver.h>
+#include <FrameComposer.h>
+#include <RefreshScheduler.h>
+#include <RenderLoop.h>
+#include <LedOutputs.h>
+#include "SimRadio.h"
+
+// End-to-end simulation of sender-gh and one receiver on simulated time.
+//
+// A serial stream, recorded from Grasshopper or generated, reaches the
+// sender's UART at the configured baud rate. The sender side runs sender-gh's
+// SerialBridge and TxRing, and its packets cross a SimRadio link with loss,
+// latency and a 250-byte ESP-NOW frame model. The receiver side runs the
+// receiver sketch's FrameReceiver, FrameComposer and RenderLoop, with the
+// render task's sleeps and wakes on simulated time, and an LED frame is done
+// once the strips are clocked out.
+//
+// Every serial frame's latency runs from when Grasshopper wrote it to when
+// the LEDs showed it or a newer frame. Frames the receiver shows are compared
+// with what Grasshopper sent, so lost packets that leave wrong colours show
+// up in the report. With --adaptive the sender paces frames with sender-gh's
+// RateController, and colours it quantized count as right.
+
+#define SIM_TICK_US 10
+#define SERIAL_RX_BUFFER 8192     // Same as sender-gh
+#define SERIAL_CHUNK 64           // Bytes sender-gh takes from the UART per loop()
+#define FLUSH_INTERVAL_MS 5       // Same as sender-gh
+#define SENDER_BUSY_LOOP_US 20    // One sender loop() that found serial data
+#define SENDER_IDLE_LOOP_US 1000  // delay(1) when it found none
+#define RECEIVER_CLOCK_OFFSET 0xFFF00000ULL // The receiver's micros() wraps about a second in
+#define DRAIN_US 2000000          // Keep running this long after the last serial byte
+#define MAX_SERIAL_PIXELS ((SERIAL_MAX_PAYLOAD - 3) / sizeof(RGB))
+
+enum Pattern
+{
+  PATTERN_CHASE,   // A bright head running along a dim gradient, few pixels change
+  PATTERN_RAINBOW, // Every pixel changes by the same step every frame, cheap as ADD runs
+  PATTERN_PLASMA,  // Every pixel drifts by its own small step, mostly literal colours
+};
+
+typedef struct
+{
+  const char *input; // Serial capture to replay, NULL generates a stream
+  uint32_t baud;
+  uint16_t pixels;   // Generated stream only
+  uint16_t fps;      // Generated stream only
+  uint32_t frames;   // Generated stream only
+  uint8_t pattern;   // Generated stream only, Pattern
+  uint16_t latchMs;
+  uint16_t maxFps;
+  uint16_t windowStart; // Receiver Pixel_Index
+  uint16_t windowCount; // Receiver Num_Pixels
+  uint16_t leds;
+  uint8_t strips;
+  RadioModel radio;
+  uint32_t seed;
+  bool adaptive; // Pace frames with sender-gh's RateController
+} Options;
+
+// A binary frame in the serial stream
+typedef struct
+{
+  size_t lastByte;    // Offset of its last byte, where the parser completes it
+  uint64_t writtenAt; // When Grasshopper wrote it
+} SerialFrame;
+
+// Serial input
+std::vector<uint8_t> stream;
+std::vector<uint64_t> byteWrittenAt; // When Grasshopper wrote each byte
+std::vector<uint64_t> byteArrivesAt; // When each byte reaches the UART
+std::vector<SerialFrame> serialFrames;
+std::vector<RGB> expected; // Pixels [0, span) after every serial frame, span per frame
+uint16_t span = 0;
+size_t arrived = 0;
+std::deque<size_t> uart; // Offsets of the bytes waiting in the RX buffer
+uint32_t uartOverflow = 0;
+
+// Sender
+const uint8_t receiverMac[] = {0x11, 0x11, 0x11, 0x11, 0x11, 0x11};
+bool sendPacket(const uint8_t *data, size_t len);
+uint8_t *reservePacket();
+void queuePacket(size_t len);
+uint32_t packetClock();
+TxRing txRing(sendPacket);
+const PacketSink packetSink = {reservePacket, queuePacket};
+SerialBridge bridge(txRing, packetSink, FLUSH_INTERVAL_MS);
+uint8_t *reservedPacket = NULL; // Ring slot the packer is building in
+uint8_t worstQuantize = 0; // Most bits the pacing ever dropped
+long newestHanded = -1;  // Newest serial frame given to the packer
+long completing = -1;    // Serial frame whose last byte is being fed, -1 between frames
+long frameCovers[256];   // Newest serial frame in each frame ID the packer sent
+
+// Receiver
+FrameReceiver receiver;
+FrameComposer composer;
+RefreshScheduler refresh(60);
+uint16_t windowStart = 0;
+uint16_t windowCount = FRAME_MAX_PIXELS;
+uint32_t outputUs = 0;
+uint64_t renderAwakeAt = 0;   // The render task sleeps until then, a published frame wakes it
+uint64_t renderBusyUntil = 0; // End of the render in progress, its latch wait and show included
+
+// Results
+std::vector<uint64_t> latencies;
+long newestShown = -1;
+uint32_t framesShown = 0;
+uint32_t framesWrong = 0;
+int worstError = 0; // Largest difference of one channel from what Grasshopper sent
+uint64_t firstShownAt = 0;
+uint64_t lastShownAt = 0;
+
+void usage();
+bool parseOptions(int argc, char **argv, Options *options);
+bool loadCapture(const char *path, uint32_t baud);
+void generateStream(const Options &options);
+void scanStream();
+void setupSender(const Options &options);
+void setupReceiver(const Options &options);
+void receiveSerial();
+uint32_t senderLoop();
+long serialFrameEndingAt(size_t offset);
+void onDataSent(const uint8_t *mac_addr, esp_now_send_status_t status);
+void onDataRecv(const uint8_t *mac_addr, const uint8_t *data, int data_len);
+void renderStep();
+uint32_t renderNow();
+void renderSleep(uint32_t us);
+bool takeFrame();
+bool animating();
+bool drawFrame(bool newFrame);
+void frameShown(uint8_t frameId, uint64_t doneAt);
+void report(const Options &options, uint64_t duration);
+//---------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+  Options options;
+  if (!parseOptions(argc, argv, &options))
+  {
+    usage();
+    return 2;
+  }
+
+  if (options.input != NULL)
+  {
+    if (!loadCapture(options.input, options.baud))
+    {
+      return 1;
+    }
+  }
+  else
+  {
+    generateStream(options);
+  }
+  scanStream();
+  if (serialFrames.empty())
+  {
+    fprintf(stderr, "No binary frames in the serial stream\n");
+    return 1;
+  }
+
+  radio.configure(options.radio, options.seed);
+  setupSender(options);
+  setupReceiver(options);
+
+  uint64_t end = byteArrivesAt.back() + DRAIN_US;
+  uint64_t nextSenderLoop = 0;
+  for (simNow = 0; simNow <= end; simNow += SIM_TICK_US)
+  {
+    receiveSerial();       // The UART fills in the background
+    radio.advance(simNow); // Send completions and deliveries
+    if (simNow >= nextSenderLoop)
+    {
+      nextSenderLoop = simNow + senderLoop();
+    }
+    renderStep();
+  }
+
+  report(options, end);
+  return 0;
+}
+
+void usage()
+{
+  fprintf(stderr,
+          "Usage: simulator [options] [capture]\n"
+          "\n"
+          "Replays capture, raw bytes as Grasshopper writes them to sender-gh's serial\n"
+          "port, or generates a stream without one.\n"
+          "\n"
+          "  --baud N        Serial rate (921600, as sender-gh)\n"
+          "  --pixels N      Generated: pixels per frame (300)\n"
+          "  --fps N         Generated: frames per second (30)\n"
+          "  --frames N      Generated: frames (300)\n"
+          "  --rainbow       Generated: change every pixel every frame, not a chase\n"
+          "  --plasma        Generated: drift every pixel its own way, hard to compress\n"
+          "  --loss P        Chance a transmission is lost, 0-1 (0)\n"
+          "  --retries N     Times a lost unicast is sent again before it fails (0)\n"
+          "  --latency-us N  Delay after the air time before a packet arrives (300)\n"
+          "  --jitter-us N   Up to this much extra delay per packet (0)\n"
+          "  --rate-kbps N   Radio PHY rate (1000)\n"
+          "  --broadcast     No ACKs, the sender never sees a packet fail\n"
+          "  --adaptive      Pace frames to the link like sender-gh's rate controller\n"
+          "  --latch-ms N    Sender Latch_Delay_Ms (0)\n"
+          "  --max-fps N     Receiver Max_FPS (60)\n"
+          "  --first N       Receiver Pixel_Index, the first pixel it shows (0)\n"
+          "  --count N       Receiver Num_Pixels, pixels it shows from there (all)\n"
+          "  --leds N        LEDs on the receiver (300)\n"
+          "  --strips N      Strips the LEDs are split over, driven in parallel (1)\n"
+          "  --seed N        Random seed for loss and jitter (1)\n");
+}
+
+bool parseOptions(int argc, char **argv, Options *options)
+{
+  options->input = NULL;
+  options->baud = 921600;
+  options->pixels = 300;
+  options->fps = 30;
+  options->frames = 300;
+  options->pattern = PATTERN_CHASE;
+  options->latchMs = 0;
+  options->maxFps = 60;
+  options->windowStart = 0;
+  options->windowCount = FRAME_MAX_PIXELS;
+  options->leds = 300;
+  options->strips = 1;
+  options->radio.loss = 0.0;
+  options->radio.retries = 0;
+  options->radio.latencyUs = 300;
+  options->radio.jitterUs = 0;
+  options->radio.rateKbps = 1000;
+  options->radio.broadcast = false;
+  options->seed = 1;
+  options->adaptive = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (strcmp(arg, "--rainbow") == 0)
+    {
+      options->pattern = PATTERN_RAINBOW;
+      continue;
+    }
+    if (strcmp(arg, "--plasma") == 0)
+    {
+      options->pattern = PATTERN_PLASMA;
+      continue;
+    }
+    if (strcmp(arg, "--adaptive") == 0)
+    {
+      options->adaptive = true;
+      continue;
+    }
+    if (strcmp(arg, "--broadcast") == 0)
+    {
+      options->radio.broadcast = true;
+      continue;
+    }
+    if (arg[0] != '-')
+    {
+      options->input = arg;
+      continue;
+    }
+    if (value == NULL)
+    {
+      return false;
+    }
+    i++;
+
+    unsigned long number = strtoul(value, NULL, 10);
+    if (strcmp(arg, "--baud") == 0 && number > 0)
+    {
+      options->baud = number;
+    }
+    else if (strcmp(arg, "--pixels") == 0 && number > 0 && number <= FRAME_MAX_PIXELS)
+    {
+      options->pixels = number;
+    }
+    else if (strcmp(arg, "--fps") == 0 && number > 0 && number <= 1000)
+    {
+      options->fps = number;
+    }
+    else if (strcmp(arg, "--frames") == 0 && number > 0)
+    {
+      options->frames = number;
+    }
+    else if (strcmp(arg, "--loss") == 0)
+    {
+      options->radio.loss = strtod(value, NULL);
+    }
+    else if (strcmp(arg, "--retries") == 0 && number < 0xFF)
+    {
+      options->radio.retries = number;
+    }
+    else if (strcmp(arg, "--latency-us") == 0)
+    {
+      options->radio.latencyUs = number;
+    }
+    else if (strcmp(arg, "--jitter-us") == 0)
+    {
+      options->radio.jitterUs = number;
+    }
+    else if (strcmp(arg, "--rate-kbps") == 0 && number > 0)
+    {
+      options->radio.rateKbps = number;
+    }
+    else if (strcmp(arg, "--latch-ms") == 0 && number <= 0xFFFF)
+    {
+      options->latchMs = number;
+    }
+    else if (strcmp(arg, "--max-fps") == 0 && number <= 1000)
+    {
+      options->maxFps = number;
+    }
+    else if (strcmp(arg, "--first") == 0 && number < FRAME_MAX_PIXELS)
+    {
+      options->windowStart = number;
+    }
+    else if (strcmp(arg, "--count") == 0 && number > 0 && number <= FRAME_MAX_PIXELS)
+    {
+      options->windowCount = number;
+    }
+    else if (strcmp(arg, "--leds") == 0 && number > 0 && number <= FRAME_MAX_PIXELS)
+    {
+      options->leds = number;
+    }
+    else if (strcmp(arg, "--strips") == 0 && number > 0 && number <= MAX_OUTPUTS)
+    {
+      options->strips = number;
+    }
+    else if (strcmp(arg, "--seed") == 0)
+    {
+      options->seed = number;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool loadCapture(const char *path, uint32_t baud)
+// The capture has no timing, its bytes reach the UART back to back
+{
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+  {
+    stream.insert(stream.end(), chunk, chunk + n);
+  }
+  fclose(file);
+
+  double byteUs = 10e6 / baud; // Start, 8 data and stop bits
+  for (size_t i = 0; i < stream.size(); i++)
+  {
+    byteWrittenAt.push_back((uint64_t)(i * byteUs));
+    byteArrivesAt.push_back((uint64_t)((i + 1) * byteUs));
+  }
+  return !stream.empty();
+}
+
+static void writeSerialFrame(uint16_t start, const RGB *colors, uint16_t count, uint64_t writtenAt)
+{
+  uint8_t body[SERIAL_MAX_PAYLOAD];
+  uint8_t frame[SERIAL_MAX_PAYLOAD + SERIAL_FRAME_OVERHEAD];
+  body[0] = start & 0xFF;
+  body[1] = start >> 8;
+  memcpy(&body[2], colors, count * sizeof(RGB));
+  size_t len = writeSerialFrame(frame, sizeof(frame), SERIAL_TYPE_PIXELS, body, 2 + count * sizeof(RGB));
+  stream.insert(stream.end(), frame, frame + len);
+  byteWrittenAt.resize(stream.size(), writtenAt);
+}
+
+static RGB wheel(uint8_t position)
+{
+  if (position < 85)
+  {
+    return {(uint8_t)(255 - position * 3), (uint8_t)(position * 3), 0};
+  }
+  if (position < 170)
+  {
+    position -= 85;
+    return {0, (uint8_t)(255 - position * 3), (uint8_t)(position * 3)};
+  }
+  position -= 170;
+  return {(uint8_t)(position * 3), 0, (uint8_t)(255 - position * 3)};
+}
+
+void generateStream(const Options &options)
+// One image every 1/fps, split into as many serial frames as it needs
+{
+  std::vector<RGB> image(options.pixels);
+  for (uint32_t k = 0; k < options.frames; k++)
+  {
+    for (uint16_t i = 0; i < options.pixels; i++)
+    {
+      if (options.pattern == PATTERN_RAINBOW)
+      {
+        image[i] = wheel(i * 256 / options.pixels + k * 4);
+      }
+      else if (options.pattern == PATTERN_PLASMA)
+      {
+        // Three slow waves, one per channel, at different speeds
+        double t = (double)k / options.fps;
+        image[i] = {(uint8_t)(127.5 + 127.5 * sin(i * 0.07 + t * 1.3)),
+                    (uint8_t)(127.5 + 127.5 * sin(i * 0.11 - t * 0.9)),
+                    (uint8_t)(127.5 + 127.5 * sin(i * 0.05 + t * 0.5 + 2.0))};
+      }
+      else
+      {
+        // A dim gradient with a bright head and a short tail running along it
+        uint16_t behind = (k + options.pixels - i) % options.pixels;
+        uint8_t level = behind < 4 ? 255 >> (behind * 2) : 0;
+        image[i] = {level, (uint8_t)(i * 32 / options.pixels), (uint8_t)(level / 2)};
+      }
+    }
+
+    uint64_t writtenAt = (uint64_t)k * 1000000ULL / options.fps;
+    for (uint16_t start = 0; start < options.pixels; start += MAX_SERIAL_PIXELS)
+    {
+      uint16_t count = std::min<uint16_t>(options.pixels - start, MAX_SERIAL_PIXELS);
+      writeSerialFrame(start, &image[start], count, writtenAt);
+    }
+  }
+
+  // Bytes go out back to back once written, so a slow link queues frames on the host
+  double byteUs = 10e6 / options.baud;
+  double wireFreeAt = 0;
+  for (size_t i = 0; i < stream.size(); i++)
+  {
+    wireFreeAt = std::max(wireFreeAt, (double)byteWrittenAt[i]) + byteUs;
+    byteArrivesAt.push_back((uint64_t)wireFreeAt);
+  }
+}
+
+void scanStream()
+// Find every binary frame and what the LEDs should show after it
+{
+  SerialFrameParser parser;
+  std::vector<RGB> image(FRAME_MAX_PIXELS);
+  std::vector<std::vector<RGB> > images;
+  for (size_t i = 0; i < stream.size(); i++)
+  {
+    if (parser.feed(stream[i]) != SERIAL_FRAME || parser.type() != SERIAL_TYPE_PIXELS ||
+        parser.bodyLength() < 2 || (parser.bodyLength() - 2) % sizeof(RGB) != 0)
+    {
+      continue;
+    }
+    const uint8_t *body = parser.body();
+    uint16_t start = body[0] | (body[1] << 8);
+    uint16_t count = (parser.bodyLength() - 2) / sizeof(RGB);
+    for (uint16_t p = 0; p < count && start + p < FRAME_MAX_PIXELS; p++)
+    {
+      memcpy(&image[start + p], &body[2 + p * sizeof(RGB)], sizeof(RGB));
+      span = std::max<uint16_t>(span, start + p + 1);
+    }
+
+    size_t first = i + 1 - (parser.bodyLength() + SERIAL_FRAME_OVERHEAD);
+    SerialFrame serialFrame = {i, byteWrittenAt[first]};
+    serialFrames.push_back(serialFrame);
+    images.push_back(image);
+  }
+
+  for (size_t k = 0; k < images.size(); k++)
+  {
+    expected.insert(expected.end(), images[k].begin(), images[k].begin() + span);
+  }
+}
+
+void setupSender(const Options &options)
+{
+  for (int i = 0; i < 256; i++)
+  {
+    frameCovers[i] = -1;
+  }
+  bridge.packer().setLatch(options.latchMs, packetClock);
+  bridge.setAdaptive(options.adaptive);
+  esp_now_register_send_cb(onDataSent);
+}
+
+void setupReceiver(const Options &options)
+{
+  windowStart = options.windowStart;
+  windowCount = options.windowCount;
+  receiver.setWindow(windowStart, windowCount);
+
+  // Split the LEDs evenly over the strips
+  uint8_t pins[MAX_OUTPUTS];
+  uint16_t counts[MAX_OUTPUTS];
+  for (uint8_t i = 0; i < options.strips; i++)
+  {
+    pins[i] = i;
+    counts[i] = (options.leds + options.strips - 1) / options.strips;
+  }
+  LedOutput outputs[MAX_OUTPUTS];
+  uint8_t outputCount = planOutputs(pins, counts, options.strips, options.leds, outputs);
+  outputUs = frameTimeUs(outputs, outputCount, true);
+
+  refresh.setMaxFps(options.maxFps);
+  esp_now_register_recv_cb(onDataRecv);
+}
+
+static uint32_t receiverMicros()
+{
+  return (uint32_t)(simNow + RECEIVER_CLOCK_OFFSET);
+}
+
+static uint32_t receiverMillis()
+{
+  return (uint32_t)((simNow + RECEIVER_CLOCK_OFFSET) / 1000);
+}
+
+void receiveSerial()
+// Bytes that find the RX buffer full are lost, like on the UART
+{
+  while (arrived < stream.size() && byteArrivesAt[arrived] <= simNow)
+  {
+    if (uart.size() < SERIAL_RX_BUFFER)
+    {
+      uart.push_back(arrived);
+    }
+    else
+    {
+      uartOverflow++;
+    }
+    arrived++;
+  }
+}
+
+uint32_t senderLoop()
+// sender-gh's loop(), returns how long it took
+{
+  unsigned long now = simNow / 1000;
+  size_t n = std::min<size_t>(uart.size(), SERIAL_CHUNK);
+  for (size_t i = 0; i < n; i++)
+  {
+    size_t offset = uart.front();
+    uart.pop_front();
+    completing = serialFrameEndingAt(offset);
+    if (bridge.feed(stream[offset], now) == SERIAL_FRAME && completing >= 0)
+    {
+      newestHanded = completing;
+    }
+    completing = -1;
+  }
+
+  bridge.poll(now);
+  worstQuantize = std::max(worstQuantize, bridge.rate().pacing().quantizeBits);
+  return n > 0 ? SENDER_BUSY_LOOP_US : SENDER_IDLE_LOOP_US;
+}
+
+long serialFrameEndingAt(size_t offset)
+// Which frame of the stream ends with this byte. Bytes lost to an overflow
+// can make the parser complete none there, or a different one.
+{
+  SerialFrame key = {offset, 0};
+  std::vector<SerialFrame>::iterator found = std::lower_bound(
+      serialFrames.begin(), serialFrames.end(), key,
+      [](const SerialFrame &a, const SerialFrame &b) { return a.lastByte < b.lastByte; });
+  return found != serialFrames.end() && found->lastByte == offset ? found - serialFrames.begin() : -1;
+}
+
+void onDataSent(const uint8_t * /* mac_addr */, esp_now_send_status_t status)
+{
+  txRing.onSent(status == ESP_NOW_SEND_SUCCESS);
+}
+
+bool sendPacket(const uint8_t *data, size_t len)
+{
+  return esp_now_send(receiverMac, data, len) == ESP_OK;
+}
+
+uint8_t *reservePacket()
+{
+  reservedPacket = txRing.reserve();
+  return reservedPacket;
+}
+
+void queuePacket(size_t len)
+// Remember which serial frames each frame ID carries. A frame the bridge
+// flushes as soon as it completes carries the serial frame being fed.
+{
+  FrameHeader header;
+  if (readFrameHeader(reservedPacket, len, &header) == FRAME_OK &&
+      (header.flags & (FRAME_FLAG_LAST | FRAME_FLAG_COMMIT)) == FRAME_FLAG_LAST)
+  {
+    frameCovers[header.frameId] = completing >= 0 ? completing : newestHanded;
+  }
+  txRing.commit(len);
+}
+
+uint32_t packetClock()
+{
+  return (uint32_t)simNow;
+}
+
+void onDataRecv(const uint8_t *mac_addr, const uint8_t *data, int data_len)
+// The receiver's onDataRecv() and handOver()
+{
+  ReceiveResult result = receiver.receive(mac_addr, data, data_len, receiverMicros(), receiverMillis());
+  if (result == RECEIVE_NOTHING)
+  {
+    return;
+  }
+  if (result == RECEIVE_REPLACED)
+  {
+    refresh.frameDropped();
+  }
+  renderAwakeAt = simNow; // wakeRenderer()
+}
+
+void renderStep()
+// The receiver's render task: steps once it is awake and done with the last
+// render. Every hook answers on simulated time.
+{
+  static const RenderHooks hooks = {renderNow, renderSleep, takeFrame, animating, drawFrame};
+  static RenderLoop renderLoop(hooks, refresh);
+  if (simNow < renderAwakeAt || simNow < renderBusyUntil)
+  {
+    return;
+  }
+  renderLoop.step();
+}
+
+uint32_t renderNow()
+// The render task's micros(), past the end of a render it just did
+{
+  return (uint32_t)(std::max(simNow, renderBusyUntil) + RECEIVER_CLOCK_OFFSET);
+}
+
+void renderSleep(uint32_t us)
+{
+  renderAwakeAt = simNow + us;
+}
+
+bool takeFrame()
+{
+  return receiver.takeFrame();
+}
+
+bool animating()
+{
+  return composer.animating();
+}
+
+bool drawFrame(bool newFrame)
+// Compose like the receiver, hold the frame for its latch time, then clock
+// it out to the strips
+{
+  const FrameBuffer &current = receiver.frame();
+  unsigned long now = receiverMillis();
+  uint32_t wait = newFrame ? latchWait(current, receiverMicros()) : 0;
+  composer.compose(current, newFrame, now, now + (wait + 500) / 1000);
+
+  uint64_t doneAt = simNow + wait + outputUs;
+  renderBusyUntil = doneAt;
+  if (newFrame)
+  {
+    frameShown(current.frameId, doneAt);
+  }
+  return true;
+}
+
+void frameShown(uint8_t frameId, uint64_t doneAt)
+{
+  long covers = frameCovers[frameId];
+  if (covers <= newestShown)
+  {
+    return; // Nothing newer than what the LEDs already show
+  }
+
+  // Every serial frame up to this one is now on the LEDs or overtaken by it
+  for (long k = newestShown + 1; k <= covers; k++)
+  {
+    latencies.push_back(doneAt - serialFrames[k].writtenAt);
+  }
+  newestShown = covers;
+
+  // Only the receiver's window is compared. Quantizing moves a channel by
+  // less than 1 << bits, anything more is a lost packet.
+  const RGB *want = &expected[(size_t)covers * span];
+  const RGB *got = composer.shown();
+  uint32_t end = std::min<uint32_t>(span, (uint32_t)windowStart + windowCount);
+  int error = 0;
+  for (uint32_t i = windowStart; i < end; i++)
+  {
+    error = std::max(error, abs(got[i].red - want[i].red));
+    error = std::max(error, abs(got[i].green - want[i].green));
+    error = std::max(error, abs(got[i].blue - want[i].blue));
+  }
+  if (error >= (1 << worstQuantize))
+  {
+    framesWrong++;
+  }
+  worstError = std::max(worstError, error);
+  if (framesShown++ == 0)
+  {
+    firstShownAt = doneAt;
+  }
+  lastShownAt = doneAt;
+}
+
+static double percentileMs(const std::vector<uint64_t> &sorted, double p)
+{
+  size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+  return sorted[i] / 1000.0;
+}
+
+void report(const Options &options, uint64_t duration)
+{
+  const RadioStats &air = radio.stats();
+  const SequenceStats &seq = receiver.sequenceStats();
+  RefreshStats renders = refresh.stats();
+  uint64_t written = serialFrames.back().writtenAt - serialFrames.front().writtenAt;
+
+  printf("Serial frames       %zu written over %.2f s, %.1f fps", serialFrames.size(), written / 1e6,
+         written > 0 ? (serialFrames.size() - 1) * 1e6 / written : 0.0);
+  printf(", %u text lines, %u bad, %u bytes lost to UART overflow\n", bridge.textLines(), bridge.parser().errors(),
+         uartOverflow);
+  printf("Frames shown        %u, %.1f fps", framesShown,
+         framesShown > 1 ? (framesShown - 1) * 1e6 / (lastShownAt - firstShownAt) : 0.0);
+  printf(", %zu serial frames never shown, %u shown with wrong pixels, worst channel off by %d\n",
+         serialFrames.size() - latencies.size(), framesWrong, worstError);
+
+  if (!latencies.empty())
+  {
+    std::vector<uint64_t> sorted(latencies);
+    std::sort(sorted.begin(), sorted.end());
+    printf("Latency ms          p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n", percentileMs(sorted, 0.5),
+           percentileMs(sorted, 0.9), percentileMs(sorted, 0.99), sorted.back() / 1000.0);
+  }
+
+  uint64_t shownOver = lastShownAt - serialFrames.front().writtenAt;
+  printf("Goodput             %.2f kB/s delivered until the last frame was shown, %.1f%% of the bytes sent\n",
+         shownOver > 0 ? air.deliveredBytes * 1000.0 / shownOver : 0.0,
+         air.bytes > 0 ? air.deliveredBytes * 100.0 / air.bytes : 0.0);
+  printf("Radio               %u packets, %u bytes, %u retries, %u lost, air busy %.1f%%\n", air.sent, air.bytes,
+         air.retries, air.lost, air.airtimeUs * 100.0 / duration);
+  printf("Sender              %u delivered, %u failed, %u resent, %u refused, ring full %u times", txRing.delivered(),
+         txRing.failed(), txRing.retried(), txRing.refused(), txRing.full());
+  if (options.adaptive)
+  {
+    printf(", compression level %u, up to %u bits dropped, %u repair keyframes", bridge.rate().pacing().level,
+           worstQuantize, bridge.repairs());
+  }
+  printf("\n");
+  printf("Receiver            %u accepted, %u lost, %u late, %u duplicates, %u renders, %u replaced before shown\n",
+         seq.received, seq.lost, seq.late, seq.duplicates, renders.rendered, renders.dropped);
+  printf("LED output          %u LEDs on %u strips, %.2f ms per frame, latch %u ms, max %u fps\n", options.leds,
+         options.strips, outputUs / 1000.0, options.latchMs, options.maxFps);
+}